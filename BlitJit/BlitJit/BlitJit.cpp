@@ -27,11 +27,22 @@
 #include <AsmJit/Assembler.h>
 #include <AsmJit/Compiler.h>
 #include <AsmJit/Logger.h>
+#include <AsmJit/MemoryManager.h>
 
 #include "BlitJit.h"
 #include "Constants_p.h"
 #include "Generator_p.h"
 
+#include <string.h>
+
+#if defined(BLITJIT_WINDOWS)
+# include <windows.h>
+#endif // BLITJIT_WINDOWS
+
+#if defined(BLITJIT_POSIX)
+# include <sys/time.h>
+#endif // BLITJIT_POSIX
+
 namespace BlitJit {
 
 // ============================================================================
@@ -43,21 +54,144 @@ void Api::init()
   if (Constants::instance == NULL) Constants::init();
 }
 
+// ============================================================================
+// [BlitJit::Api - Prefetch]
+// ============================================================================
+
+PrefetchInfo Api::prefetchInfo[KernelCount] =
+{
+  // Src Dist | Dst Dist | Src Hint  | Dst Hint
+  { 512       , 512      , PrefetchT0, PrefetchT0 }, // KernelSimple
+  { 256       , 256      , PrefetchT0, PrefetchT0 }  // KernelComplex
+};
+
+static UInt32 getMicroseconds()
+{
+#if defined(BLITJIT_WINDOWS)
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER now;
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&now);
+
+  // now * 1000000 overflows after ~10 days of uptime with 10 MHz counter,
+  // whole seconds and remainder are converted separately.
+  return (UInt32)((now.QuadPart / frequency.QuadPart) * 1000000 +
+                  (now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+#else
+  timeval now;
+
+  gettimeofday(&now, NULL);
+  return (UInt32)(now.tv_sec * 1000000 + now.tv_usec);
+#endif
+}
+
+// Distances (in bytes) tried by calibration.
+static const SysInt calibrationDistances[] = { 128, 256, 512, 1024, 2048 };
+
+void Api::calibrate()
+{
+  init();
+
+  // Buffers must be larger than last level cache, otherwise we are measuring
+  // cache bandwidth and prefetch distance doesn't matter.
+  SysUInt len = (32 * 1024 * 1024) / 4;
+
+  UInt8* srcBuffer = (UInt8*)BLITJIT_MALLOC(len * 4 + 16);
+  UInt8* dstBuffer = (UInt8*)BLITJIT_MALLOC(len * 4 + 16);
+
+  if (srcBuffer && dstBuffer)
+  {
+    void* src = (void*)(((SysUInt)srcBuffer + 15) & ~(SysUInt)15);
+    void* dst = (void*)(((SysUInt)dstBuffer + 15) & ~(SysUInt)15);
+
+    // Semi-transparent pixels, CompositeOver can't skip them.
+    memset(src, 0x80, len * 4);
+    memset(dst, 0x40, len * 4);
+
+    const PixelFormat* pf = &pixelFormats[PixelFormat::PRGB32];
+
+    for (UInt32 kernel = 0; kernel < KernelCount; kernel++)
+    {
+      const Operator* op = &operators[(kernel == KernelSimple)
+        ? Operator::CompositeSrc
+        : Operator::CompositeOver];
+
+      SysInt bestDistance = prefetchInfo[kernel].srcDistance;
+      UInt32 bestTime = 0xFFFFFFFF;
+
+      for (SysUInt i = 0; i < BLITJIT_ARRAY_SIZE(calibrationDistances); i++)
+      {
+        SysInt distance = calibrationDistances[i];
+
+        Generator gen;
+        gen.setPrefetchDistance(distance, distance);
+        gen.genBlitSpan(pf, pf, op);
+
+        BlitSpanFn fn = AsmJit::function_cast<BlitSpanFn>(gen.c->make());
+        if (fn == NULL) continue;
+
+        // Take the best of several runs to filter out noise.
+        UInt32 time = 0xFFFFFFFF;
+        for (SysUInt run = 0; run < 3; run++)
+        {
+          UInt32 start = getMicroseconds();
+          fn(dst, src, len);
+          UInt32 delta = getMicroseconds() - start;
+          if (delta < time) time = delta;
+        }
+
+        freeFunction((void*)fn);
+
+        if (time < bestTime)
+        {
+          bestTime = time;
+          bestDistance = distance;
+        }
+      }
+
+      // Source and destination distances were measured together, hints are
+      // not calibrated.
+      prefetchInfo[kernel].srcDistance = bestDistance;
+      prefetchInfo[kernel].dstDistance = bestDistance;
+    }
+  }
+
+  if (srcBuffer) BLITJIT_FREE(srcBuffer);
+  if (dstBuffer) BLITJIT_FREE(dstBuffer);
+}
+
 // ============================================================================
 // [BlitJit::Api - Pixel Formats]
 // ============================================================================
 
 const PixelFormat Api::pixelFormats[PixelFormat::Count] = 
 {
-  // Name   | Id                 | D | RGBA Size     | RGBA Shift      | premul | float |
-  { "ARGB32", PixelFormat::ARGB32, 32,  8,  8,  8,  8, 16,  8 ,  0 , 24, false  , false },
-  { "PRGB32", PixelFormat::PRGB32, 32,  8,  8,  8,  8, 16,  8 ,  0 , 24, true   , false },
-  { "XRGB32", PixelFormat::XRGB32, 32,  8,  8,  8,  0, 16,  8 ,  0 ,  0, false  , false },
+  // Name     | Id                   | D | RGBA Size     | RGBA Shift      | premul | float |
+  { "ARGB32"  , PixelFormat::ARGB32  , 32,  8,  8,  8,  8, 16,  8 ,  0 , 24, false  , false },
+  { "PRGB32"  , PixelFormat::PRGB32  , 32,  8,  8,  8,  8, 16,  8 ,  0 , 24, true   , false },
+  { "XRGB32"  , PixelFormat::XRGB32  , 32,  8,  8,  8,  0, 16,  8 ,  0 ,  0, false  , false },
+
+  { "RGB24"   , PixelFormat::RGB24   , 24,  8,  8,  8,  0, 16,  8 ,  0 ,  0, false  , false },
+  { "BGR24"   , PixelFormat::BGR24   , 24,  8,  8,  8,  0,  0,  8 , 16 ,  0, false  , false },
+
+  { "A8"      , PixelFormat::A8      ,  8,  0,  0,  0,  8,  0,  0 ,  0 ,  0, false  , false },
+
+  { "RGBA32"  , PixelFormat::RGBA32  , 32,  8,  8,  8,  8, 24, 16 ,  8 ,  0, false  , false },
+  { "ABGR32"  , PixelFormat::ABGR32  , 32,  8,  8,  8,  8,  0,  8 , 16 , 24, false  , false },
+  { "BGRA32"  , PixelFormat::BGRA32  , 32,  8,  8,  8,  8,  8, 16 , 24 ,  0, false  , false },
+
+  { "RGB565"  , PixelFormat::RGB565  , 16,  5,  6,  5,  0, 11,  5 ,  0 ,  0, false  , false },
+  { "XRGB1555", PixelFormat::XRGB1555, 16,  5,  5,  5,  0, 10,  5 ,  0 ,  0, false  , false },
+
+  { "PRGB64"  , PixelFormat::PRGB64  , 64, 16, 16, 16, 16, 32, 16 ,  0 , 48, true   , false },
 
-  { "RGB24" , PixelFormat::RGB24 , 24,  8,  8,  8,  0, 16,  8 ,  0 ,  0, false  , false },
-  { "BGR24" , PixelFormat::BGR24 , 24,  8,  8,  8,  0,  0,  8 , 16 ,  0, false  , false },
+  { "ARGB128F", PixelFormat::ARGB128F,128, 32, 32, 32, 32, 64, 32 ,  0 , 96, false  , true  },
+  { "PRGB128F", PixelFormat::PRGB128F,128, 32, 32, 32, 32, 64, 32 ,  0 , 96, true   , true  },
 
-  { "A8"    , PixelFormat::A8    ,  8,  0,  0,  0,  8,  0,  0 ,  0 ,  0, false  , false }
+  { "I8"      , PixelFormat::I8      ,  8,  8,  8,  8,  8, 16,  8 ,  0 , 24, false  , false },
+
+  { "A1"      , PixelFormat::A1      ,  1,  0,  0,  0,  1,  0,  0 ,  0 ,  0, false  , false }
 };
 
 // ============================================================================
@@ -88,7 +222,21 @@ const Operator Api::operators[Operator::Count] =
   { "CompositeDifference" , Operator::CompositeDifference , true , true , true , true   },
   { "CompositeExclusion"  , Operator::CompositeExclusion  , true , true , true , true   },
   { "CompositeInvert"     , Operator::CompositeInvert     , true , true , true , true   },
-  { "CompositeInvertRgb"  , Operator::CompositeInvertRgb  , true , true , true , true   }
+  { "CompositeInvertRgb"  , Operator::CompositeInvertRgb  , true , true , true , true   },
+  { "CompositeOverlay"    , Operator::CompositeOverlay    , true , true , true , true   },
+  { "CompositeColorDodge" , Operator::CompositeColorDodge , true , true , true , true   },
+  { "CompositeColorBurn"  , Operator::CompositeColorBurn  , true , true , true , true   },
+  { "CompositeHardLight"  , Operator::CompositeHardLight  , true , true , true , true   },
+  { "CompositeSoftLight"  , Operator::CompositeSoftLight  , true , true , true , true   },
+  { "CompositeHue"        , Operator::CompositeHue        , true , true , true , true   },
+  { "CompositeSaturation" , Operator::CompositeSaturation , true , true , true , true   },
+  { "CompositeColor"      , Operator::CompositeColor      , true , true , true , true   },
+  { "CompositeLuminosity" , Operator::CompositeLuminosity , true , true , true , true   },
+  { "RopAnd"              , Operator::RopAnd              , true , true , false, false  },
+  { "RopOr"               , Operator::RopOr               , true , true , false, false  },
+  { "RopXor"              , Operator::RopXor              , true , true , false, false  },
+  { "RopNot"              , Operator::RopNot              , false, true , false, false  },
+  { "RopAndNot"           , Operator::RopAndNot           , true , true , false, false  }
 };
 
 // ============================================================================
@@ -101,6 +249,164 @@ void configureCompiler(AsmJit::Compiler* c)
   c->setLogger(&logger);
 }
 
+// Generated functions can't report errors, so combinations of formats,
+// operators and options that are not implemented by any module are rejected
+// here and generator returns NULL instead of generating wrong code.
+
+static bool checkConvert(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  // A1 is mask only format, I8 palette is passed only through closure.
+  if (dstPf->id() == PixelFormat::A1 || srcPf->id() == PixelFormat::A1) return false;
+  if (dstPf->id() == PixelFormat::I8 || srcPf->id() == PixelFormat::I8) return false;
+
+  return true;
+}
+
+static bool checkMask(
+  const PixelFormat* mskPf)
+{
+  return mskPf == NULL ||
+         mskPf->id() == PixelFormat::A8 ||
+         mskPf->id() == PixelFormat::A1;
+}
+
+// Mask and opacity are multiplied with source only by modules that keep both
+// source and destination in packed 32 bit pixels (Module_Fill_32_SSE2 and
+// Module_Blit_32_SSE2).
+static bool isPacked32(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  return dstPf->depth() == 32 &&
+         srcPf->depth() == 32 &&
+         !gen.useLinear(dstPf);
+}
+
+// A8 destination modules (Module_Fill_A8_SSE2 and Module_Blit_A8_SSE2) also
+// multiply source alpha by mask, they are used if source is not 64 bit or
+// float.
+static bool isMaskable(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  if (dstPf->id() == PixelFormat::A8)
+    return srcPf->depth() != 64 && !srcPf->isFloat();
+  else
+    return isPacked32(gen, dstPf, srcPf);
+}
+
+// Raster operators work on raw bits of 32 bit pixels in the same format,
+// Module_RopFill32 and Module_RopBlit32 have no mask, opacity, color key or
+// linear variant.
+static bool checkRop(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf)
+{
+  return dstPf->depth() == 32 &&
+         dstPf->id() == srcPf->id() &&
+         mskPf == NULL &&
+         !gen.useOpacity() &&
+         !gen.useColorKey() &&
+         !gen.useLinear(dstPf);
+}
+
+// Color key is handled only by Module_Blit_ColorKey_SSE2 (copy between same
+// 32 bit formats).
+static bool checkColorKey(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op)
+{
+  return op->id() == Operator::CompositeSrc &&
+         dstPf->id() == srcPf->id() &&
+         dstPf->depth() == 32 &&
+         mskPf == NULL &&
+         !gen.useOpacity();
+}
+
+static bool checkFill(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op)
+{
+  // Fill modules never read palette and there is no source to key.
+  if (!checkConvert(dstPf, srcPf)) return false;
+  if (!checkMask(mskPf)) return false;
+  if (gen.useColorKey()) return false;
+  if (op->isRop() && !checkRop(gen, dstPf, srcPf, mskPf)) return false;
+  if (mskPf != NULL && !isMaskable(gen, dstPf, srcPf)) return false;
+  if (gen.useOpacity() && !isPacked32(gen, dstPf, srcPf)) return false;
+
+  return true;
+}
+
+static bool checkBlit(
+  Generator& gen,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op)
+{
+  // I8 source is supported only if palette can be read from closure.
+  if (srcPf->id() == PixelFormat::I8 && gen.closure())
+  {
+    if (!checkConvert(dstPf, &Api::pixelFormats[PixelFormat::ARGB32])) return false;
+  }
+  else
+  {
+    if (!checkConvert(dstPf, srcPf)) return false;
+  }
+
+  if (!checkMask(mskPf)) return false;
+  if (op->isRop() && !checkRop(gen, dstPf, srcPf, mskPf)) return false;
+  if (mskPf != NULL && !isMaskable(gen, dstPf, srcPf)) return false;
+  if (gen.useOpacity() && !isPacked32(gen, dstPf, srcPf)) return false;
+  if (gen.useColorKey() && !checkColorKey(gen, dstPf, srcPf, mskPf, op)) return false;
+
+  return true;
+}
+
+// YUV loops read and write pixels by loadPixels_SSE2() and storePixels_SSE2(),
+// they handle integer formats up to 32 bits. There is no closure to read
+// palette from and A1 is not byte addressable.
+static bool checkYuvFormat(const PixelFormat* pf)
+{
+  return pf->depth() <= 32 &&
+         !pf->isFloat() &&
+         pf->id() != PixelFormat::I8 &&
+         pf->id() != PixelFormat::A1;
+}
+
+static bool checkYuv(
+  const PixelFormat* dstPf,
+  const PixelFormat* ovlPf,
+  const Operator* op,
+  UInt32 layout,
+  UInt32 matrix)
+{
+  if (layout >= YuvLayoutCount) return false;
+  if (matrix >= YuvMatrixCount) return false;
+  if (!checkYuvFormat(dstPf)) return false;
+
+  if (ovlPf != NULL)
+  {
+    if (!checkYuvFormat(ovlPf)) return false;
+    if (op == NULL || op->isRop()) return false;
+  }
+
+  return true;
+}
+
 PremultiplyFn Api::genPremultiply(
   const PixelFormat* dstPf)
 {
@@ -121,63 +427,183 @@ DemultiplyFn Api::genDemultiply(
   return AsmJit::function_cast<DemultiplyFn>(gen.c->make());
 }
 
+ConvertSpanFn Api::genConvertSpan(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkConvert(dstPf, srcPf)) return NULL;
+
+  gen.genConvertSpan(dstPf, srcPf);
+  return AsmJit::function_cast<ConvertSpanFn>(gen.c->make());
+}
+
+ConvertRectFn Api::genConvertRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkConvert(dstPf, srcPf)) return NULL;
+
+  gen.genConvertRect(dstPf, srcPf);
+  return AsmJit::function_cast<ConvertRectFn>(gen.c->make());
+}
+
 FillSpanFn Api::genFillSpan(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf, 
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkFill(gen, dstPf, srcPf, NULL, op)) return NULL;
 
   gen.genFillSpan(dstPf, srcPf, op);
   return AsmJit::function_cast<FillSpanFn>(gen.c->make());
 }
 
+FillSpanClosureFn Api::genFillSpanClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkFill(gen, dstPf, srcPf, NULL, op)) return NULL;
+
+  gen.genFillSpan(dstPf, srcPf, op);
+  return AsmJit::function_cast<FillSpanClosureFn>(gen.c->make());
+}
+
 FillSpanMaskFn Api::genFillSpanWithMask(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
   const PixelFormat* mskPf,
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkFill(gen, dstPf, srcPf, mskPf, op)) return NULL;
 
   gen.genFillSpanWithMask(dstPf, srcPf, mskPf, op);
   return AsmJit::function_cast<FillSpanMaskFn>(gen.c->make());
 }
 
+FillSpanMaskClosureFn Api::genFillSpanWithMaskClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkFill(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genFillSpanWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<FillSpanMaskClosureFn>(gen.c->make());
+}
+
 FillRectFn Api::genFillRect(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkFill(gen, dstPf, srcPf, NULL, op)) return NULL;
 
   gen.genFillRect(dstPf, srcPf, op);
   return AsmJit::function_cast<FillRectFn>(gen.c->make());
 }
 
+FillRectClosureFn Api::genFillRectClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkFill(gen, dstPf, srcPf, NULL, op)) return NULL;
+
+  gen.genFillRect(dstPf, srcPf, op);
+  return AsmJit::function_cast<FillRectClosureFn>(gen.c->make());
+}
+
 FillRectMaskFn Api::genFillRectWithMask(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
   const PixelFormat* mskPf,
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkFill(gen, dstPf, srcPf, mskPf, op)) return NULL;
 
   gen.genFillRectWithMask(dstPf, srcPf, mskPf, op);
   return AsmJit::function_cast<FillRectMaskFn>(gen.c->make());
 }
 
+FillRectMaskClosureFn Api::genFillRectWithMaskClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkFill(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genFillRectWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<FillRectMaskClosureFn>(gen.c->make());
+}
+
 BlitSpanFn Api::genBlitSpan(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkBlit(gen, dstPf, srcPf, NULL, op)) return NULL;
 
   gen.genBlitSpan(dstPf, srcPf, op);
   return AsmJit::function_cast<BlitSpanFn>(gen.c->make());
@@ -186,13 +612,362 @@ BlitSpanFn Api::genBlitSpan(
 BlitRectFn Api::genBlitRect(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
-  const Operator* op)
+  const Operator* op,
+  UInt32 options)
 {
   Generator gen;
   configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkBlit(gen, dstPf, srcPf, NULL, op)) return NULL;
 
   gen.genBlitRect(dstPf, srcPf, op);
   return AsmJit::function_cast<BlitRectFn>(gen.c->make());
 }
 
+BlitSpanMaskFn Api::genBlitSpanWithMask(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkBlit(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genBlitSpanWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<BlitSpanMaskFn>(gen.c->make());
+}
+
+BlitRectMaskFn Api::genBlitRectWithMask(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+
+  if (!checkBlit(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genBlitRectWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<BlitRectMaskFn>(gen.c->make());
+}
+
+BlitSpanMaskClosureFn Api::genBlitSpanWithMaskClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genBlitSpanWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<BlitSpanMaskClosureFn>(gen.c->make());
+}
+
+BlitRectMaskClosureFn Api::genBlitRectWithMaskClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genBlitRectWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<BlitRectMaskClosureFn>(gen.c->make());
+}
+
+BlitSpanClosureFn Api::genBlitSpanClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, srcPf, NULL, op)) return NULL;
+
+  gen.genBlitSpan(dstPf, srcPf, op);
+  return AsmJit::function_cast<BlitSpanClosureFn>(gen.c->make());
+}
+
+BlitRectClosureFn Api::genBlitRectClosure(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, srcPf, NULL, op)) return NULL;
+
+  gen.genBlitRect(dstPf, srcPf, op);
+  return AsmJit::function_cast<BlitRectClosureFn>(gen.c->make());
+}
+
+// Opacity is applied by multiplying source before the operator. For the
+// operators below it's the same as applying it after the operator, as
+// lerp(dst, op(src, dst), opacity), because they are linear in source and
+// keep destination if source is transparent.
+static bool isOpacityInterpolated(const Operator* op)
+{
+  switch (op->id())
+  {
+    case Operator::CompositeDest:
+    case Operator::CompositeOver:
+    case Operator::CompositeOverReverse:
+    case Operator::CompositeAtop:
+    case Operator::CompositeOutReverse:
+    case Operator::CompositeXor:
+    case Operator::CompositeMultiply:
+    case Operator::CompositeScreen:
+    case Operator::CompositeDarken:
+    case Operator::CompositeLighten:
+    case Operator::CompositeDifference:
+    case Operator::CompositeExclusion:
+    case Operator::CompositeInvert:
+    case Operator::CompositeInvertRgb:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+PipelineRectFn Api::genPipelineRect(
+  const PipelineStage* stages,
+  SysUInt count,
+  UInt32 options)
+{
+  const PixelFormat* srcPf = NULL;
+  const PixelFormat* mskPf = NULL;
+  const PixelFormat* dstPf = NULL;
+  const Operator* op = NULL;
+
+  // Stages must be in order fetch, [mask], [opacity], operator, [opacity],
+  // store.
+  SysUInt i = 0;
+  bool opacity = false;
+
+  if (i < count && stages[i].type == PipelineFetch) srcPf = stages[i++].pf;
+  if (i < count && stages[i].type == PipelineMask) mskPf = stages[i++].pf;
+  if (i < count && stages[i].type == PipelineOpacity) { opacity = true; i++; }
+  if (i < count && stages[i].type == PipelineOperator) op = stages[i++].op;
+  if (i < count && stages[i].type == PipelineOpacity && !opacity) { opacity = true; i++; }
+  if (i < count && stages[i].type == PipelineStore) dstPf = stages[i++].pf;
+
+  if (i != count || srcPf == NULL || dstPf == NULL || op == NULL) return NULL;
+
+  // Raster operators work on raw bits, there is nothing to mask or fade.
+  if (op->isRop()) return NULL;
+  if (opacity && !isOpacityInterpolated(op)) return NULL;
+
+  if (opacity) options |= OptionOpacity;
+
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  // Mask and opacity need 32 bit formats, they are multiplied with source
+  // inside of compositing loop.
+  if (!checkBlit(gen, dstPf, srcPf, mskPf, op)) return NULL;
+
+  gen.genBlitRectWithMask(dstPf, srcPf, mskPf, op);
+  return AsmJit::function_cast<PipelineRectFn>(gen.c->make());
+}
+
+ScaledBlitRectFn Api::genScaledBlitRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, srcPf, NULL, op)) return NULL;
+
+  gen.genScaledBlitRect(dstPf, srcPf, op);
+  return AsmJit::function_cast<ScaledBlitRectFn>(gen.c->make());
+}
+
+FilteredBlitRectFn Api::genFilteredBlitRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op,
+  UInt32 options)
+{
+  if (srcPf->depth() != 32) return NULL;
+
+  Generator gen;
+  configureCompiler(gen.c);
+  gen.setOptions(options);
+  gen.setClosure(true);
+
+  if (!checkBlit(gen, dstPf, &Api::pixelFormats[PixelFormat::PRGB32], NULL, op)) return NULL;
+
+  gen.genFilteredBlitRect(dstPf, srcPf, op);
+  return AsmJit::function_cast<FilteredBlitRectFn>(gen.c->make());
+}
+
+// Generated filter processes two pixels per iteration, tables and row are
+// padded to even count of pixels.
+static inline SysUInt filterAlign(SysUInt size)
+{
+  return (size + 15) & ~(SysUInt)15;
+}
+
+SysUInt Api::filterBufferSize(SysUInt width, SysUInt height)
+{
+  SysUInt n = (width + 1) & ~(SysUInt)1;
+
+  return filterAlign(n * 4) +
+         filterAlign(n * 8) +
+         filterAlign(n * 2) +
+         filterAlign(height * 12);
+}
+
+static Int32 filterEdge(Int32 i, Int32 size, UInt32 edgeMode)
+{
+  switch (edgeMode)
+  {
+    case EdgeRepeat:
+      i %= size;
+      if (i < 0) i += size;
+      return i;
+
+    case EdgeReflect:
+    {
+      Int32 period = size * 2;
+
+      i %= period;
+      if (i < 0) i += period;
+      return (i < size) ? i : period - 1 - i;
+    }
+
+    default:
+      if (i < 0) return 0;
+      if (i >= size) return size - 1;
+      return i;
+  }
+}
+
+void Api::prepareFilter(FilterParams* params, SysUInt width, SysUInt height)
+{
+  SysUInt n = (width + 1) & ~(SysUInt)1;
+  SysUInt i;
+
+  UInt8* p = (UInt8*)params->buffer;
+  BLITJIT_ASSERT(((SysUInt)p & 15) == 0);
+
+  params->_row = (void*)p;
+  p += filterAlign(n * 4);
+  params->_xIndex = (void*)p;
+  p += filterAlign(n * 8);
+  params->_xWeight = (void*)p;
+  p += filterAlign(n * 2);
+  params->_yTable = (void*)p;
+
+  Int32* xIndex = (Int32*)params->_xIndex;
+  UInt16* xWeight = (UInt16*)params->_xWeight;
+  Int32* yTable = (Int32*)params->_yTable;
+
+  Int32 w = (Int32)params->srcWidth;
+  Int32 h = (Int32)params->srcHeight;
+
+  // Empty source has no pixel to sample (edge modes would divide by zero).
+  BLITJIT_ASSERT(w > 0 && h > 0);
+  if (w <= 0 || h <= 0) return;
+
+  // Indices are resolved here, so generated code doesn't depend on edge mode
+  // and never reads outside of source image. Padding pixel repeats the last
+  // one. Tables are built in scalar code, repeat and reflect modes need
+  // division per index and SSE2 has no vector integer division.
+  Int32 fx = params->srcX;
+  for (i = 0; i < n; i++)
+  {
+    Int32 x = fx >> 16;
+
+    xIndex[i * 2    ] = filterEdge(x    , w, params->edgeMode);
+    xIndex[i * 2 + 1] = filterEdge(x + 1, w, params->edgeMode);
+    xWeight[i] = (UInt16)((fx >> 8) & 0xFF);
+
+    if (i + 1 < width) fx += params->stepX;
+  }
+
+  Int32 fy = params->srcY;
+  for (i = 0; i < height; i++)
+  {
+    Int32 y = fy >> 16;
+
+    yTable[i * 3    ] = filterEdge(y    , h, params->edgeMode);
+    yTable[i * 3 + 1] = filterEdge(y + 1, h, params->edgeMode);
+    yTable[i * 3 + 2] = (fy >> 8) & 0xFF;
+
+    fy += params->stepY;
+  }
+}
+
+ConvertYuvRectFn Api::genConvertYuvRect(
+  const PixelFormat* dstPf,
+  UInt32 layout,
+  UInt32 matrix)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+
+  if (!checkYuv(dstPf, NULL, NULL, layout, matrix)) return NULL;
+
+  gen.genYuvRect(dstPf, NULL, NULL, layout, matrix);
+  return AsmJit::function_cast<ConvertYuvRectFn>(gen.c->make());
+}
+
+BlitYuvRectFn Api::genBlitYuvRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* ovlPf,
+  const Operator* op,
+  UInt32 layout,
+  UInt32 matrix)
+{
+  Generator gen;
+  configureCompiler(gen.c);
+
+  if (!checkYuv(dstPf, ovlPf, op, layout, matrix)) return NULL;
+
+  gen.genYuvRect(dstPf, ovlPf, op, layout, matrix);
+  return AsmJit::function_cast<BlitYuvRectFn>(gen.c->make());
+}
+
+void Api::freeFunction(void* fn)
+{
+  AsmJit::MemoryManager::global()->free(fn);
+}
+
 } // BlitJit namespace
\ No newline at end of file
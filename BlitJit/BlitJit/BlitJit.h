@@ -148,6 +148,20 @@ typedef void (BLITJIT_CALL *PremultiplyFn)(
 typedef void (BLITJIT_CALL *DemultiplyFn)(
   void* dst, SysUInt len);
 
+// ============================================================================
+// [BlitJit - Convert Function Prototypes]
+// ============================================================================
+
+//! @brief Convert span function prototype.
+typedef void (BLITJIT_CALL *ConvertSpanFn)(
+  void* dst, const void* src, SysUInt len);
+
+//! @brief Convert rect function prototype.
+typedef void (BLITJIT_CALL *ConvertRectFn)(
+  void* dst, const void* src,
+  SysInt dstStride, SysInt srcStride,
+  SysUInt width, SysUInt height);
+
 // ============================================================================
 // [BlitJit - Span Function Prototypes]
 // ============================================================================
@@ -240,6 +254,256 @@ typedef void (BLITJIT_CALL *BlitRectMaskClosureFn)(
   SysUInt width, SysUInt height,
   const void* closure);
 
+// ============================================================================
+// [BlitJit - Closure]
+// ============================================================================
+
+//! @brief Data passed through closure argument of generated functions.
+//!
+//! Functions with closure argument are generated by @c Api::gen...Closure()
+//! methods. Generated code reads only members needed by given pixel formats
+//! and operator, other members can be left uninitialized.
+struct Closure
+{
+  //! @brief Palette used by I8 source format (256 ARGB32 entries, colors
+  //! are not premultiplied by alpha).
+  const UInt32* palette;
+
+  //! @brief Bit offset of first pixel in A1 mask (0 to 7), counted from the
+  //! most significant bit of the first mask byte.
+  UInt32 maskOffset;
+
+  //! @brief Global opacity (0 to 255) used if function was generated with
+  //! @c OptionOpacity.
+  UInt32 opacity;
+
+  //! @brief Transparent color (in source pixel format) used if function was
+  //! generated with @c OptionColorKey. Alpha (or unused) byte is ignored.
+  UInt32 colorKey;
+
+  //! @brief Maximum difference of each color component (0 to 255) from
+  //! @c colorKey for pixel to be still considered transparent, 0 means exact
+  //! match.
+  UInt32 colorKeyTolerance;
+};
+
+// ============================================================================
+// [BlitJit - Pipeline]
+// ============================================================================
+
+//! @brief Pipeline stage types.
+//!
+//! Stages must be ordered as fetch, [mask], operator, [opacity], store
+//! (opacity can be also placed before operator, result is the same). There
+//! is no separate convert stage, pixel format conversion is done by fetch
+//! and store stages (source is loaded from fetch format and result is stored
+//! in store format).
+enum PipelineStageType
+{
+  //! @brief Load source pixels (@c PipelineStage::pf is source format).
+  PipelineFetch = 0,
+  //! @brief Multiply source by mask (@c PipelineStage::pf is A8 or A1), same
+  //! as @c Api::genBlitRectWithMask().
+  PipelineMask = 1,
+  //! @brief Interpolate between destination and result of operator by 
+  //! global opacity (see @c Closure::opacity).
+  //!
+  //! Dca' = Dca + (Op(Sca, Dca) - Dca).opacity
+  //!
+  //! It's implemented by multiplying source by opacity, which gives the same
+  //! result only for operators that are linear in source and keep 
+  //! destination if source is transparent: @c Operator::CompositeDest, 
+  //! @c Operator::CompositeOver, @c Operator::CompositeOverReverse, 
+  //! @c Operator::CompositeAtop, @c Operator::CompositeOutReverse,
+  //! @c Operator::CompositeXor, @c Operator::CompositeMultiply, 
+  //! @c Operator::CompositeScreen, @c Operator::CompositeDarken,
+  //! @c Operator::CompositeLighten, @c Operator::CompositeDifference,
+  //! @c Operator::CompositeExclusion, @c Operator::CompositeInvert and
+  //! @c Operator::CompositeInvertRgb. 
+  //! Pipelines with other operators are not generated.
+  PipelineOpacity = 2,
+  //! @brief Composite source to destination (@c PipelineStage::op).
+  PipelineOperator = 3,
+  //! @brief Store pixels (@c PipelineStage::pf is destination format).
+  PipelineStore = 4
+};
+
+//! @brief Pipeline stage, see @c Api::genPipelineRect().
+struct PipelineStage
+{
+  //! @brief Stage type, see @c PipelineStageType.
+  UInt32 type;
+  //! @brief Pixel format used by fetch, mask and store stages.
+  const PixelFormat* pf;
+  //! @brief Operator used by operator stage.
+  const Operator* op;
+};
+
+//! @brief Pipeline rect function prototype.
+//!
+//! Pipelines without mask stage ignore @a msk and @a mskStride arguments.
+typedef BlitRectMaskClosureFn PipelineRectFn;
+
+// ============================================================================
+// [BlitJit - Scaling]
+// ============================================================================
+
+//! @brief Nearest neighbour scaling parameters, see 
+//! @c Api::genScaledBlitRect().
+//!
+//! Positions and steps are 16.16 fixed point numbers in source pixels. 
+//! Destination pixel [x, y] is taken from source pixel 
+//! [(x * stepX + srcX) >> 16, (y * stepY + srcY) >> 16].
+struct ScaleParams
+{
+  //! @brief Source position of first destination pixel.
+  UInt32 srcX;
+  UInt32 srcY;
+
+  //! @brief Source step per one destination pixel (0x10000 means no 
+  //! scaling, 0x8000 is 2x zoom and 0x20000 is 1/2x).
+  UInt32 stepX;
+  UInt32 stepY;
+
+  //! @brief Buffer for one row of scaled source pixels. Must be 16 byte
+  //! aligned and large enough for @c width pixels in source format.
+  void* buffer;
+};
+
+//! @brief Scaled blit rect function prototype.
+typedef void (BLITJIT_CALL *ScaledBlitRectFn)(
+  void* dst, const void* src,
+  SysInt dstStride, SysInt srcStride,
+  SysUInt width, SysUInt height,
+  const ScaleParams* scale,
+  const void* closure);
+
+//! @brief Edge modes used by filtered blit to sample pixels outside of
+//! source image.
+enum EdgeMode
+{
+  //! @brief Repeat nearest edge pixel.
+  EdgePad = 0,
+  //! @brief Tile source image.
+  EdgeRepeat = 1,
+  //! @brief Tile source image, every second tile is mirrored.
+  EdgeReflect = 2,
+
+  //! @brief Count of edge modes.
+  EdgeCount = 3
+};
+
+//! @brief Bilinear filtering parameters, see @c Api::genFilteredBlitRect().
+//!
+//! Positions and steps are signed 16.16 fixed point numbers in source pixels.
+//! Destination pixel [x, y] is interpolated between four source pixels around
+//! [x * stepX + srcX, y * stepY + srcY], so source pixel centers are at
+//! integer positions. To map pixel centers of the whole destination to pixel
+//! centers of the whole source use srcX = stepX / 2 - 0x8000 (same for Y).
+//!
+//! Edge mode, weights and source indices are resolved once per call by
+//! @c Api::prepareFilter(), generated function only reads prepared tables.
+struct FilterParams
+{
+  //! @brief Source position of first destination pixel.
+  Int32 srcX;
+  Int32 srcY;
+
+  //! @brief Source step per one destination pixel.
+  Int32 stepX;
+  Int32 stepY;
+
+  //! @brief Source image size, used by edge mode (must be non-zero).
+  UInt32 srcWidth;
+  UInt32 srcHeight;
+
+  //! @brief Edge mode, see @c EdgeMode.
+  UInt32 edgeMode;
+
+  //! @brief Buffer for tables and one filtered row. Must be 16 byte aligned
+  //! and @c Api::filterBufferSize() bytes long.
+  void* buffer;
+
+  //! @brief Filtered row (PRGB32), set by @c Api::prepareFilter().
+  void* _row;
+  //! @brief Pairs of source column indices, set by @c Api::prepareFilter().
+  void* _xIndex;
+  //! @brief Horizontal weights (16 bit), set by @c Api::prepareFilter().
+  void* _xWeight;
+  //! @brief Source row indices and vertical weights (three 32 bit integers
+  //! per row), set by @c Api::prepareFilter().
+  void* _yTable;
+};
+
+//! @brief Filtered blit rect function prototype.
+typedef void (BLITJIT_CALL *FilteredBlitRectFn)(
+  void* dst, const void* src,
+  SysInt dstStride, SysInt srcStride,
+  SysUInt width, SysUInt height,
+  const FilterParams* filter,
+  const void* closure);
+
+// ============================================================================
+// [BlitJit - YUV]
+// ============================================================================
+
+//! @brief YUV image layouts.
+enum YuvLayout
+{
+  //! @brief Y plane followed by plane with interleaved U and V samples 
+  //! (4:2:0, chroma is subsampled horizontally and vertically).
+  YuvNV12 = 0,
+  //! @brief Y, U and V planes (4:2:0).
+  YuvI420 = 1,
+  //! @brief One plane with Y0 U0 Y1 V0 macro pixels (4:2:2).
+  YuvYUY2 = 2,
+
+  //! @brief Count of YUV layouts.
+  YuvLayoutCount = 3
+};
+
+//! @brief YUV to RGB conversion matrices (limited range).
+enum YuvMatrix
+{
+  //! @brief ITU-R BT.601 (SD video).
+  YuvBT601 = 0,
+  //! @brief ITU-R BT.709 (HD video).
+  YuvBT709 = 1,
+
+  //! @brief Count of YUV matrices.
+  YuvMatrixCount = 2
+};
+
+//! @brief Multi-plane YUV source image.
+//!
+//! Plane usage depends on @c YuvLayout:
+//! - @c YuvNV12 - Y and UV planes (@c planes[2] is not used).
+//! - @c YuvI420 - Y, U and V planes.
+//! - @c YuvYUY2 - only @c planes[0] is used.
+//!
+//! Pointers point to the first row of the converted rect, chroma planes of 
+//! 4:2:0 layouts must start at even row and the rect must start at even 
+//! column.
+struct BLITJIT_HIDDEN YuvImage
+{
+  //! @brief Plane pointers.
+  const void* planes[3];
+  //! @brief Plane strides in bytes.
+  SysInt strides[3];
+};
+
+//! @brief Convert YUV rect function prototype.
+typedef void (BLITJIT_CALL *ConvertYuvRectFn)(
+  void* dst, const YuvImage* src,
+  SysInt dstStride,
+  SysUInt width, SysUInt height);
+
+//! @brief Convert YUV rect and composite overlay on it, function prototype.
+typedef void (BLITJIT_CALL *BlitYuvRectFn)(
+  void* dst, const YuvImage* src, const void* ovl,
+  SysInt dstStride, SysInt ovlStride,
+  SysUInt width, SysUInt height);
+
 // ============================================================================
 // [BlitJit - Pixel Format]
 // ============================================================================
@@ -273,7 +537,7 @@ struct BLITJIT_HIDDEN PixelFormat
   inline UInt32 bShift() const { return _bShift; }
   inline UInt32 aShift() const { return _aShift; }
 
-  inline UInt32 isPremultiplied() const { _isPremultiplied; }
+  inline UInt32 isPremultiplied() const { return _isPremultiplied; }
   inline UInt32 isFloat() const { return _isFloat; }
 
   inline bool isArgb() const { return _rSize != 0 && _gSize != 0 && _bSize != 0 && _aSize != 0; }
@@ -299,6 +563,46 @@ struct BLITJIT_HIDDEN PixelFormat
     //! @brief 8 bit alpha format used for masks.
     A8,
 
+    //! @brief 32 bit RGBA format (alpha in lowest byte), colors are not
+    //! premultiplied by alpha. Bytes in memory are A, B, G, R.
+    RGBA32,
+    //! @brief 32 bit ABGR format (red in lowest byte), colors are not
+    //! premultiplied by alpha. Bytes in memory are R, G, B, A.
+    ABGR32,
+    //! @brief 32 bit BGRA format (alpha in lowest byte), colors are not
+    //! premultiplied by alpha. Bytes in memory are A, R, G, B.
+    BGRA32,
+
+    //! @brief 16 bit RGB format (5 bits red, 6 bits green, 5 bits blue).
+    RGB565,
+    //! @brief 16 bit RGB format (5 bits for each color). Highest bit is unused.
+    XRGB1555,
+
+    //! @brief 64 bit RGB format with alpha (16 bits per component), colors
+    //! are premultiplied by alpha.
+    PRGB64,
+
+    //! @brief 128 bit RGB format with alpha (32 bit float per component), 
+    //! colors are not premultiplied by alpha.
+    ARGB128F,
+    //! @brief 128 bit RGB format with alpha (32 bit float per component), 
+    //! colors are premultiplied by alpha.
+    PRGB128F,
+
+    //! @brief 8 bit indexed format, colors are taken from @c Closure::palette.
+    //!
+    //! Can be used only as source of blit functions generated with closure
+    //! argument.
+    I8,
+
+    //! @brief 1 bit alpha format used for masks (stencils and monochrome
+    //! glyphs).
+    //!
+    //! Bits are stored from the most significant one, first pixel of span is
+    //! selected by @c Closure::maskOffset (zero if function has no closure).
+    //! Set bit means alpha 0xFF. Can be used only as mask.
+    A1,
+
     //! @brief Count of formats.
     Count
   };
@@ -337,9 +641,39 @@ struct BLITJIT_HIDDEN PixelFormat
   UInt32 _isFloat : 1;
 };
 
+//! @brief Get byte positions of blue, green, red and alpha components (in
+//! this order) of 32 bit pixel format @a pf. If format has no alpha, the
+//! position of unused byte is returned instead.
+static void getARGB32Positions(const PixelFormat* pf, UInt32* pos)
+{
+  pos[0] = pf->bShift() / 8;
+  pos[1] = pf->gShift() / 8;
+  pos[2] = pf->rShift() / 8;
+  pos[3] = pf->isAlpha() ? pf->aShift() / 8 : 6 - pos[0] - pos[1] - pos[2];
+}
+
 static UInt32 getARGB32AlphaPos(const PixelFormat* pf)
 {
-  return pf->aShift() / 8;
+  UInt32 pos[4];
+  getARGB32Positions(pf, pos);
+  return pos[3];
+}
+
+//! @brief Get pshuflw / pshufhw immediate that reorders unpacked pixels
+//! from @a srcPf channel order to @a dstPf channel order. If both formats
+//! use the same order, the result is identity shuffle (0xE4).
+static UInt32 getARGB32Swizzle(const PixelFormat* dstPf, const PixelFormat* srcPf)
+{
+  UInt32 dstPos[4];
+  UInt32 srcPos[4];
+  UInt32 i;
+  UInt32 swizzle = 0;
+
+  getARGB32Positions(dstPf, dstPos);
+  getARGB32Positions(srcPf, srcPos);
+
+  for (i = 0; i < 4; i++) swizzle |= srcPos[i] << (dstPos[i] * 2);
+  return swizzle;
 }
 
 // ============================================================================
@@ -357,6 +691,9 @@ struct BLITJIT_HIDDEN Operator
   inline UInt8 srcAlphaUsed() const { return _srcAlphaUsed; }
   inline UInt8 dstAlphaUsed() const { return _dstAlphaUsed; }
 
+  //! @brief Return true if operator is raster operator (@c RopAnd and next).
+  inline bool isRop() const { return _id >= RopAnd; }
+
   enum Id
   {
     //! @brief Source to dest (dest will be altered).
@@ -517,6 +854,104 @@ struct BLITJIT_HIDDEN Operator
     //! Da'  = Sa + Da - Sa.Da
     CompositeInvertRgb,
 
+    //! @brief Multiplies or screens the colors, depending on the destination
+    //! color (HardLight with source and destination swapped).
+    //!
+    //! Dca' = 2.Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)                if 2.Dca <= Da
+    //! Dca' = Sa.Da - 2.(Da - Dca).(Sa - Sca) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //!                                                               otherwise
+    //! Da'  = Sa + Da - Sa.Da
+    CompositeOverlay,
+
+    //! @brief Brightens the destination color to reflect the source color.
+    //!
+    //! Dca' = min(Sa.Da, Sa.Sa.Dca / (Sa - Sca)) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //! Da'  = Sa + Da - Sa.Da
+    //!
+    //! The min() term is zero if Dca is zero.
+    CompositeColorDodge,
+
+    //! @brief Darkens the destination color to reflect the source color.
+    //!
+    //! Dca' = max(0, Sa.Da - Sa.Sa.(Da - Dca) / Sca) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //! Da'  = Sa + Da - Sa.Da
+    //!
+    //! The max() term is Sa.Da if Dca is equal to Da.
+    CompositeColorBurn,
+
+    //! @brief Multiplies or screens the colors, depending on the source color.
+    //!
+    //! Dca' = 2.Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)                if 2.Sca <= Sa
+    //! Dca' = Sa.Da - 2.(Da - Dca).(Sa - Sca) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //!                                                               otherwise
+    //! Da'  = Sa + Da - Sa.Da
+    CompositeHardLight,
+
+    //! @brief Darkens or lightens the colors, depending on the source color.
+    //!
+    //! Cb = Dca / Da, B = Sa.Da.soft-light(Sca / Sa, Cb) as defined by W3C
+    //! compositing specification:
+    //!
+    //! Dca' = Dca.Sa + (2.Sca - Sa).Dca.(1 - Cb)                     if 2.Sca < Sa
+    //! Dca' = Dca.Sa + (2.Sca - Sa).Dca.((16.Cb - 12).Cb + 3)        if 4.Dca <= Da
+    //! Dca' = Dca.Sa + (2.Sca - Sa).(sqrt(Dca.Da) - Dca)             otherwise
+    //!
+    //! and Sca.(1 - Da) + Dca.(1 - Sa) is added to all of them.
+    //!
+    //! Da'  = Sa + Da - Sa.Da
+    CompositeSoftLight,
+
+    //! @brief Non-separable blend modes below use these functions (as defined
+    //! by PDF and W3C compositing specification):
+    //!
+    //! Lum(C) = 0.3.R + 0.59.G + 0.11.B
+    //! Sat(C) = max(R, G, B) - min(R, G, B)
+    //! SetLum(C, l) moves C to luminance l and clips it to gamut
+    //! SetSat(C, s) scales C to saturation s
+    //!
+    //! Da' = Sa + Da - Sa.Da for all of them.
+
+    //! @brief Hue of source with saturation and luminosity of destination.
+    //!
+    //! Dca' = SetLum(SetSat(Sc, Sat(Dc)), Lum(Dc)).Sa.Da + Sca.(1 - Da) + Dca.(1 - Sa)
+    CompositeHue,
+
+    //! @brief Saturation of source with hue and luminosity of destination.
+    //!
+    //! Dca' = SetLum(SetSat(Dc, Sat(Sc)), Lum(Dc)).Sa.Da + Sca.(1 - Da) + Dca.(1 - Sa)
+    CompositeSaturation,
+
+    //! @brief Hue and saturation of source with luminosity of destination.
+    //!
+    //! Dca' = SetLum(Sc, Lum(Dc)).Sa.Da + Sca.(1 - Da) + Dca.(1 - Sa)
+    CompositeColor,
+
+    //! @brief Luminosity of source with hue and saturation of destination.
+    //!
+    //! Dca' = SetLum(Dc, Lum(Sc)).Sa.Da + Sca.(1 - Da) + Dca.(1 - Sa)
+    CompositeLuminosity,
+
+    //! @brief Raster operators below work with raw pixel bits (alpha is not
+    //! special), so they are as fast as memcpy. They are supported only by
+    //! 32 bit formats and source and destination must have same format. 
+    //! Generators return NULL for other formats and if mask,
+    //! @c OptionOpacity, @c OptionColorKey or @c OptionLinear is used.
+
+    //! @brief D' = D & S
+    RopAnd,
+
+    //! @brief D' = D | S
+    RopOr,
+
+    //! @brief D' = D ^ S (xor rubber band, undone by second call)
+    RopXor,
+
+    //! @brief D' = ~D (source is not used)
+    RopNot,
+
+    //! @brief D' = D & ~S
+    RopAndNot,
+
     //! @brief Count of operators.
     Count
   };
@@ -562,6 +997,119 @@ enum Optimize
   OptimizeSSE2 = 2
 };
 
+// ============================================================================
+// [BlitJit - Options]
+// ============================================================================
+
+//! @brief Generator options (can be combined).
+enum Option
+{
+  //! @brief Use ordered (4x4 Bayer) dithering when storing pixels to format
+  //! with less precision than source (RGB565, XRGB1555).
+  //!
+  //! Horizontal dither phase is taken from destination address, vertical
+  //! phase from row counter in rect functions. Span functions always use first
+  //! row of dither matrix.
+  OptionDither = 0x00000001,
+
+  //! @brief Use sRGB transfer function when converting between float formats
+  //! and 8 bit formats.
+  //!
+  //! Float formats are always linear, 8 bit components are decoded from sRGB
+  //! when loaded and encoded to sRGB when stored.
+  OptionSRGB = 0x00000002,
+
+  //! @brief Composite in linear light (gamma correct fill and blit).
+  //!
+  //! 8 bit components are decoded from sRGB to linear 16 bit components, 
+  //! composited with 16 bit precision and encoded back to sRGB. PRGB64 is 
+  //! considered linear. This is slower than compositing in sRGB space, but
+  //! antialiased edges and gradients have correct brightness.
+  OptionLinear = 0x00000004,
+
+  //! @brief Multiply source by global opacity (see @c Closure::opacity).
+  //!
+  //! Used only by fill and blit functions generated with closure argument.
+  //! Supported only if source and destination are 32 bit formats (and 
+  //! @c OptionLinear is not used), generators return NULL otherwise. 
+  //! Opacity 255 uses unmodified compositing loop, opacity 0 returns without
+  //! touching destination.
+  OptionOpacity = 0x00000008,
+
+  //! @brief Use approximate division by 255 in 8 bit multiplications.
+  //!
+  //! By default products are divided by 255 with correct rounding, results
+  //! are bit exact with round(a * b / 255). There is no separate "standard"
+  //! mode, the usual (x + 0x80) * 0x0101 >> 16 sequence is the exact one.
+  //!
+  //! Approximate division computes (x + 255) >> 8, it's faster and it's exact
+  //! for a * 0 and a * 255, other results are within +-1 of correct value
+  //! (for example 138 * 243 gives 131 instead of 132).
+  OptionDiv255Approx = 0x00000010,
+
+  //! @brief Use fastest division by 255 in 8 bit multiplications.
+  //!
+  //! Products are only shifted (x >> 8), so results can be up to two less
+  //! than correct, never greater (a * 255 is not identity). Takes precedence
+  //! over @c OptionDiv255Approx.
+  OptionDiv255Fast = 0x00000020,
+
+  //! @brief Skip source pixels of key color (see @c Closure::colorKey).
+  //!
+  //! Used only by blit functions generated with closure argument, with
+  //! @c Operator::CompositeSrc and same 32 bit source and destination format
+  //! (without mask and @c OptionOpacity). Generators return NULL for other
+  //! combinations.
+  //! Pixels that don't match the key are copied, blocks of keyed pixels are
+  //! skipped without touching destination.
+  OptionColorKey = 0x00000040
+};
+
+// ============================================================================
+// [BlitJit - Prefetch]
+// ============================================================================
+
+//! @brief Kernel classes, each class has its own prefetch defaults.
+enum KernelClass
+{
+  //! @brief Simple kernels (memset, memcpy, ...), usually bandwidth bound.
+  KernelSimple = 0,
+  //! @brief Complex kernels (compositing), usually compute bound if data
+  //! are in cache.
+  KernelComplex = 1,
+
+  //! @brief Count of kernel classes.
+  KernelCount = 2
+};
+
+//! @brief Prefetch hints.
+enum PrefetchHint
+{
+  //! @brief Use hint from @c Api::prefetchInfo for given kernel class.
+  PrefetchDefault = 0,
+  //! @brief Prefetch into all cache levels.
+  PrefetchT0 = 1,
+  //! @brief Prefetch into L2 cache and higher.
+  PrefetchT1 = 2,
+  //! @brief Prefetch into L3 cache and higher.
+  PrefetchT2 = 3,
+  //! @brief Prefetch into non-temporal cache structure (minimize pollution).
+  PrefetchNTA = 4
+};
+
+//! @brief Prefetch configuration of generated loops.
+struct BLITJIT_HIDDEN PrefetchInfo
+{
+  //! @brief Source prefetch distance in bytes (ahead of current position).
+  SysInt srcDistance;
+  //! @brief Destination prefetch distance in bytes (ahead of current position).
+  SysInt dstDistance;
+  //! @brief Source prefetch hint, see @c PrefetchHint.
+  UInt32 srcHint;
+  //! @brief Destination prefetch hint, see @c PrefetchHint.
+  UInt32 dstHint;
+};
+
 // ============================================================================
 // [BlitJit - Api]
 // ============================================================================
@@ -574,6 +1122,26 @@ struct BLITJIT_API Api
 
   static void init();
 
+  //! @brief Benchmark few prefetch distances on current machine and store
+  //! the best ones to @c prefetchInfo.
+  //!
+  //! Only one distance per kernel is measured (source and destination are
+  //! prefetched at the same distance while benchmarking), the winner is stored
+  //! to both @c PrefetchInfo::srcDistance and @c PrefetchInfo::dstDistance.
+  //! Prefetch hints are not calibrated and keep their current values.
+  //!
+  //! Calibration takes hundreds of milliseconds (2 kernels, 5 distances and
+  //! 3 runs over 32 MB buffers) and allocates two 32 MB buffers, call it
+  //! once at application startup (before generating functions).
+  static void calibrate();
+
+  // --------------------------------------------------------------------------
+  // [Prefetch]
+  // --------------------------------------------------------------------------
+
+  //! @brief Prefetch defaults for each kernel class (see @c KernelClass).
+  static PrefetchInfo prefetchInfo[KernelCount];
+
   // --------------------------------------------------------------------------
   // [Pixel Formats]
   // --------------------------------------------------------------------------
@@ -590,6 +1158,10 @@ struct BLITJIT_API Api
   // [Generator]
   // --------------------------------------------------------------------------
 
+  // All generators return NULL if combination of pixel formats, operator and
+  // options is not supported (for example I8 source without closure or A1
+  // used as anything else than mask).
+
   //! @brief Generate pixel premultiply function.
   static PremultiplyFn genPremultiply(
     const PixelFormat* dstPf);
@@ -598,43 +1170,246 @@ struct BLITJIT_API Api
   static DemultiplyFn genDemultiply(
     const PixelFormat* dstPf);
 
+  //! @brief Generate span conversion function.
+  //!
+  //! Converts @a srcPf pixels to @a dstPf pixels. Colors are premultiplied or
+  //! demultiplied when needed, formats without alpha are treated as opaque
+  //! and A8 is converted to black color with given alpha (and back).
+  static ConvertSpanFn genConvertSpan(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    UInt32 options = 0);
+
+  //! @brief Generate rect conversion function.
+  //!
+  //! @a options is combination of @c Option flags, it's accepted also by
+  //! fill and blit generators.
+  static ConvertRectFn genConvertRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    UInt32 options = 0);
+
   //! @brief Generate fill span function.
   static FillSpanFn genFillSpan(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf, 
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate fill span function with closure argument.
+  //!
+  //! Closure (see @c Closure) is needed by @c OptionOpacity.
+  static FillSpanClosureFn genFillSpanClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf, 
+    const Operator* op,
+    UInt32 options = 0);
 
   //! @brief Generate fill span with mask function.
+  //!
+  //! Masks are supported only if source and destination are 32 bit formats
+  //! (and @c OptionLinear is not used) or if destination is A8 and source
+  //! is not 64 bit or float format, returns NULL otherwise.
   static FillSpanMaskFn genFillSpanWithMask(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf,
     const PixelFormat* mskPf,
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate fill span with mask function with closure argument.
+  //!
+  //! Closure (see @c Closure) is needed by A1 masks that don't start at
+  //! byte boundary.
+  static FillSpanMaskClosureFn genFillSpanWithMaskClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
 
   //! @brief Generate fill rect function.
   static FillRectFn genFillRect(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf,
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate fill rect function with closure argument.
+  static FillRectClosureFn genFillRectClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op,
+    UInt32 options = 0);
 
   //! @brief Generate fill rect with mask function.
   static FillRectMaskFn genFillRectWithMask(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf,
     const PixelFormat* mskPf,
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate fill rect with mask function with closure argument.
+  static FillRectMaskClosureFn genFillRectWithMaskClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
 
   //! @brief Generate blit span function.
   static BlitSpanFn genBlitSpan(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf,
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
 
   //! @brief Generate blit rect function.
   static BlitRectFn genBlitRect(
     const PixelFormat* dstPf,
     const PixelFormat* srcPf,
-    const Operator* op);
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit span with mask function.
+  //!
+  //! Source is multiplied by mask before it's composited to destination.
+  //! A8 and A1 masks are supported if source and destination are 32 bit
+  //! formats (and @c OptionLinear is not used) or if destination is A8 and
+  //! source is not 64 bit or float format, returns NULL otherwise.
+  static BlitSpanMaskFn genBlitSpanWithMask(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit rect with mask function.
+  static BlitRectMaskFn genBlitRectWithMask(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit span with mask function with closure argument.
+  static BlitSpanMaskClosureFn genBlitSpanWithMaskClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit rect with mask function with closure argument.
+  static BlitRectMaskClosureFn genBlitRectWithMaskClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit span function with closure argument.
+  //!
+  //! Closure (see @c Closure) is needed by I8 source format and by
+  //! @c OptionOpacity.
+  static BlitSpanClosureFn genBlitSpanClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate blit rect function with closure argument.
+  static BlitRectClosureFn genBlitRectClosure(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate pipeline rect function.
+  //!
+  //! All stages are compiled into one loop, source is fetched, masked, 
+  //! multiplied by opacity and composited while kept in registers and
+  //! destination is read and written only once. For example "src In mask,
+  //! Over dst, with opacity" is one pass instead of three.
+  //!
+  //! Mask and opacity stages are supported only by 32 bit formats and
+  //! opacity only by operators listed in @c PipelineOpacity. Raster 
+  //! operators are not supported. Returns NULL if stages are not in correct
+  //! order or if pipeline can't be compiled into single loop.
+  static PipelineRectFn genPipelineRect(
+    const PipelineStage* stages,
+    SysUInt count,
+    UInt32 options = 0);
+
+  //! @brief Generate nearest neighbour scaled blit rect function.
+  //!
+  //! Each source row is scaled to @c ScaleParams::buffer and composited to
+  //! destination row by the same loop as @c genBlitRectClosure(), so all
+  //! formats, operators and options are supported. Rows that map to the same
+  //! source row are scaled only once. 2x, 4x and 1/2x horizontal scale 
+  //! factors of 32 bit formats are expanded by SSE2 shuffles, other factors
+  //! are scaled per pixel.
+  static ScaledBlitRectFn genScaledBlitRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Generate bilinear filtered blit rect function (scale and
+  //! translation with sub-pixel precision, see @c FilterParams).
+  //!
+  //! Each destination row is filtered to premultiplied row buffer and
+  //! composited to destination by the same loop as @c genBlitRectClosure(),
+  //! no scaled copy of source image is created. Source must be 32 bit
+  //! format, returns NULL otherwise.
+  static FilteredBlitRectFn genFilteredBlitRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op,
+    UInt32 options = 0);
+
+  //! @brief Get size of @c FilterParams::buffer in bytes needed to filter
+  //! @a width x @a height destination rect.
+  static SysUInt filterBufferSize(SysUInt width, SysUInt height);
+
+  //! @brief Build tables of @a params for @a width x @a height destination
+  //! rect. Must be called after any member of @a params changes.
+  //!
+  //! @c FilterParams::srcWidth and @c FilterParams::srcHeight must be
+  //! non-zero. Tables are not built for empty source and filtered blit
+  //! function must not be called with such @a params.
+  //!
+  //! Source indices and weights are computed by scalar C++ code (one pass
+  //! over destination columns and rows), they are not vectorized. Only the
+  //! interpolation in generated function runs in 16 bit SSE2 lanes, where
+  //! the weights are broadcast and 256 - weight is computed.
+  static void prepareFilter(FilterParams* params, SysUInt width, SysUInt height);
+
+  //! @brief Generate YUV to RGB rect conversion function.
+  //!
+  //! Destination can be any integer format up to 32 bits per pixel except
+  //! I8 and A1. Video is opaque, so alpha of destination pixels is always
+  //! 0xFF. Returns NULL for unsupported format, layout or matrix.
+  static ConvertYuvRectFn genConvertYuvRect(
+    const PixelFormat* dstPf,
+    UInt32 layout,
+    UInt32 matrix = YuvBT601);
+
+  //! @brief Generate fused YUV conversion and compositing function.
+  //!
+  //! Each YUV pixel is converted to RGB, then @a ovlPf overlay (usually UI) 
+  //! is composited on it using @a op and result is stored to destination. 
+  //! This is one pass version of genConvertYuvRect() followed by 
+  //! genBlitRect() and it never reads destination. Overlay has the same
+  //! format restrictions as destination, @a op must not be NULL or raster
+  //! operator, NULL is returned otherwise.
+  static BlitYuvRectFn genBlitYuvRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* ovlPf,
+    const Operator* op,
+    UInt32 layout,
+    UInt32 matrix = YuvBT601);
 
   //! @brief Free generated function.
   static void freeFunction(void* fn);
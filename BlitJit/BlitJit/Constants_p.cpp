@@ -24,6 +24,8 @@
 // OTHER DEALINGS IN THE SOFTWARE.
 
 // [Dependencies]
+#include <math.h>
+
 #include "Constants_p.h"
 
 namespace BlitJit {
@@ -56,8 +58,87 @@ void Constants::init()
   c->_0000000000FF00000000000000FF0000.set_uw(0x0000, 0x00FF, 0x0000, 0x0000, 0x0000, 0x00FF, 0x0000, 0x0000);
   c->_00000000000000FF00000000000000FF.set_uw(0x00FF, 0x0000, 0x0000, 0x0000, 0x00FF, 0x0000, 0x0000, 0x0000);
 
+  c->_FF000000FF000000FF000000FF000000.set_ud(0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000);
+  c->_FF00FF00FF00FF00FF00FF00FF00FF00.set_ud(0xFF00FF00, 0xFF00FF00, 0xFF00FF00, 0xFF00FF00);
+  c->_0000000000FFFFFF0000000000FFFFFF.set_ud(0x00FFFFFF, 0x00000000, 0x00FFFFFF, 0x00000000);
+  c->_0000FFFFFF0000000000FFFFFF000000.set_ud(0xFF000000, 0x0000FFFF, 0xFF000000, 0x0000FFFF);
+
+  c->_437F0000437F0000437F0000437F0000.set_ud(0x437F0000, 0x437F0000, 0x437F0000, 0x437F0000);
+  c->_3F0000003F0000003F0000003F000000.set_ud(0x3F000000, 0x3F000000, 0x3F000000, 0x3F000000);
+
+  c->_00F8000000F8000000F8000000F80000.set_ud(0x00F80000, 0x00F80000, 0x00F80000, 0x00F80000);
+  c->_0000FC000000FC000000FC000000FC00.set_ud(0x0000FC00, 0x0000FC00, 0x0000FC00, 0x0000FC00);
+  c->_0000F8000000F8000000F8000000F800.set_ud(0x0000F800, 0x0000F800, 0x0000F800, 0x0000F800);
+  c->_000000F8000000F8000000F8000000F8.set_ud(0x000000F8, 0x000000F8, 0x000000F8, 0x000000F8);
+  c->_00070007000700070007000700070007.set_ud(0x00070007, 0x00070007, 0x00070007, 0x00070007);
+  c->_00070707000707070007070700070707.set_ud(0x00070707, 0x00070707, 0x00070707, 0x00070707);
+  c->_00000300000003000000030000000300.set_ud(0x00000300, 0x00000300, 0x00000300, 0x00000300);
+
+  c->_00007C0000007C0000007C0000007C00.set_ud(0x00007C00, 0x00007C00, 0x00007C00, 0x00007C00);
+  c->_000007E0000007E0000007E0000007E0.set_ud(0x000007E0, 0x000007E0, 0x000007E0, 0x000007E0);
+  c->_000003E0000003E0000003E0000003E0.set_ud(0x000003E0, 0x000003E0, 0x000003E0, 0x000003E0);
+  c->_0000001F0000001F0000001F0000001F.set_ud(0x0000001F, 0x0000001F, 0x0000001F, 0x0000001F);
+
+  c->_FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF.set_ud(0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
+  c->_FFFF000000000000FFFF000000000000.set_uw(0x0000, 0x0000, 0x0000, 0xFFFF, 0x0000, 0x0000, 0x0000, 0xFFFF);
+  c->_00008000000080000000800000008000.set_ud(0x00008000, 0x00008000, 0x00008000, 0x00008000);
+  c->_00000000FFFFFFFFFFFFFFFFFFFFFFFF.set_ud(0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x00000000);
+  c->_3B7F00FF000000000000000000000000.set_ud(0x00000000, 0x00000000, 0x00000000, 0x3B7F00FF);
+
+  c->_3F8000003F8000003F8000003F800000.set_ud(0x3F800000, 0x3F800000, 0x3F800000, 0x3F800000);
+  c->_3B8080813B8080813B8080813B808081.set_ud(0x3B808081, 0x3B808081, 0x3B808081, 0x3B808081);
+  c->_477FFF00477FFF00477FFF00477FFF00.set_ud(0x477FFF00, 0x477FFF00, 0x477FFF00, 0x477FFF00);
+  c->_37800080378000803780008037800080.set_ud(0x37800080, 0x37800080, 0x37800080, 0x37800080);
+  c->_437F0000457FF000457FF000457FF000.set_ud(0x457FF000, 0x457FF000, 0x457FF000, 0x437F0000);
+  c->_3F800000000000000000000000000000.set_ud(0x00000000, 0x00000000, 0x00000000, 0x3F800000);
+
+  c->_00100010001000100010001000100010.set_uw(0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010, 0x0010);
+  c->_00200020002000200020002000200020.set_uw(0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x0020, 0x0020);
+  c->_40000000400000004000000040000000.set_ud(0x40000000, 0x40000000, 0x40000000, 0x40000000);
+  c->_3F0040003F0040003F0040003F004000.set_ud(0x3F004000, 0x3F004000, 0x3F004000, 0x3F004000);
+
+  c->_01020408102040800102040810204080.set_ud(0x10204080, 0x01020408, 0x10204080, 0x01020408);
+
+  c->_40400000404000004040000040400000.set_ud(0x40400000, 0x40400000, 0x40400000, 0x40400000);
+  c->_41400000414000004140000041400000.set_ud(0x41400000, 0x41400000, 0x41400000, 0x41400000);
+  c->_41800000418000004180000041800000.set_ud(0x41800000, 0x41800000, 0x41800000, 0x41800000);
+
+  c->_3E99999A3E99999A3E99999A3E99999A.set_ud(0x3E99999A, 0x3E99999A, 0x3E99999A, 0x3E99999A);
+  c->_3F170A3D3F170A3D3F170A3D3F170A3D.set_ud(0x3F170A3D, 0x3F170A3D, 0x3F170A3D, 0x3F170A3D);
+  c->_3DE147AE3DE147AE3DE147AE3DE147AE.set_ud(0x3DE147AE, 0x3DE147AE, 0x3DE147AE, 0x3DE147AE);
+
+  c->_01000100010001000100010001000100.set_uw(0x0100, 0x0100, 0x0100, 0x0100, 0x0100, 0x0100, 0x0100, 0x0100);
+
   SysInt i;
 
+  // 4x4 Bayer matrix, values are added to 8 bit components before truncating
+  // them to 5 bits (offset 0...7) or 6 bits (offset 0...3).
+  static const UInt8 bayer[4][4] =
+  {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+  };
+
+  for (i = 0; i < 16; i++)
+  {
+    SysInt y = i >> 2;
+    SysInt phase = i & 3;
+    UInt32 d565[4];
+    UInt32 d555[4];
+
+    for (SysInt k = 0; k < 4; k++)
+    {
+      UInt32 d = bayer[y][(phase + k) & 3];
+      d565[k] = ((d >> 1) << 16) | ((d >> 2) << 8) | (d >> 1);
+      d555[k] = ((d >> 1) << 16) | ((d >> 1) << 8) | (d >> 1);
+    }
+
+    c->_Dither565[y][phase].set_ud(d565[0], d565[1], d565[2], d565[3]);
+    c->_Dither555[y][phase].set_ud(d555[0], d555[1], d555[2], d555[3]);
+  }
+
   for (i = 0; i < 256; i++)
   {
     UInt16 a = 0xFF;
@@ -68,6 +149,40 @@ void Constants::init()
     c->_Demultiply[3][i].set_uw(i, i, i, a);
   }
 
+  // YUV to RGB coefficients multiplied by 64:
+  //
+  //   BT.601: Y=1.164, V->R=1.596, U->G=0.392, V->G=0.813, U->B=2.017
+  //   BT.709: Y=1.164, V->R=1.793, U->G=0.213, V->G=0.533, U->B=2.112
+  //
+  // Y is 74.5, yuvToRgb_SSE2() adds the half by shift.
+  static const UInt16 yuvToRgb[2][5] =
+  {
+    { 74, 102, 25, 52, 129 },
+    { 74, 115, 14, 34, 135 }
+  };
+
+  for (i = 0; i < 10; i++)
+  {
+    UInt16 k = yuvToRgb[i / 5][i % 5];
+    c->_YuvToRgb[i / 5][i % 5].set_uw(k, k, k, k, k, k, k, k);
+  }
+
+  // sRGB transfer function (IEC 61966-2-1).
+  for (i = 0; i < 256; i++)
+  {
+    double v = (double)i / 255.0;
+    v = (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+    c->_SrgbToLinear[i] = (float)v;
+    c->_SrgbToLinear16[i] = (UInt16)(int)(v * 65535.0 + 0.5);
+  }
+
+  for (i = 0; i < 4096; i++)
+  {
+    double v = (double)i / 4095.0;
+    v = (v <= 0.0031308) ? v * 12.92 : 1.055 * pow(v, 1.0 / 2.4) - 0.055;
+    c->_LinearToSrgb[i] = (UInt8)(int)(v * 255.0 + 0.5);
+  }
+
   instance = c;
 }
 
@@ -66,9 +66,77 @@ struct BLITJIT_HIDDEN Constants
   AsmJit::XMMData _0000000000FF00000000000000FF0000; // [8]
   AsmJit::XMMData _000000FF00000000000000FF00000000; // [9]
   AsmJit::XMMData _00FF00000000000000FF000000000000; // [10]
+
+  AsmJit::XMMData _FF000000FF000000FF000000FF000000; // [11]
+  AsmJit::XMMData _FF00FF00FF00FF00FF00FF00FF00FF00; // [12]
+  AsmJit::XMMData _0000000000FFFFFF0000000000FFFFFF; // [13]
+  AsmJit::XMMData _0000FFFFFF0000000000FFFFFF000000; // [14]
+
+  AsmJit::XMMData _437F0000437F0000437F0000437F0000; // [15] 255.0f
+  AsmJit::XMMData _3F0000003F0000003F0000003F000000; // [16] 0.5f
+
+  AsmJit::XMMData _00F8000000F8000000F8000000F80000; // [17]
+  AsmJit::XMMData _0000FC000000FC000000FC000000FC00; // [18]
+  AsmJit::XMMData _0000F8000000F8000000F8000000F800; // [19]
+  AsmJit::XMMData _000000F8000000F8000000F8000000F8; // [20]
+  AsmJit::XMMData _00070007000700070007000700070007; // [21]
+  AsmJit::XMMData _00070707000707070007070700070707; // [22]
+  AsmJit::XMMData _00000300000003000000030000000300; // [23]
+
+  AsmJit::XMMData _00007C0000007C0000007C0000007C00; // [24]
+  AsmJit::XMMData _000007E0000007E0000007E0000007E0; // [25]
+  AsmJit::XMMData _000003E0000003E0000003E0000003E0; // [26]
+  AsmJit::XMMData _0000001F0000001F0000001F0000001F; // [27]
+
+  AsmJit::XMMData _FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF; // [28]
+  AsmJit::XMMData _FFFF000000000000FFFF000000000000; // [29]
+  AsmJit::XMMData _00008000000080000000800000008000; // [30]
+  AsmJit::XMMData _00000000FFFFFFFFFFFFFFFFFFFFFFFF; // [31]
+  AsmJit::XMMData _3B7F00FF000000000000000000000000; // [32] 255.0f / 65535.0f in last dword
+
+  AsmJit::XMMData _3F8000003F8000003F8000003F800000; // [33] 1.0f
+  AsmJit::XMMData _3B8080813B8080813B8080813B808081; // [34] 1.0f / 255.0f
+  AsmJit::XMMData _477FFF00477FFF00477FFF00477FFF00; // [35] 65535.0f
+  AsmJit::XMMData _37800080378000803780008037800080; // [36] 1.0f / 65535.0f
+  AsmJit::XMMData _437F0000457FF000457FF000457FF000; // [37] 4095.0f, 255.0f in last dword
+  AsmJit::XMMData _3F800000000000000000000000000000; // [38] 1.0f in last dword
+
+  AsmJit::XMMData _00100010001000100010001000100010; // [39]
+  AsmJit::XMMData _00200020002000200020002000200020; // [40]
+  AsmJit::XMMData _40000000400000004000000040000000; // [41] 2.0f
+  AsmJit::XMMData _3F0040003F0040003F0040003F004000; // [42] 0.5f + 1.0f / 1024.0f
+
+  AsmJit::XMMData _01020408102040800102040810204080; // [43] A1 mask bits (MSB first)
+
+  AsmJit::XMMData _40400000404000004040000040400000; // [44] 3.0f
+  AsmJit::XMMData _41400000414000004140000041400000; // [45] 12.0f
+  AsmJit::XMMData _41800000418000004180000041800000; // [46] 16.0f
+
+  AsmJit::XMMData _3E99999A3E99999A3E99999A3E99999A; // [47] 0.30f (red luminance)
+  AsmJit::XMMData _3F170A3D3F170A3D3F170A3D3F170A3D; // [48] 0.59f (green luminance)
+  AsmJit::XMMData _3DE147AE3DE147AE3DE147AE3DE147AE; // [49] 0.11f (blue luminance)
+
+  AsmJit::XMMData _01000100010001000100010001000100; // [50] 256 (bilinear weight sum)
+
+  //! @brief YUV to RGB coefficients [matrix][Y, V->R, U->G, V->G, U->B], 
+  //! words with 6 bit fraction.
+  AsmJit::XMMData _YuvToRgb[2][5];
+
+  //! @brief Ordered dither offsets for RGB565 [row][phase], each entry 
+  //! contains offsets for four pixels starting at given phase.
+  AsmJit::XMMData _Dither565[4][4];
+  //! @brief Ordered dither offsets for XRGB1555 [row][phase].
+  AsmJit::XMMData _Dither555[4][4];
   
   AsmJit::MMData _Demultiply[4][256];
 
+  //! @brief sRGB to linear table (8 bit sRGB component to float).
+  float _SrgbToLinear[256];
+  //! @brief sRGB to linear table (8 bit sRGB component to 16 bit).
+  UInt16 _SrgbToLinear16[256];
+  //! @brief Linear to sRGB table (12 bit linear component to 8 bit sRGB).
+  UInt8 _LinearToSrgb[4096];
+
   static Constants* instance;
 
   static void init();
@@ -32,9 +32,12 @@
 #include "Generator_p.h"
 #include "Module_p.h"
 #include "Module_Blit_p.h"
+#include "Module_Convert_p.h"
 #include "Module_Fill_p.h"
 #include "Module_MemCpy_p.h"
 #include "Module_MemSet_p.h"
+#include "Module_Rop_p.h"
+#include "Module_Premultiply_p.h"
 
 #include <new>
 
@@ -81,221 +84,6 @@ private:
   Emittable* _savedCurrent;
 };
 
-// ============================================================================
-// [BlitJit::PremultiplyModule_32_SSE2]
-// ============================================================================
-
-// TODO: Move to separate file
-
-struct PremultiplyModule_32_SSE2 : public Module_Filter
-{
-  PremultiplyModule_32_SSE2(
-    Generator* g,
-    const PixelFormat* pf);
-  virtual ~PremultiplyModule_32_SSE2();
-
-  virtual void init();
-  virtual void free();
-
-  virtual void processPixelsPtr(
-    const AsmJit::PtrRef* dst,
-    const AsmJit::PtrRef* src,
-    const AsmJit::PtrRef* msk,
-    SysInt count,
-    SysInt offset,
-    UInt32 kind,
-    UInt32 flags);
-
-  UInt32 dstAlphaPos;
-};
-
-PremultiplyModule_32_SSE2::PremultiplyModule_32_SSE2(
-  Generator* g,
-  const PixelFormat* pf) : Module_Filter(g, pf)
-{
-  _maxPixelsPerLoop = 4;
-  _complexity = Complex;
-
-  dstAlphaPos = getARGB32AlphaPos(pf);
-}
-
-PremultiplyModule_32_SSE2::~PremultiplyModule_32_SSE2()
-{
-}
-
-void PremultiplyModule_32_SSE2::init()
-{
-  g->usingXMMZero();
-}
-
-void PremultiplyModule_32_SSE2::free()
-{
-}
-
-void PremultiplyModule_32_SSE2::processPixelsPtr(
-  const AsmJit::PtrRef* dst,
-  const AsmJit::PtrRef* src,
-  const AsmJit::PtrRef* msk,
-  SysInt count,
-  SysInt offset,
-  UInt32 kind,
-  UInt32 flags)
-{
-  // TODO: Verify
-  SysUInt i = count;
-  
-  do {
-    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
-
-    if (i >= 4 && c->numFreeXmm() >= 4)
-    {
-      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
-      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
-
-      c->movq(dst0.x(), ptr(dst->c(), dstDisp));
-      c->movq(dst1.x(), ptr(dst->c(), dstDisp + 8));
-
-      c->punpcklbw(dst0.r(), g->xmmZero().r());
-      c->punpcklbw(dst1.r(), g->xmmZero().r());
-
-      g->premultiply_2x2W_SSE2(
-        dst0, dstAlphaPos, 
-        dst1, dstAlphaPos);
-
-      c->packuswb(dst0.r(), dst0.r());
-      g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, (flags & DstAligned) != 0);
-
-      offset += 4;
-      i -= 4;
-    }
-    else if (i >= 2)
-    {
-      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
-
-      c->movq(dst0.x(), ptr(dst->c(), dstDisp));
-      c->punpcklbw(dst0.r(), g->xmmZero().r());
-      g->premultiply_1x1W_SSE2(dst0, dstAlphaPos, true);
-      c->packuswb(dst0.r(), dst0.r());
-      c->movq(ptr(dst->c(), dstDisp), dst0.r());
-
-      offset += 2;
-      i -= 2;
-    }
-    else if (i >= 1)
-    {
-      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
-
-      c->movd(dst0.x(), ptr(dst->c(), dstDisp));
-      c->punpcklbw(dst0.r(), g->xmmZero().r());
-      g->premultiply_1x1W_SSE2(dst0, dstAlphaPos, false);
-      c->packuswb(dst0.r(), dst0.r());
-      c->movd(ptr(dst->c(), dstDisp), dst0.r());
-
-      offset++;
-      i--;
-    }
-  } while (i > 0);
-}
-
-// ============================================================================
-// [BlitJit::DemultiplyModule_32_SSE2]
-// ============================================================================
-
-// TODO: Move to separate file
-
-struct DemultiplyModule_32_SSE2 : public Module_Filter
-{
-  DemultiplyModule_32_SSE2(
-    Generator* g,
-    const PixelFormat* pf);
-  virtual ~DemultiplyModule_32_SSE2();
-
-  virtual void init();
-  virtual void free();
-
-  virtual void processPixelsPtr(
-    const AsmJit::PtrRef* dst,
-    const AsmJit::PtrRef* src,
-    const AsmJit::PtrRef* msk,
-    SysInt count,
-    SysInt offset,
-    UInt32 kind,
-    UInt32 flags);
-
-  UInt32 dstAlphaPos;
-};
-
-DemultiplyModule_32_SSE2::DemultiplyModule_32_SSE2(
-  Generator* g,
-  const PixelFormat* pf) : Module_Filter(g, pf)
-{
-  _maxPixelsPerLoop = 1;
-  _complexity = Complex;
-
-  dstAlphaPos = getARGB32AlphaPos(pf);
-}
-
-DemultiplyModule_32_SSE2::~DemultiplyModule_32_SSE2()
-{
-}
-
-void DemultiplyModule_32_SSE2::init()
-{
-  g->usingXMMZero();
-}
-
-void DemultiplyModule_32_SSE2::free()
-{
-}
-
-void DemultiplyModule_32_SSE2::processPixelsPtr(
-  const AsmJit::PtrRef* dst,
-  const AsmJit::PtrRef* src,
-  const AsmJit::PtrRef* msk,
-  SysInt count,
-  SysInt offset,
-  UInt32 kind,
-  UInt32 flags)
-{
-  // TODO: Verify
-  UInt32 alphaMask = (0xFF << (dstAlphaPos * 8));
-  SysUInt i = count;
-  
-  do {
-    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
-
-    Label* skip = c->newLabel();
-
-    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
-    XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
-
-    Int32Ref reg0(c->newVariable(VARIABLE_TYPE_INT32));
-    Int32Ref reg1(c->newVariable(VARIABLE_TYPE_INT32));
-
-    // Skip if alpha is 0x00 or 0xFF
-    c->mov(reg0.x(), ptr(dst->c(), dstDisp));
-    c->and_(reg0.r(), imm(alphaMask));
-    c->jz(skip);
-    c->cmp(reg0.r(), imm(alphaMask));
-    c->je(skip);
-
-    c->shr(reg0.r(), imm(dstAlphaPos * 8));
-    c->mov(reg1.x(), BLITJIT_GETCONST(g, _Demultiply[dstAlphaPos]));
-    c->movd(dst0.x(), ptr(dst->c(), dstDisp));
-    c->movq(a0.x(), ptr(reg1.r(), reg0.r(), TIMES_8));
-    c->punpcklbw(dst0.x(), g->xmmZero().c());
-
-    g->mul_1x1W_SSE2(dst0, dst0, a0);
-    c->packuswb(dst0.r(), dst0.r());
-    c->movd(ptr(dst->c(), dstDisp), dst0.r());
-
-    c->bind(skip);
-
-    offset++;
-    i--;
-  } while (i > 0);
-}
-
 // ============================================================================
 // [BlitJit::CreateModule]
 // ============================================================================
@@ -304,14 +92,44 @@ static Module_Filter* createModule_Premultiply(
   Generator* g,
   const PixelFormat* pfDst)
 {
-  return new PremultiplyModule_32_SSE2(g, pfDst);
+  return new Module_Premultiply_32_SSE2(g, pfDst);
 }
 
 static Module_Filter* createModule_Demultiply(
   Generator* g,
   const PixelFormat* pfDst)
 {
-  return new DemultiplyModule_32_SSE2(g, pfDst);
+  return new Module_Demultiply_32_SSE2(g, pfDst);
+}
+
+static Module_Blit* createModule_Convert(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  BLITJIT_ASSERT(dstPf != NULL);
+  BLITJIT_ASSERT(srcPf != NULL);
+
+  if (dstPf->id() == srcPf->id() && dstPf->depth() == 32)
+  {
+    return new Module_MemCpy32(g, dstPf, srcPf, &Api::operators[Operator::CompositeSrc]);
+  }
+  else if (dstPf->isFloat() || srcPf->isFloat())
+  {
+    return new Module_ConvertFloat_SSE2(g, dstPf, srcPf);
+  }
+  else if (dstPf->depth() == 64 || srcPf->depth() == 64)
+  {
+    return new Module_Convert64_SSE2(g, dstPf, srcPf);
+  }
+  else if (dstPf->id() == PixelFormat::A8)
+  {
+    return new Module_Blit_A8_SSE2(g, dstPf, srcPf, NULL, &Api::operators[Operator::CompositeSrc]);
+  }
+  else
+  {
+    return new Module_Convert_SSE2(g, dstPf, srcPf);
+  }
 }
 
 static Module_Fill* createModule_Fill(
@@ -324,14 +142,35 @@ static Module_Fill* createModule_Fill(
   BLITJIT_ASSERT(dstPf != NULL);
   BLITJIT_ASSERT(srcPf != NULL);
 
-  if (op->id() == Operator::CompositeSrc && dstPf->id() == srcPf->id() && mskPf == NULL)
+  if (op->isRop())
+  {
+    BLITJIT_ASSERT(dstPf->depth() == 32 && srcPf->depth() == 32);
+    return new Module_RopFill32(g, dstPf, op);
+  }
+  else if (op->id() == Operator::CompositeSrc && dstPf->id() == srcPf->id() && dstPf->depth() == 32 && mskPf == NULL && !g->useOpacity())
   {
     return new Module_MemSet32(g, dstPf, op);
   }
-  else
+  else if (dstPf->isFloat() || srcPf->isFloat())
+  {
+    return new Module_Fill_Float_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->depth() == 64 || srcPf->depth() == 64 || g->useLinear(dstPf))
+  {
+    return new Module_Fill_64_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->id() == PixelFormat::A8)
+  {
+    return new Module_Fill_A8_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->depth() == 32 && srcPf->depth() == 32)
   {
     return new Module_Fill_32_SSE2(g, dstPf, srcPf, mskPf, op);
   }
+  else
+  {
+    return new Module_Fill_Generic_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
 }
 
 static Module_Blit* createModule_Blit(
@@ -344,14 +183,40 @@ static Module_Blit* createModule_Blit(
   BLITJIT_ASSERT(dstPf != NULL);
   BLITJIT_ASSERT(srcPf != NULL);
 
-  if (op->id() == Operator::CompositeSrc && mskPf == NULL)
+  if (op->isRop())
   {
-    return new Module_MemCpy32(g, dstPf, srcPf, op);
+    BLITJIT_ASSERT(dstPf->depth() == 32 && srcPf->depth() == 32);
+    return new Module_RopBlit32(g, dstPf, srcPf, op);
   }
-  else
+  else if (op->id() == Operator::CompositeSrc && mskPf == NULL && g->useColorKey() &&
+           dstPf->id() == srcPf->id() && dstPf->depth() == 32)
+  {
+    return new Module_Blit_ColorKey_SSE2(g, dstPf, srcPf, op);
+  }
+  else if (op->id() == Operator::CompositeSrc && mskPf == NULL && !g->useOpacity())
+  {
+    return createModule_Convert(g, dstPf, srcPf);
+  }
+  else if (dstPf->isFloat() || srcPf->isFloat())
+  {
+    return new Module_Blit_Float_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->depth() == 64 || srcPf->depth() == 64 || g->useLinear(dstPf))
+  {
+    return new Module_Blit_64_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->id() == PixelFormat::A8)
+  {
+    return new Module_Blit_A8_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
+  else if (dstPf->depth() == 32 && srcPf->depth() == 32)
   {
     return new Module_Blit_32_SSE2(g, dstPf, srcPf, mskPf, op);
   }
+  else
+  {
+    return new Module_Blit_Generic_SSE2(g, dstPf, srcPf, mskPf, op);
+  }
 }
 
 // ============================================================================
@@ -427,12 +292,23 @@ Generator::Generator(Compiler* _c) : GeneratorBase(_c)
   // Turn ON prefetching by default.
   _prefetch = true;
 
+  // Use prefetch distances and hints of kernel class by default.
+  _prefetchSrcDistance = 0;
+  _prefetchDstDistance = 0;
+  _prefetchSrcHint = PrefetchDefault;
+  _prefetchDstHint = PrefetchDefault;
+
   // Turn OFF non-thermal hints by default.
   _nonThermalHint = false;
 
   // Turn OFF generating closures by default.
   _closure = false;
 
+  // No options by default.
+  _options = 0;
+  _ditherRow = NULL;
+  _closureArg = NULL;
+
   // Set main loop alignment to 16 by default.
   _mainLoopAlignment = 16;
 
@@ -464,6 +340,18 @@ void Generator::setPrefetch(bool prefetch)
   _prefetch = prefetch;
 }
 
+void Generator::setPrefetchDistance(SysInt srcDistance, SysInt dstDistance)
+{
+  _prefetchSrcDistance = srcDistance;
+  _prefetchDstDistance = dstDistance;
+}
+
+void Generator::setPrefetchHint(UInt32 srcHint, UInt32 dstHint)
+{
+  _prefetchSrcHint = srcHint;
+  _prefetchDstHint = dstHint;
+}
+
 void Generator::setNonThermalHint(bool nonThermalHint)
 {
   _nonThermalHint = nonThermalHint;
@@ -474,6 +362,11 @@ void Generator::setClosure(bool closure)
   _closure = closure;
 }
 
+void Generator::setOptions(UInt32 options)
+{
+  _options = options;
+}
+
 // ============================================================================
 // [BlitJit::Generator - Premultiply / Demultiply]
 // ============================================================================
@@ -498,6 +391,9 @@ void Generator::genPremultiply(const PixelFormat* dstPf)
   PtrRef dst(c->argument(0));
   SysIntRef cnt(c->argument(1));
 
+  cnt.alloc();
+  dst.alloc();
+
   Module_Filter* module = createModule_Premultiply(this, dstPf);
 
   Loop loop;
@@ -507,6 +403,8 @@ void Generator::genPremultiply(const PixelFormat* dstPf)
   _GenLoop(&dst, NULL, NULL, &cnt, module, 0, loop);
   module->free();
 
+  c->endFunction();
+
   delete module;
 }
 
@@ -530,6 +428,9 @@ void Generator::genDemultiply(const PixelFormat* dstPf)
   PtrRef dst(c->argument(0));
   SysIntRef cnt(c->argument(1));
 
+  cnt.alloc();
+  dst.alloc();
+
   Module_Filter* module = createModule_Demultiply(this, dstPf);
 
   Loop loop;
@@ -539,6 +440,163 @@ void Generator::genDemultiply(const PixelFormat* dstPf)
   _GenLoop(&dst, NULL, NULL, &cnt, module, 0, loop);
   module->free();
 
+  c->endFunction();
+
+  delete module;
+}
+
+// ============================================================================
+// [BlitJit::Generator - Convert Span / Rect]
+// ============================================================================
+
+// Emit t *= bytesPerPixel.
+static void mulBytesPerPixel(Compiler* c, const SysIntRef& t, SysInt bytesPerPixel)
+{
+  switch (bytesPerPixel)
+  {
+    case 1:
+      break;
+    case 2:
+      c->shl(t.r(), imm(1));
+      break;
+    case 3:
+      c->lea(t.r(), ptr(t.r(), t.r(), TIMES_2));
+      break;
+    case 4:
+      c->shl(t.r(), imm(2));
+      break;
+    case 8:
+      c->shl(t.r(), imm(3));
+      break;
+    case 16:
+      c->shl(t.r(), imm(4));
+      break;
+    default:
+      c->imul(t.r(), imm(bytesPerPixel));
+      break;
+  }
+}
+
+void Generator::genConvertSpan(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  c->comment("BlitJit::Generator::genConvertSpan() - %s <- %s",
+    dstPf->name(), srcPf->name());
+
+  f = c->newFunction(_callingConvention, BuildFunction3<void*, void*, SysUInt>());
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Conversion module
+  Module_Blit* module = createModule_Convert(this, dstPf, srcPf);
+
+  // Destination and source
+  PtrRef dst(c->argument(0));
+  PtrRef src(c->argument(1));
+  SysIntRef cnt(c->argument(2));
+
+  cnt.alloc();
+  dst.alloc();
+  src.alloc();
+
+  // Loop properties
+  Loop loop;
+  loop.finalizePointers = false;
+
+  module->init();
+  module->beginSwitch();
+
+  for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+  {
+    module->beginKind(kind);
+    _GenLoop(&dst, &src, NULL, &cnt, module, kind, loop);
+    module->endKind(kind);
+  }
+
+  module->endSwitch();
+  module->free();
+
+  c->endFunction();
+
+  // Cleanup
+  delete module;
+}
+
+void Generator::genConvertRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf)
+{
+  c->comment("BlitJit::Generator::genConvertRect() - %s <- %s",
+    dstPf->name(), srcPf->name());
+
+  f = c->newFunction(_callingConvention, BuildFunction6<void*, void*, SysInt, SysInt, SysUInt, SysUInt>());
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Conversion module
+  Module_Blit* module = createModule_Convert(this, dstPf, srcPf);
+
+  // Destination and source
+  PtrRef dst(c->argument(0));
+  PtrRef src(c->argument(1));
+  SysIntRef dstStride(c->argument(2));
+  SysIntRef srcStride(c->argument(3));
+  SysIntRef width(c->argument(4));
+  SysIntRef height(c->argument(5));
+
+  SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  // Adjust dstStride and srcStride (pixel sizes can differ)
+  {
+    SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+    c->mov(t.r(), width);
+    mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
+    c->sub(dstStride, t.r());
+
+    c->mov(t.r(), width);
+    mulBytesPerPixel(c, t, srcPf->bytesPerPixel());
+    c->sub(srcStride, t.r());
+  }
+
+  cnt.alloc();
+  dst.alloc();
+  src.alloc();
+
+  // Loop properties
+  Loop loop;
+  loop.finalizePointers = true;
+
+  // Vertical dither phase is taken from row counter (rows are counted down).
+  _ditherRow = &height;
+
+  module->init();
+  module->beginSwitch();
+
+  for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+  {
+    Label* L_Loop = c->newLabel();
+    c->bind(L_Loop);
+    c->mov(cnt.r(), width);
+
+    module->beginKind(kind);
+    _GenLoop(&dst, &src, NULL, &cnt, module, kind, loop);
+    module->endKind(kind);
+
+    c->add(dst.r(), dstStride);
+    c->add(src.r(), srcStride);
+    c->sub(height, imm(1));
+    c->jnz(L_Loop);
+  }
+
+  module->endSwitch();
+  module->free();
+  _ditherRow = NULL;
+
+  c->endFunction();
+
+  // Cleanup
   delete module;
 }
 
@@ -561,7 +619,6 @@ void Generator::genFillSpan(
   else
   {
     f = c->newFunction(_callingConvention, BuildFunction4<void*, const void*, SysUInt, void*>());
-    f->argument(3)->unuse();
   }
 
   f->setNaked(true);
@@ -585,7 +642,7 @@ void Generator::genFillSpan(
     Loop loop;
     loop.finalizePointers = false;
 
-    module->init(src);
+    _GenClosureInit(module, src, 3);
     src.unuse();
     module->beginSwitch();
 
@@ -612,9 +669,11 @@ void Generator::genFillSpanWithMask(
   const PixelFormat* pfMask,
   const Operator* op)
 {
-  c->comment("BlitJit::Generator::genFillSpan() - %s <- %s * %s : %s",
+  c->comment("BlitJit::Generator::genFillSpanWithMask() - %s <- %s * %s : %s",
     dstPf->name(), srcPf->name(), pfMask->name(), op->name());
 
+  bool maskA1 = pfMask->id() == PixelFormat::A1;
+
   if (!closure())
   {
     f = c->newFunction(_callingConvention, BuildFunction4<void*, const void*, const void*, SysUInt>());
@@ -622,7 +681,6 @@ void Generator::genFillSpanWithMask(
   else
   {
     f = c->newFunction(_callingConvention, BuildFunction5<void*, const void*, const void*, SysUInt, void*>());
-    f->argument(4)->unuse();
   }
 
   f->setNaked(true);
@@ -639,6 +697,9 @@ void Generator::genFillSpanWithMask(
     PtrRef msk(c->argument(2));
     SysIntRef cnt(c->argument(3));
 
+    // Bit offset of A1 mask (loaded from closure).
+    SysIntRef mskOffset;
+
     cnt.alloc();
     dst.alloc();
     src.alloc();
@@ -648,14 +709,17 @@ void Generator::genFillSpanWithMask(
     Loop loop;
     loop.finalizePointers = false;
 
-    module->init(src);
+    _GenClosureInit(module, src, 4, maskA1 ? &mskOffset : NULL);
     src.unuse();
     module->beginSwitch();
 
     for (UInt32 kind = 0; kind < module->numKinds(); kind++)
     {
       module->beginKind(kind);
-      _GenLoop(&dst, &src, &msk, &cnt, module, kind, loop);
+      if (maskA1)
+        _GenMaskA1Loop(&dst, NULL, &msk, &cnt, closure() ? &mskOffset : NULL, module, kind);
+      else
+        _GenLoop(&dst, &src, &msk, &cnt, module, kind, loop);
       module->endKind(kind);
     }
 
@@ -684,7 +748,6 @@ void Generator::genFillRect(
   else
   {
     f = c->newFunction(_callingConvention, BuildFunction6<void*, const void*, SysInt, SysUInt, SysUInt, void*>());
-    f->argument(5)->unuse();
   }
 
   f->setNaked(true);
@@ -709,7 +772,7 @@ void Generator::genFillRect(
       SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
 
       c->mov(t.r(), width);
-      c->shl(t.r(), 2);
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
 
       c->sub(dstStride, t.r());
     }
@@ -722,7 +785,10 @@ void Generator::genFillRect(
     Loop loop;
     loop.finalizePointers = true;
 
-    module->init(src);
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
+
+    _GenClosureInit(module, src, 5);
     src.unuse();
     module->beginSwitch();
 
@@ -745,6 +811,7 @@ void Generator::genFillRect(
 
     module->endSwitch();
     module->free();
+    _ditherRow = NULL;
   }
 
   c->endFunction();
@@ -759,53 +826,159 @@ void Generator::genFillRectWithMask(
   const PixelFormat* pfMask,
   const Operator* op)
 {
-  // TODO
-}
-
-// ============================================================================
-// [BlitJit::Generator - Blit Span / Rect]
-// ============================================================================
+  c->comment("BlitJit::Generator::genFillRectWithMask() - %s <- %s * %s : %s",
+    dstPf->name(), srcPf->name(), pfMask->name(), op->name());
 
-void Generator::genBlitSpan(
-  const PixelFormat* dstPf,
-  const PixelFormat* srcPf,
-  const Operator* op)
-{
-  c->comment("BlitJit::Generator::genBlitSpan() - %s <- %s : %s",
-    dstPf->name(), srcPf->name(), op->name());
+  bool maskA1 = pfMask->id() == PixelFormat::A1;
 
   if (!closure())
   {
-    f = c->newFunction(_callingConvention, BuildFunction3<void*, void*, SysUInt>());
+    f = c->newFunction(_callingConvention, BuildFunction7<void*, const void*, const void*, SysInt, SysInt, SysUInt, SysUInt>());
   }
   else
   {
-    f = c->newFunction(_callingConvention, BuildFunction4<void*, void*, SysUInt, void*>());
-    f->argument(3)->unuse();
+    f = c->newFunction(_callingConvention, BuildFunction8<void*, const void*, const void*, SysInt, SysInt, SysUInt, SysUInt, void*>());
   }
 
   f->setNaked(true);
   f->setAllocableEbp(true);
 
-  // Compositing module
-  Module_Blit* module = createModule_Blit(this, srcPf, dstPf, NULL, op);
+  // Filter module
+  Module_Fill* module = createModule_Fill(this, dstPf, srcPf, pfMask, op);
 
   if (!module->isNop())
   {
-    // Destination and source
+    // Destination, source and mask
     PtrRef dst(c->argument(0));
     PtrRef src(c->argument(1));
-    SysIntRef cnt(c->argument(2));
+    PtrRef msk(c->argument(2));
+    SysIntRef dstStride(c->argument(3));
+    SysIntRef mskStride(c->argument(4));
+    SysIntRef width(c->argument(5));
+    SysIntRef height(c->argument(6));
 
-    cnt.alloc();
-    dst.alloc();
+    SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+    // Bit offset of A1 mask (loaded from closure, it's same for all rows).
+    SysIntRef mskOffset;
+
+    // Adjust dstStride and mskStride. A1 loop doesn't finalize mask pointer,
+    // so mskStride is added to saved start of row instead.
+    {
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
+      c->sub(dstStride, t.r());
+
+      if (!maskA1)
+      {
+        c->mov(t.r(), width);
+        mulBytesPerPixel(c, t, pfMask->bytesPerPixel());
+        c->sub(mskStride, t.r());
+      }
+    }
+
+    PtrRef mskRow;
+    if (maskA1) mskRow.use(c->newVariable(VARIABLE_TYPE_PTR));
+
+    cnt.alloc();
+    dst.alloc();
+    src.alloc();
+    msk.alloc();
+
+    // Loop properties
+    Loop loop;
+    loop.finalizePointers = true;
+
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
+
+    _GenClosureInit(module, src, 7, maskA1 ? &mskOffset : NULL);
+    src.unuse();
+    module->beginSwitch();
+
+    for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+    {
+      module->beginKind(kind);
+
+      Label* L_Loop = c->newLabel();
+      c->bind(L_Loop);
+      c->mov(cnt.r(), width);
+
+      if (maskA1)
+      {
+        c->mov(mskRow.x(), msk.r());
+        _GenMaskA1Loop(&dst, NULL, &msk, &cnt, closure() ? &mskOffset : NULL, module, kind);
+        c->mov(msk.r(), mskRow.r());
+      }
+      else
+      {
+        _GenLoop(&dst, &src, &msk, &cnt, module, kind, loop);
+      }
+
+      c->add(dst.r(), dstStride);
+      c->add(msk.r(), mskStride);
+      c->sub(height, imm(1));
+      c->jnz(L_Loop);
+
+      module->endKind(kind);
+    }
+
+    module->endSwitch();
+    module->free();
+    _ditherRow = NULL;
+  }
+
+  c->endFunction();
+
+  // Cleanup
+  delete module;
+}
+
+// ============================================================================
+// [BlitJit::Generator - Blit Span / Rect]
+// ============================================================================
+
+void Generator::genBlitSpan(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op)
+{
+  c->comment("BlitJit::Generator::genBlitSpan() - %s <- %s : %s",
+    dstPf->name(), srcPf->name(), op->name());
+
+  if (!closure())
+  {
+    f = c->newFunction(_callingConvention, BuildFunction3<void*, void*, SysUInt>());
+  }
+  else
+  {
+    f = c->newFunction(_callingConvention, BuildFunction4<void*, void*, SysUInt, void*>());
+  }
+
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Compositing module
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, NULL, op);
+
+  if (!module->isNop())
+  {
+    // Destination and source
+    PtrRef dst(c->argument(0));
+    PtrRef src(c->argument(1));
+    SysIntRef cnt(c->argument(2));
+
+    cnt.alloc();
+    dst.alloc();
     src.alloc();
 
     // Loop properties
     Loop loop;
     loop.finalizePointers = false;
 
-    module->init();
+    _GenClosureInit(module, srcPf, 3);
     module->beginSwitch();
 
     for (UInt32 kind = 0; kind < module->numKinds(); kind++)
@@ -840,14 +1013,13 @@ void Generator::genBlitRect(
   else
   {
     f = c->newFunction(_callingConvention, BuildFunction7<void*, void*, SysInt, SysInt, SysUInt, SysUInt, void*>());
-    f->argument(6)->unuse();
   }
 
   f->setNaked(true);
   f->setAllocableEbp(true);
 
   // Compositing module
-  Module_Blit* module = createModule_Blit(this, srcPf, dstPf, NULL, op);
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, NULL, op);
 
   if (!module->isNop())
   {
@@ -866,9 +1038,11 @@ void Generator::genBlitRect(
       SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
 
       c->mov(t.r(), width);
-      c->shl(t.r(), 2);
-
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
       c->sub(dstStride, t.r());
+
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, srcPf->bytesPerPixel());
       c->sub(srcStride, t.r());
     }
 
@@ -880,27 +1054,33 @@ void Generator::genBlitRect(
     Loop loop;
     loop.finalizePointers = true;
 
-    module->init();
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
+
+    _GenClosureInit(module, srcPf, 6);
     module->beginSwitch();
 
     for (UInt32 kind = 0; kind < module->numKinds(); kind++)
     {
+      module->beginKind(kind);
+
       Label* L_Loop = c->newLabel();
       c->bind(L_Loop);
       c->mov(cnt.r(), width);
 
-      module->beginKind(kind);
       _GenLoop(&dst, &src, NULL, &cnt, module, kind, loop);
-      module->endKind(kind);
 
       c->add(dst.r(), dstStride);
       c->add(src.r(), srcStride);
       c->sub(height, imm(1));
       c->jnz(L_Loop);
+
+      module->endKind(kind);
     }
 
     module->endSwitch();
     module->free();
+    _ditherRow = NULL;
   }
 
   c->endFunction();
@@ -909,56 +1089,62 @@ void Generator::genBlitRect(
   delete module;
 }
 
-// ============================================================================
-// [BlitJit::Generator - Experimental]
-// ============================================================================
-
-void Generator::experimentalBlitSpan(
+void Generator::genBlitSpanWithMask(
   const PixelFormat* dstPf,
   const PixelFormat* srcPf,
+  const PixelFormat* pfMask,
   const Operator* op)
 {
-  c->comment("BlitJit::Generator::experimentalBlitSpan() - %s <- %s : %s",
-    dstPf->name(), srcPf->name(), op->name());
+  c->comment("BlitJit::Generator::genBlitSpanWithMask() - %s <- %s * %s : %s",
+    dstPf->name(), srcPf->name(), pfMask->name(), op->name());
+
+  bool maskA1 = pfMask->id() == PixelFormat::A1;
 
   if (!closure())
   {
-    f = c->newFunction(_callingConvention, BuildFunction3<void*, void*, SysUInt>());
+    f = c->newFunction(_callingConvention, BuildFunction4<void*, void*, const void*, SysUInt>());
   }
   else
   {
-    f = c->newFunction(_callingConvention, BuildFunction4<void*, void*, SysUInt, void*>());
-    f->argument(3)->unuse();
+    f = c->newFunction(_callingConvention, BuildFunction5<void*, void*, const void*, SysUInt, void*>());
   }
 
   f->setNaked(true);
   f->setAllocableEbp(true);
 
   // Compositing module
-  Module_Blit* module = createModule_Blit(this, srcPf, dstPf, NULL, op);
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, pfMask, op);
 
   if (!module->isNop())
   {
-    // Destination and source
+    // Destination, source and mask
     PtrRef dst(c->argument(0));
     PtrRef src(c->argument(1));
-    SysIntRef cnt(c->argument(2));
+    PtrRef msk(c->argument(2));
+    SysIntRef cnt(c->argument(3));
+
+    // Bit offset of A1 mask (loaded from closure).
+    SysIntRef mskOffset;
 
     cnt.alloc();
     dst.alloc();
     src.alloc();
+    msk.alloc();
 
     // Loop properties
     Loop loop;
     loop.finalizePointers = false;
 
-    module->init();
+    _GenClosureInit(module, srcPf, 4, maskA1 ? &mskOffset : NULL);
     module->beginSwitch();
 
     for (UInt32 kind = 0; kind < module->numKinds(); kind++)
     {
       module->beginKind(kind);
-      _GenLoop(&dst, &src, NULL, &cnt, module, kind, loop);
+      if (maskA1)
+        _GenMaskA1Loop(&dst, &src, &msk, &cnt, closure() ? &mskOffset : NULL, module, kind);
+      else
+        _GenLoop(&dst, &src, &msk, &cnt, module, kind, loop);
       module->endKind(kind);
     }
 
@@ -972,973 +1158,5381 @@ void Generator::experimentalBlitSpan(
   delete module;
 }
 
-// ==========================================================================
-// [BlitJit::Generator - Loops]
-// ==========================================================================
-
-// Calculate correct alignment. We need to use dstSize and pixels perLoop.
-// If perLoop is too short (1, maybe two pixels) alignment is in most cases
-// no necessary (for two pixels it's simple condition).
-static SysInt getAlignment(SysInt dstSize, SysInt perLoop)
+void Generator::genBlitRectWithMask(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* pfMask,
+  const Operator* op)
 {
-  SysInt align = 0;
-  if (perLoop <= 1) return align;
+  c->comment("BlitJit::Generator::genBlitRectWithMask() - %s <- %s * %s : %s",
+    dstPf->name(), srcPf->name(), pfMask ? pfMask->name() : "none", op->name());
 
-  switch (dstSize)
+  // Mask is optional (pipelines without mask stage), in this case the mask
+  // and mskStride arguments are ignored.
+  bool hasMask = pfMask != NULL;
+  bool maskA1 = hasMask && pfMask->id() == PixelFormat::A1;
+
+  if (!closure())
   {
-    case 1:
-      if      (perLoop >=16) align =16;
-      else if (perLoop >= 8) align = 8;
-      else if (perLoop >= 4) align = 4;
-      else if (perLoop >= 2) align = 2;
-      break;
-    case 2:
-      if      (perLoop >= 8) align =16;
-      else if (perLoop >= 4) align = 8;
-      else if (perLoop >= 2) align = 4;
-      break;
-    case 3:
-      align = 4;
-      break;
-    case 4:
-      align = (perLoop >= 4) ? 16 : 8;
-      break;
-    case 8:
-      align = 16;
-      break;
+    f = c->newFunction(_callingConvention, BuildFunction8<void*, void*, const void*, SysInt, SysInt, SysInt, SysUInt, SysUInt>());
+  }
+  else
+  {
+    f = c->newFunction(_callingConvention, BuildFunction9<void*, void*, const void*, SysInt, SysInt, SysInt, SysUInt, SysUInt, void*>());
   }
 
-  return align;
-}
-
-void Generator::_GenLoop(
-  PtrRef* dst,
-  PtrRef* src,
-  PtrRef* msk,
-  SysIntRef* cnt,
-  Module* module,
-  UInt32 kind,
-  const Loop& loop)
-{
-  // First calculate how the loop will be structured
-  SysInt perLoop = module->maxPixelsPerLoop();
-  SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
-  SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
-  SysInt mskSize = module->mskPf ? module->mskPf->bytesPerPixel() : 0;
+  if (!hasMask)
+  {
+    f->argument(2)->unuse();
+    f->argument(5)->unuse();
+  }
 
-  SysInt align = getAlignment(dstSize, perLoop);
+  f->setNaked(true);
+  f->setAllocableEbp(true);
 
-  // Alloc variables if they are not allocated before.
-  if (dst) dst->alloc();
-  if (src) src->alloc();
-  if (msk) msk->alloc();
+  // Compositing module
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, pfMask, op);
 
-  cnt->alloc();
+  if (!module->isNop())
+  {
+    // Destination, source and mask
+    PtrRef dst(c->argument(0));
+    PtrRef src(c->argument(1));
+    PtrRef msk;
+    SysIntRef dstStride(c->argument(3));
+    SysIntRef srcStride(c->argument(4));
+    SysIntRef mskStride;
+    SysIntRef width(c->argument(6));
+    SysIntRef height(c->argument(7));
+
+    if (hasMask)
+    {
+      msk.use(c->argument(2));
+      mskStride.use(c->argument(5));
+    }
 
-  // Save state
-  StateRef state(c->saveState());
+    SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
 
-  // Helpers
-  SysIntRef tmp(c->newVariable(VARIABLE_TYPE_SYSINT));
+    // Bit offset of A1 mask (loaded from closure, it's same for all rows).
+    SysIntRef mskOffset;
 
-  // Labels
-  Label* L_MainEntry  = (perLoop > 1) ? c->newLabel() : NULL;
-  Label* L_MainLoop   = c->newLabel();
-  Label* L_Misaligned = NULL;
-  // Only if more pixels at a time are used
-  Label* L_TailEntry  = (perLoop > 1) ? c->newLabel() : NULL;
-  Label* L_TailPre    = (perLoop > 1) ? c->newLabel() : NULL;
-  Label* L_TailLoop   = (perLoop > 1) ? c->newLabel() : NULL;
-  Label* L_TailSkipLargeJumpTable = c->newLabel();
-  // End
-  Label* L_End        = c->newLabel();
+    // Adjust dstStride, srcStride and mskStride. A1 loop doesn't finalize 
+    // mask pointer, so mskStride is added to saved start of row instead.
+    {
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
 
-  // We need one temporary variable for alignment
-  if (align != 0) tmp.alloc();
-  c->clearPrevented();
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
+      c->sub(dstStride, t.r());
 
-  // Skip alignment and main loop if cnt is too small (to be useful)
-  if (perLoop > 1 && align)
-  {
-    c->cmp(cnt->r(), imm(perLoop));
-    c->jb(L_TailLoop);
-  }
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, srcPf->bytesPerPixel());
+      c->sub(srcStride, t.r());
 
-  // Align 4 bytes dst to 8 bytes. We are using trick that if alignment
-  // fail, we will continue into main loop, because this type of alignment
-  // is usually used together with MMX or X64 modes (no SSE and unaligned
-  // exceptions here)
-  if (dstSize == 4 && align == 8)
-  {
-    c->mov(tmp.x(), dst->r());
-    c->and_(tmp.r(), imm(7));
-    c->jz(L_MainEntry);
-    tmp.unuse();
+      if (hasMask && !maskA1)
+      {
+        c->mov(t.r(), width);
+        mulBytesPerPixel(c, t, pfMask->bytesPerPixel());
+        c->sub(mskStride, t.r());
+      }
+    }
 
-    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-    if (dst) c->add(dst->r(), imm(dstSize));
-    if (src) c->add(src->r(), imm(srcSize));
-    if (msk) c->add(msk->r(), imm(mskSize));
-    c->sub(cnt->r(), imm(1));
-  }
-  // Align 4 bytes dst to 16 bytes. This is hardest job, because we must
-  // ensure that destination is aligned for instructions that needs it.
-  // This is reason for last check and bail into tail loop if destination
-  // is totally misaligned (this shouldn't happpen, but we must be sure).
-  else if (dstSize == 4 && align == 16)
-  {
-    // Calculate how many pixels needs to be aligned
-    c->xor_(tmp.x(), tmp.x());
-    c->sub(tmp.r(), dst->r());
-    c->and_(tmp.r(), imm(15));
-    // Alignment not needed, jump to main loop entry
-    c->jz(L_MainEntry);
+    PtrRef mskRow;
+    if (maskA1) mskRow.use(c->newVariable(VARIABLE_TYPE_PTR));
 
-    c->shr(tmp.r(), imm(2));
-    c->sub(cnt->r(), tmp.r());
+    cnt.alloc();
+    dst.alloc();
+    src.alloc();
+    if (hasMask) msk.alloc();
 
-    Label* L_AlignLoop = c->newLabel();
-    c->bind(L_AlignLoop);
-    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-    if (dst) c->add(dst->r(), imm(dstSize));
-    if (src) c->add(src->r(), imm(srcSize));
-    if (msk) c->add(msk->r(), imm(mskSize));
-    c->sub(tmp.r(), imm(1));
-    c->jnz(L_AlignLoop);
+    // Loop properties
+    Loop loop;
+    loop.finalizePointers = true;
 
-    // Make sure that dst is aligned to 16 bytes
-    c->mov(tmp.x(), dst->r());
-    c->and_(tmp.r(), imm(15));
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
 
-    if (module->complexity() == Module::Simple)
-    {
-      L_Misaligned = c->newLabel();
-      c->jnz(L_Misaligned);
-    }
-    else
-    {
-      c->jnz(L_TailLoop);
-    }
-    tmp.unuse();
-  }
-  // TODO: Not implemented
-  else if (align)
-  {
-    BLITJIT_ASSERT(0);
-  }
+    _GenClosureInit(module, srcPf, 8, maskA1 ? &mskOffset : NULL);
+    module->beginSwitch();
 
-  // Main Loop
-  if (perLoop > 1)
-  {
-    // More pixels at a time
-    c->bind(L_MainEntry);
-    c->sub(cnt->r(), imm(perLoop));
-    c->jc(L_TailEntry);
+    for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+    {
+      module->beginKind(kind);
 
-    c->align(_mainLoopAlignment);
-    c->bind(L_MainLoop);
+      Label* L_Loop = c->newLabel();
+      c->bind(L_Loop);
+      c->mov(cnt.r(), width);
 
-    if (src && _prefetch && module->prefetchSrc()) c->prefetch(ptr(src->r(), perLoop * srcSize), PREFETCH_T0);
-    if (dst && _prefetch && module->prefetchDst()) c->prefetch(ptr(dst->r(), perLoop * dstSize), PREFETCH_T0);
+      if (maskA1)
+      {
+        c->mov(mskRow.x(), msk.r());
+        _GenMaskA1Loop(&dst, &src, &msk, &cnt, closure() ? &mskOffset : NULL, module, kind);
+        c->mov(msk.r(), mskRow.r());
+      }
+      else
+      {
+        _GenLoop(&dst, &src, hasMask ? &msk : NULL, &cnt, module, kind, loop);
+      }
 
-    module->processPixelsPtr(dst, src, msk, perLoop, 0, kind, Module::DstAligned);
-    if (dst) c->add(dst->r(), imm(perLoop * dstSize));
-    if (src) c->add(src->r(), imm(perLoop * srcSize));
-    if (msk) c->add(msk->r(), imm(perLoop * mskSize));
-    c->sub(cnt->r(), imm(perLoop));
-    c->jnc(L_MainLoop);
-  }
-  else
-  {
-    // One pixel at a time
-    c->align(_mainLoopAlignment);
-    c->bind(L_MainLoop);
-    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-    if (dst) c->add(dst->r(), imm(dstSize));
-    if (src) c->add(src->r(), imm(srcSize));
-    if (msk) c->add(msk->r(), imm(mskSize));
-    c->sub(cnt->r(), imm(1));
-    c->jnz(L_MainLoop);
-  }
+      c->add(dst.r(), dstStride);
+      c->add(src.r(), srcStride);
+      if (hasMask) c->add(msk.r(), mskStride);
+      c->sub(height, imm(1));
+      c->jnz(L_Loop);
 
-  if (L_Misaligned)
-  {
-    bool embedMisalignedTail = (perLoop > 8 && module->complexity() == Module::Simple);
+      module->endKind(kind);
+    }
 
-    OutsideBlock block(c);
-    Label* L_MisalignedLoop = c->newLabel();
-    Label* L_MisalignedTailEntry = embedMisalignedTail
-      ? c->newLabel() 
-      : L_TailEntry;
+    module->endSwitch();
+    module->free();
+    _ditherRow = NULL;
+  }
 
-    // More pixels at a time
-    c->bind(L_Misaligned);
-    c->sub(cnt->r(), imm(perLoop));
-    c->jc(L_MisalignedTailEntry);
+  c->endFunction();
 
-    c->align(_mainLoopAlignment);
-    c->bind(L_MisalignedLoop);
+  // Cleanup
+  delete module;
+}
 
-    if (src && _prefetch && module->prefetchSrc()) c->prefetch(ptr(src->r(), perLoop * srcSize), PREFETCH_T0);
-    if (dst && _prefetch && module->prefetchDst()) c->prefetch(ptr(dst->r(), perLoop * dstSize), PREFETCH_T0);
+// ============================================================================
+// [BlitJit::Generator - Scaling]
+// ============================================================================
 
-    module->processPixelsPtr(dst, src, msk, perLoop, 0, kind, 0);
-    if (dst) c->add(dst->r(), imm(perLoop * dstSize));
-    if (src) c->add(src->r(), imm(perLoop * srcSize));
-    if (msk) c->add(msk->r(), imm(perLoop * mskSize));
-    c->sub(cnt->r(), imm(perLoop));
-    c->jnc(L_MisalignedLoop);
+void Generator::genScaledBlitRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op)
+{
+  c->comment("BlitJit::Generator::genScaledBlitRect() - %s <- %s : %s",
+    dstPf->name(), srcPf->name(), op->name());
 
-    if (!embedMisalignedTail)
-    {
-      c->jmp(L_TailEntry);
-    }
-    else
-    {
-      // Misaligned tail loop
-      JumpTable* jumpTable = c->newJumpTable();
-      jumpTable->addLabel(L_TailSkipLargeJumpTable, 0);
+  f = c->newFunction(_callingConvention, BuildFunction8<void*, void*, SysInt, SysInt, SysUInt, SysUInt, const void*, void*>());
 
-      tmp.use(c->newVariable(VARIABLE_TYPE_SYSINT));
-      c->mov(tmp.x(), cnt->r());
-      c->shr(tmp.r(), 2);
-      c->jumpToTable(jumpTable, tmp.r());
-      tmp.unuse();
+  f->setNaked(true);
+  f->setAllocableEbp(true);
 
-      for (SysInt j = (perLoop / 4) - 1; j > 0; j--)
-      {
-        c->bind(jumpTable->addLabel(NULL, j));
-        module->processPixelsPtr(dst, src, msk, 4, 0, kind, 0);
-        if (dst) c->add(dst->r(), imm(dstSize * 4));
-        if (src) c->add(src->r(), imm(srcSize * 4));
-        if (msk) c->add(msk->r(), imm(mskSize * 4));
-      }
-      c->and_(cnt->r(), 3);
-      c->jmp(L_TailSkipLargeJumpTable);
-    }
-  }
+  // Compositing module
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, NULL, op);
 
-  // Tail (only if more pixels at a time loop is used)
-  if (perLoop == 1)
-  {
-    // NOP
-  }
-  else if (perLoop == 2)
+  if (!module->isNop())
   {
-    // Two pixels at a time, it's only needed to process remaining pixel
-    c->bind(L_TailEntry);
-    c->add(cnt->r(), imm(2));
-    c->jz(L_End);
+    // Destination, source and scale parameters
+    PtrRef dst(c->argument(0));
+    PtrRef src(c->argument(1));
+    SysIntRef dstStride(c->argument(2));
+    SysIntRef srcStride(c->argument(3));
+    SysIntRef width(c->argument(4));
+    SysIntRef height(c->argument(5));
+    PtrRef scale(c->argument(6));
 
-    c->bind(L_TailLoop);
-    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-    if (loop.finalizePointers)
+    SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
+    SysIntRef fy(c->newVariable(VARIABLE_TYPE_SYSINT));
+    SysIntRef lastRow(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+    // Adjust dstStride, source is read from the row buffer.
     {
-      if (dst) c->add(dst->r(), imm(dstSize));
-      if (src) c->add(src->r(), imm(srcSize));
-      if (msk) c->add(msk->r(), imm(mskSize));
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
+      c->sub(dstStride, t.r());
     }
-  }
-  else if (module->complexity() == Module::Simple)
-  {
-    SysInt i = perLoop;
 
-    // Jump table based loop for simple operators
-    c->bind(L_TailEntry);
-    c->add(cnt->r(), imm(perLoop));
-    c->jz(L_End);
+    c->mov(fy.x32(), dword_ptr(scale.c(), BLITJIT_DISPSCALE(srcY)));
 
-    c->bind(L_TailLoop);
+    cnt.alloc();
+    dst.alloc();
 
-    if (i > 8)
+    // Loop properties
+    Loop loop;
+    loop.finalizePointers = true;
+
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
+
+    _GenClosureInit(module, srcPf, 7);
+    module->beginSwitch();
+
+    for (UInt32 kind = 0; kind < module->numKinds(); kind++)
     {
-      JumpTable* jumpTable = c->newJumpTable();
-      jumpTable->addLabel(L_TailSkipLargeJumpTable, 0);
+      module->beginKind(kind);
 
-      tmp.use(c->newVariable(VARIABLE_TYPE_SYSINT));
-      c->mov(tmp.x(), cnt->r());
-      c->shr(tmp.r(), 2);
-      c->jumpToTable(jumpTable, tmp.r());
-      tmp.unuse();
+      Label* L_Loop = c->newLabel();
+      Label* L_Composite = c->newLabel();
 
-      for (SysInt j = (i / 4) - 1; j > 0; j--, i -= 4)
+      // No source row is in buffer.
+      c->mov(lastRow.x(), imm(-1));
+
+      c->bind(L_Loop);
+
+      // Scale source row to buffer, skipped if it's the same row as before
+      // (zoom in vertical direction).
       {
-        c->bind(jumpTable->addLabel(NULL, j));
-        module->processPixelsPtr(dst, src, msk, 4, 0, kind, Module::DstAligned);
-        if (dst) c->add(dst->r(), imm(dstSize * 4));
-        if (src) c->add(src->r(), imm(srcSize * 4));
-        if (msk) c->add(msk->r(), imm(mskSize * 4));
+        SysIntRef row(c->newVariable(VARIABLE_TYPE_SYSINT));
+        SysIntRef fx(c->newVariable(VARIABLE_TYPE_SYSINT));
+        SysIntRef stepX(c->newVariable(VARIABLE_TYPE_SYSINT));
+        PtrRef srow(c->newVariable(VARIABLE_TYPE_PTR));
+        PtrRef buf(c->newVariable(VARIABLE_TYPE_PTR));
+
+        c->mov(row.x(), fy.r());
+        c->shr(row.r(), imm(16));
+        c->cmp(row.r(), lastRow.r());
+        c->je(L_Composite);
+        c->mov(lastRow.x(), row.r());
+
+        c->imul(row.r(), srcStride.c());
+        c->mov(srow.x(), src.c());
+        c->add(srow.r(), row.r());
+
+        c->mov(buf.x(), ptr(scale.c(), BLITJIT_DISPSCALE(buffer)));
+        c->mov(fx.x32(), dword_ptr(scale.c(), BLITJIT_DISPSCALE(srcX)));
+        c->mov(stepX.x32(), dword_ptr(scale.c(), BLITJIT_DISPSCALE(stepX)));
+        c->mov(cnt.r(), width);
+
+        _GenScaleRow(buf, srow, cnt, fx, stepX, srcPf->bytesPerPixel());
       }
-      c->and_(cnt->r(), 3);
-      c->bind(L_TailSkipLargeJumpTable);
-    }
 
-    // Last few pixels will be processed through jump table
-    {
-      JumpTable* jumpTable = c->newJumpTable();
-      jumpTable->addLabel(L_End, 0);
+      // Composite buffer to destination row.
+      c->bind(L_Composite);
+      {
+        PtrRef buf(c->newVariable(VARIABLE_TYPE_PTR));
 
-      // cnt is modified by jumpToTable().
-      c->jumpToTable(jumpTable, cnt->r());
+        c->mov(buf.x(), ptr(scale.c(), BLITJIT_DISPSCALE(buffer)));
+        c->mov(cnt.r(), width);
 
-      for (i--; i > 0; i--)
-      {
-        c->bind(jumpTable->addLabel(NULL, i));
-        module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-        if (dst) c->add(dst->r(), imm(dstSize));
-        if (src) c->add(src->r(), imm(srcSize));
-        if (msk) c->add(msk->r(), imm(mskSize));
+        _GenLoop(&dst, &buf, NULL, &cnt, module, kind, loop);
       }
+
+      c->add(dst.r(), dstStride);
+      c->add(fy.r32(), dword_ptr(scale.c(), BLITJIT_DISPSCALE(stepY)));
+      c->sub(height, imm(1));
+      c->jnz(L_Loop);
+
+      module->endKind(kind);
     }
-  }
-  else
-  {
-    // Complex operators
-    c->bind(L_TailEntry);
-    c->add(cnt->r(), imm(perLoop));
-    c->jz(L_End);
 
-    c->bind(L_TailLoop);
-    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
-    if (dst) c->add(dst->r(), imm(dstSize));
-    if (src) c->add(src->r(), imm(srcSize));
-    if (msk) c->add(msk->r(), imm(mskSize));
-    c->sub(cnt->r(), imm(1));
-    c->jnz(L_TailLoop);
+    module->endSwitch();
+    module->free();
+    _ditherRow = NULL;
   }
 
-  // End
-  c->bind(L_End);
+  c->endFunction();
 
-  BLITJIT_ASSERT(!L_TailSkipLargeJumpTable->isLinked());
+  // Cleanup
+  delete module;
 }
 
-// ============================================================================
-// [BlitJit::Generator - Mov Helpers]
-// ============================================================================
-
-void Generator::loadD(const SysIntRef& dst, const Mem& src)
+void Generator::_GenScaleRow(
+  const PtrRef& dst,
+  const PtrRef& src,
+  const SysIntRef& cnt,
+  const SysIntRef& fx,
+  const SysIntRef& stepX,
+  SysInt bytesPerPixel)
 {
-  c->mov(dst.x32(), src);
-}
+  Label* L_Generic = c->newLabel();
+  Label* L_End = c->newLabel();
 
-#if defined(ASMJIT_X64)
-void Generator::loadQ(const SysIntRef& dst, const Mem& src)
-{
-  c->mov(dst.x64(), src);
+  // Integer scale factors of 32 bit pixels are expanded by shuffles, source
+  // position must be at pixel boundary. Fast loops leave the rest of the row
+  // (less than one block) to generic loop.
+  if (bytesPerPixel == 4)
+  {
+    Label* L_Zoom2 = c->newLabel();
+    Label* L_Zoom4 = c->newLabel();
+    Label* L_Shrink2 = c->newLabel();
+
+    c->test(fx.r32(), imm(0xFFFF));
+    c->jnz(L_Generic);
+
+    c->cmp(stepX.r32(), imm(0x8000));
+    c->je(L_Zoom2);
+    c->cmp(stepX.r32(), imm(0x4000));
+    c->je(L_Zoom4);
+    c->cmp(stepX.r32(), imm(0x20000));
+    c->je(L_Shrink2);
+    c->jmp(L_Generic);
+
+    // 2x: 4 source pixels -> 8 destination pixels.
+    {
+      OutsideBlock block(c);
+
+      Label* L_Loop = c->newLabel();
+      Label* L_Tail = c->newLabel();
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+      PtrRef p(c->newVariable(VARIABLE_TYPE_PTR));
+
+      c->bind(L_Zoom2);
+      c->mov(p.x(), fx.r());
+      c->shr(p.r(), imm(16));
+      c->lea(p.r(), ptr(src.c(), p.r(), TIMES_4));
+
+      c->sub(cnt.r(), imm(8));
+      c->jc(L_Tail);
+
+      c->bind(L_Loop);
+      c->movdqu(t0.x(), ptr(p.c()));
+      c->pshufd(t1.x(), t0.r(), imm(mm_shuffle(1, 1, 0, 0)));
+      c->pshufd(t0.r(), t0.r(), imm(mm_shuffle(3, 3, 2, 2)));
+      c->movdqa(ptr(dst.c()), t1.r());
+      c->movdqa(ptr(dst.c(), 16), t0.r());
+
+      c->add(p.r(), imm(16));
+      c->add(dst.r(), imm(32));
+      c->add(fx.r(), imm(0x8000 * 8));
+      c->sub(cnt.r(), imm(8));
+      c->jnc(L_Loop);
+
+      c->bind(L_Tail);
+      c->add(cnt.r(), imm(8));
+      c->jmp(L_Generic);
+    }
+
+    // 4x: 4 source pixels -> 16 destination pixels.
+    {
+      OutsideBlock block(c);
+
+      Label* L_Loop = c->newLabel();
+      Label* L_Tail = c->newLabel();
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+      PtrRef p(c->newVariable(VARIABLE_TYPE_PTR));
+
+      c->bind(L_Zoom4);
+      c->mov(p.x(), fx.r());
+      c->shr(p.r(), imm(16));
+      c->lea(p.r(), ptr(src.c(), p.r(), TIMES_4));
+
+      c->sub(cnt.r(), imm(16));
+      c->jc(L_Tail);
+
+      c->bind(L_Loop);
+      c->movdqu(t0.x(), ptr(p.c()));
+      c->pshufd(t1.x(), t0.r(), imm(mm_shuffle(0, 0, 0, 0)));
+      c->movdqa(ptr(dst.c()), t1.r());
+      c->pshufd(t1.x(), t0.r(), imm(mm_shuffle(1, 1, 1, 1)));
+      c->movdqa(ptr(dst.c(), 16), t1.r());
+      c->pshufd(t1.x(), t0.r(), imm(mm_shuffle(2, 2, 2, 2)));
+      c->movdqa(ptr(dst.c(), 32), t1.r());
+      c->pshufd(t1.x(), t0.r(), imm(mm_shuffle(3, 3, 3, 3)));
+      c->movdqa(ptr(dst.c(), 48), t1.r());
+
+      c->add(p.r(), imm(16));
+      c->add(dst.r(), imm(64));
+      c->add(fx.r(), imm(0x4000 * 16));
+      c->sub(cnt.r(), imm(16));
+      c->jnc(L_Loop);
+
+      c->bind(L_Tail);
+      c->add(cnt.r(), imm(16));
+      c->jmp(L_Generic);
+    }
+
+    // 1/2x: 7 source pixels -> 4 destination pixels (0, 2, 4, 6). Second
+    // load starts at pixel 3, so nothing after pixel 6 is read.
+    {
+      OutsideBlock block(c);
+
+      Label* L_Loop = c->newLabel();
+      Label* L_Tail = c->newLabel();
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+      PtrRef p(c->newVariable(VARIABLE_TYPE_PTR));
+
+      c->bind(L_Shrink2);
+      c->mov(p.x(), fx.r());
+      c->shr(p.r(), imm(16));
+      c->lea(p.r(), ptr(src.c(), p.r(), TIMES_4));
+
+      c->sub(cnt.r(), imm(4));
+      c->jc(L_Tail);
+
+      c->bind(L_Loop);
+      c->movdqu(t0.x(), ptr(p.c()));
+      c->movdqu(t1.x(), ptr(p.c(), 12));
+      c->shufps(t0.r(), t1.r(), imm(mm_shuffle(3, 1, 2, 0)));
+      c->movdqa(ptr(dst.c()), t0.r());
+
+      c->add(p.r(), imm(32));
+      c->add(dst.r(), imm(16));
+      c->add(fx.r(), imm(0x20000 * 4));
+      c->sub(cnt.r(), imm(4));
+      c->jnc(L_Loop);
+
+      c->bind(L_Tail);
+      c->add(cnt.r(), imm(4));
+      c->jmp(L_Generic);
+    }
+  }
+
+  // Generic loop, one pixel per iteration.
+  c->bind(L_Generic);
+  c->test(cnt.r(), cnt.r());
+  c->jz(L_End);
+
+  {
+    Label* L_Loop = c->newLabel();
+    SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+    Int32Ref v(c->newVariable(VARIABLE_TYPE_INT32));
+    XMMRef x(c->newVariable(VARIABLE_TYPE_XMM));
+
+    c->bind(L_Loop);
+    c->mov(t.x(), fx.r());
+    c->shr(t.r(), imm(16));
+    mulBytesPerPixel(c, t, bytesPerPixel);
+
+    switch (bytesPerPixel)
+    {
+      case 1:
+        c->movzx(v.x(), byte_ptr(src.c(), t.c()));
+        c->mov(byte_ptr(dst.c()), v.r8());
+        break;
+      case 2:
+        c->movzx(v.x(), word_ptr(src.c(), t.c()));
+        c->mov(word_ptr(dst.c()), v.r16());
+        break;
+      case 3:
+        c->movzx(v.x(), word_ptr(src.c(), t.c()));
+        c->mov(word_ptr(dst.c()), v.r16());
+        c->movzx(v.x(), byte_ptr(src.c(), t.c(), TIMES_1, 2));
+        c->mov(byte_ptr(dst.c(), 2), v.r8());
+        break;
+      case 4:
+        c->mov(v.x(), dword_ptr(src.c(), t.c()));
+        c->mov(dword_ptr(dst.c()), v.r());
+        break;
+      case 8:
+        c->movq(x.x(), qword_ptr(src.c(), t.c()));
+        c->movq(qword_ptr(dst.c()), x.r());
+        break;
+      case 16:
+        c->movdqu(x.x(), dqword_ptr(src.c(), t.c()));
+        c->movdqa(dqword_ptr(dst.c()), x.r());
+        break;
+      default:
+        BLITJIT_ASSERT(0);
+    }
+
+    c->add(dst.r(), imm(bytesPerPixel));
+    c->add(fx.r(), stepX.r());
+    c->sub(cnt.r(), imm(1));
+    c->jnz(L_Loop);
+  }
+
+  c->bind(L_End);
 }
-#endif // ASMJIT_X64
 
-void Generator::loadQ(const MMRef& dst, const Mem& src)
+void Generator::genFilteredBlitRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op)
 {
-  c->movq(dst.x(), src);
+  BLITJIT_ASSERT(srcPf->depth() == 32);
+
+  c->comment("BlitJit::Generator::genFilteredBlitRect() - %s <- %s : %s",
+    dstPf->name(), srcPf->name(), op->name());
+
+  f = c->newFunction(_callingConvention, BuildFunction8<void*, void*, SysInt, SysInt, SysUInt, SysUInt, const void*, void*>());
+
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Filtered row is always premultiplied, interpolating colors that are not
+  // premultiplied would bleed color of transparent pixels.
+  const PixelFormat* rowPf = &Api::pixelFormats[PixelFormat::PRGB32];
+
+  // Compositing module
+  Module_Blit* module = createModule_Blit(this, dstPf, rowPf, NULL, op);
+
+  if (!module->isNop())
+  {
+    // Destination, source and filter parameters
+    PtrRef dst(c->argument(0));
+    PtrRef src(c->argument(1));
+    SysIntRef dstStride(c->argument(2));
+    SysIntRef srcStride(c->argument(3));
+    SysIntRef width(c->argument(4));
+    SysIntRef height(c->argument(5));
+    PtrRef filter(c->argument(6));
+
+    SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
+    PtrRef yTable(c->newVariable(VARIABLE_TYPE_PTR));
+
+    // Adjust dstStride, source is read from the row buffer.
+    {
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+      c->mov(t.r(), width);
+      mulBytesPerPixel(c, t, dstPf->bytesPerPixel());
+      c->sub(dstStride, t.r());
+    }
+
+    c->mov(yTable.x(), ptr(filter.c(), BLITJIT_DISPFILTER(_yTable)));
+
+    usingConstants();
+    usingXMMZero();
+    usingXMM0080();
+
+    cnt.alloc();
+    dst.alloc();
+
+    // Loop properties
+    Loop loop;
+    loop.finalizePointers = true;
+
+    // Vertical dither phase is taken from row counter (rows are counted down).
+    _ditherRow = &height;
+
+    _GenClosureInit(module, rowPf, 7);
+    module->beginSwitch();
+
+    for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+    {
+      module->beginKind(kind);
+
+      Label* L_Loop = c->newLabel();
+      c->bind(L_Loop);
+
+      // Filter source rows to buffer.
+      {
+        SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+        PtrRef row0(c->newVariable(VARIABLE_TYPE_PTR));
+        PtrRef row1(c->newVariable(VARIABLE_TYPE_PTR));
+        PtrRef xIndex(c->newVariable(VARIABLE_TYPE_PTR));
+        PtrRef xWeight(c->newVariable(VARIABLE_TYPE_PTR));
+        PtrRef buf(c->newVariable(VARIABLE_TYPE_PTR));
+        XMMRef wy(c->newVariable(VARIABLE_TYPE_XMM));
+        XMMRef iwy(c->newVariable(VARIABLE_TYPE_XMM));
+
+        // Row indices are never negative (resolved by Api::prepareFilter()).
+        c->mov(t.x32(), dword_ptr(yTable.c()));
+        c->imul(t.r(), srcStride.c());
+        c->mov(row0.x(), src.c());
+        c->add(row0.r(), t.r());
+
+        c->mov(t.x32(), dword_ptr(yTable.c(), 4));
+        c->imul(t.r(), srcStride.c());
+        c->mov(row1.x(), src.c());
+        c->add(row1.r(), t.r());
+
+        // Vertical weight and 256 - weight in all 16 bit lanes.
+        c->movd(wy.x(), dword_ptr(yTable.c(), 8));
+        c->pshuflw(wy.r(), wy.r(), imm(mm_shuffle(0, 0, 0, 0)));
+        c->punpcklqdq(wy.r(), wy.r());
+        c->movdqa(iwy.x(), BLITJIT_GETCONST(this, _01000100010001000100010001000100));
+        c->psubw(iwy.r(), wy.r());
+
+        c->add(yTable.r(), imm(12));
+
+        c->mov(buf.x(), ptr(filter.c(), BLITJIT_DISPFILTER(_row)));
+        c->mov(xIndex.x(), ptr(filter.c(), BLITJIT_DISPFILTER(_xIndex)));
+        c->mov(xWeight.x(), ptr(filter.c(), BLITJIT_DISPFILTER(_xWeight)));
+
+        // Pairs of pixels.
+        c->mov(cnt.r(), width);
+        c->add(cnt.r(), imm(1));
+        c->shr(cnt.r(), imm(1));
+
+        _GenFilterRow(buf, row0, row1, xIndex, xWeight, cnt, wy, iwy, srcPf);
+      }
+
+      // Composite buffer to destination row.
+      {
+        PtrRef buf(c->newVariable(VARIABLE_TYPE_PTR));
+
+        c->mov(buf.x(), ptr(filter.c(), BLITJIT_DISPFILTER(_row)));
+        c->mov(cnt.r(), width);
+
+        _GenLoop(&dst, &buf, NULL, &cnt, module, kind, loop);
+      }
+
+      c->add(dst.r(), dstStride);
+      c->sub(height, imm(1));
+      c->jnz(L_Loop);
+
+      module->endKind(kind);
+    }
+
+    module->endSwitch();
+    module->free();
+    _ditherRow = NULL;
+  }
+
+  c->endFunction();
+
+  // Cleanup
+  delete module;
 }
 
-void Generator::loadDQ(const XMMRef& dst, const Mem& src, bool aligned)
+void Generator::_GenFilterRow(
+  const PtrRef& dst,
+  const PtrRef& row0,
+  const PtrRef& row1,
+  const PtrRef& xIndex,
+  const PtrRef& xWeight,
+  const SysIntRef& cnt,
+  const XMMRef& wy,
+  const XMMRef& iwy,
+  const PixelFormat* srcPf)
 {
-  if (aligned)
-    c->movdqa(dst.x(), src);
-  else
-    c->movdqu(dst.x(), src);
+  UInt32 alphaPos = getARGB32AlphaPos(srcPf);
+  UInt32 swizzle = getARGB32Swizzle(&Api::pixelFormats[PixelFormat::PRGB32], srcPf);
+  bool premultiply = srcPf->isAlpha() && !srcPf->isPremultiplied();
+
+  Label* L_Loop = c->newLabel();
+
+  SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+  XMMRef p0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef p1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef q0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef q1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef x(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef w(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef iw(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Two destination pixels (A, B) per iteration. Each one is interpolated
+  // from four source pixels, p is first row, q is second row, *0 is left
+  // column and *1 is right column. Pixels of A and B are gathered into low
+  // quadwords and unpacked to 16 bit lanes like unpack_2x2W_SSE2() does.
+  c->bind(L_Loop);
+
+  c->mov(t.x32(), dword_ptr(xIndex.c()));
+  c->movd(p0.x(), dword_ptr(row0.c(), t.r(), TIMES_4));
+  c->movd(q0.x(), dword_ptr(row1.c(), t.r(), TIMES_4));
+  c->mov(t.x32(), dword_ptr(xIndex.c(), 8));
+  c->movd(x.x(), dword_ptr(row0.c(), t.r(), TIMES_4));
+  c->punpckldq(p0.r(), x.r());
+  c->movd(x.x(), dword_ptr(row1.c(), t.r(), TIMES_4));
+  c->punpckldq(q0.r(), x.r());
+
+  c->mov(t.x32(), dword_ptr(xIndex.c(), 4));
+  c->movd(p1.x(), dword_ptr(row0.c(), t.r(), TIMES_4));
+  c->movd(q1.x(), dword_ptr(row1.c(), t.r(), TIMES_4));
+  c->mov(t.x32(), dword_ptr(xIndex.c(), 12));
+  c->movd(x.x(), dword_ptr(row0.c(), t.r(), TIMES_4));
+  c->punpckldq(p1.r(), x.r());
+  c->movd(x.x(), dword_ptr(row1.c(), t.r(), TIMES_4));
+  c->punpckldq(q1.r(), x.r());
+
+  c->punpcklbw(p0.r(), xmmZero().r());
+  c->punpcklbw(p1.r(), xmmZero().r());
+  c->punpcklbw(q0.r(), xmmZero().r());
+  c->punpcklbw(q1.r(), xmmZero().r());
+
+  if (premultiply)
+  {
+    premultiply_2x2W_SSE2(p0, alphaPos, p1, alphaPos);
+    premultiply_2x2W_SSE2(q0, alphaPos, q1, alphaPos);
+  }
+
+  // Horizontal weights [wA wA wA wA wB wB wB wB] and 256 - weights.
+  c->movd(w.x(), dword_ptr(xWeight.c()));
+  c->punpcklwd(w.r(), w.r());
+  c->punpckldq(w.r(), w.r());
+  c->movdqa(iw.x(), BLITJIT_GETCONST(this, _01000100010001000100010001000100));
+  c->psubw(iw.r(), w.r());
+
+  // Horizontal pass, weights sum to 256, so 255 * 256 + 128 still fits to
+  // unsigned 16 bit lane.
+  c->pmullw(p0.r(), iw.r());            // p0 *= 256 - w
+  c->pmullw(p1.r(), w.r());             // p1 *= w
+  c->pmullw(q0.r(), iw.r());            // q0 *= 256 - w
+  c->pmullw(q1.r(), w.r());             // q1 *= w
+  c->paddw(p0.r(), p1.r());             // p0 += p1
+  c->paddw(q0.r(), q1.r());             // q0 += q1
+  c->paddw(p0.r(), xmm0080().c());      // p0 += 128
+  c->paddw(q0.r(), xmm0080().c());      // q0 += 128
+  c->psrlw(p0.r(), imm(8));             // p0 /= 256
+  c->psrlw(q0.r(), imm(8));             // q0 /= 256
+
+  // Vertical pass.
+  c->pmullw(p0.r(), iwy.c());           // p0 *= 256 - wy
+  c->pmullw(q0.r(), wy.c());            // q0 *= wy
+  c->paddw(p0.r(), q0.r());             // p0 += q0
+  c->paddw(p0.r(), xmm0080().c());      // p0 += 128
+  c->psrlw(p0.r(), imm(8));             // p0 /= 256
+
+  // Reorder to PRGB32 and store.
+  swizzle_1x1W_SSE2(p0, swizzle);
+  c->packuswb(p0.r(), p0.r());
+  if (!srcPf->isAlpha())
+  {
+    c->por(p0.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+  }
+  c->movq(qword_ptr(dst.c()), p0.r());
+
+  c->add(dst.r(), imm(8));
+  c->add(xIndex.r(), imm(16));
+  c->add(xWeight.r(), imm(4));
+  c->sub(cnt.r(), imm(1));
+  c->jnz(L_Loop);
 }
 
-void Generator::storeD(const Mem& dst, const SysIntRef& src, bool nt)
+// ============================================================================
+// [BlitJit::Generator - YUV]
+// ============================================================================
+
+static const char* yuvLayoutNames[YuvLayoutCount] = { "NV12", "I420", "YUY2" };
+
+void Generator::genYuvRect(
+  const PixelFormat* dstPf,
+  const PixelFormat* ovlPf,
+  const Operator* op,
+  UInt32 layout,
+  UInt32 matrix)
 {
-  if (nt && (_features & AsmJit::CpuInfo::Feature_SSE2) != 0)
+  BLITJIT_ASSERT(dstPf->depth() <= 32);
+  BLITJIT_ASSERT(ovlPf == NULL || (ovlPf->depth() <= 32 && op != NULL));
+  BLITJIT_ASSERT(layout < YuvLayoutCount);
+  BLITJIT_ASSERT(matrix < YuvMatrixCount);
+
+  if (ovlPf == NULL)
   {
-    c->movnti(dst, src.c32());
-    f->setSfence(true);
+    c->comment("BlitJit::Generator::genYuvRect() - %s <- %s",
+      dstPf->name(), yuvLayoutNames[layout]);
+
+    f = c->newFunction(_callingConvention, BuildFunction5<void*, const void*, SysInt, SysUInt, SysUInt>());
   }
   else
   {
-    c->mov(dst, src.c32());
+    c->comment("BlitJit::Generator::genYuvRect() - %s <- %s : %s <- %s",
+      dstPf->name(), yuvLayoutNames[layout], op->name(), ovlPf->name());
+
+    f = c->newFunction(_callingConvention, BuildFunction7<void*, const void*, const void*, SysInt, SysInt, SysUInt, SysUInt>());
+  }
+
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Destination, YUV image and overlay
+  UInt32 arg = 0;
+
+  PtrRef dst(c->argument(arg++));
+  PtrRef img(c->argument(arg++));
+  PtrRef ovl;
+  if (ovlPf) ovl.use(c->argument(arg++));
+
+  SysIntRef dstStride(c->argument(arg++));
+  SysIntRef ovlStride;
+  if (ovlPf) ovlStride.use(c->argument(arg++));
+
+  SysIntRef width(c->argument(arg++));
+  SysIntRef height(c->argument(arg++));
+
+  // Planes (YuvImage contains three pointers followed by three strides).
+  PtrRef yRow(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef uRow(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef vRow(c->newVariable(VARIABLE_TYPE_PTR));
+  SysIntRef yStride(c->newVariable(VARIABLE_TYPE_SYSINT));
+  SysIntRef uStride(c->newVariable(VARIABLE_TYPE_SYSINT));
+  SysIntRef vStride(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  const SysInt planesDisp = 0;
+  const SysInt stridesDisp = 3 * (SysInt)sizeof(void*);
+
+  c->mov(yRow.x(), ptr(img.c(), planesDisp));
+  c->mov(yStride.x(), ptr(img.c(), stridesDisp));
+
+  if (layout != YuvYUY2)
+  {
+    c->mov(uRow.x(), ptr(img.c(), planesDisp + (SysInt)sizeof(void*)));
+    c->mov(uStride.x(), ptr(img.c(), stridesDisp + (SysInt)sizeof(SysInt)));
+  }
+
+  if (layout == YuvI420)
+  {
+    c->mov(vRow.x(), ptr(img.c(), planesDisp + 2 * (SysInt)sizeof(void*)));
+    c->mov(vStride.x(), ptr(img.c(), stridesDisp + 2 * (SysInt)sizeof(SysInt)));
+  }
+
+  img.unuse();
+
+  usingConstants();
+  usingXMMZero();
+  if (ovlPf) usingXMM0080();
+
+  // Row counter is used to advance subsampled chroma planes every 2 rows.
+  SysIntRef row(c->newVariable(VARIABLE_TYPE_SYSINT));
+  c->xor_(row.x(), row.x());
+
+  // Working pointers
+  PtrRef dp(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef ovp(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef yp(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef up(c->newVariable(VARIABLE_TYPE_PTR));
+  PtrRef vp(c->newVariable(VARIABLE_TYPE_PTR));
+  SysIntRef cnt(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  cnt.alloc();
+  dp.alloc();
+  yp.alloc();
+  if (ovlPf) ovp.alloc();
+  if (layout != YuvYUY2) up.alloc();
+  if (layout == YuvI420) vp.alloc();
+
+  Label* L_Row = c->newLabel();
+  Label* L_Loop = c->newLabel();
+  Label* L_Tail = c->newLabel();
+  Label* L_Skip4 = c->newLabel();
+  Label* L_Skip2 = c->newLabel();
+  Label* L_Skip1 = c->newLabel();
+
+  c->bind(L_Row);
+  c->mov(cnt.r(), width);
+  c->mov(dp.r(), dst);
+  c->mov(yp.r(), yRow);
+  if (ovlPf) c->mov(ovp.r(), ovl);
+  if (layout != YuvYUY2) c->mov(up.r(), uRow);
+  if (layout == YuvI420) c->mov(vp.r(), vRow);
+
+  // Main loop (8 pixels)
+  c->bind(L_Loop);
+  c->cmp(cnt.r(), imm(8));
+  c->jl(L_Tail);
+
+  _GenYuvPixels(dp, ovp, yp, up, vp, dstPf, ovlPf, op, layout, matrix, 8);
+
+  c->sub(cnt.r(), imm(8));
+  c->jmp(L_Loop);
+
+  // Tail (4, 2 and 1 pixels)
+  c->bind(L_Tail);
+
+  c->test(cnt.r(), imm(4));
+  c->jz(L_Skip4);
+  _GenYuvPixels(dp, ovp, yp, up, vp, dstPf, ovlPf, op, layout, matrix, 4);
+  c->bind(L_Skip4);
+
+  c->test(cnt.r(), imm(2));
+  c->jz(L_Skip2);
+  _GenYuvPixels(dp, ovp, yp, up, vp, dstPf, ovlPf, op, layout, matrix, 2);
+  c->bind(L_Skip2);
+
+  c->test(cnt.r(), imm(1));
+  c->jz(L_Skip1);
+  _GenYuvPixels(dp, ovp, yp, up, vp, dstPf, ovlPf, op, layout, matrix, 1);
+  c->bind(L_Skip1);
+
+  // Next row
+  {
+    StateRef state(c->saveState());
+
+    c->add(dst.r(), dstStride);
+    if (ovlPf) c->add(ovl.r(), ovlStride);
+    c->add(yRow.r(), yStride);
+
+    if (layout != YuvYUY2)
+    {
+      Label* L_SameChroma = c->newLabel();
+
+      c->add(row.r(), imm(1));
+      c->test(row.r(), imm(1));
+      c->jnz(L_SameChroma);
+
+      c->add(uRow.r(), uStride);
+      if (layout == YuvI420) c->add(vRow.r(), vStride);
+
+      c->bind(L_SameChroma);
+    }
   }
+
+  c->sub(height, imm(1));
+  c->jnz(L_Row);
+
+  c->endFunction();
 }
 
-#if defined(ASMJIT_X64)
-void Generator::storeQ(const Mem& dst, const SysIntRef& src, bool nt)
+void Generator::_GenYuvPixels(
+  const PtrRef& dst, const PtrRef& ovl,
+  const PtrRef& yp, const PtrRef& up, const PtrRef& vp,
+  const PixelFormat* dstPf,
+  const PixelFormat* ovlPf,
+  const Operator* op,
+  UInt32 layout,
+  UInt32 matrix,
+  SysInt count)
 {
-  if (nt && (_features & AsmJit::CpuInfo::Feature_SSE2) != 0)
+  StateRef state(c->saveState());
+
+  XMMRef y0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef u0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef v0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  loadYuv_SSE2(y0, u0, v0, yp, up, vp, layout, count);
+  yuvToRgb_SSE2(pix0, pix1, y0, u0, v0, matrix);
+
+  SysInt dstBpp = dstPf->bytesPerPixel();
+  SysInt ovlBpp = ovlPf ? ovlPf->bytesPerPixel() : 0;
+  SysInt i;
+
+  for (i = 0; i < count; i += 4)
   {
-    c->movnti(dst, src.c64());
-    f->setSfence(true);
+    const XMMRef& pix = (i == 0) ? pix0 : pix1;
+    SysInt n = (count >= 4) ? 4 : count;
+
+    if (ovlPf)
+    {
+      // Video is opaque, so it's also premultiplied.
+      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef src1(c->newVariable(VARIABLE_TYPE_XMM));
+
+      loadPixels_SSE2(src0, ovl, i * ovlBpp, ovlPf, n, false);
+
+      unpack_2x2W_SSE2(pix, dst1, pix);
+      unpack_2x2W_SSE2(src0, src1, src0);
+
+      if (ovlPf->isArgb() && !ovlPf->isPremultiplied())
+        premultiply_2x2W_SSE2(src0, 3, src1, 3);
+
+      composite_2x2W_SSE2(
+        pix, src0, 3,
+        dst1, src1, 3,
+        op);
+      pack_2x2W_SSE2(pix, pix, dst1);
+
+      if (dstPf->isArgb() && !dstPf->isPremultiplied())
+        demultiply_1x1B_SSE2(pix, 3);
+    }
+
+    storePixels_SSE2(dst, i * dstBpp, pix, dstPf, n, false);
   }
-  else
+
+  // Advance pointers
+  c->add(dst.r(), imm(count * dstBpp));
+  if (ovlPf) c->add(ovl.r(), imm(count * ovlBpp));
+
+  switch (layout)
   {
-    c->mov(dst, src.c64());
+    case YuvNV12:
+      c->add(yp.r(), imm(count));
+      if (count > 1) c->add(up.r(), imm(count));
+      break;
+    case YuvI420:
+      c->add(yp.r(), imm(count));
+      if (count > 1) c->add(up.r(), imm(count >> 1));
+      if (count > 1) c->add(vp.r(), imm(count >> 1));
+      break;
+    case YuvYUY2:
+      c->add(yp.r(), imm(count * 2));
+      break;
   }
 }
-#endif // ASMJIT_X64
 
-void Generator::storeQ(const Mem& dst, const MMRef& src, bool nt)
-{
-  if (nt && (_features & (
-      AsmJit::CpuInfo::Feature_SSE |
-      AsmJit::CpuInfo::Feature_3dNow)) != 0)
-  {
-    c->movntq(dst, src.c());
-    f->setSfence(true);
-  }
-  else
-  {
-    c->movq(dst, src.c());
+// ============================================================================
+// [BlitJit::Generator - Experimental]
+// ============================================================================
+
+void Generator::experimentalBlitSpan(
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op)
+{
+  c->comment("BlitJit::Generator::experimentalBlitSpan() - %s <- %s : %s",
+    dstPf->name(), srcPf->name(), op->name());
+
+  if (!closure())
+  {
+    f = c->newFunction(_callingConvention, BuildFunction3<void*, void*, SysUInt>());
+  }
+  else
+  {
+    f = c->newFunction(_callingConvention, BuildFunction4<void*, void*, SysUInt, void*>());
+    f->argument(3)->unuse();
+  }
+
+  f->setNaked(true);
+  f->setAllocableEbp(true);
+
+  // Compositing module
+  Module_Blit* module = createModule_Blit(this, dstPf, srcPf, NULL, op);
+
+  if (!module->isNop())
+  {
+    // Destination and source
+    PtrRef dst(c->argument(0));
+    PtrRef src(c->argument(1));
+    SysIntRef cnt(c->argument(2));
+
+    cnt.alloc();
+    dst.alloc();
+    src.alloc();
+
+    // Loop properties
+    Loop loop;
+    loop.finalizePointers = false;
+
+    module->init();
+    module->beginSwitch();
+
+    for (UInt32 kind = 0; kind < module->numKinds(); kind++)
+    {
+      module->beginKind(kind);
+      _GenLoop(&dst, &src, NULL, &cnt, module, kind, loop);
+      module->endKind(kind);
+    }
+
+    module->endSwitch();
+    module->free();
+  }
+
+  c->endFunction();
+
+  // Cleanup
+  delete module;
+}
+
+// ==========================================================================
+// [BlitJit::Generator - Loops]
+// ==========================================================================
+
+// Calculate correct alignment. We need to use dstSize and pixels perLoop.
+// If perLoop is too short (1, maybe two pixels) alignment is in most cases
+// no necessary (for two pixels it's simple condition).
+//
+// Only alignments implemented by _GenLoop() are returned, 3 byte pixels can
+// be aligned to 16 bytes only if loop processes 16 pixels (48 bytes).
+static SysInt getAlignment(SysInt dstSize, SysInt perLoop)
+{
+  SysInt align = 0;
+  if (perLoop <= 1) return align;
+
+  switch (dstSize)
+  {
+    case 1:
+      if (perLoop >= 16) align = 16;
+      break;
+    case 2:
+      if (perLoop >= 8) align = 16;
+      break;
+    case 3:
+      if (perLoop >= 16) align = 16;
+      break;
+    case 4:
+      align = (perLoop >= 4) ? 16 : 8;
+      break;
+    case 8:
+      align = 16;
+      break;
+  }
+
+  return align;
+}
+
+void Generator::_GenLoop(
+  PtrRef* dst,
+  PtrRef* src,
+  PtrRef* msk,
+  SysIntRef* cnt,
+  Module* module,
+  UInt32 kind,
+  const Loop& loop)
+{
+  // First calculate how the loop will be structured
+  SysInt perLoop = module->maxPixelsPerLoop();
+  SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
+  SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
+  SysInt mskSize = module->mskPf ? module->mskPf->bytesPerPixel() : 0;
+
+  SysInt align = getAlignment(dstSize, perLoop);
+
+  // Alloc variables if they are not allocated before.
+  if (dst) dst->alloc();
+  if (src) src->alloc();
+  if (msk) msk->alloc();
+
+  cnt->alloc();
+
+  // Save state
+  StateRef state(c->saveState());
+
+  // Helpers
+  SysIntRef tmp(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  // Labels
+  Label* L_MainEntry  = (perLoop > 1) ? c->newLabel() : NULL;
+  Label* L_MainLoop   = c->newLabel();
+  Label* L_Misaligned = NULL;
+  // Only if more pixels at a time are used
+  Label* L_TailEntry  = (perLoop > 1) ? c->newLabel() : NULL;
+  Label* L_TailPre    = (perLoop > 1) ? c->newLabel() : NULL;
+  Label* L_TailLoop   = (perLoop > 1) ? c->newLabel() : NULL;
+  Label* L_TailSkipLargeJumpTable = c->newLabel();
+  // End
+  Label* L_End        = c->newLabel();
+
+  // We need one temporary variable for alignment
+  if (align != 0) tmp.alloc();
+  c->clearPrevented();
+
+  // Skip alignment and main loop if cnt is too small (to be useful)
+  if (perLoop > 1 && align)
+  {
+    c->cmp(cnt->r(), imm(perLoop));
+    c->jb(L_TailLoop);
+  }
+
+  // Align 4 bytes dst to 8 bytes. We are using trick that if alignment
+  // fail, we will continue into main loop, because this type of alignment
+  // is usually used together with MMX or X64 modes (no SSE and unaligned
+  // exceptions here)
+  if (dstSize == 4 && align == 8)
+  {
+    c->mov(tmp.x(), dst->r());
+    c->and_(tmp.r(), imm(7));
+    c->jz(L_MainEntry);
+    tmp.unuse();
+
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(dstSize));
+    if (src) c->add(src->r(), imm(srcSize));
+    if (msk) c->add(msk->r(), imm(mskSize));
+    c->sub(cnt->r(), imm(1));
+  }
+  // Align 3 bytes dst to 16 bytes. Every address can be aligned, because
+  // 3 * 11 == 1 (mod 16), count of pixels to align is ((-dst) * 11) & 15.
+  else if (dstSize == 3 && align == 16)
+  {
+    SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+    c->xor_(tmp.x(), tmp.x());
+    c->sub(tmp.r(), dst->r());
+    c->lea(t.x(), ptr(tmp.r(), tmp.r(), TIMES_4));
+    c->lea(tmp.r(), ptr(tmp.r(), t.r(), TIMES_2));
+    t.unuse();
+    c->and_(tmp.r(), imm(15));
+    // Alignment not needed, jump to main loop entry
+    c->jz(L_MainEntry);
+
+    c->sub(cnt->r(), tmp.r());
+
+    Label* L_AlignLoop = c->newLabel();
+    c->bind(L_AlignLoop);
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(dstSize));
+    if (src) c->add(src->r(), imm(srcSize));
+    if (msk) c->add(msk->r(), imm(mskSize));
+    c->sub(tmp.r(), imm(1));
+    c->jnz(L_AlignLoop);
+
+    tmp.unuse();
+  }
+  // Align 1, 2, 4 or 8 bytes dst to 16 bytes. This is hardest job, because
+  // we must ensure that destination is aligned for instructions that needs
+  // it. This is reason for the check and bail into misaligned or tail loop 
+  // if destination is not aligned to pixel size (this shouldn't happpen, but
+  // we must be sure).
+  else if (align == 16)
+  {
+    SysInt shift = (dstSize == 1) ? 0 : (dstSize == 2) ? 1 : (dstSize == 4) ? 2 : 3;
+
+    if (module->complexity() == Module::Simple) L_Misaligned = c->newLabel();
+    Label* L_Unaligned = L_Misaligned ? L_Misaligned : L_TailLoop;
+
+    // Calculate how many pixels needs to be aligned
+    c->xor_(tmp.x(), tmp.x());
+    c->sub(tmp.r(), dst->r());
+    c->and_(tmp.r(), imm(15));
+    // Alignment not needed, jump to main loop entry
+    c->jz(L_MainEntry);
+
+    if (shift)
+    {
+      // Destination is not aligned to pixel size, alignment is not possible
+      c->test(tmp.r(), imm((1 << shift) - 1));
+      c->jnz(L_Unaligned);
+      c->shr(tmp.r(), imm(shift));
+    }
+    c->sub(cnt->r(), tmp.r());
+
+    Label* L_AlignLoop = c->newLabel();
+    c->bind(L_AlignLoop);
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(dstSize));
+    if (src) c->add(src->r(), imm(srcSize));
+    if (msk) c->add(msk->r(), imm(mskSize));
+    c->sub(tmp.r(), imm(1));
+    c->jnz(L_AlignLoop);
+
+    tmp.unuse();
+  }
+  // TODO: Not implemented
+  else if (align)
+  {
+    BLITJIT_ASSERT(0);
+  }
+
+  // Main Loop
+  if (perLoop > 1)
+  {
+    // More pixels at a time
+    c->bind(L_MainEntry);
+    c->sub(cnt->r(), imm(perLoop));
+    c->jc(L_TailEntry);
+
+    c->align(_mainLoopAlignment);
+    c->bind(L_MainLoop);
+
+    _GenPrefetch(dst, src, module, perLoop);
+
+    module->processPixelsPtr(dst, src, msk, perLoop, 0, kind, Module::DstAligned);
+    if (dst) c->add(dst->r(), imm(perLoop * dstSize));
+    if (src) c->add(src->r(), imm(perLoop * srcSize));
+    if (msk) c->add(msk->r(), imm(perLoop * mskSize));
+    c->sub(cnt->r(), imm(perLoop));
+    c->jnc(L_MainLoop);
+  }
+  else
+  {
+    // One pixel at a time
+    c->align(_mainLoopAlignment);
+    c->bind(L_MainLoop);
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(dstSize));
+    if (src) c->add(src->r(), imm(srcSize));
+    if (msk) c->add(msk->r(), imm(mskSize));
+    c->sub(cnt->r(), imm(1));
+    c->jnz(L_MainLoop);
+  }
+
+  if (L_Misaligned)
+  {
+    bool embedMisalignedTail = (perLoop > 8 && module->complexity() == Module::Simple);
+
+    OutsideBlock block(c);
+    Label* L_MisalignedLoop = c->newLabel();
+    Label* L_MisalignedTailEntry = embedMisalignedTail
+      ? c->newLabel() 
+      : L_TailEntry;
+
+    // More pixels at a time
+    c->bind(L_Misaligned);
+    c->sub(cnt->r(), imm(perLoop));
+    c->jc(L_MisalignedTailEntry);
+
+    c->align(_mainLoopAlignment);
+    c->bind(L_MisalignedLoop);
+
+    _GenPrefetch(dst, src, module, perLoop);
+
+    module->processPixelsPtr(dst, src, msk, perLoop, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(perLoop * dstSize));
+    if (src) c->add(src->r(), imm(perLoop * srcSize));
+    if (msk) c->add(msk->r(), imm(perLoop * mskSize));
+    c->sub(cnt->r(), imm(perLoop));
+    c->jnc(L_MisalignedLoop);
+
+    if (!embedMisalignedTail)
+    {
+      c->jmp(L_TailEntry);
+    }
+    else
+    {
+      // Misaligned tail loop
+      JumpTable* jumpTable = c->newJumpTable();
+      jumpTable->addLabel(L_TailSkipLargeJumpTable, 0);
+
+      tmp.use(c->newVariable(VARIABLE_TYPE_SYSINT));
+      c->mov(tmp.x(), cnt->r());
+      c->shr(tmp.r(), 2);
+      c->jumpToTable(jumpTable, tmp.r());
+      tmp.unuse();
+
+      for (SysInt j = (perLoop / 4) - 1; j > 0; j--)
+      {
+        c->bind(jumpTable->addLabel(NULL, j));
+        module->processPixelsPtr(dst, src, msk, 4, 0, kind, 0);
+        if (dst) c->add(dst->r(), imm(dstSize * 4));
+        if (src) c->add(src->r(), imm(srcSize * 4));
+        if (msk) c->add(msk->r(), imm(mskSize * 4));
+      }
+      c->and_(cnt->r(), 3);
+      c->jmp(L_TailSkipLargeJumpTable);
+    }
+  }
+
+  // Tail (only if more pixels at a time loop is used)
+  if (perLoop == 1)
+  {
+    // NOP
+  }
+  else if (perLoop == 2)
+  {
+    // Two pixels at a time, it's only needed to process remaining pixel
+    c->bind(L_TailEntry);
+    c->add(cnt->r(), imm(2));
+    c->jz(L_End);
+
+    c->bind(L_TailLoop);
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (loop.finalizePointers)
+    {
+      if (dst) c->add(dst->r(), imm(dstSize));
+      if (src) c->add(src->r(), imm(srcSize));
+      if (msk) c->add(msk->r(), imm(mskSize));
+    }
+  }
+  else if (module->complexity() == Module::Simple)
+  {
+    SysInt i = perLoop;
+
+    // Jump table based loop for simple operators
+    c->bind(L_TailEntry);
+    c->add(cnt->r(), imm(perLoop));
+    c->jz(L_End);
+
+    c->bind(L_TailLoop);
+
+    if (i > 8)
+    {
+      JumpTable* jumpTable = c->newJumpTable();
+      jumpTable->addLabel(L_TailSkipLargeJumpTable, 0);
+
+      tmp.use(c->newVariable(VARIABLE_TYPE_SYSINT));
+      c->mov(tmp.x(), cnt->r());
+      c->shr(tmp.r(), 2);
+      c->jumpToTable(jumpTable, tmp.r());
+      tmp.unuse();
+
+      for (SysInt j = (i / 4) - 1; j > 0; j--, i -= 4)
+      {
+        c->bind(jumpTable->addLabel(NULL, j));
+        module->processPixelsPtr(dst, src, msk, 4, 0, kind, Module::DstAligned);
+        if (dst) c->add(dst->r(), imm(dstSize * 4));
+        if (src) c->add(src->r(), imm(srcSize * 4));
+        if (msk) c->add(msk->r(), imm(mskSize * 4));
+      }
+      c->and_(cnt->r(), 3);
+      c->bind(L_TailSkipLargeJumpTable);
+    }
+
+    // Last few pixels will be processed through jump table
+    {
+      JumpTable* jumpTable = c->newJumpTable();
+      jumpTable->addLabel(L_End, 0);
+
+      // cnt is modified by jumpToTable().
+      c->jumpToTable(jumpTable, cnt->r());
+
+      for (i--; i > 0; i--)
+      {
+        c->bind(jumpTable->addLabel(NULL, i));
+        module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+        if (dst) c->add(dst->r(), imm(dstSize));
+        if (src) c->add(src->r(), imm(srcSize));
+        if (msk) c->add(msk->r(), imm(mskSize));
+      }
+    }
+  }
+  else
+  {
+    // Complex operators
+    c->bind(L_TailEntry);
+    c->add(cnt->r(), imm(perLoop));
+    c->jz(L_End);
+
+    c->bind(L_TailLoop);
+    module->processPixelsPtr(dst, src, msk, 1, 0, kind, 0);
+    if (dst) c->add(dst->r(), imm(dstSize));
+    if (src) c->add(src->r(), imm(srcSize));
+    if (msk) c->add(msk->r(), imm(mskSize));
+    c->sub(cnt->r(), imm(1));
+    c->jnz(L_TailLoop);
+  }
+
+  // End
+  c->bind(L_End);
+
+  BLITJIT_ASSERT(!L_TailSkipLargeJumpTable->isLinked());
+}
+
+static UInt32 getPrefetchHint(UInt32 hint)
+{
+  switch (hint)
+  {
+    case PrefetchT1 : return PREFETCH_T1;
+    case PrefetchT2 : return PREFETCH_T2;
+    case PrefetchNTA: return PREFETCH_NTA;
+    default         : return PREFETCH_T0;
+  }
+}
+
+void Generator::_GenMaskA1Loop(
+  PtrRef* dst,
+  PtrRef* src,
+  PtrRef* msk,
+  SysIntRef* cnt,
+  SysIntRef* mskOffset,
+  Module* module,
+  UInt32 kind)
+{
+  // Mask word (all-zero words are skipped at once).
+  SysInt perWord = sizeof(SysInt) * 8;
+  SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
+  SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
+
+  usingConstants();
+
+  if (dst) dst->alloc();
+  if (src) src->alloc();
+  msk->alloc();
+  cnt->alloc();
+
+  SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+  SysIntRef idx(c->newVariable(VARIABLE_TYPE_SYSINT));
+  XMMRef mskx(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef msk0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  t.alloc();
+  idx.alloc();
+  c->clearPrevented();
+
+  // Save state
+  StateRef state(c->saveState());
+
+  Label* L_Main       = c->newLabel();
+  Label* L_MainLoop   = c->newLabel();
+  Label* L_ByteLoop   = c->newLabel();
+  Label* L_WordSkip   = c->newLabel();
+  Label* L_WordNext   = c->newLabel();
+  Label* L_TailEntry  = c->newLabel();
+  Label* L_TailBytes  = c->newLabel();
+  Label* L_TailBits   = c->newLabel();
+  Label* L_End        = c->newLabel();
+
+  // Head - pixels before first byte boundary of mask.
+  if (mskOffset)
+  {
+    c->test(mskOffset->r(), mskOffset->r());
+    c->jz(L_Main);
+    c->test(cnt->r(), cnt->r());
+    c->jz(L_End);
+
+    c->mov(idx.x(), imm(7));
+    c->sub(idx.r(), mskOffset->r());
+    _GenMaskA1Bits(dst, src, msk, cnt, t, idx, msk0, module, kind, L_End);
+  }
+
+  // Main loop - one mask word at a time.
+  c->bind(L_Main);
+  c->sub(cnt->r(), imm(perWord));
+  c->jc(L_TailEntry);
+
+  c->align(_mainLoopAlignment);
+  c->bind(L_MainLoop);
+
+  c->mov(t.x(), ptr(msk->r()));
+  c->test(t.r(), t.r());
+  c->jz(L_WordSkip);
+
+  c->mov(idx.x(), imm(perWord / 8));
+  c->bind(L_ByteLoop);
+  _GenMaskA1Byte(dst, src, msk, t, mskx, msk0, module, kind);
+  c->sub(idx.r(), imm(1));
+  c->jnz(L_ByteLoop);
+  c->jmp(L_WordNext);
+
+  c->bind(L_WordSkip);
+  if (dst) c->add(dst->r(), imm(perWord * dstSize));
+  if (src) c->add(src->r(), imm(perWord * srcSize));
+  c->add(msk->r(), imm(perWord / 8));
+
+  c->bind(L_WordNext);
+  c->sub(cnt->r(), imm(perWord));
+  c->jnc(L_MainLoop);
+
+  // Tail - remaining mask bytes and then remaining bits.
+  c->bind(L_TailEntry);
+  c->add(cnt->r(), imm(perWord));
+  c->jz(L_End);
+
+  c->bind(L_TailBytes);
+  c->cmp(cnt->r(), imm(8));
+  c->jb(L_TailBits);
+  _GenMaskA1Byte(dst, src, msk, t, mskx, msk0, module, kind);
+  c->sub(cnt->r(), imm(8));
+  c->jnz(L_TailBytes);
+  c->jmp(L_End);
+
+  // There is less than 8 pixels, loop always ends by cnt.
+  c->bind(L_TailBits);
+  c->mov(idx.x(), imm(7));
+  _GenMaskA1Bits(dst, src, msk, cnt, t, idx, msk0, module, kind, L_End);
+
+  // End
+  c->bind(L_End);
+}
+
+void Generator::_GenMaskA1Byte(
+  PtrRef* dst,
+  PtrRef* src,
+  PtrRef* msk,
+  SysIntRef& t,
+  XMMRef& mskx,
+  XMMRef& msk0,
+  Module* module,
+  UInt32 kind)
+{
+  SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
+  SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
+
+  Label* L_Skip = c->newLabel();
+
+  c->movzx(t.x(), byte_ptr(msk->r()));
+  c->test(t.r(), t.r());
+  c->jz(L_Skip);
+
+  // Expand 8 bits to 8 bytes, first pixel is in the most significant bit.
+  c->movd(mskx.x(), t.c32());
+  c->punpcklbw(mskx.r(), mskx.r());
+  c->pshuflw(mskx.r(), mskx.r(), imm(mm_shuffle(0, 0, 0, 0)));
+  c->pand(mskx.r(), BLITJIT_GETCONST(this, _01020408102040800102040810204080));
+  c->pcmpeqb(mskx.r(), BLITJIT_GETCONST(this, _01020408102040800102040810204080));
+
+  c->movdqa(msk0.x(), mskx.r());
+  module->processPixelsMsk(dst, src, msk0, 4, 0, kind, 0);
+  c->pshufd(msk0.x(), mskx.r(), imm(mm_shuffle(1, 1, 1, 1)));
+  module->processPixelsMsk(dst, src, msk0, 4, 4, kind, 0);
+
+  c->bind(L_Skip);
+  if (dst) c->add(dst->r(), imm(8 * dstSize));
+  if (src) c->add(src->r(), imm(8 * srcSize));
+  c->add(msk->r(), imm(1));
+}
+
+void Generator::_GenMaskA1Bits(
+  PtrRef* dst,
+  PtrRef* src,
+  PtrRef* msk,
+  SysIntRef* cnt,
+  SysIntRef& t,
+  SysIntRef& idx,
+  XMMRef& msk0,
+  Module* module,
+  UInt32 kind,
+  Label* L_End)
+{
+  SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
+  SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
+
+  Label* L_Loop = c->newLabel();
+  Label* L_Skip = c->newLabel();
+
+  c->movzx(t.x(), byte_ptr(msk->r()));
+  c->add(msk->r(), imm(1));
+
+  c->bind(L_Loop);
+  c->bt(t.r(), idx.r());
+  c->jnc(L_Skip);
+
+  c->pcmpeqb(msk0.x(), msk0.x());
+  module->processPixelsMsk(dst, src, msk0, 1, 0, kind, 0);
+
+  c->bind(L_Skip);
+  if (dst) c->add(dst->r(), imm(dstSize));
+  if (src) c->add(src->r(), imm(srcSize));
+  c->sub(cnt->r(), imm(1));
+  c->jz(L_End);
+  c->sub(idx.r(), imm(1));
+  c->jns(L_Loop);
+}
+
+void Generator::_GenPrefetch(
+  PtrRef* dst,
+  PtrRef* src,
+  Module* module,
+  SysInt perLoop)
+{
+  if (!_prefetch) return;
+
+  const PrefetchInfo& info = Api::prefetchInfo[module->complexity()];
+
+  // Distance is never shorter than one loop iteration, this was the only
+  // distance used by the loop generator before it was configurable.
+  if (src && module->prefetchSrc())
+  {
+    SysInt srcSize = module->srcPf ? module->srcPf->bytesPerPixel() : 0;
+    SysInt distance = _prefetchSrcDistance ? _prefetchSrcDistance : info.srcDistance;
+    UInt32 hint = _prefetchSrcHint ? _prefetchSrcHint : info.srcHint;
+
+    if (distance < perLoop * srcSize) distance = perLoop * srcSize;
+    c->prefetch(ptr(src->r(), distance), getPrefetchHint(hint));
+  }
+
+  if (dst && module->prefetchDst())
+  {
+    SysInt dstSize = module->dstPf ? module->dstPf->bytesPerPixel() : 0;
+    SysInt distance = _prefetchDstDistance ? _prefetchDstDistance : info.dstDistance;
+    UInt32 hint = _prefetchDstHint ? _prefetchDstHint : info.dstHint;
+
+    if (distance < perLoop * dstSize) distance = perLoop * dstSize;
+    c->prefetch(ptr(dst->r(), distance), getPrefetchHint(hint));
+  }
+}
+
+// ============================================================================
+// [BlitJit::Generator - Mov Helpers]
+// ============================================================================
+
+void Generator::loadD(const SysIntRef& dst, const Mem& src)
+{
+  c->mov(dst.x32(), src);
+}
+
+#if defined(ASMJIT_X64)
+void Generator::loadQ(const SysIntRef& dst, const Mem& src)
+{
+  c->mov(dst.x64(), src);
+}
+#endif // ASMJIT_X64
+
+void Generator::loadQ(const MMRef& dst, const Mem& src)
+{
+  c->movq(dst.x(), src);
+}
+
+void Generator::loadDQ(const XMMRef& dst, const Mem& src, bool aligned)
+{
+  if (aligned)
+    c->movdqa(dst.x(), src);
+  else
+    c->movdqu(dst.x(), src);
+}
+
+void Generator::storeD(const Mem& dst, const SysIntRef& src, bool nt)
+{
+  if (nt && (_features & AsmJit::CpuInfo::Feature_SSE2) != 0)
+  {
+    c->movnti(dst, src.c32());
+    f->setSfence(true);
+  }
+  else
+  {
+    c->mov(dst, src.c32());
+  }
+}
+
+#if defined(ASMJIT_X64)
+void Generator::storeQ(const Mem& dst, const SysIntRef& src, bool nt)
+{
+  if (nt && (_features & AsmJit::CpuInfo::Feature_SSE2) != 0)
+  {
+    c->movnti(dst, src.c64());
+    f->setSfence(true);
+  }
+  else
+  {
+    c->mov(dst, src.c64());
+  }
+}
+#endif // ASMJIT_X64
+
+void Generator::storeQ(const Mem& dst, const MMRef& src, bool nt)
+{
+  if (nt && (_features & (
+      AsmJit::CpuInfo::Feature_SSE |
+      AsmJit::CpuInfo::Feature_3dNow)) != 0)
+  {
+    c->movntq(dst, src.c());
+    f->setSfence(true);
+  }
+  else
+  {
+    c->movq(dst, src.c());
+  }
+}
+
+void Generator::storeDQ(const Mem& dst, const XMMRef& src, bool nt, bool aligned)
+{
+  if (nt && aligned)
+  {
+    c->movntdq(dst, src.c());
+    f->setSfence(true);
+  }
+  else if (aligned)
+  {
+    c->movdqa(dst, src.c());
+  }
+  else
+  {
+    c->movdqu(dst, src.c());
+  }
+}
+
+// ==========================================================================
+// [BlitJit::Generator - Constants Management]
+// ==========================================================================
+
+void Generator::usingConstants()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingConstants) return;
+
+#if defined(BLITJIT_X86)
+  // 32-bit mode: Nop
+#else
+  // 64-bit mode: Allocate register and set custom alloc/spill functions.
+  // TODO:
+  _rConstantsAddress.use(c->newVariable(VARIABLE_TYPE_PTR, 0));
+  c->mov(_rConstantsAddress.x(), imm((SysInt)Constants::instance));
+#endif
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingConstants;
+}
+
+Mem Generator::getConstantsOperand(SysInt displacement)
+{
+#if defined(BLITJIT_X86)
+  // 32-bit mode: Absolute address
+  return ptr_abs(Constants::instance, displacement);
+#else
+  // 64-bit mode: Register + Displacement
+  return ptr(_rConstantsAddress.c(), displacement);
+#endif
+}
+
+// ==========================================================================
+// [BlitJit::Generator - MMX/SSE Zero Registers]
+// ==========================================================================
+
+// custom alloc / spills
+static void customAlloc_zero(Variable* v)
+{
+  Compiler* c = v->compiler();
+
+  switch (v->type())
+  {
+    case VARIABLE_TYPE_MM:
+    {
+      MMRegister r = mk_mm(v->registerCode());
+      c->pxor(r, r);
+      break;
+    }
+    case VARIABLE_TYPE_XMM:
+    {
+      XMMRegister r = mk_xmm(v->registerCode());
+      c->pxor(r, r);
+      break;
+    }
+  }
+}
+
+static void customAlloc_const(Variable* v)
+{
+  Compiler* c = v->compiler();
+
+  Generator* g = (Generator*)v->dataPtr();
+  SysInt displacement = v->dataInt();
+
+  switch (v->type())
+  {
+    case VARIABLE_TYPE_MM:
+    {
+      MMRegister r = mk_mm(v->registerCode());
+      c->movq(r, g->getConstantsOperand(displacement));
+      break;
+    }
+    case VARIABLE_TYPE_XMM:
+    {
+      XMMRegister r = mk_xmm(v->registerCode());
+      c->movdqa(r, g->getConstantsOperand(displacement));
+      break;
+    }
+  }
+}
+
+static void customSpill_none(Variable* v)
+{
+  BLITJIT_USE(v);
+}
+
+void Generator::usingMMZero()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingMMZero) return;
+
+  // MM register with custom alloc / spill
+  _mmZero.use(c->newVariable(VARIABLE_TYPE_MM, 20));
+  _mmZero.setAllocFn(customAlloc_zero);
+  _mmZero.setSpillFn(customSpill_none);
+  _mmZero.alloc();
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingMMZero;
+}
+
+void Generator::usingXMMZero()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingXMMZero) return;
+
+  // XMM register with custom alloc / spill
+  _xmmZero.use(c->newVariable(VARIABLE_TYPE_XMM, 20));
+  _xmmZero.setAllocFn(customAlloc_zero);
+  _xmmZero.setSpillFn(customSpill_none);
+  _xmmZero.alloc();
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingXMMZero;
+}
+
+void Generator::usingXMM0080()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingXMM0080) return;
+
+  usingConstants();
+
+  // XMM register with custom alloc / spill
+  _xmm0080.use(c->newVariable(VARIABLE_TYPE_XMM, 20));
+  _xmm0080.setAllocFn(customAlloc_const);
+  _xmm0080.setSpillFn(customSpill_none);
+  _xmm0080.setDataPtr((void*)this);
+  _xmm0080.setDataInt(BLITJIT_DISPCONST(_00800080008000800080008000800080));
+  _xmm0080.alloc();
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingXMM0080;
+}
+
+// ==========================================================================
+// [BlitJit::Generator - Closure]
+// ==========================================================================
+
+void Generator::usingPalette()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingPalette) return;
+
+  // Palette is passed through closure.
+  BLITJIT_ASSERT(_closureArg != NULL);
+
+  _palette.use(c->newVariable(VARIABLE_TYPE_PTR, 10));
+  c->mov(_palette.x(), ptr(_closureArg->c(), BLITJIT_DISPCLOSURE(palette)));
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingPalette;
+}
+
+void Generator::usingOpacity()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingOpacity) return;
+
+  // Opacity is passed through closure.
+  BLITJIT_ASSERT(_closureArg != NULL);
+
+  _opacity.use(c->newVariable(VARIABLE_TYPE_XMM, 10));
+  c->movd(_opacity.x(), ptr(_closureArg->c(), BLITJIT_DISPCLOSURE(opacity)));
+  c->pshuflw(_opacity.r(), _opacity.r(), imm(mm_shuffle(0, 0, 0, 0)));
+  c->punpcklqdq(_opacity.r(), _opacity.r());
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingOpacity;
+}
+
+void Generator::checkOpacity(Label* L_Zero, Label* L_Full)
+{
+  BLITJIT_ASSERT(_body & BodyUsingOpacity);
+
+  Int32Ref t(c->newVariable(VARIABLE_TYPE_INT32));
+
+  c->pextrw(t.x(), _opacity.r(), imm(0));
+  c->test(t.r(), t.r());
+  c->jz(L_Zero);
+
+  if (L_Full)
+  {
+    c->cmp(t.r(), imm(255));
+    c->je(L_Full);
+  }
+}
+
+void Generator::usingColorKey()
+{
+  // Don't initialize it more times
+  if (_body & BodyUsingColorKey) return;
+
+  // Color key is passed through closure.
+  BLITJIT_ASSERT(_closureArg != NULL);
+
+  _colorKey.use(c->newVariable(VARIABLE_TYPE_XMM, 10));
+  c->movd(_colorKey.x(), ptr(_closureArg->c(), BLITJIT_DISPCLOSURE(colorKey)));
+  c->pshufd(_colorKey.r(), _colorKey.r(), imm(mm_shuffle(0, 0, 0, 0)));
+
+  _colorKeyTolerance.use(c->newVariable(VARIABLE_TYPE_XMM, 10));
+  c->movd(_colorKeyTolerance.x(), ptr(_closureArg->c(), BLITJIT_DISPCLOSURE(colorKeyTolerance)));
+  c->punpcklbw(_colorKeyTolerance.r(), _colorKeyTolerance.r());
+  c->pshuflw(_colorKeyTolerance.r(), _colorKeyTolerance.r(), imm(mm_shuffle(0, 0, 0, 0)));
+  c->punpcklqdq(_colorKeyTolerance.r(), _colorKeyTolerance.r());
+
+  // Initialized, this will prevent us to do initialization more times
+  _body |= BodyUsingColorKey;
+}
+
+void Generator::_GenClosureInit(Module_Blit* module, const PixelFormat* srcPf, UInt32 closureIndex, SysIntRef* mskOffset)
+{
+  // Closure data are loaded to registers while module is initialized, the
+  // argument itself is not needed in the loop. Generators keep closure
+  // argument alive from function entry (it's never unused before), so it's
+  // released here after its last read.
+  PtrRef closureArg;
+
+  if (closure())
+  {
+    closureArg.use(c->argument(closureIndex));
+    _closureArg = &closureArg;
+
+    if (mskOffset)
+    {
+      mskOffset->use(c->newVariable(VARIABLE_TYPE_SYSINT));
+      c->mov(mskOffset->x32(), dword_ptr(closureArg.c(), BLITJIT_DISPCLOSURE(maskOffset)));
+    }
+  }
+
+  if (srcPf->id() == PixelFormat::I8) usingPalette();
+  if (useOpacity()) usingOpacity();
+  module->init();
+
+  if (closure())
+  {
+    closureArg.unuse();
+    _closureArg = NULL;
+  }
+}
+
+void Generator::_GenClosureInit(Module_Fill* module, PtrRef& src, UInt32 closureIndex, SysIntRef* mskOffset)
+{
+  // Same as blit version, but fill module is initialized with source.
+  PtrRef closureArg;
+
+  if (closure())
+  {
+    closureArg.use(c->argument(closureIndex));
+    _closureArg = &closureArg;
+
+    if (mskOffset)
+    {
+      mskOffset->use(c->newVariable(VARIABLE_TYPE_SYSINT));
+      c->mov(mskOffset->x32(), dword_ptr(closureArg.c(), BLITJIT_DISPCLOSURE(maskOffset)));
+    }
+  }
+
+  if (useOpacity()) usingOpacity();
+  module->init(src);
+
+  if (closure())
+  {
+    closureArg.unuse();
+    _closureArg = NULL;
+  }
+}
+
+// ==========================================================================
+// [BlitJit::Generator - Pixel Format Helpers]
+// ==========================================================================
+
+void Generator::loadPixels_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp,
+  const PixelFormat* pf, SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 2 || count == 4);
+
+  switch (pf->bytesPerPixel())
+  {
+    case 4:
+    {
+      if (count == 4)
+        loadDQ(dst0, ptr(base.c(), disp), aligned);
+      else if (count == 2)
+        c->movq(dst0.x(), ptr(base.c(), disp));
+      else
+        c->movd(dst0.x(), ptr(base.c(), disp));
+
+      // Convert channel order to ARGB32.
+      swizzle_1x1B_SSE2(dst0, getARGB32Swizzle(&Api::pixelFormats[PixelFormat::ARGB32], pf));
+
+      // Unused byte of XRGB32 is undefined, make pixels opaque.
+      if (!pf->isAlpha())
+        c->por(dst0.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+      break;
+    }
+
+    case 3:
+    {
+      if (count == 4)
+      {
+        XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        c->movq(dst0.x(), ptr(base.c(), disp));
+        c->movd(t0.x(), ptr(base.c(), disp + 8));
+        c->punpcklqdq(dst0.r(), t0.r());
+      }
+      else if (count == 2)
+      {
+        XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+        Int32Ref t1(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movd(dst0.x(), ptr(base.c(), disp));
+        c->movzx(t1.x(), word_ptr(base.c(), disp + 4));
+        c->movd(t0.x(), t1.c());
+        c->punpckldq(dst0.r(), t0.r());
+      }
+      else
+      {
+        Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+        Int32Ref t1(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movzx(t0.x(), word_ptr(base.c(), disp));
+        c->movzx(t1.x(), byte_ptr(base.c(), disp + 2));
+        c->shl(t1.r(), imm(16));
+        c->or_(t0.r(), t1.r());
+        c->movd(dst0.x(), t0.c());
+      }
+
+      if (count > 1) expand24_1x1B_SSE2(dst0, count);
+      c->por(dst0.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+
+      // Red is stored at lowest address (BGR24).
+      if (pf->rShift() == 0) swapRB_1x1B_SSE2(dst0);
+      break;
+    }
+
+    case 2:
+    {
+      if (count == 4)
+      {
+        c->movq(dst0.x(), ptr(base.c(), disp));
+      }
+      else if (count == 2)
+      {
+        c->movd(dst0.x(), ptr(base.c(), disp));
+      }
+      else
+      {
+        Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movzx(t0.x(), word_ptr(base.c(), disp));
+        c->movd(dst0.x(), t0.c());
+      }
+
+      c->punpcklwd(dst0.r(), xmmZero().r());
+      expand16_1x1B_SSE2(dst0, pf);
+      break;
+    }
+
+    case 1:
+    {
+      if (pf->id() == PixelFormat::I8)
+      {
+        loadIndexed_SSE2(dst0, base, disp, count);
+        break;
+      }
+
+      Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+      if (count == 4)
+        c->mov(t0.x(), dword_ptr(base.c(), disp));
+      else if (count == 2)
+        c->movzx(t0.x(), word_ptr(base.c(), disp));
+      else
+        c->movzx(t0.x(), byte_ptr(base.c(), disp));
+
+      // Black color with alpha.
+      c->movd(dst0.x(), t0.c());
+      c->punpcklbw(dst0.r(), dst0.r());
+      c->punpcklwd(dst0.r(), dst0.r());
+      c->pslld(dst0.r(), imm(24));
+      break;
+    }
+
+    default:
+      BLITJIT_ASSERT(0);
+  }
+}
+
+void Generator::storePixels_SSE2(
+  const PtrRef& base, SysInt disp, const XMMRef& src0,
+  const PixelFormat* pf, SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 2 || count == 4);
+
+  switch (pf->bytesPerPixel())
+  {
+    case 4:
+    {
+      // Convert channel order from ARGB32.
+      swizzle_1x1B_SSE2(src0, getARGB32Swizzle(pf, &Api::pixelFormats[PixelFormat::ARGB32]));
+
+      if (count == 4)
+        storeDQ(ptr(base.c(), disp), src0, nonThermalHint(), aligned);
+      else if (count == 2)
+        c->movq(ptr(base.c(), disp), src0.r());
+      else
+        c->movd(ptr(base.c(), disp), src0.r());
+      break;
+    }
+
+    case 3:
+    {
+      // Red is stored at lowest address (BGR24).
+      if (pf->rShift() == 0) swapRB_1x1B_SSE2(src0);
+      if (count > 1) pack24_1x1B_SSE2(src0, count);
+
+      if (count == 4)
+      {
+        c->movq(ptr(base.c(), disp), src0.r());
+        c->psrldq(src0.r(), imm(8));
+        c->movd(ptr(base.c(), disp + 8), src0.r());
+      }
+      else if (count == 2)
+      {
+        Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movd(ptr(base.c(), disp), src0.r());
+        c->psrldq(src0.r(), imm(4));
+        c->movd(t0.x(), src0.r());
+        c->mov(word_ptr(base.c(), disp + 4), t0.r16());
+      }
+      else
+      {
+        Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movd(t0.x(), src0.r());
+        c->mov(word_ptr(base.c(), disp), t0.r16());
+        c->shr(t0.r(), imm(16));
+        c->mov(byte_ptr(base.c(), disp + 2), t0.r8());
+      }
+      break;
+    }
+
+    case 2:
+    {
+      pack16_1x1B_SSE2(src0, pf);
+
+      // Sign extend words so packssdw can't saturate them.
+      c->pslld(src0.r(), imm(16));
+      c->psrad(src0.r(), imm(16));
+      c->packssdw(src0.r(), src0.r());
+
+      if (count == 4)
+      {
+        c->movq(ptr(base.c(), disp), src0.r());
+      }
+      else if (count == 2)
+      {
+        c->movd(ptr(base.c(), disp), src0.r());
+      }
+      else
+      {
+        Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+        c->movd(t0.x(), src0.r());
+        c->mov(word_ptr(base.c(), disp), t0.r16());
+      }
+      break;
+    }
+
+    case 1:
+    {
+      // Indexed format can't be destination.
+      BLITJIT_ASSERT(pf->id() == PixelFormat::A8);
+
+      Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+      c->psrld(src0.r(), imm(24));
+      c->packssdw(src0.r(), src0.r());
+      c->packuswb(src0.r(), src0.r());
+      c->movd(t0.x(), src0.r());
+
+      if (count == 4)
+        c->mov(dword_ptr(base.c(), disp), t0.r());
+      else if (count == 2)
+        c->mov(word_ptr(base.c(), disp), t0.r16());
+      else
+        c->mov(byte_ptr(base.c(), disp), t0.r8());
+      break;
+    }
+
+    default:
+      BLITJIT_ASSERT(0);
+  }
+}
+
+void Generator::loadPixels_4x4B_SSE2(
+  const XMMRef& dst0, const XMMRef& dst1, const XMMRef& dst2, const XMMRef& dst3,
+  const PtrRef& base, SysInt disp,
+  const PixelFormat* pf, bool aligned)
+{
+  switch (pf->bytesPerPixel())
+  {
+    case 3:
+    {
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      loadDQ(dst0, ptr(base.c(), disp     ), aligned);
+      loadDQ(dst2, ptr(base.c(), disp + 16), aligned);
+      loadDQ(dst3, ptr(base.c(), disp + 32), aligned);
+
+      // Split 48 bytes to four groups of 12 bytes.
+      c->movdqa(dst1.x(), dst0.c());
+      c->movdqa(t0.x(), dst2.c());
+      c->psrldq(dst1.r(), imm(12));
+      c->pslldq(t0.r(), imm(4));
+      c->por(dst1.r(), t0.r());
+
+      c->movdqa(t0.x(), dst3.c());
+      c->psrldq(dst2.r(), imm(8));
+      c->pslldq(t0.r(), imm(8));
+      c->por(dst2.r(), t0.r());
+
+      c->psrldq(dst3.r(), imm(4));
+
+      expand24_1x1B_SSE2(dst0, 4);
+      expand24_1x1B_SSE2(dst1, 4);
+      expand24_1x1B_SSE2(dst2, 4);
+      expand24_1x1B_SSE2(dst3, 4);
+
+      c->por(dst0.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+      c->por(dst1.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+      c->por(dst2.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+      c->por(dst3.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+
+      if (pf->rShift() == 0)
+      {
+        swapRB_1x1B_SSE2(dst0);
+        swapRB_1x1B_SSE2(dst1);
+        swapRB_1x1B_SSE2(dst2);
+        swapRB_1x1B_SSE2(dst3);
+      }
+      break;
+    }
+
+    case 2:
+    {
+      loadDQ(dst0, ptr(base.c(), disp     ), aligned);
+      loadDQ(dst2, ptr(base.c(), disp + 16), aligned);
+
+      c->movdqa(dst1.x(), dst0.c());
+      c->movdqa(dst3.x(), dst2.c());
+      c->punpcklwd(dst0.r(), xmmZero().r());
+      c->punpckhwd(dst1.r(), xmmZero().r());
+      c->punpcklwd(dst2.r(), xmmZero().r());
+      c->punpckhwd(dst3.r(), xmmZero().r());
+
+      expand16_1x1B_SSE2(dst0, pf);
+      expand16_1x1B_SSE2(dst1, pf);
+      expand16_1x1B_SSE2(dst2, pf);
+      expand16_1x1B_SSE2(dst3, pf);
+      break;
+    }
+
+    case 1:
+    {
+      if (pf->id() == PixelFormat::I8)
+      {
+        loadIndexed_SSE2(dst0, base, disp     , 4);
+        loadIndexed_SSE2(dst1, base, disp +  4, 4);
+        loadIndexed_SSE2(dst2, base, disp +  8, 4);
+        loadIndexed_SSE2(dst3, base, disp + 12, 4);
+        break;
+      }
+
+      loadDQ(dst0, ptr(base.c(), disp), aligned);
+
+      // Black color with alpha.
+      c->movdqa(dst2.x(), dst0.c());
+      c->punpcklbw(dst0.r(), dst0.r());
+      c->punpckhbw(dst2.r(), dst2.r());
+      c->movdqa(dst1.x(), dst0.c());
+      c->movdqa(dst3.x(), dst2.c());
+      c->punpcklwd(dst0.r(), dst0.r());
+      c->punpckhwd(dst1.r(), dst1.r());
+      c->punpcklwd(dst2.r(), dst2.r());
+      c->punpckhwd(dst3.r(), dst3.r());
+
+      c->pslld(dst0.r(), imm(24));
+      c->pslld(dst1.r(), imm(24));
+      c->pslld(dst2.r(), imm(24));
+      c->pslld(dst3.r(), imm(24));
+      break;
+    }
+
+    default:
+    {
+      SysInt size = pf->bytesPerPixel() * 4;
+
+      loadPixels_SSE2(dst0, base, disp           , pf, 4, aligned);
+      loadPixels_SSE2(dst1, base, disp + size    , pf, 4, aligned);
+      loadPixels_SSE2(dst2, base, disp + size * 2, pf, 4, aligned);
+      loadPixels_SSE2(dst3, base, disp + size * 3, pf, 4, aligned);
+      break;
+    }
+  }
+}
+
+void Generator::storePixels_4x4B_SSE2(
+  const PtrRef& base, SysInt disp,
+  const XMMRef& src0, const XMMRef& src1, const XMMRef& src2, const XMMRef& src3,
+  const PixelFormat* pf, bool aligned)
+{
+  switch (pf->bytesPerPixel())
+  {
+    case 3:
+    {
+      if (pf->rShift() == 0)
+      {
+        swapRB_1x1B_SSE2(src0);
+        swapRB_1x1B_SSE2(src1);
+        swapRB_1x1B_SSE2(src2);
+        swapRB_1x1B_SSE2(src3);
+      }
+
+      pack24_4x4B_SSE2(src0, src1, src2, src3);
+
+      storeDQ(ptr(base.c(), disp     ), src0, nonThermalHint(), aligned);
+      storeDQ(ptr(base.c(), disp + 16), src1, nonThermalHint(), aligned);
+      storeDQ(ptr(base.c(), disp + 32), src2, nonThermalHint(), aligned);
+      break;
+    }
+
+    case 2:
+    {
+      pack16_1x1B_SSE2(src0, pf);
+      pack16_1x1B_SSE2(src1, pf);
+      pack16_1x1B_SSE2(src2, pf);
+      pack16_1x1B_SSE2(src3, pf);
+
+      // Sign extend words so packssdw can't saturate them.
+      c->pslld(src0.r(), imm(16));
+      c->pslld(src1.r(), imm(16));
+      c->pslld(src2.r(), imm(16));
+      c->pslld(src3.r(), imm(16));
+      c->psrad(src0.r(), imm(16));
+      c->psrad(src1.r(), imm(16));
+      c->psrad(src2.r(), imm(16));
+      c->psrad(src3.r(), imm(16));
+
+      c->packssdw(src0.r(), src1.r());
+      c->packssdw(src2.r(), src3.r());
+
+      storeDQ(ptr(base.c(), disp     ), src0, nonThermalHint(), aligned);
+      storeDQ(ptr(base.c(), disp + 16), src2, nonThermalHint(), aligned);
+      break;
+    }
+
+    case 1:
+    {
+      c->psrld(src0.r(), imm(24));
+      c->psrld(src1.r(), imm(24));
+      c->psrld(src2.r(), imm(24));
+      c->psrld(src3.r(), imm(24));
+
+      c->packssdw(src0.r(), src1.r());
+      c->packssdw(src2.r(), src3.r());
+      c->packuswb(src0.r(), src2.r());
+
+      storeDQ(ptr(base.c(), disp), src0, nonThermalHint(), aligned);
+      break;
+    }
+
+    default:
+    {
+      SysInt size = pf->bytesPerPixel() * 4;
+
+      storePixels_SSE2(base, disp           , src0, pf, 4, aligned);
+      storePixels_SSE2(base, disp + size    , src1, pf, 4, aligned);
+      storePixels_SSE2(base, disp + size * 2, src2, pf, 4, aligned);
+      storePixels_SSE2(base, disp + size * 3, src3, pf, 4, aligned);
+      break;
+    }
+  }
+}
+
+void Generator::loadIndexed_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp, SysInt count)
+{
+  BLITJIT_ASSERT(count == 1 || count == 2 || count == 4);
+  BLITJIT_ASSERT(_body & BodyUsingPalette);
+
+  // There is no gather in SSE2, each index is loaded separately and palette
+  // entries are interleaved (loads are independent, so they can overlap).
+  SysIntRef i0(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  c->movzx(i0.x32(), byte_ptr(base.c(), disp));
+  c->movd(dst0.x(), ptr(_palette.c(), i0.c(), TIMES_4));
+
+  if (count >= 2)
+  {
+    SysIntRef i1(c->newVariable(VARIABLE_TYPE_SYSINT));
+    XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+    c->movzx(i1.x32(), byte_ptr(base.c(), disp + 1));
+    c->movd(t1.x(), ptr(_palette.c(), i1.c(), TIMES_4));
+
+    if (count == 4)
+    {
+      SysIntRef i2(c->newVariable(VARIABLE_TYPE_SYSINT));
+      SysIntRef i3(c->newVariable(VARIABLE_TYPE_SYSINT));
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
+
+      c->movzx(i2.x32(), byte_ptr(base.c(), disp + 2));
+      c->movzx(i3.x32(), byte_ptr(base.c(), disp + 3));
+      c->movd(t2.x(), ptr(_palette.c(), i2.c(), TIMES_4));
+      c->movd(t3.x(), ptr(_palette.c(), i3.c(), TIMES_4));
+
+      c->punpckldq(dst0.r(), t1.r());
+      c->punpckldq(t2.r(), t3.r());
+      c->punpcklqdq(dst0.r(), t2.r());
+    }
+    else
+    {
+      c->punpckldq(dst0.r(), t1.r());
+    }
+  }
+}
+
+void Generator::expand24_1x1B_SSE2(
+  const XMMRef& pix0, SysInt count)
+{
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->movdqa(t1.x(), pix0.c());
+  c->psrldq(t1.r(), imm(3));
+
+  if (count == 2)
+  {
+    c->punpckldq(pix0.r(), t1.r());
+  }
+  else
+  {
+    XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
+
+    c->movdqa(t2.x(), pix0.c());
+    c->movdqa(t3.x(), pix0.c());
+    c->psrldq(t2.r(), imm(6));
+    c->psrldq(t3.r(), imm(9));
+
+    c->punpckldq(pix0.r(), t1.r());
+    c->punpckldq(t2.r(), t3.r());
+    c->punpcklqdq(pix0.r(), t2.r());
+  }
+}
+
+void Generator::pack24_1x1B_SSE2(
+  const XMMRef& pix0, SysInt count)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Pack two pixels in each quadword into 6 low bytes.
+  c->movdqa(t0.x(), pix0.c());
+  c->pand(pix0.r(), BLITJIT_GETCONST(this, _0000000000FFFFFF0000000000FFFFFF));
+  c->psrlq(t0.r(), imm(8));
+  c->pand(t0.r(), BLITJIT_GETCONST(this, _0000FFFFFF0000000000FFFFFF000000));
+  c->por(pix0.r(), t0.r());
+
+  if (count == 4)
+  {
+    // Move 6 bytes from high quadword to bytes 6...11.
+    c->movdqa(t0.x(), pix0.c());
+    c->psrldq(t0.r(), imm(8));
+    c->pslldq(pix0.r(), imm(8));
+    c->pslldq(t0.r(), imm(6));
+    c->psrldq(pix0.r(), imm(8));
+    c->por(pix0.r(), t0.r());
+  }
+}
+
+void Generator::pack24_4x4B_SSE2(
+  const XMMRef& pix0, const XMMRef& pix1, const XMMRef& pix2, const XMMRef& pix3)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  pack24_1x1B_SSE2(pix0, 4);
+  pack24_1x1B_SSE2(pix1, 4);
+  pack24_1x1B_SSE2(pix2, 4);
+  pack24_1x1B_SSE2(pix3, 4);
+
+  // Merge four groups of 12 bytes to 48 bytes.
+  c->movdqa(t0.x(), pix1.c());
+  c->pslldq(t0.r(), imm(12));
+  c->por(pix0.r(), t0.r());
+
+  c->movdqa(t0.x(), pix2.c());
+  c->psrldq(pix1.r(), imm(4));
+  c->pslldq(t0.r(), imm(8));
+  c->por(pix1.r(), t0.r());
+
+  c->psrldq(pix2.r(), imm(8));
+  c->pslldq(pix3.r(), imm(4));
+  c->por(pix2.r(), pix3.r());
+}
+
+void Generator::loadPixels_1x1W16_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp,
+  const PixelFormat* pf, SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 2);
+
+  if (pf->depth() == 64)
+  {
+    if (count == 2)
+      loadDQ(dst0, ptr(base.c(), disp), aligned);
+    else
+      c->movq(dst0.x(), ptr(base.c(), disp));
+  }
+  else
+  {
+    loadPixels_SSE2(dst0, base, disp, pf, count, false);
+
+    if (useLinear(pf))
+    {
+      srgbDecode_1x1W16_SSE2(dst0, pf, count);
+    }
+    else
+    {
+      // c * 257 == (c << 8) | c
+      c->punpcklbw(dst0.r(), dst0.r());
+      if (pf->isArgb() && !pf->isPremultiplied()) premultiply_1x1W16_SSE2(dst0);
+    }
+  }
+}
+
+void Generator::storePixels_1x1W16_SSE2(
+  const PtrRef& base, SysInt disp, const XMMRef& src0,
+  const PixelFormat* pf, SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 2);
+
+  if (pf->depth() == 64)
+  {
+    if (count == 2)
+      storeDQ(ptr(base.c(), disp), src0, nonThermalHint(), aligned);
+    else
+      c->movq(ptr(base.c(), disp), src0.r());
+  }
+  else
+  {
+    if (useLinear(pf))
+      srgbEncode_1x1W16_SSE2(src0, pf, count);
+    else if (pf->isArgb() && !pf->isPremultiplied())
+      demultiply_1x1W16_SSE2(src0);
+    else
+      reduce_1x1W16_SSE2(src0);
+
+    storePixels_SSE2(base, disp, src0, pf, count, false);
+  }
+}
+
+void Generator::reduce_1x1W16_SSE2(
+  const XMMRef& pix0)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // round(c / 257) == (t - (t >> 8)) >> 8, where t = c + 128. Saturation
+  // doesn't matter, all c >= 65408 are rounded to 255.
+  c->paddusw(pix0.r(), BLITJIT_GETCONST(this, _00800080008000800080008000800080));
+  c->movdqa(t0.x(), pix0.c());
+  c->psrlw(t0.r(), imm(8));
+  c->psubw(pix0.r(), t0.r());
+  c->psrlw(pix0.r(), imm(8));
+  c->packuswb(pix0.r(), pix0.r());
+}
+
+void Generator::demultiply_1x1W16_SSE2(
+  const XMMRef& pix0)
+{
+  XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef m0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef r0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // One pixel per register (as floats).
+  c->movdqa(pix1.x(), pix0.c());
+  c->punpcklwd(pix0.r(), xmmZero().r());
+  c->punpckhwd(pix1.r(), xmmZero().r());
+  c->cvtdq2ps(pix0.r(), pix0.r());
+  c->cvtdq2ps(pix1.r(), pix1.r());
+
+  for (int i = 0; i < 2; i++)
+  {
+    const XMMRef& p = (i == 0) ? pix0 : pix1;
+
+    // Alpha and mask of non-zero alpha.
+    c->pshufd(a0.x(), p.c(), mm_shuffle(3, 3, 3, 3));
+    c->xorps(m0.x(), m0.x());
+    c->cmpps(m0.r(), a0.r(), imm(4));
+
+    // r0 = [255 / a, 255 / a, 255 / a, 255 / 65535]
+    c->movaps(r0.x(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+    c->divps(r0.r(), a0.r());
+    c->andps(r0.r(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+    c->orps(r0.r(), BLITJIT_GETCONST(this, _3B7F00FF000000000000000000000000));
+
+    c->mulps(p.r(), r0.r());
+    c->minps(p.r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+    c->andps(p.r(), m0.r());
+    c->addps(p.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(p.r(), p.r());
+  }
+
+  c->packssdw(pix0.r(), pix1.r());
+  c->packuswb(pix0.r(), pix0.r());
+}
+
+void Generator::loadPixels_1x1F_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp,
+  const PixelFormat* pf)
+{
+  if (pf->isFloat())
+  {
+    c->movups(dst0.x(), ptr(base.c(), disp));
+    if (!pf->isPremultiplied()) premultiply_1x1F_SSE2(dst0);
+  }
+  else if (pf->depth() == 64)
+  {
+    loadPixels_1x1W16_SSE2(dst0, base, disp, pf, 1, false);
+    c->punpcklwd(dst0.r(), xmmZero().r());
+    c->cvtdq2ps(dst0.r(), dst0.r());
+    c->mulps(dst0.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+  }
+  else if (useSrgb(pf))
+  {
+    XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    // Transfer function is applied to colors that are not premultiplied.
+    loadPixels_SSE2(pix0, base, disp, pf, 1, false);
+    if (pf->isArgb() && pf->isPremultiplied()) demultiply_1x1B_SSE2(pix0, 3);
+
+    srgbDecode_1x1F_SSE2(dst0, pix0);
+    if (pf->isAlpha()) premultiply_1x1F_SSE2(dst0);
+  }
+  else
+  {
+    loadPixels_SSE2(dst0, base, disp, pf, 1, false);
+    c->punpcklbw(dst0.r(), xmmZero().r());
+    c->punpcklwd(dst0.r(), xmmZero().r());
+    c->cvtdq2ps(dst0.r(), dst0.r());
+    c->mulps(dst0.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+
+    if (pf->isArgb() && !pf->isPremultiplied()) premultiply_1x1F_SSE2(dst0);
+  }
+}
+
+void Generator::storePixels_1x1F_SSE2(
+  const PtrRef& base, SysInt disp, const XMMRef& src0,
+  const PixelFormat* pf)
+{
+  if (pf->isFloat())
+  {
+    if (!pf->isPremultiplied()) demultiply_1x1F_SSE2(src0);
+    c->movups(ptr(base.c(), disp), src0.r());
+    return;
+  }
+
+  if (useSrgb(pf))
+  {
+    if (pf->isAlpha()) demultiply_1x1F_SSE2(src0);
+    srgbEncode_1x1F_SSE2(src0);
+    if (pf->isArgb() && pf->isPremultiplied()) premultiply_1x1B_SSE2(src0, 3);
+
+    storePixels_SSE2(base, disp, src0, pf, 1, false);
+    return;
+  }
+
+  if (pf->isArgb() && !pf->isPremultiplied()) demultiply_1x1F_SSE2(src0);
+
+  // Clamp to [0, 1] and round.
+  c->maxps(src0.r(), xmmZero().r());
+  c->minps(src0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+
+  if (pf->depth() == 64)
+  {
+    c->mulps(src0.r(), BLITJIT_GETCONST(this, _477FFF00477FFF00477FFF00477FFF00));
+    c->addps(src0.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(src0.r(), src0.r());
+
+    // Sign extend words so packssdw doesn't saturate them.
+    c->pslld(src0.r(), imm(16));
+    c->psrad(src0.r(), imm(16));
+    c->packssdw(src0.r(), src0.r());
+
+    storePixels_1x1W16_SSE2(base, disp, src0, pf, 1, false);
+  }
+  else
+  {
+    c->mulps(src0.r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+    c->addps(src0.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(src0.r(), src0.r());
+    c->packssdw(src0.r(), src0.r());
+    c->packuswb(src0.r(), src0.r());
+
+    storePixels_SSE2(base, disp, src0, pf, 1, false);
+  }
+}
+
+bool Generator::useSrgb(
+  const PixelFormat* pf)
+{
+  // Only formats that are converted through packed ARGB32 are encoded.
+  return (options() & OptionSRGB) != 0 &&
+         !pf->isFloat() &&
+         pf->depth() != 64 &&
+         pf->isRgb();
+}
+
+bool Generator::useLinear(
+  const PixelFormat* pf)
+{
+  // PRGB64 and float formats are linear.
+  return (options() & OptionLinear) != 0 &&
+         !pf->isFloat() &&
+         pf->depth() != 64 &&
+         pf->isRgb();
+}
+
+bool Generator::useOpacity()
+{
+  return (options() & OptionOpacity) != 0 && closure();
+}
+
+bool Generator::useColorKey()
+{
+  return (options() & OptionColorKey) != 0 && closure();
+}
+
+UInt32 Generator::div255Precision()
+{
+  if (options() & OptionDiv255Fast) return Div255Fast;
+  if (options() & OptionDiv255Approx) return Div255Approx;
+  return Div255Exact;
+}
+
+void Generator::srgbDecode_1x1W16_SSE2(
+  const XMMRef& pix0, const PixelFormat* pf, SysInt count)
+{
+  XMMRef w0(c->newVariable(VARIABLE_TYPE_XMM));
+  SysIntRef i0(c->newVariable(VARIABLE_TYPE_SYSINT));
+  PtrRef table(c->newVariable(VARIABLE_TYPE_PTR));
+
+  // Transfer function is applied to colors that are not premultiplied.
+  if (pf->isArgb() && pf->isPremultiplied()) demultiply_1x1B_SSE2(pix0, 3);
+
+  // Table indexes to w0, alpha is linear (c * 257 == (c << 8) | c).
+  c->movdqa(w0.x(), pix0.c());
+  c->punpcklbw(w0.r(), xmmZero().r());
+  c->punpcklbw(pix0.r(), pix0.r());
+  c->lea(table.x(), BLITJIT_GETCONST(this, _SrgbToLinear16));
+
+  for (SysInt i = 0; i < count * 4; i++)
+  {
+    if ((i & 3) == 3) continue;
+
+    c->pextrw(i0.x(), w0.c(), imm(i));
+    c->movzx(i0.x(), word_ptr(table.c(), i0.c(), TIMES_2));
+    c->pinsrw(pix0.r(), i0.c(), imm(i));
+  }
+
+  if (pf->isArgb()) premultiply_1x1W16_SSE2(pix0);
+}
+
+void Generator::srgbEncode_1x1W16_SSE2(
+  const XMMRef& pix0, const PixelFormat* pf, SysInt count)
+{
+  XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // One pixel per register as floats in 0..1 range, then demultiplied and
+  // encoded through 12 bit table.
+  if (count == 2) c->movdqa(pix1.x(), pix0.c());
+
+  c->punpcklwd(pix0.r(), xmmZero().r());
+  c->cvtdq2ps(pix0.r(), pix0.r());
+  c->mulps(pix0.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+  if (pf->isArgb()) demultiply_1x1F_SSE2(pix0);
+  srgbEncode_1x1F_SSE2(pix0);
+
+  if (count == 2)
+  {
+    c->punpckhwd(pix1.r(), xmmZero().r());
+    c->cvtdq2ps(pix1.r(), pix1.r());
+    c->mulps(pix1.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+    if (pf->isArgb()) demultiply_1x1F_SSE2(pix1);
+    srgbEncode_1x1F_SSE2(pix1);
+
+    c->punpckldq(pix0.r(), pix1.r());
+  }
+
+  if (pf->isArgb() && pf->isPremultiplied()) premultiply_1x1B_SSE2(pix0, 3);
+}
+
+void Generator::srgbDecode_1x1F_SSE2(
+  const XMMRef& dst0, const XMMRef& pix0)
+{
+  XMMRef w0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+  SysIntRef i0(c->newVariable(VARIABLE_TYPE_SYSINT));
+  PtrRef table(c->newVariable(VARIABLE_TYPE_PTR));
+
+  c->movdqa(w0.x(), pix0.c());
+  c->punpcklbw(w0.r(), xmmZero().r());
+  c->lea(table.x(), BLITJIT_GETCONST(this, _SrgbToLinear));
+
+  // Colors through table, alpha is linear.
+  c->pextrw(i0.x(), w0.c(), imm(0));
+  c->movss(dst0.x(), ptr(table.c(), i0.c(), TIMES_4));
+  c->pextrw(i0.x(), w0.c(), imm(1));
+  c->movss(t0.x(), ptr(table.c(), i0.c(), TIMES_4));
+  c->pextrw(i0.x(), w0.c(), imm(2));
+  c->movss(t1.x(), ptr(table.c(), i0.c(), TIMES_4));
+  c->pextrw(i0.x(), w0.c(), imm(3));
+  c->cvtsi2ss(t2.x(), i0.c());
+  c->mulss(t2.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+
+  c->unpcklps(dst0.r(), t0.r());
+  c->unpcklps(t1.r(), t2.r());
+  c->movlhps(dst0.r(), t1.r());
+}
+
+void Generator::srgbEncode_1x1F_SSE2(
+  const XMMRef& pix0)
+{
+  SysIntRef i0(c->newVariable(VARIABLE_TYPE_SYSINT));
+  SysIntRef i1(c->newVariable(VARIABLE_TYPE_SYSINT));
+  PtrRef table(c->newVariable(VARIABLE_TYPE_PTR));
+
+  // Colors to 12 bit table indexes, alpha to 8 bits.
+  c->maxps(pix0.r(), xmmZero().r());
+  c->minps(pix0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->mulps(pix0.r(), BLITJIT_GETCONST(this, _437F0000457FF000457FF000457FF000));
+  c->addps(pix0.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+  c->cvttps2dq(pix0.r(), pix0.r());
+
+  c->lea(table.x(), BLITJIT_GETCONST(this, _LinearToSrgb));
+
+  c->pextrw(i0.x(), pix0.c(), imm(0));
+  c->movzx(i0.x(), byte_ptr(table.c(), i0.c()));
+
+  c->pextrw(i1.x(), pix0.c(), imm(2));
+  c->movzx(i1.x(), byte_ptr(table.c(), i1.c()));
+  c->shl(i1.r(), imm(8));
+  c->or_(i0.r(), i1.r());
+
+  c->pextrw(i1.x(), pix0.c(), imm(4));
+  c->movzx(i1.x(), byte_ptr(table.c(), i1.c()));
+  c->shl(i1.r(), imm(16));
+  c->or_(i0.r(), i1.r());
+
+  c->pextrw(i1.x(), pix0.c(), imm(6));
+  c->shl(i1.r(), imm(24));
+  c->or_(i0.r(), i1.r());
+
+  c->movd(pix0.x(), i0.c());
+}
+
+// Load count (8, 4, 2 or 1) bytes to low bytes of dst0.
+static void loadBytes_SSE2(
+  Compiler* c,
+  const XMMRef& dst0, const PtrRef& base, SysInt disp, SysInt count)
+{
+  switch (count)
+  {
+    case 8:
+      c->movq(dst0.x(), ptr(base.c(), disp));
+      break;
+    case 4:
+      c->movd(dst0.x(), ptr(base.c(), disp));
+      break;
+    default:
+    {
+      Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+      if (count == 2)
+        c->movzx(t0.x(), word_ptr(base.c(), disp));
+      else
+        c->movzx(t0.x(), byte_ptr(base.c(), disp));
+      c->movd(dst0.x(), t0.c());
+      break;
+    }
+  }
+}
+
+void Generator::loadYuv_SSE2(
+  const XMMRef& y0, const XMMRef& u0, const XMMRef& v0,
+  const PtrRef& yp, const PtrRef& up, const PtrRef& vp,
+  UInt32 layout, SysInt count)
+{
+  BLITJIT_ASSERT(count == 8 || count == 4 || count == 2 || count == 1);
+
+  // Count of chroma samples (one sample for two pixels).
+  SysInt chroma = (count + 1) >> 1;
+
+  switch (layout)
+  {
+    case YuvYUY2:
+    {
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      // Whole macro pixel is loaded also for last odd pixel.
+      if (count == 8)
+        c->movdqu(y0.x(), ptr(yp.c(), 0));
+      else if (count == 4)
+        c->movq(y0.x(), ptr(yp.c(), 0));
+      else
+        c->movd(y0.x(), ptr(yp.c(), 0));
+
+      c->movdqa(u0.x(), y0.c());
+      c->punpcklbw(y0.r(), xmmZero().r());
+      c->punpckhbw(u0.r(), xmmZero().r());
+      c->movdqa(v0.x(), y0.c());
+      c->movdqa(t0.x(), u0.c());
+
+      // Y samples are in even words.
+      c->pslld(y0.r(), imm(16));
+      c->pslld(u0.r(), imm(16));
+      c->psrld(y0.r(), imm(16));
+      c->psrld(u0.r(), imm(16));
+      c->packssdw(y0.r(), u0.r());
+
+      // U and V samples are in odd words.
+      c->psrld(v0.r(), imm(16));
+      c->psrld(t0.r(), imm(16));
+      c->packssdw(v0.r(), t0.r());
+      c->movdqa(u0.x(), v0.c());
+      break;
+    }
+
+    case YuvNV12:
+      loadBytes_SSE2(c, y0, yp, 0, count);
+      loadBytes_SSE2(c, u0, up, 0, chroma * 2);
+      c->punpcklbw(y0.r(), xmmZero().r());
+      c->punpcklbw(u0.r(), xmmZero().r());
+      c->movdqa(v0.x(), u0.c());
+      break;
+
+    case YuvI420:
+      loadBytes_SSE2(c, y0, yp, 0, count);
+      loadBytes_SSE2(c, u0, up, 0, chroma);
+      loadBytes_SSE2(c, v0, vp, 0, chroma);
+      c->punpcklbw(y0.r(), xmmZero().r());
+
+      // Duplicate chroma samples for both pixels.
+      c->punpcklbw(u0.r(), u0.r());
+      c->punpcklbw(v0.r(), v0.r());
+      c->punpcklbw(u0.r(), xmmZero().r());
+      c->punpcklbw(v0.r(), xmmZero().r());
+      return;
+
+    default:
+      BLITJIT_ASSERT(0);
+  }
+
+  // Split interleaved U and V words and duplicate them for both pixels.
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->pslld(u0.r(), imm(16));
+  c->psrld(v0.r(), imm(16));
+  c->psrld(u0.r(), imm(16));
+
+  c->movdqa(t1.x(), u0.c());
+  c->pslld(t1.r(), imm(16));
+  c->por(u0.r(), t1.r());
+
+  c->movdqa(t1.x(), v0.c());
+  c->pslld(t1.r(), imm(16));
+  c->por(v0.r(), t1.r());
+}
+
+void Generator::yuvToRgb_SSE2(
+  const XMMRef& pix0, const XMMRef& pix1,
+  const XMMRef& y0, const XMMRef& u0, const XMMRef& v0,
+  UInt32 matrix)
+{
+  XMMRef r0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef g0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Y = (Y - 16) * (Ky + 0.5) + 0.5, U = U - 128, V = V - 128
+  //
+  // Ky is 74 (1.164 * 64 is 74.5), half is added by shift, whole 75 would
+  // make results up to 3 levels brighter.
+  c->psubw(y0.r(), BLITJIT_GETCONST(this, _00100010001000100010001000100010));
+  c->movdqa(t0.x(), y0.c());
+  c->psraw(t0.r(), imm(1));
+  c->pmullw(y0.r(), BLITJIT_GETCONST(this, _YuvToRgb[matrix][0]));
+  c->paddw(y0.r(), t0.r());
+  c->paddw(y0.r(), BLITJIT_GETCONST(this, _00200020002000200020002000200020));
+  c->psubw(u0.r(), BLITJIT_GETCONST(this, _00800080008000800080008000800080));
+  c->psubw(v0.r(), BLITJIT_GETCONST(this, _00800080008000800080008000800080));
+
+  // R = Y + V.Kvr
+  c->movdqa(r0.x(), v0.c());
+  c->pmullw(r0.r(), BLITJIT_GETCONST(this, _YuvToRgb[matrix][1]));
+  c->paddsw(r0.r(), y0.r());
+
+  // G = Y - U.Kug - V.Kvg
+  c->movdqa(t0.x(), u0.c());
+  c->pmullw(t0.r(), BLITJIT_GETCONST(this, _YuvToRgb[matrix][2]));
+  c->pmullw(v0.r(), BLITJIT_GETCONST(this, _YuvToRgb[matrix][3]));
+  c->paddw(t0.r(), v0.r());
+  c->movdqa(g0.x(), y0.c());
+  c->psubsw(g0.r(), t0.r());
+
+  // B = Y + U.Kub
+  c->pmullw(u0.r(), BLITJIT_GETCONST(this, _YuvToRgb[matrix][4]));
+  c->paddsw(u0.r(), y0.r());
+
+  c->psraw(r0.r(), imm(6));
+  c->psraw(g0.r(), imm(6));
+  c->psraw(u0.r(), imm(6));
+
+  c->packuswb(r0.r(), r0.r());
+  c->packuswb(g0.r(), g0.r());
+  c->packuswb(u0.r(), u0.r());
+
+  // Interleave to B, G, R, A bytes.
+  c->pcmpeqb(t0.x(), t0.x());
+  c->punpcklbw(u0.r(), g0.r());
+  c->punpcklbw(r0.r(), t0.r());
+
+  c->movdqa(pix0.x(), u0.c());
+  c->movdqa(pix1.x(), u0.c());
+  c->punpcklwd(pix0.r(), r0.r());
+  c->punpckhwd(pix1.r(), r0.r());
+}
+
+void Generator::loadAlpha_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp,
+  const PixelFormat* pf, SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 4 || count == 16);
+
+  if (pf->id() == PixelFormat::A8)
+  {
+    if (count == 16)
+    {
+      loadDQ(dst0, ptr(base.c(), disp), aligned);
+    }
+    else if (count == 4)
+    {
+      c->movd(dst0.x(), ptr(base.c(), disp));
+    }
+    else
+    {
+      Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+      c->movzx(t0.x(), byte_ptr(base.c(), disp));
+      c->movd(dst0.x(), t0.c());
+    }
+  }
+  else if (!pf->isAlpha())
+  {
+    c->pcmpeqb(dst0.x(), dst0.x());
+  }
+  else if (count == 16)
+  {
+    XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
+
+    loadPixels_4x4B_SSE2(dst0, t1, t2, t3, base, disp, pf, aligned);
+
+    c->psrld(dst0.r(), imm(24));
+    c->psrld(t1.r(), imm(24));
+    c->psrld(t2.r(), imm(24));
+    c->psrld(t3.r(), imm(24));
+
+    c->packssdw(dst0.r(), t1.r());
+    c->packssdw(t2.r(), t3.r());
+    c->packuswb(dst0.r(), t2.r());
+  }
+  else
+  {
+    loadPixels_SSE2(dst0, base, disp, pf, count, aligned);
+    c->psrld(dst0.r(), imm(24));
+
+    if (count == 4)
+    {
+      c->packssdw(dst0.r(), dst0.r());
+      c->packuswb(dst0.r(), dst0.r());
+    }
+  }
+}
+
+void Generator::storeAlpha_SSE2(
+  const PtrRef& base, SysInt disp, const XMMRef& src0,
+  SysInt count, bool aligned)
+{
+  BLITJIT_ASSERT(count == 1 || count == 4 || count == 16);
+
+  if (count == 16)
+  {
+    storeDQ(ptr(base.c(), disp), src0, nonThermalHint(), aligned);
+  }
+  else if (count == 4)
+  {
+    c->movd(ptr(base.c(), disp), src0.r());
+  }
+  else
+  {
+    Int32Ref t0(c->newVariable(VARIABLE_TYPE_INT32));
+
+    c->movd(t0.x(), src0.r());
+    c->mov(byte_ptr(base.c(), disp), t0.r8());
+  }
+}
+
+void Generator::expand16_1x1B_SSE2(
+  const XMMRef& pix0, const PixelFormat* pf)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->movdqa(t0.x(), pix0.c());
+  c->movdqa(t1.x(), pix0.c());
+
+  if (pf->id() == PixelFormat::RGB565)
+  {
+    // Move components to highest bits of ARGB32 components.
+    c->pslld(pix0.r(), imm(8));
+    c->pslld(t0.r(), imm(5));
+    c->pslld(t1.r(), imm(3));
+    c->pand(pix0.r(), BLITJIT_GETCONST(this, _00F8000000F8000000F8000000F80000));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _0000FC000000FC000000FC000000FC00));
+    c->pand(t1.r(), BLITJIT_GETCONST(this, _000000F8000000F8000000F8000000F8));
+    c->por(pix0.r(), t0.r());
+    c->por(pix0.r(), t1.r());
+
+    // Replicate highest bits to lowest bits (0x1F -> 0xFF).
+    c->movdqa(t0.x(), pix0.c());
+    c->movdqa(t1.x(), pix0.c());
+    c->psrld(t0.r(), imm(5));
+    c->psrld(t1.r(), imm(6));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _00070007000700070007000700070007));
+    c->pand(t1.r(), BLITJIT_GETCONST(this, _00000300000003000000030000000300));
+    c->por(pix0.r(), t0.r());
+    c->por(pix0.r(), t1.r());
+  }
+  else
+  {
+    // Move components to highest bits of ARGB32 components.
+    c->pslld(pix0.r(), imm(9));
+    c->pslld(t0.r(), imm(6));
+    c->pslld(t1.r(), imm(3));
+    c->pand(pix0.r(), BLITJIT_GETCONST(this, _00F8000000F8000000F8000000F80000));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _0000F8000000F8000000F8000000F800));
+    c->pand(t1.r(), BLITJIT_GETCONST(this, _000000F8000000F8000000F8000000F8));
+    c->por(pix0.r(), t0.r());
+    c->por(pix0.r(), t1.r());
+
+    // Replicate highest bits to lowest bits (0x1F -> 0xFF).
+    c->movdqa(t0.x(), pix0.c());
+    c->psrld(t0.r(), imm(5));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _00070707000707070007070700070707));
+    c->por(pix0.r(), t0.r());
+  }
+
+  c->por(pix0.r(), BLITJIT_GETCONST(this, _FF000000FF000000FF000000FF000000));
+}
+
+void Generator::pack16_1x1B_SSE2(
+  const XMMRef& pix0, const PixelFormat* pf)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->movdqa(t0.x(), pix0.c());
+  c->movdqa(t1.x(), pix0.c());
+
+  if (pf->id() == PixelFormat::RGB565)
+  {
+    c->psrld(pix0.r(), imm(8));
+    c->psrld(t0.r(), imm(5));
+    c->psrld(t1.r(), imm(3));
+    c->pand(pix0.r(), BLITJIT_GETCONST(this, _0000F8000000F8000000F8000000F800));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _000007E0000007E0000007E0000007E0));
+  }
+  else
+  {
+    c->psrld(pix0.r(), imm(9));
+    c->psrld(t0.r(), imm(6));
+    c->psrld(t1.r(), imm(3));
+    c->pand(pix0.r(), BLITJIT_GETCONST(this, _00007C0000007C0000007C0000007C00));
+    c->pand(t0.r(), BLITJIT_GETCONST(this, _000003E0000003E0000003E0000003E0));
+  }
+
+  c->pand(t1.r(), BLITJIT_GETCONST(this, _0000001F0000001F0000001F0000001F));
+  c->por(pix0.r(), t0.r());
+  c->por(pix0.r(), t1.r());
+}
+
+bool Generator::useDither(
+  const PixelFormat* dstPf, const PixelFormat* srcPf, const Operator* op)
+{
+  if ((options() & OptionDither) == 0 || dstPf->depth() != 16) return false;
+
+  // Copying 16 bit pixels doesn't lose precision.
+  if (srcPf->depth() == 16 && op->id() == Operator::CompositeSrc) return false;
+
+  return true;
+}
+
+void Generator::loadDither_SSE2(
+  const XMMRef& dst0, const PtrRef& base, SysInt disp, const PixelFormat* pf)
+{
+  SysIntRef t0(c->newVariable(VARIABLE_TYPE_SYSINT));
+  PtrRef t1(c->newVariable(VARIABLE_TYPE_PTR));
+
+  // Horizontal phase ((address >> 1) & 3) multiplied by 16.
+  c->lea(t0.x(), ptr(base.c(), disp));
+  c->and_(t0.r(), imm(6));
+  c->shl(t0.r(), imm(3));
+
+  // Vertical phase multiplied by 64.
+  if (_ditherRow)
+  {
+    SysIntRef t2(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+    c->mov(t2.x(), *_ditherRow);
+    c->and_(t2.r(), imm(3));
+    c->shl(t2.r(), imm(6));
+    c->add(t0.r(), t2.r());
+  }
+
+  if (pf->id() == PixelFormat::RGB565)
+    c->lea(t1.x(), BLITJIT_GETCONST(this, _Dither565));
+  else
+    c->lea(t1.x(), BLITJIT_GETCONST(this, _Dither555));
+
+  c->movdqa(dst0.x(), ptr(t1.c(), t0.c()));
+}
+
+void Generator::swapRB_1x1B_SSE2(
+  const XMMRef& pix0)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->movdqa(t0.x(), pix0.c());
+  c->pand(pix0.r(), BLITJIT_GETCONST(this, _FF00FF00FF00FF00FF00FF00FF00FF00));
+  c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+  c->pshuflw(t0.r(), t0.r(), mm_shuffle(2, 3, 0, 1));
+  c->pshufhw(t0.r(), t0.r(), mm_shuffle(2, 3, 0, 1));
+  c->por(pix0.r(), t0.r());
+}
+
+void Generator::swizzle_1x1B_SSE2(
+  const XMMRef& pix0, UInt32 swizzle)
+{
+  if (swizzle == mm_shuffle(3, 2, 1, 0)) return;
+
+  // Only red and blue are swapped, no need to unpack.
+  if (swizzle == mm_shuffle(3, 0, 1, 2))
+  {
+    swapRB_1x1B_SSE2(pix0);
+    return;
+  }
+
+  XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  unpack_2x2W_SSE2(pix0, pix1, pix0);
+  swizzle_2x2W_SSE2(pix0, pix1, swizzle);
+  pack_2x2W_SSE2(pix0, pix0, pix1);
+}
+
+void Generator::swizzle_1x1W_SSE2(
+  const XMMRef& pix0, UInt32 swizzle)
+{
+  if (swizzle == mm_shuffle(3, 2, 1, 0)) return;
+
+  c->pshuflw(pix0.r(), pix0.r(), imm(swizzle));
+  c->pshufhw(pix0.r(), pix0.r(), imm(swizzle));
+}
+
+void Generator::swizzle_2x2W_SSE2(
+  const XMMRef& pix0, const XMMRef& pix1, UInt32 swizzle)
+{
+  if (swizzle == mm_shuffle(3, 2, 1, 0)) return;
+
+  c->pshuflw(pix0.r(), pix0.r(), imm(swizzle));
+  c->pshuflw(pix1.r(), pix1.r(), imm(swizzle));
+  c->pshufhw(pix0.r(), pix0.r(), imm(swizzle));
+  c->pshufhw(pix1.r(), pix1.r(), imm(swizzle));
+}
+
+void Generator::premultiply_1x1B_SSE2(
+  const XMMRef& pix0, int alphaPos0)
+{
+  XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  unpack_2x2W_SSE2(pix0, pix1, pix0);
+  premultiply_2x2W_SSE2(
+    pix0, alphaPos0,
+    pix1, alphaPos0);
+  pack_2x2W_SSE2(pix0, pix0, pix1);
+}
+
+void Generator::demultiply_1x1B_SSE2(
+  const XMMRef& pix0, int alphaPos0)
+{
+  XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef m0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef r0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Alpha, r0 is result (alpha is kept).
+  c->movdqa(a0.x(), pix0.c());
+  if (alphaPos0 != 3) c->pslld(a0.r(), imm(24 - alphaPos0 * 8));
+  c->psrld(a0.r(), imm(24));
+  c->movdqa(r0.x(), a0.c());
+  if (alphaPos0 != 0) c->pslld(r0.r(), imm(alphaPos0 * 8));
+
+  // Alpha as float and mask of pixels with non-zero alpha.
+  c->cvtdq2ps(a0.r(), a0.r());
+  c->xorps(m0.x(), m0.x());
+  c->cmpps(m0.r(), a0.r(), imm(4));
+
+  // t1 = 255 / a, reciprocal is refined by one Newton-Raphson step 
+  // (r' = r * (2 - a * r)). Remaining error is below 3e-4 after multiplying
+  // by color, rounding bias 0.5 + 1/1024 gives exact round(c * 255 / a),
+  // because fractional part of c * 255 / a is either 0.5 or at least 
+  // 1/510 away from it.
+  c->rcpps(t1.x(), a0.c());
+  c->mulps(a0.r(), t1.r());
+  c->movaps(t0.x(), BLITJIT_GETCONST(this, _40000000400000004000000040000000));
+  c->subps(t0.r(), a0.r());
+  c->mulps(t1.r(), t0.r());
+  c->mulps(t1.r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+  c->andps(t1.r(), m0.r());
+
+  for (int i = 0; i < 4; i++)
+  {
+    if (i == alphaPos0) continue;
+
+    c->movdqa(t0.x(), pix0.c());
+    if (i != 3) c->pslld(t0.r(), imm(24 - i * 8));
+    c->psrld(t0.r(), imm(24));
+    c->cvtdq2ps(t0.r(), t0.r());
+    c->mulps(t0.r(), t1.r());
+    c->minps(t0.r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+    c->addps(t0.r(), BLITJIT_GETCONST(this, _3F0040003F0040003F0040003F004000));
+    c->cvttps2dq(t0.r(), t0.r());
+    if (i != 0) c->pslld(t0.r(), imm(i * 8));
+    c->por(r0.r(), t0.r());
+  }
+
+  c->movdqa(pix0.x(), r0.c());
+}
+
+// ==========================================================================
+// [BlitJit::Generator - Generator Helpers]
+// ==========================================================================
+
+void Generator::composite_1x1W_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+  const Operator* op,
+  bool two,
+  const PixelFormat* pf)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM, 0));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+  switch (op->id())
+  {
+    // Dca' = Sca
+    // Da'  = Sa
+    case Operator::CompositeSrc:
+    {
+      // copy operation (optimized in frontends and also by Generator itself)
+      c->movdqa(dst0.r(), src0.r());
+      break;
+    }
+
+    // Dca' = Dca
+    // Da'  = Da
+    case Operator::CompositeDest:
+    {
+      // no operation (optimized in frontends and also by Generator itself)
+      break;
+    }
+
+    // Dca' = Sca + Dca.(1 - Sa)
+    // Da'  = Sa + Da.(1 - Sa)
+    //      = Sa + Da - Sa.Da
+    case Operator::CompositeOver:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
+      mul_1x1W_SSE2(dst0, dst0, t0);
+      add_1x1W_SSE2(dst0, dst0, src0);
+      break;
+    }
+
+    // Dca' = Dca + Sca.(1 - Da)
+    // Da'  = Da + Sa.(1 - Da)
+    //      = Da + Sa - Da.Sa
+    case Operator::CompositeOverReverse:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, true, two);
+      mul_1x1W_SSE2(t0, t0, src0);
+      c->paddusb(dst0.r(), t0.r());
+      break;
+    }
+
+    // Dca' = Sca.Da
+    // Da'  = Sa.Da 
+    case Operator::CompositeIn:
+    {
+      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, false, two);
+      mul_1x1W_SSE2(dst0, t0, src0);
+      break;
+    }
+
+    // Dca' = Dca.Sa
+    // Da'  = Da.Sa
+    case Operator::CompositeInReverse:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, false, two);
+      mul_1x1W_SSE2(dst0, t0, t0);
+      break;
+    }
+
+    // Dca' = Sca.(1 - Da)
+    // Da'  = Sa.(1 - Da) 
+    case Operator::CompositeOut:
+    {
+      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, true, two);
+      mul_1x1W_SSE2(dst0, t0, src0);
+      break;
+    }
+
+    // Dca' = Dca.(1 - Sa) 
+    // Da'  = Da.(1 - Sa) 
+    case Operator::CompositeOutReverse:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
+      mul_1x1W_SSE2(dst0, dst0, t0);
+      break;
+    }
+
+    // Dca' = Sca.Da + Dca.(1 - Sa)
+    // Da'  = Sa.Da + Da.(1 - Sa)
+    //      = Da.(Sa + 1 - Sa)
+    //      = Da
+    case Operator::CompositeAtop:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
+      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, false, two);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      break;
+    }
+
+    // Dca' = Dca.Sa + Sca.(1 - Da)
+    // Da'  = Da.Sa + Sa.(1 - Da)
+    //      = Sa.(Da + 1 - Da)
+    //      = Sa 
+    case Operator::CompositeAtopReverse:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, false, two);
+      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      break;
+    }
+
+    // Dca' = Sca.(1 - Da) + Dca.(1 - Sa)
+    // Da'  = Sa.(1 - Da) + Da.(1 - Sa)
+    //      = Sa + Da - 2.Sa.Da 
+    case Operator::CompositeXor:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
+      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      break;
+    }
+
+    // Dca' = 0
+    // Da'  = 0
+    case Operator::CompositeClear:
+    {
+      // clear operation (optimized in frontends and also by Generator itself)
+      c->pxor(dst0.r(), dst0.r());
+      break;
+    }
+
+    // Dca' = Sca + Dca
+    // Da'  = Sa + Da 
+    case Operator::CompositeAdd:
+    {
+      c->paddusb(dst0.r(), src0.r());
+      break;
+    }
+
+    // Dca' = Dca - Sca
+    // Da'  = 1 - (1 - Sa).(1 - Da)
+    case Operator::CompositeSubtract:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
+      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
+      mul_1x1W_SSE2(t0, t0, t1);
+      c->psubusb(dst0.r(), src0.r());
+      c->por(dst0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
+      c->psubusb(dst0.r(), t0.r());
+      break;
+    }
+
+    // Dca' = Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = Sca.(Dca + 1 - Da) + Dca.(1 - Sa)
+    //      = Dca.(Sca + 1 - Sa) + Sca.(1 - Da)
+    // Da'  = Sa.Da + Sa.(1 - Da) + Da.(1 - Sa)
+    //      = Sa.(Da + 1 - Da) + Da.(1 - Sa)
+    //      = Da.(Sa + 1 - Sa) + Sa.(1 - Da)
+    //      = Sa + Da - Sa.Da
+    case Operator::CompositeMultiply:
+    {
+      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two); // t0 == 1-alpha from src0
+      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two); // t1 == 1-alpha from dst0
+      add_1x1W_SSE2(t0, t0, src0);
+      mul_2x2W_SSE2(dst0, dst0, t0, t1, t1, src0);
+      add_1x1W_SSE2(dst0, dst0, t1);
+      break;
+    }
+
+    // Dca' = (Sca.Da + Dca.Sa - Sca.Dca) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = Sca + Dca - Sca.Dca
+    //      = Dca + Sca.(1 - Dca)
+    //      = Sca + Dca.(1 - Sca)
+    // Da'  = Sa + Da - Sa.Da
+    //      = Da + Sa.(1 - Da) = Sa + Da.(1 - Sa)
+    case Operator::CompositeScreen:
+    {
+      mov_1x1W_SSE2(t0, src0);
+      negate_1x1W_SSE2(t0, t0);
+      mul_1x1W_SSE2(dst0, dst0, t0);
+      add_1x1W_SSE2(dst0, dst0, src0);
+      break;
+    }
+
+    // Dca' = min(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    // Da'  = min(Sa.Da, Da.Sa) + Sa.(1 - Da) + Da.(1 - Sa)
+    //      = Sa.Da + Sa - Sa.Da + Da - Sa.Da
+    //      = Sa + Da - Sa.Da 
+    case Operator::CompositeDarken:
+    // ... go through ...
+
+    // Dca' = max(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    // Da'  = max(Sa.Da, Da.Sa) + Sa.(1 - Da) + Da.(1 - Sa)
+    //      = Sa.Da + Sa - Sa.Da + Da - Sa.Da
+    //      = Sa + Da - Sa.Da 
+    case Operator::CompositeLighten:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos0, false);
+      mul_2x2W_SSE2(t2, t0, dst0, t3, t1, src0);
+
+      if (op->id() == Operator::CompositeDarken)
+        c->pminsw(t3.r(), t2.r());
+      else
+        c->pmaxsw(t3.r(), t2.r());
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos0, true);
+      _PackedMultiplyAdd(dst0, t0, t1, src0, t2);
+      c->paddusw(dst0.r(), t3.r());
+      break;
+    }
+
+    // Dca' = Sca + Dca - 2.min(Sca.Da, Dca.Sa)
+    // Da'  = Sa + Da - min(Sa.Da, Da.Sa)
+    //      = Sa + Da - Sa.Da
+    case Operator::CompositeDifference:
+    {
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos0, false);
+      mul_2x2W_SSE2(t0, t0, dst0, t1, t1, src0);
+      c->pminsw(t0.r(), t1.r());
+      c->paddusw(dst0.r(), src0.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _000000FF00FF00FF000000FF00FF00FF));
+      c->psubusw(dst0.r(), t0.r());
+      break;
+    }
+
+    // Dca' = (Sca.Da + Dca.Sa - 2.Sca.Dca) + Sca.(1 - Da) + Dca.(1 - Sa)
+    // Dca' = Sca + Dca - 2.Sca.Dca
+    //      
+    // Da'  = (Sa.Da + Da.Sa - 2.Sa.Da) + Sa.(1 - Da) + Da.(1 - Sa)
+    //      = Sa - Sa.Da + Da - Da.Sa = Sa + Da - 2.Sa.Da
+    // Substitute 2.Sa.Da with Sa.Da
+    //
+    // Da'  = Sa + Da - Sa.Da 
+    case Operator::CompositeExclusion:
+    {
+      c->movdqa(t0.r(), src0.r());
+      mul_1x1W_SSE2(t0, t0, dst0);
+      c->paddusw(dst0.r(), src0.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _000000FF00FF00FF000000FF00FF00FF));
+      c->psubusw(dst0.r(), t0.r());
+      break;
+    }
+
+    // Dca' = (Da - Dca) * Sa + Dca.(1 - Sa)
+    // Da'  = Sa + (Da - Da) * Sa + Da - Sa.Da
+    //      = Sa + Da - Sa.Da
+    case Operator::CompositeInvert:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(
+        t0, src0, alphaPos0, false,  // Sa
+        t2, dst0, alphaPos0, false); // Da
+
+      c->movdqa(t1.r(), t0.r());
+      c->psubusb(t2.r(), dst0.r());
+      c->pxor(t1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+
+      // t1 = 1 - Sa
+      // t2 = Da - Dca
+
+      mul_2x2W_SSE2(
+        t2, t2, t0,       // t2   = Sa.(Da - Dca)
+        dst0, dst0, t1);  // dst0 = Dca.(1 - Sa)
+
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
+      c->paddusb(dst0.r(), t2.r());
+      c->paddusb(dst0.r(), t0.r());
+      break;
+    }
+
+    // Dca' = (Da - Dca) * Sca + Dca.(1 - Sa)
+    // Da'  = Sa + (Da - Da) * Sa + Da - Da.Sa
+    //      = Sa + Da - Da.Sa
+    case Operator::CompositeInvertRgb:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(
+        t0, src0, alphaPos0, false,  // Sa
+        t2, dst0, alphaPos0, false); // Da
+
+      c->movdqa(t1.r(), t0.r());
+      c->psubw(t2.r(), dst0.r());
+      c->pxor(t1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+
+      // t1 = 1 - Sa
+      // t2 = Da - Dca
+
+      mul_2x2W_SSE2(
+        t2, t2, src0,     // t2   = Sca.(Da - Dca)
+        dst0, dst0, t1);  // dst0 = Dca.(1 - Sa)
+
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
+      c->paddusb(dst0.r(), t2.r());
+      c->paddusb(dst0.r(), t0.r());
+      break;
+    }
+
+    // Separable blend modes (divisions and square root are done in floats).
+    case Operator::CompositeOverlay:
+    case Operator::CompositeColorDodge:
+    case Operator::CompositeColorBurn:
+    case Operator::CompositeHardLight:
+    case Operator::CompositeSoftLight:
+    {
+      blend_1x1W_SSE2(dst0, src0, alphaPos0, op, two);
+      break;
+    }
+
+    // Non-separable blend modes (4 pixels are transposed to planar form).
+    case Operator::CompositeHue:
+    case Operator::CompositeSaturation:
+    case Operator::CompositeColor:
+    case Operator::CompositeLuminosity:
+    {
+      UInt32 pos[4];
+      getARGB32Positions(pf ? pf : &Api::pixelFormats[PixelFormat::ARGB32], pos);
+
+      blendNonSeparable_2x2W_SSE2(dst0, src0, dst0, src0, pos, op, false);
+      break;
+    }
+  }
+}
+
+void Generator::composite_2x2W_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+  const XMMRef& dst1, const XMMRef& src1, int alphaPos1,
+  const Operator* op,
+  const PixelFormat* pf)
+{
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM, 0));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+      // copy operation (optimized in frontends and also by Generator itself)
+      mov_2x2W_SSE2(dst0, src0, dst1, src1);
+      break;
+    case Operator::CompositeDest:
+      // no operation (optimized in frontends and also by Generator itself)
+      break;
+    case Operator::CompositeOver:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
+      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      add_2x2W_SSE2(dst0, dst0, src0, dst1, dst1, src1);
+      break;
+    case Operator::CompositeOverReverse:
+      extractAlpha_2x2W_SSE2(t0, dst0, alphaPos0, true, t1, dst1, alphaPos1, true);
+      mul_2x2W_SSE2(t0, t0, src0, t1, t1, src1);
+      add_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      break;
+    case Operator::CompositeIn:
+      extractAlpha_2x2W_SSE2(t0, dst0, alphaPos0, false, t1, dst1, alphaPos1, false);
+      mul_2x2W_SSE2(dst0, t0, src0, dst1, t1, src1);
+      break;
+    case Operator::CompositeInReverse:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, src1, alphaPos1, false);
+      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      break;
+    case Operator::CompositeOut:
+      extractAlpha_2x2W_SSE2(dst0, dst0, alphaPos0, true, dst1, dst1, alphaPos1, true);
+      mul_2x2W_SSE2(dst0, dst0, src0, dst1, dst1, src1);
+      break;
+    case Operator::CompositeOutReverse:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
+      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      break;
+    case Operator::CompositeAtop:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos1, false);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, true, t1, dst1, alphaPos1, false);
+      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
+      break;
+    case Operator::CompositeAtopReverse:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos1, true);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, false, t1, dst1, alphaPos1, true);
+      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
+      break;
+    case Operator::CompositeXor:
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos1, true);
+      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+
+      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, true, t1, dst1, alphaPos1, true);
+      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
+      break;
+    case Operator::CompositeClear:
+      // clear operation (optimized in frontends and also by Generator itself)
+      c->pxor(dst0.r(), dst0.r());
+      c->pxor(dst1.r(), dst1.r());
+      break;
+    case Operator::CompositeAdd:
+      c->paddusb(dst0.r(), src0.r());
+      c->paddusb(dst1.r(), src1.r());
+      break;
+
+    // Operators below use at most four temporaries (t0 to t3), so together
+    // with source and destination pixels they fit in eight XMM registers and
+    // the register allocator needs to spill only constants in 32 bit mode.
+
+    // Dca' = Dca - Sca
+    // Da'  = 1 - (1 - Sa).(1 - Da)
+    case Operator::CompositeSubtract:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
+      extractAlpha_2x2W_SSE2(t2, dst0, alphaPos0, true, t3, dst1, alphaPos1, true);
+      mul_2x2W_SSE2(t0, t0, t2, t1, t1, t3);
+
+      c->psubusw(dst0.r(), src0.r());
+      c->psubusw(dst1.r(), src1.r());
+      c->por(dst0.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos0 * 16));
+      c->por(dst1.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos1 * 16));
+      c->pand(t0.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos0 * 16));
+      c->pand(t1.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos1 * 16));
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      break;
+    }
+
+    // Dca' = Dca.(Sca + 1 - Sa) + Sca.(1 - Da)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeMultiply:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
+      extractAlpha_2x2W_SSE2(t2, dst0, alphaPos0, true, t3, dst1, alphaPos1, true);
+      c->paddw(t0.r(), src0.r());
+      c->paddw(t1.r(), src1.r());
+
+      // dst = (dst * t0 + t2 * src) / 255, t0 and t1 are used as temporaries
+      // after they are multiplied.
+      _PackedMultiplyAdd_4(
+        dst0, t0, t2, src0, t0,
+        dst1, t1, t3, src1, t1,
+        false);
+      break;
+    }
+
+    // Dca' = Sca + Dca.(1 - Sca)
+    // Da'  = Sa + Da.(1 - Sa)
+    case Operator::CompositeScreen:
+    {
+      negate_2x2W_SSE2(t0, src0, t1, src1);
+      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      c->paddw(dst0.r(), src0.r());
+      c->paddw(dst1.r(), src1.r());
+      break;
+    }
+
+    // Dca' = min(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = Sca + Dca - max(Sca.Da, Dca.Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeDarken:
+    // ... go through ...
+
+    // Dca' = max(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = Sca + Dca - min(Sca.Da, Dca.Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeLighten:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, src1, alphaPos1, false);
+      extractAlpha_2x2W_SSE2(t2, dst0, alphaPos0, false, t3, dst1, alphaPos1, false);
+      mul_2x2W_SSE2(t0, t0, dst0, t1, t1, dst1); // Dca.Sa
+      mul_2x2W_SSE2(t2, t2, src0, t3, t3, src1); // Sca.Da
+
+      if (op->id() == Operator::CompositeDarken)
+      {
+        c->pmaxsw(t0.r(), t2.r());
+        c->pmaxsw(t1.r(), t3.r());
+      }
+      else
+      {
+        c->pminsw(t0.r(), t2.r());
+        c->pminsw(t1.r(), t3.r());
+      }
+
+      c->paddw(dst0.r(), src0.r());
+      c->paddw(dst1.r(), src1.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      break;
+    }
+
+    // Dca' = Sca + Dca - 2.min(Sca.Da, Dca.Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeDifference:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, src1, alphaPos1, false);
+      extractAlpha_2x2W_SSE2(t2, dst0, alphaPos0, false, t3, dst1, alphaPos1, false);
+      mul_2x2W_SSE2(t0, t0, dst0, t1, t1, dst1); // Dca.Sa
+      mul_2x2W_SSE2(t2, t2, src0, t3, t3, src1); // Sca.Da
+      c->pminsw(t0.r(), t2.r());
+      c->pminsw(t1.r(), t3.r());
+
+      // Subtract min() twice, then add it back to alpha.
+      c->paddw(dst0.r(), src0.r());
+      c->paddw(dst1.r(), src1.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      c->pand(t0.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos0 * 16));
+      c->pand(t1.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos1 * 16));
+      c->paddw(dst0.r(), t0.r());
+      c->paddw(dst1.r(), t1.r());
+      break;
+    }
+
+    // Dca' = Sca + Dca - 2.Sca.Dca
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeExclusion:
+    {
+      mul_2x2W_SSE2(t0, src0, dst0, t1, src1, dst1);
+
+      // Subtract product twice, then add it back to alpha.
+      c->paddw(dst0.r(), src0.r());
+      c->paddw(dst1.r(), src1.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->psubusw(dst1.r(), t1.r());
+      c->pand(t0.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos0 * 16));
+      c->pand(t1.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos1 * 16));
+      c->paddw(dst0.r(), t0.r());
+      c->paddw(dst1.r(), t1.r());
+      break;
+    }
+
+    // Dca' = (Da - Dca).Sa + Dca.(1 - Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeInvert:
+    // ... go through ...
+
+    // Dca' = (Da - Dca).Sca + Dca.(1 - Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeInvertRgb:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+
+      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, src1, alphaPos1, false);
+      extractAlpha_2x2W_SSE2(t2, dst0, alphaPos0, false, t3, dst1, alphaPos1, false);
+
+      // t2 = Da - Dca, alpha is set to 1 so it's multiplied to Sa.
+      c->psubw(t2.r(), dst0.r());
+      c->psubw(t3.r(), dst1.r());
+      c->por(t2.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos0 * 16));
+      c->por(t3.r(), BLITJIT_GETCONST_WITH_DISPLACEMENT(this, _00000000000000FF00000000000000FF, alphaPos1 * 16));
+
+      if (op->id() == Operator::CompositeInvert)
+      {
+        c->pmullw(t2.r(), t0.r());
+        c->pmullw(t3.r(), t1.r());
+      }
+      else
+      {
+        c->pmullw(t2.r(), src0.r());
+        c->pmullw(t3.r(), src1.r());
+      }
+
+      // t0 = 1 - Sa
+      c->pxor(t0.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+      c->pxor(t1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+      c->pmullw(dst0.r(), t0.r());
+      c->pmullw(dst1.r(), t1.r());
+
+      c->paddusw(dst0.r(), t2.r());
+      c->paddusw(dst1.r(), t3.r());
+
+      // dst /= 255
+      div255_2x2W_SSE2(dst0, dst1);
+      break;
+    }
+
+    // Separable blend modes (divisions and square root are done in floats).
+    case Operator::CompositeOverlay:
+    case Operator::CompositeColorDodge:
+    case Operator::CompositeColorBurn:
+    case Operator::CompositeHardLight:
+    case Operator::CompositeSoftLight:
+    {
+      blend_1x1W_SSE2(dst0, src0, alphaPos0, op, true);
+      blend_1x1W_SSE2(dst1, src1, alphaPos1, op, true);
+      break;
+    }
+
+    // Non-separable blend modes (4 pixels are transposed to planar form).
+    case Operator::CompositeHue:
+    case Operator::CompositeSaturation:
+    case Operator::CompositeColor:
+    case Operator::CompositeLuminosity:
+    {
+      UInt32 pos[4];
+      getARGB32Positions(pf ? pf : &Api::pixelFormats[PixelFormat::ARGB32], pos);
+
+      blendNonSeparable_2x2W_SSE2(dst0, src0, dst1, src1, pos, op, false);
+      break;
+    }
   }
 }
 
-void Generator::storeDQ(const Mem& dst, const XMMRef& src, bool nt, bool aligned)
+void Generator::composite_1x1W16_SSE2(
+  const XMMRef& dst0, const XMMRef& src0,
+  const Operator* op)
 {
-  if (nt && aligned)
-  {
-    c->movntdq(dst, src.c());
-    f->setSfence(true);
-  }
-  else if (aligned)
-  {
-    c->movdqa(dst, src.c());
-  }
-  else
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  switch (op->id())
   {
-    c->movdqu(dst, src.c());
-  }
-}
+    case Operator::CompositeSrc:
+      c->movdqa(dst0.x(), src0.c());
+      break;
 
-// ==========================================================================
-// [BlitJit::Generator - Constants Management]
-// ==========================================================================
+    case Operator::CompositeDest:
+      break;
 
-void Generator::usingConstants()
-{
-  // Don't initialize it more times
-  if (_body & BodyUsingConstants) return;
+    // Dca' = Sca + Dca.(1 - Sa)
+    case Operator::CompositeOver:
+      extractAlpha_1x1W16_SSE2(t0, src0, true);
+      mul_1x1W16_SSE2(dst0, dst0, t0);
+      c->paddusw(dst0.r(), src0.r());
+      break;
 
-#if defined(BLITJIT_X86)
-  // 32-bit mode: Nop
-#else
-  // 64-bit mode: Allocate register and set custom alloc/spill functions.
-  // TODO:
-  _rConstantsAddress.use(c->newVariable(VARIABLE_TYPE_PTR, 0));
-  c->mov(_rConstantsAddress.x(), imm((SysInt)Constants::instance));
-#endif
+    // Dca' = Dca + Sca.(1 - Da)
+    case Operator::CompositeOverReverse:
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      c->paddusw(dst0.r(), t0.r());
+      break;
 
-  // Initialized, this will prevent us to do initialization more times
-  _body |= BodyUsingConstants;
-}
+    // Dca' = Sca.Da
+    case Operator::CompositeIn:
+      extractAlpha_1x1W16_SSE2(t0, dst0, false);
+      mul_1x1W16_SSE2(dst0, src0, t0);
+      break;
 
-Mem Generator::getConstantsOperand(SysInt displacement)
-{
-#if defined(BLITJIT_X86)
-  // 32-bit mode: Absolute address
-  return ptr_abs(Constants::instance, displacement);
-#else
-  // 64-bit mode: Register + Displacement
-  return ptr(_rConstantsAddress.c(), displacement);
-#endif
-}
+    // Dca' = Dca.Sa
+    case Operator::CompositeInReverse:
+      extractAlpha_1x1W16_SSE2(t0, src0, false);
+      mul_1x1W16_SSE2(dst0, dst0, t0);
+      break;
 
-// ==========================================================================
-// [BlitJit::Generator - MMX/SSE Zero Registers]
-// ==========================================================================
+    // Dca' = Sca.(1 - Da)
+    case Operator::CompositeOut:
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      mul_1x1W16_SSE2(dst0, src0, t0);
+      break;
 
-// custom alloc / spills
-static void customAlloc_zero(Variable* v)
-{
-  Compiler* c = v->compiler();
+    // Dca' = Dca.(1 - Sa)
+    case Operator::CompositeOutReverse:
+      extractAlpha_1x1W16_SSE2(t0, src0, true);
+      mul_1x1W16_SSE2(dst0, dst0, t0);
+      break;
 
-  switch (v->type())
-  {
-    case VARIABLE_TYPE_MM:
+    // Dca' = Sca.Da + Dca.(1 - Sa)
+    case Operator::CompositeAtop:
+      extractAlpha_1x1W16_SSE2(t0, dst0, false);
+      extractAlpha_1x1W16_SSE2(t1, src0, true);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(dst0, dst0, t1);
+      c->paddusw(dst0.r(), t0.r());
+      break;
+
+    // Dca' = Dca.Sa + Sca.(1 - Da)
+    case Operator::CompositeAtopReverse:
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      extractAlpha_1x1W16_SSE2(t1, src0, false);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(dst0, dst0, t1);
+      c->paddusw(dst0.r(), t0.r());
+      break;
+
+    // Dca' = Sca.(1 - Da) + Dca.(1 - Sa)
+    case Operator::CompositeXor:
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      extractAlpha_1x1W16_SSE2(t1, src0, true);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(dst0, dst0, t1);
+      c->paddusw(dst0.r(), t0.r());
+      break;
+
+    case Operator::CompositeClear:
+      c->pxor(dst0.r(), dst0.r());
+      break;
+
+    // Dca' = Sca + Dca
+    case Operator::CompositeAdd:
+      c->paddusw(dst0.r(), src0.r());
+      break;
+
+    // Dca' = Dca - Sca
+    // Da'  = Da + Sa.(1 - Da)
+    case Operator::CompositeSubtract:
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      c->paddusw(t0.r(), dst0.r());
+      c->psubusw(dst0.r(), src0.r());
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+      c->pandn(dst0.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+      c->por(dst0.r(), t0.r());
+      break;
+
+    // Dca' = Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)
+    case Operator::CompositeMultiply:
     {
-      MMRegister r = mk_mm(v->registerCode());
-      c->pxor(r, r);
+      extractAlpha_1x1W16_SSE2(t0, dst0, true);
+      extractAlpha_1x1W16_SSE2(t1, src0, true);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(t1, t1, dst0);
+      mul_1x1W16_SSE2(dst0, dst0, src0);
+      c->paddusw(dst0.r(), t0.r());
+      c->paddusw(dst0.r(), t1.r());
       break;
     }
-    case VARIABLE_TYPE_XMM:
+
+    // Dca' = Sca + Dca.(1 - Sca)
+    case Operator::CompositeScreen:
+      c->movdqa(t0.x(), src0.c());
+      c->pxor(t0.r(), BLITJIT_GETCONST(this, _FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF));
+      mul_1x1W16_SSE2(dst0, dst0, t0);
+      c->paddusw(dst0.r(), src0.r());
+      break;
+
+    // Dca' = min(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = (Sca - Sca.Da) + (Dca - Dca.Sa) + min(Sca.Da, Dca.Sa)
+    //
+    // Dca' = max(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
+    //      = (Sca - Sca.Da) + (Dca - Dca.Sa) + max(Sca.Da, Dca.Sa)
+    case Operator::CompositeDarken:
+    case Operator::CompositeLighten:
     {
-      XMMRegister r = mk_xmm(v->registerCode());
-      c->pxor(r, r);
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+
+      extractAlpha_1x1W16_SSE2(t0, dst0, false);
+      extractAlpha_1x1W16_SSE2(t1, src0, false);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(t1, t1, dst0);
+
+      // t2 = max(t0, t1) - t1 (unsigned)
+      c->movdqa(t2.x(), t0.c());
+      c->psubusw(t2.r(), t1.r());
+
+      c->psubusw(dst0.r(), t1.r());
+      c->paddusw(dst0.r(), src0.r());
+      c->psubusw(dst0.r(), t0.r());
+
+      if (op->id() == Operator::CompositeDarken)
+      {
+        // min(t0, t1) = t0 - t2
+        c->psubusw(t0.r(), t2.r());
+        c->paddusw(dst0.r(), t0.r());
+      }
+      else
+      {
+        // max(t0, t1) = t1 + t2
+        c->paddusw(t1.r(), t2.r());
+        c->paddusw(dst0.r(), t1.r());
+      }
       break;
     }
-  }
-}
 
-static void customAlloc_const(Variable* v)
-{
-  Compiler* c = v->compiler();
+    // Dca' = Sca + Dca - 2.min(Sca.Da, Dca.Sa)
+    //      = (Sca - Sca.Da) + (Dca - Dca.Sa) + abs(Sca.Da - Dca.Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeDifference:
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
+
+      extractAlpha_1x1W16_SSE2(t0, dst0, false);
+      extractAlpha_1x1W16_SSE2(t1, src0, false);
+      mul_1x1W16_SSE2(t0, t0, src0);
+      mul_1x1W16_SSE2(t1, t1, dst0);
+
+      c->movdqa(t2.x(), t0.c());
+      c->movdqa(t3.x(), t1.c());
+      c->psubusw(t2.r(), t1.r());
+      c->psubusw(t3.r(), t0.r());
+      c->psubusw(dst0.r(), t1.r());
+      c->por(t2.r(), t3.r());
+      c->paddusw(dst0.r(), src0.r());
+      c->psubusw(dst0.r(), t0.r());
+      c->paddusw(dst0.r(), t2.r());
 
-  Generator* g = (Generator*)v->dataPtr();
-  SysInt displacement = v->dataInt();
+      // Alpha: add Sa.Da back (it's subtracted twice).
+      c->pand(t1.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+      c->paddusw(dst0.r(), t1.r());
+      break;
+    }
 
-  switch (v->type())
-  {
-    case VARIABLE_TYPE_MM:
+    // Dca' = Sca + Dca - 2.Sca.Dca
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeExclusion:
+      mul_1x1W16_SSE2(t0, src0, dst0);
+      c->psubusw(dst0.r(), t0.r());
+      c->movdqa(t1.x(), src0.c());
+      c->psubusw(t1.r(), t0.r());
+      c->pand(t0.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+      c->paddusw(dst0.r(), t1.r());
+      c->paddusw(dst0.r(), t0.r());
+      break;
+
+    // Dca' = (Da - Dca).Sa + Dca.(1 - Sa)
+    // Dca' = (Da - Dca).Sca + Dca.(1 - Sa)
+    // Da'  = Sa + Da.(1 - Sa)
+    case Operator::CompositeInvert:
+    case Operator::CompositeInvertRgb:
     {
-      MMRegister r = mk_mm(v->registerCode());
-      c->movq(r, g->getConstantsOperand(displacement));
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+
+      // t0 = Da - Dca (zero for alpha)
+      extractAlpha_1x1W16_SSE2(t0, dst0, false);
+      c->psubusw(t0.r(), dst0.r());
+
+      if (op->id() == Operator::CompositeInvert)
+      {
+        extractAlpha_1x1W16_SSE2(t1, src0, false);
+        mul_1x1W16_SSE2(t0, t0, t1);
+      }
+      else
+      {
+        mul_1x1W16_SSE2(t0, t0, src0);
+      }
+
+      extractAlpha_1x1W16_SSE2(t1, src0, true);
+      mul_1x1W16_SSE2(dst0, dst0, t1);
+      c->paddusw(dst0.r(), t0.r());
+
+      c->movdqa(t2.x(), src0.c());
+      c->pand(t2.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+      c->paddusw(dst0.r(), t2.r());
       break;
     }
-    case VARIABLE_TYPE_XMM:
+
+    case Operator::CompositeOverlay:
+    case Operator::CompositeColorDodge:
+    case Operator::CompositeColorBurn:
+    case Operator::CompositeHardLight:
+    case Operator::CompositeSoftLight:
+      blend_1x1W16_SSE2(dst0, src0, op);
+      break;
+
+    case Operator::CompositeHue:
+    case Operator::CompositeSaturation:
+    case Operator::CompositeColor:
+    case Operator::CompositeLuminosity:
     {
-      XMMRegister r = mk_xmm(v->registerCode());
-      c->movdqa(r, g->getConstantsOperand(displacement));
+      static const UInt32 pos[4] = { 0, 1, 2, 3 };
+      blendNonSeparable_2x2W_SSE2(dst0, src0, dst0, src0, pos, op, true);
       break;
     }
-  }
-}
 
-static void customSpill_none(Variable* v)
-{
-  BLITJIT_USE(v);
+    default:
+      BLITJIT_ASSERT(0);
+  }
 }
 
-void Generator::usingMMZero()
+void Generator::extractAlpha_1x1W16_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, bool negate)
 {
-  // Don't initialize it more times
-  if (_body & BodyUsingMMZero) return;
-
-  // MM register with custom alloc / spill
-  _mmZero.use(c->newVariable(VARIABLE_TYPE_MM, 20));
-  _mmZero.setAllocFn(customAlloc_zero);
-  _mmZero.setSpillFn(customSpill_none);
-  _mmZero.alloc();
+  c->pshuflw(dst0.x(), src0.c(), mm_shuffle(3, 3, 3, 3));
+  c->pshufhw(dst0.r(), dst0.r(), mm_shuffle(3, 3, 3, 3));
 
-  // Initialized, this will prevent us to do initialization more times
-  _body |= BodyUsingMMZero;
+  if (negate) c->pxor(dst0.r(), BLITJIT_GETCONST(this, _FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF));
 }
 
-void Generator::usingXMMZero()
+void Generator::mul_1x1W16_SSE2(
+  const XMMRef& dst0, const XMMRef& a0, const XMMRef& b0)
 {
-  // Don't initialize it more times
-  if (_body & BodyUsingXMMZero) return;
-
-  // XMM register with custom alloc / spill
-  _xmmZero.use(c->newVariable(VARIABLE_TYPE_XMM, 20));
-  _xmmZero.setAllocFn(customAlloc_zero);
-  _xmmZero.setSpillFn(customSpill_none);
-  _xmmZero.alloc();
-
-  // Initialized, this will prevent us to do initialization more times
-  _body |= BodyUsingXMMZero;
+  XMMRef lo(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef hi(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // 32 bit products (low four words in lo, high four words in t0).
+  c->movdqa(lo.x(), a0.c());
+  c->movdqa(hi.x(), a0.c());
+  c->pmullw(lo.r(), b0.r());
+  c->pmulhuw(hi.r(), b0.r());
+  c->movdqa(t0.x(), lo.c());
+  c->punpcklwd(lo.r(), hi.r());
+  c->punpckhwd(t0.r(), hi.r());
+
+  // x / 65535 == (t + (t >> 16)) >> 16, where t = x + 0x8000.
+  c->paddd(lo.r(), BLITJIT_GETCONST(this, _00008000000080000000800000008000));
+  c->paddd(t0.r(), BLITJIT_GETCONST(this, _00008000000080000000800000008000));
+  c->movdqa(hi.x(), lo.c());
+  c->psrld(hi.r(), imm(16));
+  c->paddd(lo.r(), hi.r());
+  c->movdqa(hi.x(), t0.c());
+  c->psrld(hi.r(), imm(16));
+  c->paddd(t0.r(), hi.r());
+
+  // Arithmetic shift keeps packssdw from saturating (high word is result).
+  c->psrad(lo.r(), imm(16));
+  c->psrad(t0.r(), imm(16));
+  c->packssdw(lo.r(), t0.r());
+
+  c->movdqa(dst0.x(), lo.c());
 }
 
-void Generator::usingXMM0080()
+void Generator::premultiply_1x1W16_SSE2(
+  const XMMRef& pix0)
 {
-  // Don't initialize it more times
-  if (_body & BodyUsingXMM0080) return;
-
-  usingConstants();
-
-  // XMM register with custom alloc / spill
-  _xmm0080.use(c->newVariable(VARIABLE_TYPE_XMM, 20));
-  _xmm0080.setAllocFn(customAlloc_const);
-  _xmm0080.setSpillFn(customSpill_none);
-  _xmm0080.setDataPtr((void*)this);
-  _xmm0080.setDataInt(BLITJIT_DISPCONST(_00FF00FF00FF00FF00FF00FF00FF00FF));
-  _xmm0080.alloc();
+  XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
 
-  // Initialized, this will prevent us to do initialization more times
-  _body |= BodyUsingXMM0080;
+  extractAlpha_1x1W16_SSE2(a0, pix0, false);
+  c->por(a0.r(), BLITJIT_GETCONST(this, _FFFF000000000000FFFF000000000000));
+  mul_1x1W16_SSE2(pix0, pix0, a0);
 }
 
-// ==========================================================================
-// [BlitJit::Generator - Generator Helpers]
-// ==========================================================================
-
-void Generator::composite_1x1W_SSE2(
-  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
-  const Operator* op,
-  bool two)
+void Generator::composite_1x1F_SSE2(
+  const XMMRef& dst0, const XMMRef& src0,
+  const Operator* op)
 {
-  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM, 0));
-  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM, 0));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
 
   switch (op->id())
   {
-    // Dca' = Sca
-    // Da'  = Sa
     case Operator::CompositeSrc:
-    {
-      // copy operation (optimized in frontends and also by Generator itself)
-      c->movdqa(dst0.r(), src0.r());
+      c->movaps(dst0.x(), src0.c());
       break;
-    }
 
-    // Dca' = Dca
-    // Da'  = Da
     case Operator::CompositeDest:
-    {
-      // no operation (optimized in frontends and also by Generator itself)
       break;
-    }
 
     // Dca' = Sca + Dca.(1 - Sa)
-    // Da'  = Sa + Da.(1 - Sa)
-    //      = Sa + Da - Sa.Da
     case Operator::CompositeOver:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
-      mul_1x1W_SSE2(dst0, dst0, t0);
-      add_1x1W_SSE2(dst0, dst0, src0);
+      extractAlpha_1x1F_SSE2(t0, src0, true);
+      c->mulps(dst0.r(), t0.r());
+      c->addps(dst0.r(), src0.r());
       break;
-    }
 
     // Dca' = Dca + Sca.(1 - Da)
-    // Da'  = Da + Sa.(1 - Da)
-    //      = Da + Sa - Da.Sa
     case Operator::CompositeOverReverse:
-    {
-      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
-
-      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, true, two);
-      mul_1x1W_SSE2(t0, t0, src0);
-      c->paddusb(dst0.r(), t0.r());
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      c->mulps(t0.r(), src0.r());
+      c->addps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Sca.Da
-    // Da'  = Sa.Da 
     case Operator::CompositeIn:
-    {
-      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, false, two);
-      mul_1x1W_SSE2(dst0, t0, src0);
+      extractAlpha_1x1F_SSE2(t0, dst0, false);
+      c->movaps(dst0.x(), src0.c());
+      c->mulps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Dca.Sa
-    // Da'  = Da.Sa
     case Operator::CompositeInReverse:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, false, two);
-      mul_1x1W_SSE2(dst0, t0, t0);
+      extractAlpha_1x1F_SSE2(t0, src0, false);
+      c->mulps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Sca.(1 - Da)
-    // Da'  = Sa.(1 - Da) 
     case Operator::CompositeOut:
-    {
-      extractAlpha_1x1W_SSE2(t0, dst0, alphaPos0, true, two);
-      mul_1x1W_SSE2(dst0, t0, src0);
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      c->movaps(dst0.x(), src0.c());
+      c->mulps(dst0.r(), t0.r());
       break;
-    }
 
-    // Dca' = Dca.(1 - Sa) 
-    // Da'  = Da.(1 - Sa) 
+    // Dca' = Dca.(1 - Sa)
     case Operator::CompositeOutReverse:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
-      mul_1x1W_SSE2(dst0, dst0, t0);
+      extractAlpha_1x1F_SSE2(t0, src0, true);
+      c->mulps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Sca.Da + Dca.(1 - Sa)
-    // Da'  = Sa.Da + Da.(1 - Sa)
-    //      = Da.(Sa + 1 - Sa)
-    //      = Da
     case Operator::CompositeAtop:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
-      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, false, two);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t0, dst0, false);
+      extractAlpha_1x1F_SSE2(t1, src0, true);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(dst0.r(), t1.r());
+      c->addps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Dca.Sa + Sca.(1 - Da)
-    // Da'  = Da.Sa + Sa.(1 - Da)
-    //      = Sa.(Da + 1 - Da)
-    //      = Sa 
     case Operator::CompositeAtopReverse:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, false, two);
-      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t1, src0, false);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(dst0.r(), t1.r());
+      c->addps(dst0.r(), t0.r());
       break;
-    }
 
     // Dca' = Sca.(1 - Da) + Dca.(1 - Sa)
-    // Da'  = Sa.(1 - Da) + Da.(1 - Sa)
-    //      = Sa + Da - 2.Sa.Da 
     case Operator::CompositeXor:
-    {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
-      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t1, src0, true);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(dst0.r(), t1.r());
+      c->addps(dst0.r(), t0.r());
       break;
-    }
 
-    // Dca' = 0
-    // Da'  = 0
     case Operator::CompositeClear:
+      c->xorps(dst0.r(), dst0.r());
+      break;
+
+    // Dca' = min(Sca + Dca, 1)
+    case Operator::CompositeAdd:
+      c->addps(dst0.r(), src0.r());
+      c->minps(dst0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+      break;
+
+    // Dca' = max(Dca - Sca, 0)
+    // Da'  = Da + Sa.(1 - Da)
+    case Operator::CompositeSubtract:
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      c->mulps(t0.r(), src0.r());
+      c->addps(t0.r(), dst0.r());
+      c->subps(dst0.r(), src0.r());
+      c->maxps(dst0.r(), xmmZero().r());
+
+      c->movaps(t1.x(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+      c->andps(dst0.r(), t1.r());
+      c->andnps(t1.r(), t0.r());
+      c->orps(dst0.r(), t1.r());
+      break;
+
+    // Dca' = Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)
+    case Operator::CompositeMultiply:
+      extractAlpha_1x1F_SSE2(t0, dst0, true);
+      extractAlpha_1x1F_SSE2(t1, src0, true);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(t1.r(), dst0.r());
+      c->mulps(dst0.r(), src0.r());
+      c->addps(dst0.r(), t0.r());
+      c->addps(dst0.r(), t1.r());
+      break;
+
+    // Dca' = Sca + Dca - Sca.Dca
+    case Operator::CompositeScreen:
+      c->movaps(t0.x(), src0.c());
+      c->mulps(t0.r(), dst0.r());
+      c->addps(dst0.r(), src0.r());
+      c->subps(dst0.r(), t0.r());
+      break;
+
+    // Dca' = Sca + Dca - max(Sca.Da, Dca.Sa)
+    // Dca' = Sca + Dca - min(Sca.Da, Dca.Sa)
+    case Operator::CompositeDarken:
+    case Operator::CompositeLighten:
+      extractAlpha_1x1F_SSE2(t0, dst0, false);
+      extractAlpha_1x1F_SSE2(t1, src0, false);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(t1.r(), dst0.r());
+
+      if (op->id() == Operator::CompositeDarken)
+        c->maxps(t0.r(), t1.r());
+      else
+        c->minps(t0.r(), t1.r());
+
+      c->addps(dst0.r(), src0.r());
+      c->subps(dst0.r(), t0.r());
+      break;
+
+    // Dca' = Sca + Dca - 2.min(Sca.Da, Dca.Sa)
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeDifference:
+      extractAlpha_1x1F_SSE2(t0, dst0, false);
+      extractAlpha_1x1F_SSE2(t1, src0, false);
+      c->mulps(t0.r(), src0.r());
+      c->mulps(t1.r(), dst0.r());
+      c->minps(t0.r(), t1.r());
+
+      c->addps(dst0.r(), src0.r());
+      c->subps(dst0.r(), t0.r());
+      c->subps(dst0.r(), t0.r());
+
+      c->movaps(t1.x(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+      c->andnps(t1.r(), t0.r());
+      c->addps(dst0.r(), t1.r());
+      break;
+
+    // Dca' = Sca + Dca - 2.Sca.Dca
+    // Da'  = Sa + Da - Sa.Da
+    case Operator::CompositeExclusion:
+      c->movaps(t0.x(), src0.c());
+      c->mulps(t0.r(), dst0.r());
+
+      c->addps(dst0.r(), src0.r());
+      c->subps(dst0.r(), t0.r());
+      c->subps(dst0.r(), t0.r());
+
+      c->movaps(t1.x(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+      c->andnps(t1.r(), t0.r());
+      c->addps(dst0.r(), t1.r());
+      break;
+
+    // Dca' = (Da - Dca).Sa + Dca.(1 - Sa)
+    // Dca' = (Da - Dca).Sca + Dca.(1 - Sa)
+    // Da'  = Sa + Da.(1 - Sa)
+    case Operator::CompositeInvert:
+    case Operator::CompositeInvertRgb:
+      // t0 = Da - Dca (zero for alpha)
+      extractAlpha_1x1F_SSE2(t0, dst0, false);
+      c->subps(t0.r(), dst0.r());
+
+      if (op->id() == Operator::CompositeInvert)
+      {
+        extractAlpha_1x1F_SSE2(t1, src0, false);
+        c->mulps(t0.r(), t1.r());
+      }
+      else
+      {
+        c->mulps(t0.r(), src0.r());
+      }
+
+      extractAlpha_1x1F_SSE2(t1, src0, true);
+      c->mulps(dst0.r(), t1.r());
+      c->addps(dst0.r(), t0.r());
+
+      c->movaps(t1.x(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+      c->andnps(t1.r(), src0.r());
+      c->addps(dst0.r(), t1.r());
+      break;
+
+    case Operator::CompositeOverlay:
+    case Operator::CompositeColorDodge:
+    case Operator::CompositeColorBurn:
+    case Operator::CompositeHardLight:
+    case Operator::CompositeSoftLight:
+      blend_1x1F_SSE2(dst0, src0, 3, op, true);
+      break;
+
+    case Operator::CompositeHue:
+    case Operator::CompositeSaturation:
+    case Operator::CompositeColor:
+    case Operator::CompositeLuminosity:
     {
-      // clear operation (optimized in frontends and also by Generator itself)
-      c->pxor(dst0.r(), dst0.r());
+      XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef d1(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef d2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef s0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef s1(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef s2(c->newVariable(VARIABLE_TYPE_XMM));
+
+      // Each component is broadcasted to all dwords (dst0 and t0 hold alpha).
+      c->movaps(d0.x(), dst0.c());
+      c->movaps(d1.x(), dst0.c());
+      c->movaps(d2.x(), dst0.c());
+      c->movaps(s0.x(), src0.c());
+      c->movaps(s1.x(), src0.c());
+      c->movaps(s2.x(), src0.c());
+      c->shufps(d0.r(), d0.r(), mm_shuffle(0, 0, 0, 0));
+      c->shufps(d1.r(), d1.r(), mm_shuffle(1, 1, 1, 1));
+      c->shufps(d2.r(), d2.r(), mm_shuffle(2, 2, 2, 2));
+      c->shufps(dst0.r(), dst0.r(), mm_shuffle(3, 3, 3, 3));
+      c->shufps(s0.r(), s0.r(), mm_shuffle(0, 0, 0, 0));
+      c->shufps(s1.r(), s1.r(), mm_shuffle(1, 1, 1, 1));
+      c->shufps(s2.r(), s2.r(), mm_shuffle(2, 2, 2, 2));
+      extractAlpha_1x1F_SSE2(t0, src0, false);
+
+      blendNonSeparable_4F_SSE2(d2, d1, d0, dst0, s2, s1, s0, t0, op, true);
+
+      // dst0 = [d0, d1, d2, alpha]
+      c->unpcklps(d0.r(), d1.r());
+      c->unpcklps(d2.r(), dst0.r());
+      c->movlhps(d0.r(), d2.r());
+      c->movaps(dst0.x(), d0.c());
       break;
     }
 
-    // Dca' = Sca + Dca
-    // Da'  = Sa + Da 
-    case Operator::CompositeAdd:
+    default:
+      BLITJIT_ASSERT(0);
+  }
+}
+
+void Generator::blend_1x1F_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+  const Operator* op, bool precise)
+{
+  XMMRef sa(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef da(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef b0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef m0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  UInt8 alphaShuffle = mm_shuffle(alphaPos0, alphaPos0, alphaPos0, alphaPos0);
+
+  c->movaps(sa.x(), src0.c());
+  c->movaps(da.x(), dst0.c());
+  c->shufps(sa.r(), sa.r(), alphaShuffle);
+  c->shufps(da.r(), da.r(), alphaShuffle);
+
+  // b0 is blend term (Sa.Da.B(Cs, Cb)), alpha equation is the same for all
+  // separable blend modes and it's result of color equation where Sca == Sa
+  // and Dca == Da, so alpha is not handled separately.
+  switch (op->id())
+  {
+    // B = 2.X.Y                          if 2.X <= Xa
+    //   = Xa.Ya - 2.(Ya - Y).(Xa - X)    otherwise
+    //
+    // X is source for HardLight and destination for Overlay.
+    case Operator::CompositeOverlay:
+    case Operator::CompositeHardLight:
     {
-      c->paddusb(dst0.r(), src0.r());
+      bool hardLight = (op->id() == Operator::CompositeHardLight);
+
+      const XMMRef& x0 = hardLight ? src0 : dst0;
+      const XMMRef& y0 = hardLight ? dst0 : src0;
+      const XMMRef& xa = hardLight ? sa : da;
+      const XMMRef& ya = hardLight ? da : sa;
+
+      c->movaps(b0.x(), x0.c());
+      c->mulps(b0.r(), y0.r());
+      c->addps(b0.r(), b0.r());
+
+      c->movaps(t0.x(), ya.c());
+      c->movaps(t1.x(), xa.c());
+      c->subps(t0.r(), y0.r());
+      c->subps(t1.r(), x0.r());
+      c->mulps(t0.r(), t1.r());
+      c->addps(t0.r(), t0.r());
+      c->movaps(t1.x(), xa.c());
+      c->mulps(t1.r(), ya.r());
+      c->subps(t1.r(), t0.r());
+
+      c->movaps(m0.x(), x0.c());
+      c->addps(m0.r(), m0.r());
+      c->cmpps(m0.r(), xa.r(), imm(2));
+
+      c->andps(b0.r(), m0.r());
+      c->andnps(m0.r(), t1.r());
+      c->orps(b0.r(), m0.r());
       break;
     }
 
-    // Dca' = Dca - Sca
-    // Da'  = 1 - (1 - Sa).(1 - Da)
-    case Operator::CompositeSubtract:
+    // B = min(Sa.Da, Sa.Sa.Dca / (Sa - Sca)), zero if Dca is zero.
+    //
+    // Division by zero gives infinity (Sca == Sa) or NaN (Sa == 0 or 
+    // Dca == 0), both are handled by min() and by Dca mask. minps returns
+    // its second operand if any operand is NaN, so the quotient must be the
+    // first one.
+    case Operator::CompositeColorDodge:
     {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two);
-      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two);
-      mul_1x1W_SSE2(t0, t0, t1);
-      c->psubusb(dst0.r(), src0.r());
-      c->por(dst0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
-      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
-      c->psubusb(dst0.r(), t0.r());
+      c->movaps(t0.x(), sa.c());
+      c->subps(t0.r(), src0.r());
+      c->maxps(t0.r(), xmmZero().r());
+
+      c->movaps(t1.x(), sa.c());
+      c->mulps(t1.r(), sa.r());
+      c->mulps(t1.r(), dst0.r());
+
+      if (precise)
+      {
+        c->divps(t1.r(), t0.r());
+      }
+      else
+      {
+        c->rcpps(t0.r(), t0.r());
+        c->mulps(t1.r(), t0.r());
+      }
+
+      c->movaps(b0.x(), sa.c());
+      c->mulps(b0.r(), da.r());
+      c->minps(t1.r(), b0.r());
+      c->movaps(b0.x(), t1.c());
+
+      c->movaps(m0.x(), dst0.c());
+      c->cmpps(m0.r(), xmmZero().r(), imm(4));
+      c->andps(b0.r(), m0.r());
       break;
     }
 
-    // Dca' = Sca.Dca + Sca.(1 - Da) + Dca.(1 - Sa)
-    //      = Sca.(Dca + 1 - Da) + Dca.(1 - Sa)
-    //      = Dca.(Sca + 1 - Sa) + Sca.(1 - Da)
-    // Da'  = Sa.Da + Sa.(1 - Da) + Da.(1 - Sa)
-    //      = Sa.(Da + 1 - Da) + Da.(1 - Sa)
-    //      = Da.(Sa + 1 - Sa) + Sa.(1 - Da)
-    //      = Sa + Da - Sa.Da
-    case Operator::CompositeMultiply:
+    // B = max(0, Sa.Da - Sa.Sa.(Da - Dca) / Sca), Sa.Da if Dca >= Da.
+    //
+    // NaN (Sca == 0 and Dca == Da) is replaced by max() and Dca mask.
+    case Operator::CompositeColorBurn:
     {
-      extractAlpha_1x1W_SSE2(t0, src0, alphaPos0, true, two); // t0 == 1-alpha from src0
-      extractAlpha_1x1W_SSE2(t1, dst0, alphaPos0, true, two); // t1 == 1-alpha from dst0
-      add_1x1W_SSE2(t0, t0, src0);
-      mul_2x2W_SSE2(dst0, dst0, t0, t1, t1, src0);
-      add_1x1W_SSE2(dst0, dst0, t1);
+      c->movaps(t0.x(), da.c());
+      c->subps(t0.r(), dst0.r());
+      c->mulps(t0.r(), sa.r());
+      c->mulps(t0.r(), sa.r());
+
+      if (precise)
+      {
+        c->divps(t0.r(), src0.r());
+      }
+      else
+      {
+        c->rcpps(t1.x(), src0.c());
+        c->mulps(t0.r(), t1.r());
+      }
+
+      c->movaps(t1.x(), sa.c());
+      c->mulps(t1.r(), da.r());
+      c->movaps(b0.x(), t1.c());
+      c->subps(b0.r(), t0.r());
+      c->maxps(b0.r(), xmmZero().r());
+
+      c->movaps(m0.x(), dst0.c());
+      c->cmpps(m0.r(), da.r(), imm(5));
+      c->andps(t1.r(), m0.r());
+      c->andnps(m0.r(), b0.r());
+      c->orps(t1.r(), m0.r());
+      c->movaps(b0.x(), t1.c());
       break;
     }
 
-    // Dca' = (Sca.Da + Dca.Sa - Sca.Dca) + Sca.(1 - Da) + Dca.(1 - Sa)
-    //      = Sca + Dca - Sca.Dca
-    //      = Dca + Sca.(1 - Dca)
-    //      = Sca + Dca.(1 - Sca)
-    // Da'  = Sa + Da - Sa.Da
-    //      = Da + Sa.(1 - Da) = Sa + Da.(1 - Sa)
-    case Operator::CompositeScreen:
+    // Cb = Dca / Da (zero if Da is zero)
+    //
+    // B = Dca.Sa + (2.Sca - Sa).F, where F is
+    //
+    //   Dca.(1 - Cb)                     if 2.Sca < Sa
+    //   Dca.((16.Cb - 12).Cb + 3)        if 4.Dca <= Da
+    //   sqrt(Dca.Da) - Dca               otherwise
+    case Operator::CompositeSoftLight:
     {
-      mov_1x1W_SSE2(t0, src0);
-      negate_1x1W_SSE2(t0, t0);
-      mul_1x1W_SSE2(dst0, dst0, t0);
-      add_1x1W_SSE2(dst0, dst0, src0);
+      // t0 = Cb
+      if (precise)
+      {
+        c->movaps(t0.x(), dst0.c());
+        c->divps(t0.r(), da.r());
+      }
+      else
+      {
+        c->rcpps(t0.x(), da.c());
+        c->mulps(t0.r(), dst0.r());
+      }
+
+      c->movaps(m0.x(), da.c());
+      c->cmpps(m0.r(), xmmZero().r(), imm(4));
+      c->andps(t0.r(), m0.r());
+      c->minps(t0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+
+      // b0 = Dca.((16.Cb - 12).Cb + 3)
+      c->movaps(b0.x(), t0.c());
+      c->mulps(b0.r(), BLITJIT_GETCONST(this, _41800000418000004180000041800000));
+      c->subps(b0.r(), BLITJIT_GETCONST(this, _41400000414000004140000041400000));
+      c->mulps(b0.r(), t0.r());
+      c->addps(b0.r(), BLITJIT_GETCONST(this, _40400000404000004040000040400000));
+      c->mulps(b0.r(), dst0.r());
+
+      // t1 = Dca.(1 - Cb)
+      c->movaps(t1.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+      c->subps(t1.r(), t0.r());
+      c->mulps(t1.r(), dst0.r());
+
+      // t0 = sqrt(Dca.Da) - Dca
+      c->movaps(t0.x(), dst0.c());
+      c->mulps(t0.r(), da.r());
+      c->sqrtps(t0.r(), t0.r());
+      c->subps(t0.r(), dst0.r());
+
+      // b0 = (4.Dca <= Da) ? b0 : t0
+      c->movaps(m0.x(), dst0.c());
+      c->addps(m0.r(), m0.r());
+      c->addps(m0.r(), m0.r());
+      c->cmpps(m0.r(), da.r(), imm(2));
+      c->andps(b0.r(), m0.r());
+      c->andnps(m0.r(), t0.r());
+      c->orps(b0.r(), m0.r());
+
+      // t0 = 2.Sca - Sa, b0 = (2.Sca < Sa) ? t1 : b0
+      c->movaps(t0.x(), src0.c());
+      c->addps(t0.r(), t0.r());
+      c->movaps(m0.x(), t0.c());
+      c->subps(t0.r(), sa.r());
+      c->cmpps(m0.r(), sa.r(), imm(1));
+      c->andps(t1.r(), m0.r());
+      c->andnps(m0.r(), b0.r());
+      c->orps(t1.r(), m0.r());
+
+      // b0 = Dca.Sa + (2.Sca - Sa).F
+      c->mulps(t1.r(), t0.r());
+      c->movaps(b0.x(), dst0.c());
+      c->mulps(b0.r(), sa.r());
+      c->addps(b0.r(), t1.r());
       break;
     }
 
-    // Dca' = min(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
-    // Da'  = min(Sa.Da, Da.Sa) + Sa.(1 - Da) + Da.(1 - Sa)
-    //      = Sa.Da + Sa - Sa.Da + Da - Sa.Da
-    //      = Sa + Da - Sa.Da 
-    case Operator::CompositeDarken:
-    // ... go through ...
+    default:
+      BLITJIT_ASSERT(0);
+  }
+
+  // Dca' = B + Sca.(1 - Da) + Dca.(1 - Sa)
+  c->movaps(t0.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->movaps(t1.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->subps(t0.r(), da.r());
+  c->subps(t1.r(), sa.r());
+  c->mulps(t0.r(), src0.r());
+  c->mulps(dst0.r(), t1.r());
+  c->addps(dst0.r(), t0.r());
+  c->addps(dst0.r(), b0.r());
+
+  c->maxps(dst0.r(), xmmZero().r());
+  c->minps(dst0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+}
+
+void Generator::blend_1x1W_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+  const Operator* op, bool two)
+{
+  XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef d1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Pixels are processed one by one to keep register pressure low.
+  for (int i = 0; i < (two ? 2 : 1); i++)
+  {
+    const XMMRef& d = (i == 0) ? d0 : d1;
+
+    c->movdqa(d.x(), dst0.c());
+    c->movdqa(s0.x(), src0.c());
+
+    if (i == 0)
+    {
+      c->punpcklwd(d.r(), xmmZero().r());
+      c->punpcklwd(s0.r(), xmmZero().r());
+    }
+    else
+    {
+      c->punpckhwd(d.r(), xmmZero().r());
+      c->punpckhwd(s0.r(), xmmZero().r());
+    }
+
+    c->cvtdq2ps(d.r(), d.r());
+    c->cvtdq2ps(s0.r(), s0.r());
+    c->mulps(d.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+    c->mulps(s0.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+
+    blend_1x1F_SSE2(d, s0, alphaPos0, op, false);
+
+    c->mulps(d.r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+    c->addps(d.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(d.r(), d.r());
+  }
+
+  if (two)
+    c->packssdw(d0.r(), d1.r());
+  else
+    c->packssdw(d0.r(), d0.r());
+
+  c->movdqa(dst0.x(), d0.c());
+}
+
+void Generator::blend_1x1W16_SSE2(
+  const XMMRef& dst0, const XMMRef& src0,
+  const Operator* op)
+{
+  XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef d1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  for (int i = 0; i < 2; i++)
+  {
+    const XMMRef& d = (i == 0) ? d0 : d1;
+
+    c->movdqa(d.x(), dst0.c());
+    c->movdqa(s0.x(), src0.c());
+
+    if (i == 0)
+    {
+      c->punpcklwd(d.r(), xmmZero().r());
+      c->punpcklwd(s0.r(), xmmZero().r());
+    }
+    else
+    {
+      c->punpckhwd(d.r(), xmmZero().r());
+      c->punpckhwd(s0.r(), xmmZero().r());
+    }
+
+    c->cvtdq2ps(d.r(), d.r());
+    c->cvtdq2ps(s0.r(), s0.r());
+    c->mulps(d.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+    c->mulps(s0.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+
+    blend_1x1F_SSE2(d, s0, 3, op, true);
+
+    c->mulps(d.r(), BLITJIT_GETCONST(this, _477FFF00477FFF00477FFF00477FFF00));
+    c->addps(d.r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(d.r(), d.r());
+
+    // Sign extend low word, so packssdw doesn't saturate values above 32767.
+    c->pslld(d.r(), imm(16));
+    c->psrad(d.r(), imm(16));
+  }
+
+  c->packssdw(d0.r(), d1.r());
+  c->movdqa(dst0.x(), d0.c());
+}
+
+void Generator::blendNonSeparable_4F_SSE2(
+  const XMMRef& dr, const XMMRef& dg, const XMMRef& db, const XMMRef& da,
+  const XMMRef& sr, const XMMRef& sg, const XMMRef& sb, const XMMRef& sa,
+  const Operator* op, bool precise)
+{
+  XMMRef rr(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef rg(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef rb(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef l0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+
+  UInt32 id = op->id();
+
+  // Blend color is computed already multiplied by Sa.Da, Sc.Da == Sca and
+  // Dc.Sa == Dca.Sa, so no demultiplication is needed. Saturation and 
+  // luminance are scaled the same way.
+  bool fromSrc = (id == Operator::CompositeHue || id == Operator::CompositeColor);
+
+  {
+    const XMMRef& xr = fromSrc ? sr : dr;
+    const XMMRef& xg = fromSrc ? sg : dg;
+    const XMMRef& xb = fromSrc ? sb : db;
+    const XMMRef& xa = fromSrc ? da : sa;
+
+    c->movaps(rr.x(), xr.c());
+    c->movaps(rg.x(), xg.c());
+    c->movaps(rb.x(), xb.c());
+    c->mulps(rr.r(), xa.r());
+    c->mulps(rg.r(), xa.r());
+    c->mulps(rb.r(), xa.r());
+  }
+
+  // SetSat(R, Sat(Y).Ya), Y is destination for Hue and source for Saturation.
+  if (id == Operator::CompositeHue || id == Operator::CompositeSaturation)
+  {
+    bool hue = (id == Operator::CompositeHue);
+
+    const XMMRef& yr = hue ? dr : sr;
+    const XMMRef& yg = hue ? dg : sg;
+    const XMMRef& yb = hue ? db : sb;
+    const XMMRef& ya = hue ? sa : da;
+
+    // l0 = Sat(Y).Ya
+    c->movaps(l0.x(), yr.c());
+    c->movaps(t0.x(), yr.c());
+    c->maxps(l0.r(), yg.r());
+    c->minps(t0.r(), yg.r());
+    c->maxps(l0.r(), yb.r());
+    c->minps(t0.r(), yb.r());
+    c->subps(l0.r(), t0.r());
+    c->mulps(l0.r(), ya.r());
+
+    // t0 = min(R), t1 = max(R) - min(R), t2 = mask of non-zero t1
+    c->movaps(t1.x(), rr.c());
+    c->movaps(t0.x(), rr.c());
+    c->maxps(t1.r(), rg.r());
+    c->minps(t0.r(), rg.r());
+    c->maxps(t1.r(), rb.r());
+    c->minps(t0.r(), rb.r());
+    c->subps(t1.r(), t0.r());
+    c->movaps(t2.x(), t1.c());
+    c->cmpps(t2.r(), xmmZero().r(), imm(4));
+
+    if (precise)
+    {
+      c->divps(l0.r(), t1.r());
+    }
+    else
+    {
+      c->rcpps(t1.r(), t1.r());
+      c->mulps(l0.r(), t1.r());
+    }
+    c->andps(l0.r(), t2.r());
+
+    // R = (R - min(R)).Sat / (max(R) - min(R))
+    c->subps(rr.r(), t0.r());
+    c->subps(rg.r(), t0.r());
+    c->subps(rb.r(), t0.r());
+    c->mulps(rr.r(), l0.r());
+    c->mulps(rg.r(), l0.r());
+    c->mulps(rb.r(), l0.r());
+  }
+
+  // l0 = Lum(Z).Za, Z is source for Luminosity and destination otherwise.
+  {
+    bool lumSrc = (id == Operator::CompositeLuminosity);
+
+    const XMMRef& zr = lumSrc ? sr : dr;
+    const XMMRef& zg = lumSrc ? sg : dg;
+    const XMMRef& zb = lumSrc ? sb : db;
+    const XMMRef& za = lumSrc ? da : sa;
+
+    c->movaps(l0.x(), zr.c());
+    c->movaps(t0.x(), zg.c());
+    c->mulps(l0.r(), BLITJIT_GETCONST(this, _3E99999A3E99999A3E99999A3E99999A));
+    c->mulps(t0.r(), BLITJIT_GETCONST(this, _3F170A3D3F170A3D3F170A3D3F170A3D));
+    c->addps(l0.r(), t0.r());
+    c->movaps(t0.x(), zb.c());
+    c->mulps(t0.r(), BLITJIT_GETCONST(this, _3DE147AE3DE147AE3DE147AE3DE147AE));
+    c->addps(l0.r(), t0.r());
+    c->mulps(l0.r(), za.r());
+  }
 
-    // Dca' = max(Sca.Da, Dca.Sa) + Sca.(1 - Da) + Dca.(1 - Sa)
-    // Da'  = max(Sa.Da, Da.Sa) + Sa.(1 - Da) + Da.(1 - Sa)
-    //      = Sa.Da + Sa - Sa.Da + Da - Sa.Da
-    //      = Sa + Da - Sa.Da 
-    case Operator::CompositeLighten:
-    {
-      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
-      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+  // SetLum(R, l0), first move R to luminance l0.
+  c->movaps(t0.x(), rr.c());
+  c->movaps(t1.x(), rg.c());
+  c->mulps(t0.r(), BLITJIT_GETCONST(this, _3E99999A3E99999A3E99999A3E99999A));
+  c->mulps(t1.r(), BLITJIT_GETCONST(this, _3F170A3D3F170A3D3F170A3D3F170A3D));
+  c->addps(t0.r(), t1.r());
+  c->movaps(t1.x(), rb.c());
+  c->mulps(t1.r(), BLITJIT_GETCONST(this, _3DE147AE3DE147AE3DE147AE3DE147AE));
+  c->addps(t0.r(), t1.r());
+
+  c->movaps(t1.x(), l0.c());
+  c->subps(t1.r(), t0.r());
+  c->addps(rr.r(), t1.r());
+  c->addps(rg.r(), t1.r());
+  c->addps(rb.r(), t1.r());
+
+  // Then clip R to [0, Sa.Da] keeping luminance, R = l0 + (R - l0).f, where
+  // f = f0.f1 and
+  //
+  //   f0 = l0 / (l0 - min(R))             if min(R) < 0, otherwise 1
+  //   f1 = (Sa.Da - l0) / (max(R) - l0)   if max(R) > Sa.Da, otherwise 1
+  {
+    XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef m0(c->newVariable(VARIABLE_TYPE_XMM));
 
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos0, false);
-      mul_2x2W_SSE2(t2, t0, dst0, t3, t1, src0);
+    c->movaps(t0.x(), rr.c());
+    c->movaps(t1.x(), rr.c());
+    c->minps(t0.r(), rg.r());
+    c->maxps(t1.r(), rg.r());
+    c->minps(t0.r(), rb.r());
+    c->maxps(t1.r(), rb.r());
 
-      if (op->id() == Operator::CompositeDarken)
-        c->pminsw(t3.r(), t2.r());
-      else
-        c->pmaxsw(t3.r(), t2.r());
+    // t0 = f0
+    c->movaps(t2.x(), l0.c());
+    c->subps(t2.r(), t0.r());
 
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos0, true);
-      _PackedMultiplyAdd(dst0, t0, t1, src0, t2);
-      c->paddusw(dst0.r(), t3.r());
-      break;
+    if (precise)
+    {
+      c->movaps(t3.x(), l0.c());
+      c->divps(t3.r(), t2.r());
     }
-
-    // Dca' = Sca + Dca - 2.min(Sca.Da, Dca.Sa)
-    // Da'  = Sa + Da - min(Sa.Da, Da.Sa)
-    //      = Sa + Da - Sa.Da
-    case Operator::CompositeDifference:
+    else
     {
-      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
-      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
-
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos0, false);
-      mul_2x2W_SSE2(t2, t0, dst0, t3, t1, src0);
-      c->pminsw(t0.r(), t1.r());
-      c->paddusw(dst0.r(), src0.r());
-      c->psubusw(dst0.r(), t0.r());
-      c->pand(t0.r(), BLITJIT_GETCONST(this, _000000FF00FF00FF000000FF00FF00FF));
-      c->psubusw(dst0.r(), t0.r());
-      break;
+      c->rcpps(t3.x(), t2.c());
+      c->mulps(t3.r(), l0.r());
     }
 
-    // Dca' = (Sca.Da + Dca.Sa - 2.Sca.Dca) + Sca.(1 - Da) + Dca.(1 - Sa)
-    // Dca' = Sca + Dca - 2.Sca.Dca
-    //      
-    // Da'  = (Sa.Da + Da.Sa - 2.Sa.Da) + Sa.(1 - Da) + Da.(1 - Sa)
-    //      = Sa - Sa.Da + Da - Da.Sa = Sa + Da - 2.Sa.Da
-    // Substitute 2.Sa.Da with Sa.Da
-    //
-    // Da'  = Sa + Da - Sa.Da 
-    case Operator::CompositeExclusion:
+    c->cmpps(t0.r(), xmmZero().r(), imm(1));
+    c->andps(t3.r(), t0.r());
+    c->andnps(t0.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+    c->orps(t0.r(), t3.r());
+
+    // t1 = f1
+    c->movaps(m0.x(), sa.c());
+    c->mulps(m0.r(), da.r());
+    c->movaps(t2.x(), t1.c());
+    c->subps(t2.r(), l0.r());
+    c->cmpps(t1.r(), m0.r(), imm(6));
+    c->subps(m0.r(), l0.r());
+
+    if (precise)
     {
-      c->movdqa(t0.r(), src0.r());
-      mul_1x1W_SSE2(t0, t0, dst0);
-      c->paddusw(dst0.r(), src0.r());
-      c->psubusw(dst0.r(), t0.r());
-      c->pand(t0.r(), BLITJIT_GETCONST(this, _000000FF00FF00FF000000FF00FF00FF));
-      c->psubusw(dst0.r(), t0.r());
-      break;
+      c->divps(m0.r(), t2.r());
     }
-
-    // Dca' = (Da - Dca) * Sa + Dca.(1 - Sa)
-    // Da'  = Sa + (Da - Da) * Sa + Da - Sa.Da
-    //      = Sa + Da - Sa.Da
-    case Operator::CompositeInvert:
+    else
     {
-      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
-      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      c->rcpps(t2.r(), t2.r());
+      c->mulps(m0.r(), t2.r());
+    }
 
-      extractAlpha_2x2W_SSE2(
-        t0, src0, alphaPos0, false,  // Sa
-        t2, dst0, alphaPos0, false); // Da
+    c->andps(m0.r(), t1.r());
+    c->andnps(t1.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+    c->orps(t1.r(), m0.r());
+    c->mulps(t0.r(), t1.r());
+
+    c->subps(rr.r(), l0.r());
+    c->subps(rg.r(), l0.r());
+    c->subps(rb.r(), l0.r());
+    c->mulps(rr.r(), t0.r());
+    c->mulps(rg.r(), t0.r());
+    c->mulps(rb.r(), t0.r());
+    c->addps(rr.r(), l0.r());
+    c->addps(rg.r(), l0.r());
+    c->addps(rb.r(), l0.r());
+  }
 
-      c->movdqa(t1.r(), t0.r());
-      c->psubusb(t2.r(), dst0.r());
-      c->pxor(t1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+  // Dca' = R + Sca.(1 - Da) + Dca.(1 - Sa)
+  // Da'  = Sa + Da - Sa.Da
+  c->movaps(t0.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->movaps(t1.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->subps(t0.r(), sa.r());
+  c->subps(t1.r(), da.r());
+
+  c->mulps(dr.r(), t0.r());
+  c->movaps(t2.x(), sr.c());
+  c->mulps(t2.r(), t1.r());
+  c->addps(dr.r(), t2.r());
+  c->addps(dr.r(), rr.r());
+
+  c->mulps(dg.r(), t0.r());
+  c->movaps(t2.x(), sg.c());
+  c->mulps(t2.r(), t1.r());
+  c->addps(dg.r(), t2.r());
+  c->addps(dg.r(), rg.r());
+
+  c->mulps(db.r(), t0.r());
+  c->movaps(t2.x(), sb.c());
+  c->mulps(t2.r(), t1.r());
+  c->addps(db.r(), t2.r());
+  c->addps(db.r(), rb.r());
+
+  c->movaps(t2.x(), sa.c());
+  c->mulps(t2.r(), da.r());
+  c->addps(da.r(), sa.r());
+  c->subps(da.r(), t2.r());
+
+  // Approximated reciprocals can overshoot a bit.
+  c->maxps(dr.r(), xmmZero().r());
+  c->maxps(dg.r(), xmmZero().r());
+  c->maxps(db.r(), xmmZero().r());
+  c->minps(dr.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->minps(dg.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->minps(db.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->minps(da.r(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+}
 
-      // t1 = 1 - Sa
-      // t2 = Da - Dca
+void Generator::blendNonSeparable_2x2W_SSE2(
+  const XMMRef& dst0, const XMMRef& src0,
+  const XMMRef& dst1, const XMMRef& src1,
+  const UInt32* pos, const Operator* op, bool w16)
+{
+  XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef d1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef d2(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef d3(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s2(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef s3(c->newVariable(VARIABLE_TYPE_XMM));
+
+  const XMMRef* dp[4] = { &d0, &d1, &d2, &d3 };
+  const XMMRef* sp[4] = { &s0, &s1, &s2, &s3 };
+
+  toPlanarF_2x2W_SSE2(d0, d1, d2, d3, dst0, dst1, w16);
+  toPlanarF_2x2W_SSE2(s0, s1, s2, s3, src0, src1, w16);
+
+  // 8 bit components don't need exact division (see blend_1x1F_SSE2()).
+  blendNonSeparable_4F_SSE2(
+    *dp[pos[2]], *dp[pos[1]], *dp[pos[0]], *dp[pos[3]],
+    *sp[pos[2]], *sp[pos[1]], *sp[pos[0]], *sp[pos[3]],
+    op, w16);
+
+  if (dst0.v() == dst1.v())
+  {
+    XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+    fromPlanarF_2x2W_SSE2(dst0, t0, d0, d1, d2, d3, w16);
+  }
+  else
+  {
+    fromPlanarF_2x2W_SSE2(dst0, dst1, d0, d1, d2, d3, w16);
+  }
+}
 
-      mul_2x2W_SSE2(
-        t2, t2, t0,       // t2   = Sa.(Da - Dca)
-        dst0, dst0, t1);  // dst0 = Dca.(1 - Sa)
+void Generator::toPlanarF_2x2W_SSE2(
+  const XMMRef& p0, const XMMRef& p1, const XMMRef& p2, const XMMRef& p3,
+  const XMMRef& pix0, const XMMRef& pix1, bool w16)
+{
+  // p0 = [c0 of pixel 0, 2, ... ], p1 = [c0 of pixel 1, 3, ...]
+  c->movdqa(p0.x(), pix0.c());
+  c->movdqa(p1.x(), pix0.c());
+  c->punpcklwd(p0.r(), pix1.r());
+  c->punpckhwd(p1.r(), pix1.r());
+
+  // p0 = [c0 x 4, c1 x 4], p2 = [c2 x 4, c3 x 4]
+  c->movdqa(p2.x(), p0.c());
+  c->punpcklwd(p0.r(), p1.r());
+  c->punpckhwd(p2.r(), p1.r());
+
+  c->movdqa(p1.x(), p0.c());
+  c->movdqa(p3.x(), p2.c());
+  c->punpcklwd(p0.r(), xmmZero().r());
+  c->punpckhwd(p1.r(), xmmZero().r());
+  c->punpcklwd(p2.r(), xmmZero().r());
+  c->punpckhwd(p3.r(), xmmZero().r());
+
+  c->cvtdq2ps(p0.r(), p0.r());
+  c->cvtdq2ps(p1.r(), p1.r());
+  c->cvtdq2ps(p2.r(), p2.r());
+  c->cvtdq2ps(p3.r(), p3.r());
+
+  if (w16)
+  {
+    c->mulps(p0.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+    c->mulps(p1.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+    c->mulps(p2.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+    c->mulps(p3.r(), BLITJIT_GETCONST(this, _37800080378000803780008037800080));
+  }
+  else
+  {
+    c->mulps(p0.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+    c->mulps(p1.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+    c->mulps(p2.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+    c->mulps(p3.r(), BLITJIT_GETCONST(this, _3B8080813B8080813B8080813B808081));
+  }
+}
 
-      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
-      c->paddusb(dst0.r(), t2.r());
-      c->paddusb(dst0.r(), t0.r());
-      break;
-    }
+void Generator::fromPlanarF_2x2W_SSE2(
+  const XMMRef& pix0, const XMMRef& pix1,
+  const XMMRef& p0, const XMMRef& p1, const XMMRef& p2, const XMMRef& p3,
+  bool w16)
+{
+  const XMMRef* p[4] = { &p0, &p1, &p2, &p3 };
+  int i;
 
-    // Dca' = (Da - Dca) * Sca + Dca.(1 - Sa)
-    // Da'  = Sa + (Da - Da) * Sa + Da - Da.Sa
-    //      = Sa + Da - Da.Sa
-    case Operator::CompositeInvertRgb:
+  for (i = 0; i < 4; i++)
+  {
+    if (w16)
+      c->mulps(p[i]->r(), BLITJIT_GETCONST(this, _477FFF00477FFF00477FFF00477FFF00));
+    else
+      c->mulps(p[i]->r(), BLITJIT_GETCONST(this, _437F0000437F0000437F0000437F0000));
+
+    c->addps(p[i]->r(), BLITJIT_GETCONST(this, _3F0000003F0000003F0000003F000000));
+    c->cvttps2dq(p[i]->r(), p[i]->r());
+
+    // Sign extend low word, so packssdw doesn't saturate values above 32767.
+    if (w16)
     {
-      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM, 0));
-      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM, 0));
+      c->pslld(p[i]->r(), imm(16));
+      c->psrad(p[i]->r(), imm(16));
+    }
+  }
 
-      extractAlpha_2x2W_SSE2(
-        t0, src0, alphaPos0, false,  // Sa
-        t2, dst0, alphaPos0, false); // Da
+  // p0 = [c0 x 4, c1 x 4], p2 = [c2 x 4, c3 x 4]
+  c->packssdw(p0.r(), p1.r());
+  c->packssdw(p2.r(), p3.r());
 
-      c->movdqa(t1.r(), t0.r());
-      c->psubw(t2.r(), dst0.r());
-      c->pxor(t1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+  c->movdqa(p1.x(), p0.c());
+  c->punpcklwd(p0.r(), p2.r());
+  c->punpckhwd(p1.r(), p2.r());
 
-      // t1 = 1 - Sa
-      // t2 = Da - Dca
+  c->movdqa(pix0.x(), p0.c());
+  c->movdqa(pix1.x(), p0.c());
+  c->punpcklwd(pix0.r(), p1.r());
+  c->punpckhwd(pix1.r(), p1.r());
+}
 
-      mul_2x2W_SSE2(
-        t2, t2, src0,     // t2   = Sca.(Da - Dca)
-        dst0, dst0, t1);  // dst0 = Dca.(1 - Sa)
+void Generator::extractAlpha_1x1F_SSE2(
+  const XMMRef& dst0, const XMMRef& src0, bool negate)
+{
+  if (negate)
+  {
+    XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
 
-      c->pand(t0.r(), BLITJIT_GETCONST(this, _00FF00000000000000FF000000000000));
-      c->paddusb(dst0.r(), t2.r());
-      c->paddusb(dst0.r(), t0.r());
-      break;
-    }
+    c->movaps(t0.x(), src0.c());
+    c->shufps(t0.r(), t0.r(), mm_shuffle(3, 3, 3, 3));
+    c->movaps(dst0.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+    c->subps(dst0.r(), t0.r());
+  }
+  else
+  {
+    c->movaps(dst0.x(), src0.c());
+    c->shufps(dst0.r(), dst0.r(), mm_shuffle(3, 3, 3, 3));
   }
 }
 
-void Generator::composite_2x2W_SSE2(
-  const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
-  const XMMRef& dst1, const XMMRef& src1, int alphaPos1,
+void Generator::premultiply_1x1F_SSE2(
+  const XMMRef& pix0)
+{
+  XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // a0 = [a, a, a, 1.0]
+  extractAlpha_1x1F_SSE2(a0, pix0, false);
+  c->andps(a0.r(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+  c->orps(a0.r(), BLITJIT_GETCONST(this, _3F800000000000000000000000000000));
+  c->mulps(pix0.r(), a0.r());
+}
+
+void Generator::demultiply_1x1F_SSE2(
+  const XMMRef& pix0)
+{
+  XMMRef a0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef m0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef r0(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Mask of non-zero alpha.
+  extractAlpha_1x1F_SSE2(a0, pix0, false);
+  c->xorps(m0.x(), m0.x());
+  c->cmpps(m0.r(), a0.r(), imm(4));
+
+  // r0 = [1 / a, 1 / a, 1 / a, 1.0]
+  c->movaps(r0.x(), BLITJIT_GETCONST(this, _3F8000003F8000003F8000003F800000));
+  c->divps(r0.r(), a0.r());
+  c->andps(r0.r(), BLITJIT_GETCONST(this, _00000000FFFFFFFFFFFFFFFFFFFFFFFF));
+  c->orps(r0.r(), BLITJIT_GETCONST(this, _3F800000000000000000000000000000));
+
+  c->mulps(pix0.r(), r0.r());
+  c->andps(pix0.r(), m0.r());
+}
+
+void Generator::compositeAlpha_2x2W_SSE2(
+  const XMMRef& dst0, const XMMRef& src0,
+  const XMMRef& dst1, const XMMRef& src1,
   const Operator* op)
 {
-  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM, 0));
-  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM, 0));
+  XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef t1(c->newVariable(VARIABLE_TYPE_XMM));
 
   switch (op->id())
   {
+    // Da' = Sa
     case Operator::CompositeSrc:
-      // copy operation (optimized in frontends and also by Generator itself)
+    case Operator::CompositeAtopReverse:
       mov_2x2W_SSE2(dst0, src0, dst1, src1);
       break;
+
+    // Da' = Da
     case Operator::CompositeDest:
-      // no operation (optimized in frontends and also by Generator itself)
-      break;
-    case Operator::CompositeOver:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
-      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
-      add_2x2W_SSE2(dst0, dst0, src0, dst1, dst1, src1);
-      break;
-    case Operator::CompositeOverReverse:
-      extractAlpha_2x2W_SSE2(t0, dst0, alphaPos0, true, t1, dst1, alphaPos1, true);
-      mul_2x2W_SSE2(t0, t0, src0, t1, t1, src1);
-      add_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+    case Operator::CompositeAtop:
       break;
+
+    // Da' = Sa.Da
     case Operator::CompositeIn:
-      extractAlpha_2x2W_SSE2(t0, dst0, alphaPos0, false, t1, dst1, alphaPos1, false);
-      mul_2x2W_SSE2(dst0, dst0, src0, dst1, dst1, t1);
-      break;
     case Operator::CompositeInReverse:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, src1, alphaPos1, false);
-      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
+      mul_2x2W_SSE2(
+        dst0, dst0, src0,
+        dst1, dst1, src1);
       break;
+
+    // Da' = Sa.(1 - Da)
     case Operator::CompositeOut:
-      extractAlpha_2x2W_SSE2(dst0, dst0, alphaPos0, true, dst1, dst1, alphaPos1, true);
-      mul_2x2W_SSE2(dst0, dst0, src0, dst1, dst1, src1);
+      negate_2x2W_SSE2(dst0, dst0, dst1, dst1);
+      mul_2x2W_SSE2(
+        dst0, dst0, src0,
+        dst1, dst1, src1);
       break;
+
+    // Da' = Da.(1 - Sa)
     case Operator::CompositeOutReverse:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, src1, alphaPos1, true);
-      mul_2x2W_SSE2(dst0, dst0, t0, dst1, dst1, t1);
-      break;
-    case Operator::CompositeAtop:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos1, false);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
-      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, true, t1, dst1, alphaPos1, false);
-      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
-      break;
-    case Operator::CompositeAtopReverse:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, false, t1, dst0, alphaPos1, true);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
-      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, false, t1, dst1, alphaPos1, true);
-      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
+      negate_2x2W_SSE2(t0, src0, t1, src1);
+      mul_2x2W_SSE2(
+        dst0, dst0, t0,
+        dst1, dst1, t1);
       break;
+
+    // Da' = Sa.(1 - Da) + Da.(1 - Sa)
     case Operator::CompositeXor:
-      extractAlpha_2x2W_SSE2(t0, src0, alphaPos0, true, t1, dst0, alphaPos1, true);
-      _PackedMultiplyAdd(t1, src0, dst0, t0, dst0, true);
+    {
+      XMMRef t2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef t3(c->newVariable(VARIABLE_TYPE_XMM));
 
-      extractAlpha_2x2W_SSE2(t0, src1, alphaPos0, true, t1, dst1, alphaPos1, true);
-      _PackedMultiplyAdd(t1, src1, dst1, t0, dst1, true);
+      negate_2x2W_SSE2(t0, dst0, t1, dst1);
+      negate_2x2W_SSE2(t2, src0, t3, src1);
+      mul_2x2W_SSE2(
+        t0, t0, src0,
+        t1, t1, src1);
+      mul_2x2W_SSE2(
+        dst0, dst0, t2,
+        dst1, dst1, t3);
+      add_2x2W_SSE2(
+        dst0, dst0, t0,
+        dst1, dst1, t1);
       break;
+    }
+
+    // Da' = 0
     case Operator::CompositeClear:
-      // clear operation (optimized in frontends and also by Generator itself)
       c->pxor(dst0.r(), dst0.r());
       c->pxor(dst1.r(), dst1.r());
       break;
+
+    // Da' = Sa + Da
     case Operator::CompositeAdd:
-      c->paddusb(dst0.r(), src0.r());
-      c->paddusb(dst1.r(), src1.r());
+      add_2x2W_SSE2(
+        dst0, dst0, src0,
+        dst1, dst1, src1);
       break;
-    case Operator::CompositeSubtract:
-    case Operator::CompositeMultiply:
-    case Operator::CompositeScreen:
-    case Operator::CompositeDarken:
-    case Operator::CompositeLighten:
-    case Operator::CompositeDifference:
-    case Operator::CompositeExclusion:
-    case Operator::CompositeInvert:
-    case Operator::CompositeInvertRgb:
-    {
-      BLITJIT_ASSERT(0);
+
+    // Da' = Sa + Da - Sa.Da = Da + Sa.(1 - Da)
+    default:
+      negate_2x2W_SSE2(t0, dst0, t1, dst1);
+      mul_2x2W_SSE2(
+        t0, t0, src0,
+        t1, t1, src1);
+      add_2x2W_SSE2(
+        dst0, dst0, t0,
+        dst1, dst1, t1);
       break;
-    }
   }
 }
 
@@ -2084,27 +6678,69 @@ void Generator::add_2x2W_SSE2(
   }
 }
 
+void Generator::div255_1x1W_SSE2(
+  const XMMRef& x0)
+{
+  switch (div255Precision())
+  {
+    case Div255Exact:
+      // ((x + 128) * 257) >> 16 == round(x / 255).
+      c->paddusw(x0.r(), xmm0080().c());
+      c->pmulhuw(x0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+      break;
+    case Div255Approx:
+      c->paddusw(x0.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+      c->psrlw(x0.r(), 8);
+      break;
+    case Div255Fast:
+      c->psrlw(x0.r(), 8);
+      break;
+  }
+}
+
+void Generator::div255_2x2W_SSE2(
+  const XMMRef& x0,
+  const XMMRef& x1)
+{
+  switch (div255Precision())
+  {
+    case Div255Exact:
+      c->paddusw(x0.r(), xmm0080().c());
+      c->paddusw(x1.r(), xmm0080().c());
+      c->pmulhuw(x0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+      c->pmulhuw(x1.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+      break;
+    case Div255Approx:
+      c->paddusw(x0.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+      c->paddusw(x1.r(), BLITJIT_GETCONST(this, _00FF00FF00FF00FF00FF00FF00FF00FF));
+      c->psrlw(x0.r(), 8);
+      c->psrlw(x1.r(), 8);
+      break;
+    case Div255Fast:
+      c->psrlw(x0.r(), 8);
+      c->psrlw(x1.r(), 8);
+      break;
+  }
+}
+
 void Generator::mul_1x1W_SSE2(
   const XMMRef& dst0, const XMMRef& a0, const XMMRef& b0)
 {
   if (dst0.v() == a0.v())
   {
     c->pmullw(a0.r(), b0.c());
-    c->paddusw(a0.r(), xmm0080().c());
-    c->pmulhuw(a0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_1x1W_SSE2(a0);
   }
   else if (dst0.v() == b0.v())
   {
     c->pmullw(b0.r(), a0.c());
-    c->paddusw(b0.r(), xmm0080().c());
-    c->pmulhuw(b0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_1x1W_SSE2(b0);
   }
   else
   {
     c->movdqa(dst0.x(), a0.c());
     c->pmullw(dst0.r(), b0.r());
-    c->paddusw(dst0.r(), xmm0080().c());
-    c->pmulhuw(dst0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_1x1W_SSE2(dst0);
   }
 }
 
@@ -2116,19 +6752,13 @@ void Generator::mul_2x2W_SSE2(
   {
     c->pmullw(a0.r(), b0.c());
     c->pmullw(a1.r(), b1.c());
-    c->paddusw(a0.r(), xmm0080().c());
-    c->paddusw(a1.r(), xmm0080().c());
-    c->pmulhuw(a0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
-    c->pmulhuw(a1.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_2x2W_SSE2(a0, a1);
   }
   else if (dst0.v() == b0.v() && dst1.v() == b1.v())
   {
     c->pmullw(b0.r(), a0.c());
     c->pmullw(b1.r(), a1.c());
-    c->paddusw(b0.r(), xmm0080().c());
-    c->paddusw(b1.r(), xmm0080().c());
-    c->pmulhuw(b0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
-    c->pmulhuw(b1.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_2x2W_SSE2(b0, b1);
   }
   else
   {
@@ -2136,10 +6766,7 @@ void Generator::mul_2x2W_SSE2(
     c->movdqa(dst1.x(), a1.c());
     c->pmullw(dst0.r(), b0.r());
     c->pmullw(dst1.r(), b1.r());
-    c->paddusw(dst0.r(), xmm0080().c());
-    c->paddusw(dst1.r(), xmm0080().c());
-    c->pmulhuw(dst0.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
-    c->pmulhuw(dst1.r(), BLITJIT_GETCONST(this, _01010101010101010101010101010101));
+    div255_2x2W_SSE2(dst0, dst1);
   }
 }
 
@@ -2165,6 +6792,16 @@ void Generator::negate_2x2W_SSE2(
 void Generator::_PackedMultiplyWithAddition(
   const XMMRef& a0, const XMMRef& b0, const XMMRef& t0)
 {
+  if (div255Precision() != Div255Exact)
+  {
+    c->movdqa(t0.r(), a0.r());          // t0  = a0
+    c->pmullw(a0.r(), b0.r());          // a0 *= b0
+    c->paddusw(b0.r(), t0.r());         // b0 += a0
+    div255_1x1W_SSE2(a0);               // a0 /= 255
+    c->paddusw(a0.r(), b0.r());         // a0 += b0
+    return;
+  }
+
   c->movdqa(t0.r(), a0.r());            // t0  = a0
   c->pmullw(a0.r(), b0.r());            // a0 *= b0
   c->paddusw(a0.r(), xmm0080().c());    // a0 += 80
@@ -2181,6 +6818,16 @@ void Generator::_PackedMultiplyAdd(
   const XMMRef& c0, const XMMRef& d0,
   const XMMRef& t0, bool moveToT0)
 {
+  if (div255Precision() != Div255Exact)
+  {
+    c->pmullw(a0.r(), b0.r());          // a0 *= b0
+    c->pmullw(c0.r(), d0.r());          // c0 *= d0
+    c->paddusw(a0.r(), c0.r());         // a0 += c0
+    div255_1x1W_SSE2(a0);               // a0 /= 255
+    if (moveToT0) c->movdqa(t0.r(), a0.r());
+    return;
+  }
+
   c->pmullw(a0.r(), b0.r());            // a0 *= b0
   c->pmullw(c0.r(), d0.r());            // c0 *= d0
   c->paddusw(a0.r(), xmm0080().c());    // a0 += 80
@@ -2210,6 +6857,24 @@ void Generator::_PackedMultiplyAdd_4(
   const XMMRef& t1,
   bool moveToT0T1)
 {
+  if (div255Precision() != Div255Exact)
+  {
+    c->pmullw(a0.r(), b0.r());          // a0 *= b0
+    c->pmullw(e0.r(), f0.r());          // e0 *= f0
+    c->pmullw(c0.r(), d0.r());          // c0 *= d0
+    c->pmullw(g0.r(), h0.r());          // g0 *= h0
+    c->paddusw(a0.r(), c0.r());         // a0 += c0
+    c->paddusw(e0.r(), g0.r());         // e0 += g0
+    div255_2x2W_SSE2(a0, e0);           // a0 /= 255, e0 /= 255
+
+    if (moveToT0T1)
+    {
+      c->movdqa(t0.r(), a0.r());
+      c->movdqa(t1.r(), e0.r());
+    }
+    return;
+  }
+
   c->pmullw(a0.r(), b0.r());            // a0 *= b0
   c->pmullw(e0.r(), f0.r());            // e0 *= f0
 
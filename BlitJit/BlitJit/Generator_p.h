@@ -57,6 +57,15 @@ struct Module_Blit;
 #define BLITJIT_GETCONST(__generator__, __name__) \
   __generator__->getConstantsOperand(BLITJIT_DISPCONST(__name__))
 
+#define BLITJIT_DISPCLOSURE(__name__) \
+  (SysInt)( (UInt8 *)&((Closure *)0)->__name__ - (UInt8 *)0 )
+
+#define BLITJIT_DISPSCALE(__name__) \
+  (SysInt)( (UInt8 *)&((ScaleParams *)0)->__name__ - (UInt8 *)0 )
+
+#define BLITJIT_DISPFILTER(__name__) \
+  (SysInt)( (UInt8 *)&((FilterParams *)0)->__name__ - (UInt8 *)0 )
+
 #define BLITJIT_GETCONST_WITH_DISPLACEMENT(__generator__, __name__, __disp__) \
   __generator__->getConstantsOperand(BLITJIT_DISPCONST(__name__) + __disp__)
 
@@ -123,7 +132,24 @@ struct BLITJIT_API Generator : public GeneratorBase
     BodyUsingConstants  = 0x00000001,
     BodyUsingMMZero     = 0x00000010,
     BodyUsingXMMZero    = 0x00000100,
-    BodyUsingXMM0080    = 0x00000200
+    BodyUsingXMM0080    = 0x00000200,
+    BodyUsingPalette    = 0x00001000,
+    BodyUsingOpacity    = 0x00002000,
+    BodyUsingColorKey   = 0x00004000
+  };
+
+  // --------------------------------------------------------------------------
+  // [Div255 Precision]
+  // --------------------------------------------------------------------------
+
+  enum Div255Precision
+  {
+    //! @brief round(x / 255), default.
+    Div255Exact = 0,
+    //! @brief (x + 255) >> 8, within +-1, see @c OptionDiv255Approx.
+    Div255Approx = 1,
+    //! @brief x >> 8, within -2..0, see @c OptionDiv255Fast.
+    Div255Fast = 2
   };
 
   // --------------------------------------------------------------------------
@@ -148,14 +174,22 @@ struct BLITJIT_API Generator : public GeneratorBase
   void setFeatures(UInt32 features);
   void setOptimization(UInt32 optimization);
   void setPrefetch(bool prefetch);
+  void setPrefetchDistance(SysInt srcDistance, SysInt dstDistance);
+  void setPrefetchHint(UInt32 srcHint, UInt32 dstHint);
   void setNonThermalHint(bool nonThermalHint);
   void setClosure(bool closure);
+  void setOptions(UInt32 options);
 
   inline UInt32 features() const { return _features; }
   inline UInt32 optimization() const { return _optimization; }
   inline bool prefetch() const { return _prefetch; }
+  inline SysInt prefetchSrcDistance() const { return _prefetchSrcDistance; }
+  inline SysInt prefetchDstDistance() const { return _prefetchDstDistance; }
+  inline UInt32 prefetchSrcHint() const { return _prefetchSrcHint; }
+  inline UInt32 prefetchDstHint() const { return _prefetchDstHint; }
   inline bool nonThermalHint() const { return _nonThermalHint; }
   inline bool closure() const { return _closure; }
+  inline UInt32 options() const { return _options; }
 
   // --------------------------------------------------------------------------
   // [Premultiply / Demultiply]
@@ -167,6 +201,20 @@ struct BLITJIT_API Generator : public GeneratorBase
   //! @brief Generate pixel demultiply function.
   void genDemultiply(const PixelFormat* dstPf);
 
+  // --------------------------------------------------------------------------
+  // [ConvertSpan / ConvertRect]
+  // --------------------------------------------------------------------------
+
+  //! @brief Generate span conversion function.
+  void genConvertSpan(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf);
+
+  //! @brief Generate rect conversion function.
+  void genConvertRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf);
+
   // --------------------------------------------------------------------------
   // [FillSpan / FillRect]
   // --------------------------------------------------------------------------
@@ -213,6 +261,90 @@ struct BLITJIT_API Generator : public GeneratorBase
     const PixelFormat* srcPf,
     const Operator* op);
 
+  //! @brief Generate blit span with mask function.
+  void genBlitSpanWithMask(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* pfMask,
+    const Operator* op);
+
+  //! @brief Generate blit rect with mask function (@a pfMask can be NULL).
+  void genBlitRectWithMask(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* pfMask,
+    const Operator* op);
+
+  // --------------------------------------------------------------------------
+  // [Scaling]
+  // --------------------------------------------------------------------------
+
+  //! @brief Generate nearest neighbour scaled blit rect function (see 
+  //! @c ScaleParams), closure argument is always present.
+  void genScaledBlitRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op);
+
+  //! @brief Copy @a cnt pixels from [@a src + (@a fx >> 16) * bytesPerPixel]
+  //! to @a dst, @a fx is advanced by @a stepX for each pixel. @a dst must be
+  //! 16 byte aligned, @a dst, @a src, @a cnt and @a fx are destroyed.
+  void _GenScaleRow(
+    const PtrRef& dst,
+    const PtrRef& src,
+    const SysIntRef& cnt,
+    const SysIntRef& fx,
+    const SysIntRef& stepX,
+    SysInt bytesPerPixel);
+
+  //! @brief Generate bilinear filtered blit rect function (see 
+  //! @c FilterParams), closure argument is always present. Source must be
+  //! 32 bit format.
+  void genFilteredBlitRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op);
+
+  //! @brief Filter @a cnt pairs of pixels from rows @a row0 and @a row1 of
+  //! 32 bit @a srcPf to PRGB32 @a dst. Column indices and weights are read
+  //! from @a xIndex and @a xWeight, vertical weights are unpacked in @a wy
+  //! and @a iwy. @a dst, @a xIndex, @a xWeight and @a cnt are destroyed.
+  void _GenFilterRow(
+    const PtrRef& dst,
+    const PtrRef& row0,
+    const PtrRef& row1,
+    const PtrRef& xIndex,
+    const PtrRef& xWeight,
+    const SysIntRef& cnt,
+    const XMMRef& wy,
+    const XMMRef& iwy,
+    const PixelFormat* srcPf);
+
+  // --------------------------------------------------------------------------
+  // [YUV]
+  // --------------------------------------------------------------------------
+
+  //! @brief Generate YUV rect conversion function, if @a ovlPf is not NULL
+  //! overlay is composited on converted pixels using @a op.
+  void genYuvRect(
+    const PixelFormat* dstPf,
+    const PixelFormat* ovlPf,
+    const Operator* op,
+    UInt32 layout,
+    UInt32 matrix);
+
+  //! @brief Convert, composite and store @a count (8, 4, 2 or 1) YUV pixels,
+  //! all pointers are advanced.
+  void _GenYuvPixels(
+    const PtrRef& dst, const PtrRef& ovl,
+    const PtrRef& yp, const PtrRef& up, const PtrRef& vp,
+    const PixelFormat* dstPf,
+    const PixelFormat* ovlPf,
+    const Operator* op,
+    UInt32 layout,
+    UInt32 matrix,
+    SysInt count);
+
   // --------------------------------------------------------------------------
   // [Experimental]
   // --------------------------------------------------------------------------
@@ -241,6 +373,64 @@ struct BLITJIT_API Generator : public GeneratorBase
     UInt32 kind,
     const Loop& loop);
 
+  //! @brief Generate loop that uses A1 mask.
+  //!
+  //! Mask bits are expanded to bytes in register and passed to 
+  //! @c Module::processPixelsMsk(). All-zero mask words (32 or 64 pixels)
+  //! and bytes are skipped without touching destination. @a mskOffset is
+  //! bit offset of first pixel (NULL means zero). @a dst and @a src are
+  //! always advanced by @a cnt pixels.
+  void _GenMaskA1Loop(
+    PtrRef* dst,
+    PtrRef* src,
+    PtrRef* msk,
+    SysIntRef* cnt,
+    SysIntRef* mskOffset,
+    Module* module,
+    UInt32 kind);
+
+  //! @brief Process 8 pixels using one A1 mask byte (helper for 
+  //! @c _GenMaskA1Loop()).
+  void _GenMaskA1Byte(
+    PtrRef* dst,
+    PtrRef* src,
+    PtrRef* msk,
+    SysIntRef& t,
+    XMMRef& mskx,
+    XMMRef& msk0,
+    Module* module,
+    UInt32 kind);
+
+  //! @brief Process pixels using bits of one A1 mask byte, starting at bit
+  //! @a idx (7 is first pixel) until byte or @a cnt ends (then jumps to 
+  //! @a L_End). Helper for @c _GenMaskA1Loop().
+  void _GenMaskA1Bits(
+    PtrRef* dst,
+    PtrRef* src,
+    PtrRef* msk,
+    SysIntRef* cnt,
+    SysIntRef& t,
+    SysIntRef& idx,
+    XMMRef& msk0,
+    Module* module,
+    UInt32 kind,
+    Label* L_End);
+
+  //! @brief Initialize blit @a module. If generated function has closure
+  //! argument (at @a closureIndex), data needed by @a srcPf are loaded from it.
+  //! If @a mskOffset is not NULL, bit offset of A1 mask is loaded to it.
+  void _GenClosureInit(Module_Blit* module, const PixelFormat* srcPf, UInt32 closureIndex, SysIntRef* mskOffset = NULL);
+
+  //! @brief Initialize fill @a module (fill version of @c _GenClosureInit()).
+  void _GenClosureInit(Module_Fill* module, PtrRef& src, UInt32 closureIndex, SysIntRef* mskOffset = NULL);
+
+  //! @brief Emit prefetch instructions for one iteration of main loop.
+  void _GenPrefetch(
+    PtrRef* dst,
+    PtrRef* src,
+    Module* module,
+    SysInt perLoop);
+
   // --------------------------------------------------------------------------
   // [Mov Helpers]
   // --------------------------------------------------------------------------
@@ -270,18 +460,358 @@ struct BLITJIT_API Generator : public GeneratorBase
   //! If @a aligned is false, AsmJit::Serializer::movdqu() instruction is used.
   void storeDQ(const Mem& dst, const XMMRef& src, bool nt, bool aligned);
 
+  // --------------------------------------------------------------------------
+  // [Pixel Format Helpers]
+  // --------------------------------------------------------------------------
+
+  //! @brief Load @a count (1, 2 or 4) pixels in @a pf format from 
+  //! [@a base + @a disp] and convert them to packed ARGB32 (alpha in the 
+  //! highest byte of each dword).
+  //!
+  //! Formats without alpha are loaded as opaque and A8 is loaded as black
+  //! color with given alpha. I8 pixels are looked up in palette (see
+  //! @c usingPalette()). Memory after last pixel is never read.
+  void loadPixels_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp,
+    const PixelFormat* pf, SysInt count, bool aligned);
+
+  //! @brief Convert @a count (1, 2 or 4) packed ARGB32 pixels to @a pf format
+  //! and store them to [@a base + @a disp]. Content of @a src0 is destroyed.
+  void storePixels_SSE2(
+    const PtrRef& base, SysInt disp, const XMMRef& src0,
+    const PixelFormat* pf, SysInt count, bool aligned);
+
+  //! @brief Load 16 pixels in @a pf format from [@a base + @a disp] to four
+  //! registers of packed ARGB32 pixels.
+  //!
+  //! 24 bit pixels are loaded as three 16 byte blocks, so @a aligned can be 
+  //! used also for them.
+  void loadPixels_4x4B_SSE2(
+    const XMMRef& dst0, const XMMRef& dst1, const XMMRef& dst2, const XMMRef& dst3,
+    const PtrRef& base, SysInt disp,
+    const PixelFormat* pf, bool aligned);
+
+  //! @brief Convert 16 packed ARGB32 pixels (four registers) to @a pf format
+  //! and store them to [@a base + @a disp]. Content of source registers is
+  //! destroyed.
+  void storePixels_4x4B_SSE2(
+    const PtrRef& base, SysInt disp,
+    const XMMRef& src0, const XMMRef& src1, const XMMRef& src2, const XMMRef& src3,
+    const PixelFormat* pf, bool aligned);
+
+  //! @brief Load @a count (1, 2 or 4) I8 pixels from [@a base + @a disp] and
+  //! look them up in palette, result is packed ARGB32.
+  void loadIndexed_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp, SysInt count);
+
+  //! @brief Expand @a count 24 bit pixels (packed in low bytes of @a pix0) 
+  //! to dwords. Highest byte of each dword is undefined.
+  void expand24_1x1B_SSE2(
+    const XMMRef& pix0, SysInt count);
+
+  //! @brief Pack @a count dwords in @a pix0 to 24 bit pixels (stored in low
+  //! bytes of @a pix0). Highest byte of each dword is ignored.
+  void pack24_1x1B_SSE2(
+    const XMMRef& pix0, SysInt count);
+
+  //! @brief Pack 16 dwords in four registers to 48 bytes of 24 bit pixels
+  //! stored in @a pix0, @a pix1 and @a pix2. Content of @a pix3 is destroyed.
+  void pack24_4x4B_SSE2(
+    const XMMRef& pix0, const XMMRef& pix1, const XMMRef& pix2, const XMMRef& pix3);
+
+  //! @brief Load @a count (1 or 2) pixels in @a pf format from 
+  //! [@a base + @a disp] and convert them to premultiplied pixels with 16 bit
+  //! components (PRGB64 layout, 2 pixels in register).
+  //!
+  //! 8 bit components are expanded by multiplying them by 257 (exact) or
+  //! decoded from sRGB if @c useLinear() returns true for @a pf.
+  void loadPixels_1x1W16_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp,
+    const PixelFormat* pf, SysInt count, bool aligned);
+
+  //! @brief Convert @a count (1 or 2) premultiplied pixels with 16 bit 
+  //! components to @a pf format and store them to [@a base + @a disp]. 
+  //! Content of @a src0 is destroyed.
+  void storePixels_1x1W16_SSE2(
+    const PtrRef& base, SysInt disp, const XMMRef& src0,
+    const PixelFormat* pf, SysInt count, bool aligned);
+
+  //! @brief Reduce 2 premultiplied pixels with 16 bit components to packed 
+  //! ARGB32 (low 8 bytes of @a pix0), components are round(c / 257).
+  void reduce_1x1W16_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Demultiply 2 premultiplied pixels with 16 bit components and 
+  //! reduce them to packed ARGB32 (low 8 bytes of @a pix0).
+  //!
+  //! Color is round(c * 255 / a), so no precision is lost before final 
+  //! rounding.
+  void demultiply_1x1W16_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Load one pixel in @a pf format from [@a base + @a disp] and 
+  //! convert it to premultiplied float components (B, G, R, A in @a dst0).
+  //!
+  //! Components of 8 bit formats are decoded from sRGB if @c useSrgb() 
+  //! returns true for @a pf.
+  void loadPixels_1x1F_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp,
+    const PixelFormat* pf);
+
+  //! @brief Convert one pixel with premultiplied float components to @a pf
+  //! format and store it to [@a base + @a disp]. Content of @a src0 is 
+  //! destroyed.
+  void storePixels_1x1F_SSE2(
+    const PtrRef& base, SysInt disp, const XMMRef& src0,
+    const PixelFormat* pf);
+
+  //! @brief Return true if components of @a pf should be converted through 
+  //! sRGB transfer function when converting to or from floats (see 
+  //! @c OptionSRGB).
+  bool useSrgb(
+    const PixelFormat* pf);
+
+  //! @brief Return true if components of @a pf should be converted through
+  //! sRGB transfer function when compositing (see @c OptionLinear).
+  bool useLinear(
+    const PixelFormat* pf);
+
+  //! @brief Return true if source should be multiplied by global opacity 
+  //! (see @c OptionOpacity), closure is needed for it.
+  bool useOpacity();
+
+  //! @brief Return true if keyed source pixels should be skipped (see 
+  //! @c OptionColorKey), closure is needed for it.
+  bool useColorKey();
+
+  //! @brief Return division by 255 precision used by 8 bit multiplications
+  //! (see @c Div255Precision).
+  UInt32 div255Precision();
+
+  //! @brief Decode @a count (1 or 2) packed ARGB32 pixels in @a pf format 
+  //! from sRGB to linear premultiplied 16 bit components.
+  void srgbDecode_1x1W16_SSE2(
+    const XMMRef& pix0, const PixelFormat* pf, SysInt count);
+
+  //! @brief Encode @a count (1 or 2) linear premultiplied pixels with 16 bit 
+  //! components to sRGB packed ARGB32 pixels in @a pf format.
+  void srgbEncode_1x1W16_SSE2(
+    const XMMRef& pix0, const PixelFormat* pf, SysInt count);
+
+  //! @brief Decode packed ARGB32 pixel (low dword of @a pix0, colors are not
+  //! premultiplied) from sRGB to linear float components in @a dst0.
+  void srgbDecode_1x1F_SSE2(
+    const XMMRef& dst0, const XMMRef& pix0);
+
+  //! @brief Encode linear float components in @a pix0 (colors are not 
+  //! premultiplied) to sRGB packed ARGB32 pixel (low dword of @a pix0).
+  void srgbEncode_1x1F_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Load @a count (8, 4, 2 or 1) YUV pixels to @a y0, @a u0 and 
+  //! @a v0 words (chroma samples are duplicated for each pixel).
+  void loadYuv_SSE2(
+    const XMMRef& y0, const XMMRef& u0, const XMMRef& v0,
+    const PtrRef& yp, const PtrRef& up, const PtrRef& vp,
+    UInt32 layout, SysInt count);
+
+  //! @brief Convert 8 YUV pixels (words, content is destroyed) to packed 
+  //! ARGB32 pixels in @a pix0 (pixels 0...3) and @a pix1 (pixels 4...7).
+  //!
+  //! Coefficients have 6 bit fraction, results are saturated.
+  void yuvToRgb_SSE2(
+    const XMMRef& pix0, const XMMRef& pix1,
+    const XMMRef& y0, const XMMRef& u0, const XMMRef& v0,
+    UInt32 matrix);
+
+  //! @brief Load alpha of @a count (1, 4 or 16) pixels in @a pf format from
+  //! [@a base + @a disp] to low bytes of @a dst0.
+  //!
+  //! Alpha of formats without alpha channel is 0xFF.
+  void loadAlpha_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp,
+    const PixelFormat* pf, SysInt count, bool aligned);
+
+  //! @brief Store @a count (1, 4 or 16) alpha bytes from @a src0 to A8 
+  //! destination at [@a base + @a disp].
+  void storeAlpha_SSE2(
+    const PtrRef& base, SysInt disp, const XMMRef& src0,
+    SysInt count, bool aligned);
+
+  //! @brief Expand 16 bit pixels (RGB565 or XRGB1555 stored in low words of
+  //! dwords, high words must be zero) to opaque packed ARGB32 pixels.
+  void expand16_1x1B_SSE2(
+    const XMMRef& pix0, const PixelFormat* pf);
+
+  //! @brief Pack packed ARGB32 pixels to 16 bit pixels stored in low words of
+  //! dwords (high words are zero). Components are truncated.
+  void pack16_1x1B_SSE2(
+    const XMMRef& pix0, const PixelFormat* pf);
+
+  //! @brief Return true if ordered dithering should be used when storing
+  //! result of @a op to @a dstPf (see @c OptionDither).
+  bool useDither(
+    const PixelFormat* dstPf, const PixelFormat* srcPf, const Operator* op);
+
+  //! @brief Load dither offsets for four pixels at [@a base + @a disp] in
+  //! @a pf format. Offsets are added (paddusb) to packed ARGB32 pixels before
+  //! they are stored.
+  void loadDither_SSE2(
+    const XMMRef& dst0, const PtrRef& base, SysInt disp, const PixelFormat* pf);
+
+  //! @brief Swap red and blue components of packed 32 bit pixels.
+  void swapRB_1x1B_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Reorder channels of 4 packed 32 bit pixels, @a swizzle is
+  //! created by @c getARGB32Swizzle().
+  void swizzle_1x1B_SSE2(
+    const XMMRef& pix0, UInt32 swizzle);
+
+  //! @brief Reorder channels of 2 unpacked 32 bit pixels.
+  void swizzle_1x1W_SSE2(
+    const XMMRef& pix0, UInt32 swizzle);
+
+  //! @brief Reorder channels of 4 unpacked 32 bit pixels.
+  void swizzle_2x2W_SSE2(
+    const XMMRef& pix0, const XMMRef& pix1, UInt32 swizzle);
+
+  //! @brief Premultiply 4 packed 32 bit pixels.
+  void premultiply_1x1B_SSE2(
+    const XMMRef& pix0, int alphaPos0);
+
+  //! @brief Demultiply 4 packed 32 bit pixels.
+  //!
+  //! Result is round(c * 255 / a) (halves rounded up) for each color
+  //! component, pixels with zero alpha are converted to zero.
+  void demultiply_1x1B_SSE2(
+    const XMMRef& pix0, int alphaPos0);
+
   // --------------------------------------------------------------------------
   // [Generator Helpers]
   // --------------------------------------------------------------------------
 
+  //! @brief Composite 1 or 2 unpacked 32 bit pixels.
+  //!
+  //! @a pf is channel order of pixels, it's only needed by non-separable
+  //! blend modes (ARGB32 order is used if it's NULL).
   void composite_1x1W_SSE2(
     const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
     const Operator* op,
-    bool two);
+    bool two,
+    const PixelFormat* pf = NULL);
 
+  //! @brief Composite 4 unpacked 32 bit pixels (see @c composite_1x1W_SSE2()).
   void composite_2x2W_SSE2(
     const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
     const XMMRef& dst1, const XMMRef& src1, int alphaPos1,
+    const Operator* op,
+    const PixelFormat* pf = NULL);
+
+  //! @brief Composite 2 premultiplied pixels with 16 bit components, alpha
+  //! is in last word of each pixel. All operators are supported.
+  void composite_1x1W16_SSE2(
+    const XMMRef& dst0, const XMMRef& src0,
+    const Operator* op);
+
+  //! @brief Extract alpha of 2 pixels with 16 bit components to all words
+  //! of the pixel (65535 - alpha if @a negate is true).
+  void extractAlpha_1x1W16_SSE2(
+    const XMMRef& dst0, const XMMRef& src0, bool negate);
+
+  //! @brief dst0 = a0 * b0 / 65535 (8 unsigned words, rounded, exact).
+  void mul_1x1W16_SSE2(
+    const XMMRef& dst0, const XMMRef& a0, const XMMRef& b0);
+
+  //! @brief Premultiply 2 pixels with 16 bit components.
+  void premultiply_1x1W16_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Composite one premultiplied pixel with float components, alpha
+  //! is in last dword. All operators are supported.
+  void composite_1x1F_SSE2(
+    const XMMRef& dst0, const XMMRef& src0,
+    const Operator* op);
+
+  //! @brief Composite one premultiplied pixel with float components using
+  //! separable blend mode @a op (Overlay, ColorDodge, ColorBurn, HardLight
+  //! or SoftLight), alpha is in dword @a alphaPos0.
+  //!
+  //! If @a precise is false, divisions are replaced by rcpps (relative error
+  //! below 1.5 * 2^-12, less than 0.1 after scaling to 8 bits).
+  void blend_1x1F_SSE2(
+    const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+    const Operator* op, bool precise);
+
+  //! @brief Composite 1 or 2 unpacked 32 bit pixels using separable blend 
+  //! mode @a op, pixels are converted to floats and processed by 
+  //! @c blend_1x1F_SSE2().
+  void blend_1x1W_SSE2(
+    const XMMRef& dst0, const XMMRef& src0, int alphaPos0,
+    const Operator* op, bool two);
+
+  //! @brief Composite 2 pixels with 16 bit components using separable blend
+  //! mode @a op, alpha is in last word of each pixel.
+  void blend_1x1W16_SSE2(
+    const XMMRef& dst0, const XMMRef& src0,
+    const Operator* op);
+
+  //! @brief Composite 4 premultiplied pixels stored in planar form (each
+  //! register contains one component of 4 pixels as floats) using 
+  //! non-separable blend mode @a op (Hue, Saturation, Color or Luminosity).
+  //! Result is stored to destination registers.
+  //!
+  //! If @a precise is false, divisions are replaced by rcpps.
+  void blendNonSeparable_4F_SSE2(
+    const XMMRef& dr, const XMMRef& dg, const XMMRef& db, const XMMRef& da,
+    const XMMRef& sr, const XMMRef& sg, const XMMRef& sb, const XMMRef& sa,
+    const Operator* op, bool precise);
+
+  //! @brief Composite 4 unpacked pixels using non-separable blend mode, 
+  //! pixels are transposed to planar floats and processed by 
+  //! @c blendNonSeparable_4F_SSE2(). @a pos contains positions of blue, green,
+  //! red and alpha words (see @c getARGB32Positions()).
+  //!
+  //! @a dst1 and @a src1 can be the same register as @a dst0 and @a src0 if
+  //! only 2 pixels are processed, @a w16 means 16 bit components.
+  void blendNonSeparable_2x2W_SSE2(
+    const XMMRef& dst0, const XMMRef& src0,
+    const XMMRef& dst1, const XMMRef& src1,
+    const UInt32* pos, const Operator* op, bool w16);
+
+  //! @brief Transpose 4 unpacked pixels (2 in each register) to 4 registers
+  //! with components converted to floats in 0 to 1 range (@a p0 contains
+  //! first word of all pixels, etc...).
+  void toPlanarF_2x2W_SSE2(
+    const XMMRef& p0, const XMMRef& p1, const XMMRef& p2, const XMMRef& p3,
+    const XMMRef& pix0, const XMMRef& pix1, bool w16);
+
+  //! @brief Reverse of @c toPlanarF_2x2W_SSE2(), @a p0 to @a p3 are destroyed.
+  void fromPlanarF_2x2W_SSE2(
+    const XMMRef& pix0, const XMMRef& pix1,
+    const XMMRef& p0, const XMMRef& p1, const XMMRef& p2, const XMMRef& p3,
+    bool w16);
+
+  //! @brief Extract alpha of pixel with float components to all dwords
+  //! (1.0 - alpha if @a negate is true).
+  void extractAlpha_1x1F_SSE2(
+    const XMMRef& dst0, const XMMRef& src0, bool negate);
+
+  //! @brief Premultiply pixel with float components.
+  void premultiply_1x1F_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Demultiply pixel with float components, pixel with zero alpha
+  //! is converted to zero.
+  void demultiply_1x1F_SSE2(
+    const XMMRef& pix0);
+
+  //! @brief Composite alpha values unpacked to words (8 in each register).
+  //!
+  //! Only alpha equation of @a op is used (A8 destination).
+  void compositeAlpha_2x2W_SSE2(
+    const XMMRef& dst0, const XMMRef& src0,
+    const XMMRef& dst1, const XMMRef& src1,
     const Operator* op);
 
   void unpack_1x1W_SSE2(
@@ -328,6 +858,15 @@ struct BLITJIT_API Generator : public GeneratorBase
     const XMMRef& dst0, const XMMRef& a0, const XMMRef& b0,
     const XMMRef& dst1, const XMMRef& a1, const XMMRef& b1);
 
+  //! @brief Divide products (up to 255 * 255) in @a x0 words by 255, 
+  //! precision is selected by @c OptionDiv255Approx and @c OptionDiv255Fast.
+  void div255_1x1W_SSE2(
+    const XMMRef& x0);
+
+  void div255_2x2W_SSE2(
+    const XMMRef& x0,
+    const XMMRef& x1);
+
   void mul_1x1W_SSE2(
     const XMMRef& dst0, const XMMRef& a0, const XMMRef& b0);
 
@@ -398,6 +937,37 @@ struct BLITJIT_API Generator : public GeneratorBase
   inline XMMRef& xmmZero() { return _xmmZero; }
   inline XMMRef& xmm0080() { return _xmm0080; }
 
+  // --------------------------------------------------------------------------
+  // [Closure]
+  // --------------------------------------------------------------------------
+
+  //! @brief Tell to generator that we are using I8 palette, it loads palette
+  //! address from closure to register. Can be called only while closure
+  //! argument is available (see @c _closureArg).
+  void usingPalette();
+
+  inline PtrRef& palette() { return _palette; }
+
+  //! @brief Tell to generator that we are using global opacity, it loads
+  //! opacity from closure and broadcasts it to all words of XMM register.
+  //! Can be called only while closure argument is available.
+  void usingOpacity();
+
+  inline XMMRef& opacity() { return _opacity; }
+
+  //! @brief Jump to @a L_Zero if global opacity is zero and to @a L_Full if
+  //! it's 255 (@a L_Full can be NULL).
+  void checkOpacity(Label* L_Zero, Label* L_Full);
+
+  //! @brief Tell to generator that we are using color key, it loads key 
+  //! color (broadcasted to all dwords) and tolerance (broadcasted to all 
+  //! bytes) from closure. Can be called only while closure argument is 
+  //! available.
+  void usingColorKey();
+
+  inline XMMRef& colorKey() { return _colorKey; }
+  inline XMMRef& colorKeyTolerance() { return _colorKeyTolerance; }
+
   // --------------------------------------------------------------------------
   // [Members]
   // --------------------------------------------------------------------------
@@ -411,10 +981,26 @@ struct BLITJIT_API Generator : public GeneratorBase
   UInt32 _callingConvention;
   //! @brief Tells generator if it should use data prefetching.
   bool _prefetch;
+  //! @brief Source prefetch distance in bytes (0 means kernel class default).
+  SysInt _prefetchSrcDistance;
+  //! @brief Destination prefetch distance in bytes (0 means kernel class default).
+  SysInt _prefetchDstDistance;
+  //! @brief Source prefetch hint, see @c PrefetchHint.
+  UInt32 _prefetchSrcHint;
+  //! @brief Destination prefetch hint, see @c PrefetchHint.
+  UInt32 _prefetchDstHint;
   //! @brief Tells generator to use non-thermal hint for store (movntq, movntdq, movntdqa, ...)
   bool _nonThermalHint;
   //! @brief Tells generator to generate functions with closure parameter.
   bool _closure;
+  //! @brief Generator options, see @c Option.
+  UInt32 _options;
+  //! @brief Row counter used by ordered dithering (only set while generating
+  //! rect functions, NULL otherwise).
+  SysIntRef* _ditherRow;
+  //! @brief Closure argument (only set while module is initialized in
+  //! functions generated with closure, NULL otherwise).
+  PtrRef* _closureArg;
   //! @brief Alignment of main loops.
   SysInt _mainLoopAlignment;
   //! @brief Function body flags.
@@ -434,6 +1020,18 @@ struct BLITJIT_API Generator : public GeneratorBase
 
   //! @brief SSE 0x0080 register (used for multiplication).
   XMMRef _xmm0080;
+
+  //! @brief Address of I8 palette.
+  PtrRef _palette;
+
+  //! @brief Global opacity (broadcasted to all words).
+  XMMRef _opacity;
+
+  //! @brief Color key (broadcasted to all dwords).
+  XMMRef _colorKey;
+
+  //! @brief Color key tolerance (broadcasted to all bytes).
+  XMMRef _colorKeyTolerance;
 };
 
 //! @}
@@ -53,6 +53,11 @@ Module_Blit_32_SSE2::Module_Blit_32_SSE2(
   dstAlphaPos = getARGB32AlphaPos(dstPf);
   srcAlphaPos = getARGB32AlphaPos(srcPf);
 
+  // Source channels are reordered after unpacking, all compositing is then
+  // done in destination order.
+  srcSwizzle = getARGB32Swizzle(dstPf, srcPf);
+  applyOpacity = false;
+
   // First look at NOPs
   if (op->id() == Operator::CompositeDest)
   {
@@ -63,24 +68,21 @@ Module_Blit_32_SSE2::Module_Blit_32_SSE2(
   _maxPixelsPerLoop = 4;
   _complexity = Complex;
 
-  switch (op->id())
-  {
-    case Operator::CompositeSubtract  : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeMultiply  : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeScreen    : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeDarken    : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeLighten   : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeDifference: _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeExclusion : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeInvert    : _maxPixelsPerLoop = 2; break;
-    case Operator::CompositeInvertRgb : _maxPixelsPerLoop = 2; break;
-  }
+  // Kind 0 multiplies source by global opacity, kind 1 is used if opacity
+  // is 255.
+  if (g->useOpacity()) setNumKinds(2);
 }
 
 Module_Blit_32_SSE2::~Module_Blit_32_SSE2()
 {
 }
 
+void Module_Blit_32_SSE2::beginSwitch()
+{
+  // Nothing to do if opacity is zero.
+  if (g->useOpacity()) g->checkOpacity(_bail, getKindLabel(1));
+}
+
 void Module_Blit_32_SSE2::init()
 {
   g->usingConstants();
@@ -103,6 +105,14 @@ void Module_Blit_32_SSE2::processPixelsPtr(
 {
   StateRef state(c->saveState());
 
+  applyOpacity = (kind == 0 && g->useOpacity());
+
+  if (msk)
+  {
+    processPixelsMaskPtr(dst, src, msk, count, offset, flags);
+    return;
+  }
+
   // These are needed in all cases
   XMMRef dstpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
   XMMRef srcpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
@@ -178,19 +188,30 @@ void Module_Blit_32_SSE2::processPixelsPtr(
           SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT, 0));
           SysIntRef k(c->newVariable(VARIABLE_TYPE_SYSINT, 0));
 
+          // Mask of source alpha bytes.
+          UInt32 alphaMask = 0x1111 << srcAlphaPos;
+
           c->pmovmskb(k.r32(), dstpix0.r());
           c->pmovmskb(t.r32(), dstpix1.r());
 
-          c->and_(k.r32(), 0x8888);
+          c->and_(k.r32(), alphaMask);
           c->cmp(t.r32(), 0xFFFF);
           c->jz(L_LocalLoopExit);
 
-          c->cmp(k.r32(), 0x8888);
-          c->jz(L_LocalLoopStore);
+          // Opaque source can be stored directly only if no reordering is
+          // needed and source is not multiplied by opacity.
+          if (srcSwizzle == mm_shuffle(3, 2, 1, 0) && !applyOpacity)
+          {
+            c->cmp(k.r32(), alphaMask);
+            c->jz(L_LocalLoopStore);
+          }
         }
 
         g->loadDQ(dstpix0, ptr(dst->r(), dstDisp), dstAligned);
         g->unpack_4x2W_SSE2(srcpix0, srcpix1, srcpix0, dstpix0, dstpix1, dstpix0);
+        g->swizzle_2x2W_SSE2(srcpix0, srcpix1, srcSwizzle);
+        if (applyOpacity)
+          g->mul_2x2W_SSE2(srcpix0, srcpix0, g->opacity(), srcpix1, srcpix1, g->opacity());
 
         g->extractAlpha_2x2W_SSE2(t0, srcpix0, dstAlphaPos, true, t1, srcpix1, dstAlphaPos, true);
         g->mul_2x2W_SSE2(dstpix0, dstpix0, t0, dstpix1, dstpix1, t1);
@@ -296,6 +317,137 @@ void Module_Blit_32_SSE2::processPixelsPtr(
   }
 }
 
+void Module_Blit_32_SSE2::processPixelsMsk(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  BLITJIT_ASSERT(count == 4 || count == 1);
+
+  applyOpacity = (kind == 0 && g->useOpacity());
+
+  XMMRef dstpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+  XMMRef srcpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+  SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+  SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+  if (count == 4)
+  {
+    XMMRef dstpix1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+    XMMRef srcpix1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+    g->loadDQ(srcpix0, ptr(src->r(), srcDisp), (flags & SrcAligned) != 0);
+    g->loadDQ(dstpix0, ptr(dst->r(), dstDisp), (flags & DstAligned) != 0);
+    processPixelsRawMask_4(dstpix0, srcpix0, dstpix1, srcpix1, msk0);
+    g->storeDQ(ptr(dst->r(), dstDisp), dstpix0, false, (flags & DstAligned) != 0);
+  }
+  else
+  {
+    // Only lowest byte is valid, zero extend it to word.
+    c->punpcklbw(msk0.r(), g->xmmZero().r());
+
+    c->movd(srcpix0.x(), ptr(src->r(), srcDisp));
+    c->movd(dstpix0.x(), ptr(dst->r(), dstDisp));
+    processPixelsRawMask(dstpix0, srcpix0, msk0, false);
+    c->movd(ptr(dst->r(), dstDisp), dstpix0.r());
+  }
+}
+
+void Module_Blit_32_SSE2::processPixelsMaskPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 flags)
+{
+  XMMRef dstpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+  XMMRef srcpix0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+  XMMRef msk0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+  Int32Ref mskVal(c->newVariable(VARIABLE_TYPE_INT32));
+
+  bool srcAligned = (flags & SrcAligned) != 0;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+  SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+  SysInt mskDisp = mskPf->bytesPerPixel() * offset;
+
+  Label* L_LocalLoopExit = c->newLabel();
+
+  switch (count)
+  {
+    case 1: // Process 1 pixel
+    {
+      c->movzx(mskVal.x(), byte_ptr(msk->r(), mskDisp));
+      c->test(mskVal.r(), mskVal.r());
+      c->jz(L_LocalLoopExit);
+      c->movd(msk0.x(), mskVal.c());
+
+      c->movd(srcpix0.x(), ptr(src->r(), srcDisp));
+      c->movd(dstpix0.x(), ptr(dst->r(), dstDisp));
+      processPixelsRawMask(dstpix0, srcpix0, msk0, false);
+      c->movd(ptr(dst->r(), dstDisp), dstpix0.r());
+      break;
+    }
+    case 2: // Process 2 pixels
+    {
+      c->movzx(mskVal.x(), word_ptr(msk->r(), mskDisp));
+      c->test(mskVal.r(), mskVal.r());
+      c->jz(L_LocalLoopExit);
+      c->movd(msk0.x(), mskVal.c());
+
+      c->movq(srcpix0.x(), ptr(src->r(), srcDisp));
+      c->movq(dstpix0.x(), ptr(dst->r(), dstDisp));
+      processPixelsRawMask(dstpix0, srcpix0, msk0, true);
+      c->movq(ptr(dst->r(), dstDisp), dstpix0.r());
+      break;
+    }
+    case 4: // Process 4 pixels
+    {
+      XMMRef dstpix1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef srcpix1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+      Label* L_LocalLoopMasked = c->newLabel();
+      Label* L_LocalLoopStore = c->newLabel();
+
+      c->mov(mskVal.x(), ptr(msk->r(), mskDisp));
+      c->test(mskVal.r(), mskVal.r());
+      c->jz(L_LocalLoopExit);
+
+      g->loadDQ(srcpix0, ptr(src->r(), srcDisp), srcAligned);
+      g->loadDQ(dstpix0, ptr(dst->r(), dstDisp), dstAligned);
+
+      // Fully opaque mask means blit without mask.
+      c->cmp(mskVal.r(), imm(-1));
+      c->jne(L_LocalLoopMasked);
+
+      processPixelsRaw_4(dstpix0, srcpix0, dstpix1, srcpix1,
+        Module_Blit_32_SSE2::Raw4UnpackFromSrc0 |
+        Module_Blit_32_SSE2::Raw4UnpackFromDst0 |
+        Module_Blit_32_SSE2::Raw4PackToDst0);
+      c->jmp(L_LocalLoopStore);
+
+      c->bind(L_LocalLoopMasked);
+      c->movd(msk0.x(), mskVal.c());
+      processPixelsRawMask_4(dstpix0, srcpix0, dstpix1, srcpix1, msk0);
+
+      c->bind(L_LocalLoopStore);
+      g->storeDQ(ptr(dst->r(), dstDisp), dstpix0, false, dstAligned);
+      break;
+    }
+  }
+
+  c->bind(L_LocalLoopExit);
+}
+
 void Module_Blit_32_SSE2::processPixelsRaw(
   const XMMRef& dst0, const XMMRef& src0,
   bool two)
@@ -303,6 +455,8 @@ void Module_Blit_32_SSE2::processPixelsRaw(
   switch (op->id())
   {
     case Operator::CompositeSrc:
+      // reordered or scaled copy needs unpacking
+      if (srcSwizzle != mm_shuffle(3, 2, 1, 0) || applyOpacity) break;
       // copy operation (optimized in frontends and also by Generator itself)
       c->movdqa(dst0.r(), src0.r());
       return;
@@ -314,6 +468,8 @@ void Module_Blit_32_SSE2::processPixelsRaw(
       c->pxor(dst0.r(), dst0.r());
       return;
     case Operator::CompositeAdd:
+      // reordered or scaled add needs unpacking
+      if (srcSwizzle != mm_shuffle(3, 2, 1, 0) || applyOpacity) break;
       // add operation (not needs to be unpacked and packed)
       c->paddusb(dst0.r(), src0.r());
       return;
@@ -324,8 +480,10 @@ void Module_Blit_32_SSE2::processPixelsRaw(
 
   c->punpcklbw(src0.r(), g->xmmZero().r());
   c->punpcklbw(dst0.r(), g->xmmZero().r());
+  g->swizzle_1x1W_SSE2(src0, srcSwizzle);
+  if (applyOpacity) g->mul_1x1W_SSE2(src0, src0, g->opacity());
 
-  g->composite_1x1W_SSE2(dst0, src0, dstAlphaPos, op, two);
+  g->composite_1x1W_SSE2(dst0, src0, dstAlphaPos, op, two, dstPf);
 
   c->packuswb(dst0.r(), dst0.r());
 }
@@ -360,10 +518,14 @@ void Module_Blit_32_SSE2::processPixelsRaw_4(
     c->punpcklbw(dst1.r(), g->xmmZero().r());
   }
 
+  g->swizzle_2x2W_SSE2(src0, src1, srcSwizzle);
+  if (applyOpacity)
+    g->mul_2x2W_SSE2(src0, src0, g->opacity(), src1, src1, g->opacity());
+
   g->composite_2x2W_SSE2(
     dst0, src0, dstAlphaPos,
     dst1, src1, dstAlphaPos,
-    op);
+    op, dstPf);
 
   if (flags & Raw4PackToDst0)
   {
@@ -376,4 +538,755 @@ void Module_Blit_32_SSE2::processPixelsRaw_4(
   }
 }
 
+void Module_Blit_32_SSE2::processPixelsRawMask(
+  const XMMRef& dst0, const XMMRef& src0,
+  const XMMRef& msk0,
+  bool two)
+{
+  c->punpcklbw(src0.r(), g->xmmZero().r());
+  c->punpcklbw(dst0.r(), g->xmmZero().r());
+  g->swizzle_1x1W_SSE2(src0, srcSwizzle);
+
+  if (two)
+  {
+    c->punpcklbw(msk0.r(), g->xmmZero().r());
+    c->punpcklwd(msk0.r(), msk0.r());
+    c->punpckldq(msk0.r(), msk0.r());
+  }
+  else
+  {
+    c->pshuflw(msk0.r(), msk0.r(), imm(mm_shuffle(0, 0, 0, 0)));
+  }
+
+  g->mul_1x1W_SSE2(src0, src0, msk0);
+  if (applyOpacity) g->mul_1x1W_SSE2(src0, src0, g->opacity());
+  g->composite_1x1W_SSE2(dst0, src0, dstAlphaPos, op, two, dstPf);
+
+  c->packuswb(dst0.r(), dst0.r());
+}
+
+void Module_Blit_32_SSE2::processPixelsRawMask_4(
+  const XMMRef& dst0, const XMMRef& src0,
+  const XMMRef& dst1, const XMMRef& src1,
+  const XMMRef& msk0)
+{
+  XMMRef msk1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  c->movdqa(src1.x(), src0.r());
+  c->movdqa(dst1.x(), dst0.r());
+
+  c->punpcklbw(src0.r(), g->xmmZero().r());
+  c->punpckhbw(src1.r(), g->xmmZero().r());
+  c->punpcklbw(dst0.r(), g->xmmZero().r());
+  c->punpckhbw(dst1.r(), g->xmmZero().r());
+
+  g->swizzle_2x2W_SSE2(src0, src1, srcSwizzle);
+
+  c->punpcklbw(msk0.r(), g->xmmZero().r());                    // [  ][  ][  ][  ][ 3][ 2][ 1][ 0]
+  c->pshufd(msk0.r(), msk0.r(), imm(mm_shuffle(1, 0, 1, 0)));  // [ 3][ 2][ 1][ 0][ 3][ 2][ 1][ 0]
+
+  c->pshufhw(msk1.x(), msk0.r(), imm(mm_shuffle(3, 3, 3, 3)));
+  c->pshuflw(msk1.r(), msk1.r(), imm(mm_shuffle(2, 2, 2, 2)));
+  c->pshufhw(msk0.r(), msk0.r(), imm(mm_shuffle(1, 1, 1, 1)));
+  c->pshuflw(msk0.r(), msk0.r(), imm(mm_shuffle(0, 0, 0, 0)));
+
+  g->mul_2x2W_SSE2(src0, src0, msk0, src1, src1, msk1);
+  if (applyOpacity)
+    g->mul_2x2W_SSE2(src0, src0, g->opacity(), src1, src1, g->opacity());
+  g->composite_2x2W_SSE2(
+    dst0, src0, dstAlphaPos,
+    dst1, src1, dstAlphaPos,
+    op, dstPf);
+
+  c->packuswb(dst0.r(), dst1.r());
+}
+
+// ============================================================================
+// [BlitJit::Module_Blit_Generic_SSE2]
+// ============================================================================
+
+Module_Blit_Generic_SSE2::Module_Blit_Generic_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Blit(g, dstPf, srcPf, mskPf, op)
+{
+  // Compositing is done in premultiplied colorspace
+  srcPremultiply = srcPf->isArgb() && !srcPf->isPremultiplied();
+  dstPremultiply = dstPf->isArgb() && !dstPf->isPremultiplied();
+
+  dither = g->useDither(dstPf, srcPf, op);
+
+  // First look at NOPs
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  _maxPixelsPerLoop = 16;
+  _complexity = Complex;
+}
+
+Module_Blit_Generic_SSE2::~Module_Blit_Generic_SSE2()
+{
+}
+
+void Module_Blit_Generic_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+}
+
+void Module_Blit_Generic_SSE2::free()
+{
+}
+
+void Module_Blit_Generic_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    if (i >= 16)
+    {
+      SysInt srcSize = srcPf->bytesPerPixel() * 4;
+
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef dst2(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef dst3(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+      g->loadPixels_4x4B_SSE2(dst0, dst1, dst2, dst3, *dst, dstDisp, dstPf, dstAligned);
+
+      processPixelsPacked(dst0, src, srcDisp              , 4);
+      processPixelsPacked(dst1, src, srcDisp + srcSize    , 4);
+      processPixelsPacked(dst2, src, srcDisp + srcSize * 2, 4);
+      processPixelsPacked(dst3, src, srcDisp + srcSize * 3, 4);
+
+      if (dither)
+      {
+        XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+        c->paddusb(dst0.r(), d0.r());
+        c->paddusb(dst1.r(), d0.r());
+        c->paddusb(dst2.r(), d0.r());
+        c->paddusb(dst3.r(), d0.r());
+      }
+
+      g->storePixels_4x4B_SSE2(*dst, dstDisp, dst0, dst1, dst2, dst3, dstPf, dstAligned);
+
+      offset += 16;
+      i -= 16;
+    }
+    else
+    {
+      SysInt n = (i >= 4) ? 4 : (i >= 2) ? 2 : 1;
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+      g->loadPixels_SSE2(dst0, *dst, dstDisp, dstPf, n, n == 4 && dstAligned);
+      processPixelsPacked(dst0, src, srcDisp, n);
+
+      if (dither)
+      {
+        XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+        c->paddusb(dst0.r(), d0.r());
+      }
+
+      g->storePixels_SSE2(*dst, dstDisp, dst0, dstPf, n, n == 4 && dstAligned);
+
+      offset += n;
+      i -= n;
+    }
+  } while (i > 0);
+}
+
+void Module_Blit_Generic_SSE2::processPixelsPacked(
+  const XMMRef& dst0,
+  const AsmJit::PtrRef* src, SysInt srcDisp,
+  SysInt count)
+{
+  XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+  g->loadPixels_SSE2(src0, *src, srcDisp, srcPf, count, false);
+
+  if (srcPremultiply) g->premultiply_1x1B_SSE2(src0, 3);
+  if (dstPremultiply) g->premultiply_1x1B_SSE2(dst0, 3);
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+      c->movdqa(dst0.x(), src0.c());
+      break;
+    case Operator::CompositeClear:
+      c->pxor(dst0.r(), dst0.r());
+      break;
+    case Operator::CompositeAdd:
+      c->paddusb(dst0.r(), src0.r());
+      break;
+    default:
+      if (count == 4)
+      {
+        XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+        XMMRef src1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+        g->unpack_4x2W_SSE2(src0, src1, src0, dst0, dst1, dst0);
+        g->composite_2x2W_SSE2(
+          dst0, src0, 3,
+          dst1, src1, 3,
+          op);
+        g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      }
+      else
+      {
+        g->unpack_1x1W_SSE2(src0, src0);
+        g->unpack_1x1W_SSE2(dst0, dst0);
+        g->composite_1x1W_SSE2(dst0, src0, 3, op, count == 2);
+        g->pack_1x1W_SSE2(dst0, dst0);
+      }
+      break;
+  }
+
+  if (dstPremultiply) g->demultiply_1x1B_SSE2(dst0, 3);
+}
+
+// ============================================================================
+// [BlitJit::Module_Blit_A8_SSE2]
+// ============================================================================
+
+Module_Blit_A8_SSE2::Module_Blit_A8_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Blit(g, dstPf, srcPf, mskPf, op)
+{
+  // First look at NOPs (Da' = Da)
+  if (op->id() == Operator::CompositeDest || op->id() == Operator::CompositeAtop)
+  {
+    _isNop = true;
+    return;
+  }
+
+  switch (op->id())
+  {
+    case Operator::CompositeClear:
+      _prefetchSrc = false;
+      // ... fall through ...
+    case Operator::CompositeSrc:
+    case Operator::CompositeAtopReverse:
+      _prefetchDst = false;
+      // ... fall through ...
+    case Operator::CompositeAdd:
+      _maxPixelsPerLoop = 64;
+      _complexity = Simple;
+      break;
+    default:
+      _maxPixelsPerLoop = 16;
+      _complexity = Complex;
+      break;
+  }
+
+  // Source alpha multiplied by mask is computed on words.
+  if (mskPf)
+  {
+    _maxPixelsPerLoop = 16;
+    _complexity = Complex;
+  }
+}
+
+Module_Blit_A8_SSE2::~Module_Blit_A8_SSE2()
+{
+}
+
+void Module_Blit_A8_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  if (_complexity == Complex) g->usingXMM0080();
+}
+
+void Module_Blit_A8_SSE2::free()
+{
+}
+
+void Module_Blit_A8_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  // Source alpha is multiplied by A8 mask.
+  if (mskPf)
+  {
+    do {
+      SysInt n = (i >= 16) ? 16 : (i >= 4) ? 4 : 1;
+      SysInt mskDisp = mskPf->bytesPerPixel() * offset;
+
+      XMMRef msk0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadAlpha_SSE2(msk0, *msk, mskDisp, mskPf, n, false);
+      processPixelsRawMask(dst, src, msk0, n, offset, n == 16 && dstAligned);
+
+      offset += n;
+      i -= n;
+    } while (i > 0);
+    return;
+  }
+
+  do {
+    SysInt n = (i >= 16) ? 16 : (i >= 4) ? 4 : 1;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+    bool aligned = n == 16 && dstAligned;
+
+    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    switch (op->id())
+    {
+      case Operator::CompositeSrc:
+      case Operator::CompositeAtopReverse:
+        g->loadAlpha_SSE2(dst0, *src, srcDisp, srcPf, n, false);
+        break;
+
+      case Operator::CompositeClear:
+        c->pxor(dst0.x(), dst0.x());
+        break;
+
+      case Operator::CompositeAdd:
+      {
+        XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, n, aligned);
+        g->loadAlpha_SSE2(src0, *src, srcDisp, srcPf, n, false);
+        c->paddusb(dst0.r(), src0.r());
+        break;
+      }
+
+      default:
+      {
+        XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+        XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+        XMMRef src1(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, n, aligned);
+        g->loadAlpha_SSE2(src0, *src, srcDisp, srcPf, n, false);
+        g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+        g->unpack_2x2W_SSE2(src0, src1, src0);
+        g->compositeAlpha_2x2W_SSE2(
+          dst0, src0,
+          dst1, src1,
+          op);
+        g->pack_2x2W_SSE2(dst0, dst0, dst1);
+        break;
+      }
+    }
+
+    g->storeAlpha_SSE2(*dst, offset, dst0, n, aligned);
+
+    offset += n;
+    i -= n;
+  } while (i > 0);
+}
+
+void Module_Blit_A8_SSE2::processPixelsMsk(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  BLITJIT_ASSERT(dst != NULL);
+  BLITJIT_ASSERT(src != NULL);
+  BLITJIT_ASSERT(count == 4 || count == 1);
+
+  // A1 mask is expanded to 0x00 / 0xFF bytes, it's multiplied with source
+  // in the same way as A8 mask.
+  processPixelsRawMask(dst, src, msk0, count, offset, false);
+}
+
+void Module_Blit_A8_SSE2::processPixelsRawMask(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  bool aligned)
+{
+  XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef src1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef msk1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Clear doesn't depend on source.
+  if (op->id() == Operator::CompositeClear)
+  {
+    c->pxor(dst0.x(), dst0.x());
+    g->storeAlpha_SSE2(*dst, offset, dst0, count, aligned);
+    return;
+  }
+
+  // Sa' = Sa.M
+  g->loadAlpha_SSE2(src0, *src, srcPf->bytesPerPixel() * offset, srcPf, count, false);
+  g->unpack_2x2W_SSE2(src0, src1, src0);
+  g->unpack_2x2W_SSE2(msk0, msk1, msk0);
+  g->mul_2x2W_SSE2(
+    src0, src0, msk0,
+    src1, src1, msk1);
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+    case Operator::CompositeAtopReverse:
+      g->pack_2x2W_SSE2(dst0, src0, src1);
+      break;
+
+    default:
+      g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, count, aligned);
+      g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+      g->compositeAlpha_2x2W_SSE2(
+        dst0, src0,
+        dst1, src1,
+        op);
+      g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      break;
+  }
+
+  g->storeAlpha_SSE2(*dst, offset, dst0, count, aligned);
+}
+
+// ============================================================================
+// [BlitJit::Module_Blit_64_SSE2]
+// ============================================================================
+
+Module_Blit_64_SSE2::Module_Blit_64_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Blit(g, dstPf, srcPf, mskPf, op)
+{
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  if (op->id() == Operator::CompositeClear) _prefetchSrc = false;
+
+  _maxPixelsPerLoop = 4;
+  _complexity = Complex;
+}
+
+Module_Blit_64_SSE2::~Module_Blit_64_SSE2()
+{
+}
+
+void Module_Blit_64_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+
+  // sRGB conversion premultiplies / demultiplies packed pixels.
+  if (g->useLinear(dstPf) || g->useLinear(srcPf)) g->usingXMM0080();
+}
+
+void Module_Blit_64_SSE2::free()
+{
+}
+
+void Module_Blit_64_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt n = (i >= 2) ? 2 : 1;
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+    bool aligned = n == 2 && dstAligned && (offset & 1) == 0;
+
+    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    g->loadPixels_1x1W16_SSE2(dst0, *dst, dstDisp, dstPf, n, aligned);
+    g->loadPixels_1x1W16_SSE2(src0, *src, srcDisp, srcPf, n, false);
+    g->composite_1x1W16_SSE2(dst0, src0, op);
+    g->storePixels_1x1W16_SSE2(*dst, dstDisp, dst0, dstPf, n, aligned);
+
+    offset += n;
+    i -= n;
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_Blit_Float_SSE2]
+// ============================================================================
+
+Module_Blit_Float_SSE2::Module_Blit_Float_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Blit(g, dstPf, srcPf, mskPf, op)
+{
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  if (op->id() == Operator::CompositeClear) _prefetchSrc = false;
+
+  _maxPixelsPerLoop = 4;
+  _complexity = Complex;
+}
+
+Module_Blit_Float_SSE2::~Module_Blit_Float_SSE2()
+{
+}
+
+void Module_Blit_Float_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+}
+
+void Module_Blit_Float_SSE2::free()
+{
+}
+
+void Module_Blit_Float_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+    XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    g->loadPixels_1x1F_SSE2(dst0, *dst, dstDisp, dstPf);
+    g->loadPixels_1x1F_SSE2(src0, *src, srcDisp, srcPf);
+    g->composite_1x1F_SSE2(dst0, src0, op);
+    g->storePixels_1x1F_SSE2(*dst, dstDisp, dst0, dstPf);
+
+    offset++;
+    i--;
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_Blit_ColorKey_SSE2]
+// ============================================================================
+
+Module_Blit_ColorKey_SSE2::Module_Blit_ColorKey_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op) :
+    Module_Blit(g, dstPf, srcPf, NULL, op)
+{
+  _prefetchDst = false;
+  _prefetchSrc = true;
+
+  _maxPixelsPerLoop = 16;
+}
+
+Module_Blit_ColorKey_SSE2::~Module_Blit_ColorKey_SSE2()
+{
+}
+
+void Module_Blit_ColorKey_SSE2::init()
+{
+  g->usingColorKey();
+
+  SysIntRef t(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  rgbMask.use(c->newVariable(VARIABLE_TYPE_XMM, 10));
+  c->mov(t.x32(), imm((Int32)(srcPf->rMask32() | srcPf->gMask32() | srcPf->bMask32())));
+  c->movd(rgbMask.x(), t.c32());
+  c->pshufd(rgbMask.r(), rgbMask.r(), imm(mm_shuffle(0, 0, 0, 0)));
+}
+
+void Module_Blit_ColorKey_SSE2::free()
+{
+}
+
+void Module_Blit_ColorKey_SSE2::keyMask(
+  const XMMRef& k,
+  const XMMRef& src0,
+  const XMMRef& t)
+{
+  // k = |src - key| per byte, saturated subtraction in both directions.
+  c->movdqa(k.x(), src0.r());
+  c->movdqa(t.x(), g->colorKey().r());
+  c->psubusb(k.r(), g->colorKey().r());
+  c->psubusb(t.r(), src0.r());
+  c->por(k.r(), t.r());
+
+  // Bytes within tolerance are zero now, pixel is keyed if all its color
+  // bytes are zero.
+  c->psubusb(k.r(), g->colorKeyTolerance().r());
+  c->pand(k.r(), rgbMask.r());
+  c->pxor(t.x(), t.x());
+  c->pcmpeqd(k.r(), t.r());
+}
+
+void Module_Blit_ColorKey_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  bool srcAligned = (flags & SrcAligned) != 0;
+  bool dstAligned = (flags & DstAligned) != 0;
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    if (i >= 4)
+    {
+      // 4 or 8 pixels, mask bits of both registers are merged to one
+      // 32 bit value, so only one compare is needed for each case.
+      SysInt n = (i >= 8) ? 2 : 1;
+      SysInt j;
+      Int32 allKeyed = (n == 2) ? -1 : 0x0000FFFF;
+
+      XMMRef src0[2];
+      XMMRef k[2];
+      XMMRef t(c->newVariable(VARIABLE_TYPE_XMM));
+      SysIntRef m0(c->newVariable(VARIABLE_TYPE_SYSINT, 0));
+
+      Label* L_LocalLoopExit = c->newLabel();
+      Label* L_LocalLoopStore = c->newLabel();
+
+      for (j = 0; j < n; j++)
+      {
+        src0[j].use(c->newVariable(VARIABLE_TYPE_XMM, 5));
+        k[j].use(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+        g->loadDQ(src0[j], dqword_ptr(src->c(), srcDisp + j * 16), srcAligned);
+        keyMask(k[j], src0[j], t);
+      }
+
+      c->pmovmskb(m0.x32(), k[0].r());
+      if (n == 2)
+      {
+        SysIntRef m1(c->newVariable(VARIABLE_TYPE_SYSINT, 0));
+        c->pmovmskb(m1.x32(), k[1].r());
+        c->shl(m1.r32(), imm(16));
+        c->or_(m0.r32(), m1.r32());
+      }
+
+      c->cmp(m0.r32(), imm(allKeyed));
+      c->jz(L_LocalLoopExit);
+      c->test(m0.r32(), m0.r32());
+      c->jz(L_LocalLoopStore);
+
+      // Mixed block: src = src ^ ((src ^ dst) & k).
+      for (j = 0; j < n; j++)
+      {
+        g->loadDQ(t, dqword_ptr(dst->c(), dstDisp + j * 16), dstAligned);
+        c->pxor(t.r(), src0[j].r());
+        c->pand(t.r(), k[j].r());
+        c->pxor(src0[j].r(), t.r());
+      }
+
+      c->bind(L_LocalLoopStore);
+      for (j = 0; j < n; j++)
+      {
+        g->storeDQ(dqword_ptr(dst->c(), dstDisp + j * 16), src0[j], false, dstAligned);
+      }
+      c->bind(L_LocalLoopExit);
+
+      offset += n * 4;
+      i -= n * 4;
+    }
+    else
+    {
+      XMMRef src0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef k(c->newVariable(VARIABLE_TYPE_XMM, 5));
+      XMMRef t(c->newVariable(VARIABLE_TYPE_XMM));
+      SysIntRef m0(c->newVariable(VARIABLE_TYPE_SYSINT, 0));
+
+      Label* L_LocalLoopExit = c->newLabel();
+
+      c->movd(src0.x(), ptr(src->c(), srcDisp));
+      keyMask(k, src0, t);
+
+      c->pmovmskb(m0.x32(), k.r());
+      c->and_(m0.r32(), imm(0xF));
+      c->cmp(m0.r32(), imm(0xF));
+      c->jz(L_LocalLoopExit);
+
+      c->movd(ptr(dst->c(), dstDisp), src0.r());
+      c->bind(L_LocalLoopExit);
+
+      offset++;
+      i--;
+    }
+  } while (i > 0);
+}
+
 } // BlitJit namespace
@@ -51,6 +51,8 @@ struct BLITJIT_HIDDEN Module_Blit_32_SSE2 : public Module_Blit
     const Operator* op);
   virtual ~Module_Blit_32_SSE2();
 
+  virtual void beginSwitch();
+
   virtual void init();
   virtual void free();
 
@@ -63,6 +65,25 @@ struct BLITJIT_HIDDEN Module_Blit_32_SSE2 : public Module_Blit
     UInt32 kind,
     UInt32 flags);
 
+  virtual void processPixelsMsk(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Process @a count pixels using A8 mask. Fully transparent mask
+  //! is skipped and fully opaque 4 pixel mask is processed without mask.
+  void processPixelsMaskPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 flags);
+
   enum RawFlags
   {
     Raw4UnpackFromDst0 = (1 << 0),
@@ -82,8 +103,231 @@ struct BLITJIT_HIDDEN Module_Blit_32_SSE2 : public Module_Blit
     const AsmJit::XMMRef& dst1, const AsmJit::XMMRef& src1,
     UInt32 flags);
 
+  //! @brief Multiply source pixels by mask and composite them. @a msk0
+  //! contains mask bytes (one or two), content of all registers is 
+  //! destroyed.
+  void processPixelsRawMask(
+    const AsmJit::XMMRef& dst0, const AsmJit::XMMRef& src0,
+    const AsmJit::XMMRef& msk0,
+    bool two);
+
+  //! @brief Multiply 4 source pixels in @a src0 by mask (4 bytes in @a msk0)
+  //! and composite them with 4 pixels in @a dst0. Result is packed to 
+  //! @a dst0.
+  void processPixelsRawMask_4(
+    const AsmJit::XMMRef& dst0, const AsmJit::XMMRef& src0,
+    const AsmJit::XMMRef& dst1, const AsmJit::XMMRef& src1,
+    const AsmJit::XMMRef& msk0);
+
   UInt32 dstAlphaPos;
   UInt32 srcAlphaPos;
+  //! @brief Shuffle that reorders unpacked source pixels to destination
+  //! channel order (see @c getARGB32Swizzle()).
+  UInt32 srcSwizzle;
+  //! @brief True if source is multiplied by global opacity (set for each
+  //! processed block, depends on kind).
+  bool applyOpacity;
+};
+
+// ============================================================================
+// [BlitJit::Module_Blit_Generic_SSE2]
+// ============================================================================
+
+//! @brief Blit module for any pixel format combination.
+//!
+//! Pixels are converted to packed premultiplied ARGB32, composited and then
+//! converted back to destination format. Main loop processes 16 pixels, so
+//! 24 bit destination can be processed in aligned 48 byte blocks.
+struct BLITJIT_HIDDEN Module_Blit_Generic_SSE2 : public Module_Blit
+{
+  Module_Blit_Generic_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Blit_Generic_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Load @a count source pixels and composite them with @a dst0.
+  void processPixelsPacked(
+    const AsmJit::XMMRef& dst0,
+    const AsmJit::PtrRef* src, SysInt srcDisp,
+    SysInt count);
+
+  bool srcPremultiply;
+  bool dstPremultiply;
+  //! @brief Whether to dither pixels stored to 16 bit destination.
+  bool dither;
+};
+
+// ============================================================================
+// [BlitJit::Module_Blit_A8_SSE2]
+// ============================================================================
+
+//! @brief Blit module for A8 destination (mask accumulation).
+//!
+//! Only source alpha is loaded (formats without alpha are opaque). Operators
+//! that can be done on bytes (Src, Clear, Add) process 64 pixels in main
+//! loop, other operators are computed on words and process 16 pixels. If
+//! mask is used, source alpha is multiplied by mask and all operators are
+//! computed on words.
+struct BLITJIT_HIDDEN Module_Blit_A8_SSE2 : public Module_Blit
+{
+  Module_Blit_A8_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Blit_A8_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  virtual void processPixelsMsk(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Multiply @a count source alphas by mask bytes in @a msk0 and
+  //! composite result to destination. Content of @a msk0 is destroyed.
+  void processPixelsRawMask(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    bool aligned);
+};
+
+// ============================================================================
+// [BlitJit::Module_Blit_64_SSE2]
+// ============================================================================
+
+//! @brief Blit module used when source or destination is PRGB64.
+//!
+//! Pixels are expanded to premultiplied 16 bit components and composited
+//! using exact division by 65535, all operators are supported. Two pixels
+//! are processed in one register. The module is also used to composite 8 bit
+//! formats in linear light (see @c OptionLinear).
+struct BLITJIT_HIDDEN Module_Blit_64_SSE2 : public Module_Blit
+{
+  Module_Blit_64_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Blit_64_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+};
+
+// ============================================================================
+// [BlitJit::Module_Blit_Float_SSE2]
+// ============================================================================
+
+//! @brief Blit module used when source or destination is float format.
+//!
+//! Pixels are converted to premultiplied float components (one pixel in 
+//! register) and composited in float, all operators are supported.
+struct BLITJIT_HIDDEN Module_Blit_Float_SSE2 : public Module_Blit
+{
+  Module_Blit_Float_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Blit_Float_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+};
+
+// ============================================================================
+// [BlitJit::Module_Blit_ColorKey_SSE2]
+// ============================================================================
+
+//! @brief Blit module used by color keyed copy (see @c OptionColorKey).
+//!
+//! Source pixels are compared with key color 8 pixels at a time, blocks of
+//! keyed pixels are skipped and blocks without keyed pixels are stored 
+//! directly, destination is read only by mixed blocks.
+struct BLITJIT_HIDDEN Module_Blit_ColorKey_SSE2 : public Module_Blit
+{
+  Module_Blit_ColorKey_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const Operator* op);
+  virtual ~Module_Blit_ColorKey_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Set dwords of @a k to 0xFFFFFFFF if corresponding pixels in 
+  //! @a src0 match key color, @a t is temporary.
+  void keyMask(
+    const AsmJit::XMMRef& k,
+    const AsmJit::XMMRef& src0,
+    const AsmJit::XMMRef& t);
+
+  //! @brief Mask of color bytes (alpha or unused byte is ignored).
+  AsmJit::XMMRef rgbMask;
 };
 
 //! @}
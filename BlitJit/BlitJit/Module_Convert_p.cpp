@@ -0,0 +1,343 @@
+// BlitJit - Just In Time Image Blitting Library for C++ Language.
+
+// Copyright (c) 2008-2009, Petr Kobalicek <kobalicek.petr@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use,
+// copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+
+
+// [Dependencies]
+#include <AsmJit/Compiler.h>
+#include <AsmJit/CpuInfo.h>
+
+#include "BlitJit.h"
+#include "Constants_p.h"
+#include "Generator_p.h"
+#include "Module_p.h"
+#include "Module_Convert_p.h"
+
+using namespace AsmJit;
+
+namespace BlitJit {
+
+// ============================================================================
+// [BlitJit::Module_Convert_SSE2]
+// ============================================================================
+
+Module_Convert_SSE2::Module_Convert_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf) :
+  Module_Blit(g, dstPf, srcPf, NULL, &Api::operators[Operator::CompositeSrc])
+{
+  alphaOp = AlphaNone;
+
+  // Only ARGB formats need alpha conversion. A8 is black color with alpha 
+  // (same if premultiplied or not) and formats without alpha are opaque.
+  if (srcPf->isArgb() && dstPf->isArgb())
+  {
+    if (!srcPf->isPremultiplied() && dstPf->isPremultiplied())
+      alphaOp = AlphaPremultiply;
+    else if (srcPf->isPremultiplied() && !dstPf->isPremultiplied())
+      alphaOp = AlphaDemultiply;
+  }
+
+  dither = g->useDither(dstPf, srcPf, op);
+
+  // 32 bit formats that only differ in channel order are converted by one
+  // shuffle. Source without alpha goes through ARGB32 to be made opaque.
+  direct = srcPf->depth() == 32 && dstPf->depth() == 32 &&
+           alphaOp == AlphaNone && (srcPf->isAlpha() || !dstPf->isAlpha());
+  swizzle = getARGB32Swizzle(dstPf, srcPf);
+
+  // Destination is never read, conversion is pure streaming.
+  _prefetchDst = false;
+  _prefetchSrc = true;
+
+  _maxPixelsPerLoop = 16;
+  _complexity = Complex;
+}
+
+Module_Convert_SSE2::~Module_Convert_SSE2()
+{
+}
+
+void Module_Convert_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+
+  if (alphaOp == AlphaPremultiply) g->usingXMM0080();
+}
+
+void Module_Convert_SSE2::free()
+{
+}
+
+void Module_Convert_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  if (direct)
+  {
+    do {
+      SysInt n = (i >= 4) ? 4 : (i >= 2) ? 2 : 1;
+      SysInt disp = 4 * offset;
+      XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      if (n == 4)
+        g->loadDQ(pix0, ptr(src->c(), disp), false);
+      else if (n == 2)
+        c->movq(pix0.x(), ptr(src->c(), disp));
+      else
+        c->movd(pix0.x(), ptr(src->c(), disp));
+
+      g->swizzle_1x1B_SSE2(pix0, swizzle);
+
+      if (n == 4)
+        g->storeDQ(ptr(dst->c(), disp), pix0, g->nonThermalHint(), dstAligned);
+      else if (n == 2)
+        c->movq(ptr(dst->c(), disp), pix0.r());
+      else
+        c->movd(ptr(dst->c(), disp), pix0.r());
+
+      offset += n;
+      i -= n;
+    } while (i > 0);
+    return;
+  }
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    if (i >= 16)
+    {
+      XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef pix1(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef pix2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef pix3(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadPixels_4x4B_SSE2(pix0, pix1, pix2, pix3, *src, srcDisp, srcPf, false);
+
+      processPixelsPacked(pix0);
+      processPixelsPacked(pix1);
+      processPixelsPacked(pix2);
+      processPixelsPacked(pix3);
+
+      if (dither)
+      {
+        XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+        c->paddusb(pix0.r(), d0.r());
+        c->paddusb(pix1.r(), d0.r());
+        c->paddusb(pix2.r(), d0.r());
+        c->paddusb(pix3.r(), d0.r());
+      }
+
+      g->storePixels_4x4B_SSE2(*dst, dstDisp, pix0, pix1, pix2, pix3, dstPf, dstAligned);
+
+      offset += 16;
+      i -= 16;
+    }
+    else
+    {
+      SysInt n = (i >= 4) ? 4 : (i >= 2) ? 2 : 1;
+      XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadPixels_SSE2(pix0, *src, srcDisp, srcPf, n, false);
+      processPixelsPacked(pix0);
+
+      if (dither)
+      {
+        XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+        c->paddusb(pix0.r(), d0.r());
+      }
+
+      g->storePixels_SSE2(*dst, dstDisp, pix0, dstPf, n, n == 4 && dstAligned);
+
+      offset += n;
+      i -= n;
+    }
+  } while (i > 0);
+}
+
+void Module_Convert_SSE2::processPixelsPacked(
+  const XMMRef& pix0)
+{
+  switch (alphaOp)
+  {
+    case AlphaPremultiply:
+      g->premultiply_1x1B_SSE2(pix0, 3);
+      break;
+    case AlphaDemultiply:
+      g->demultiply_1x1B_SSE2(pix0, 3);
+      break;
+  }
+}
+
+// ============================================================================
+// [BlitJit::Module_Convert64_SSE2]
+// ============================================================================
+
+Module_Convert64_SSE2::Module_Convert64_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf) :
+  Module_Blit(g, dstPf, srcPf, NULL, &Api::operators[Operator::CompositeSrc])
+{
+  // Destination is never read, conversion is pure streaming.
+  _prefetchDst = false;
+  _prefetchSrc = true;
+
+  _maxPixelsPerLoop = 4;
+  _complexity = Complex;
+}
+
+Module_Convert64_SSE2::~Module_Convert64_SSE2()
+{
+}
+
+void Module_Convert64_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+
+  // sRGB conversion premultiplies / demultiplies packed pixels.
+  if (g->useLinear(dstPf) || g->useLinear(srcPf)) g->usingXMM0080();
+}
+
+void Module_Convert64_SSE2::free()
+{
+}
+
+void Module_Convert64_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt n = (i >= 2) ? 2 : 1;
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+    bool aligned = n == 2 && dstAligned && (offset & 1) == 0;
+
+    XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    g->loadPixels_1x1W16_SSE2(pix0, *src, srcDisp, srcPf, n, false);
+    g->storePixels_1x1W16_SSE2(*dst, dstDisp, pix0, dstPf, n, aligned);
+
+    offset += n;
+    i -= n;
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_ConvertFloat_SSE2]
+// ============================================================================
+
+Module_ConvertFloat_SSE2::Module_ConvertFloat_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf) :
+  Module_Blit(g, dstPf, srcPf, NULL, &Api::operators[Operator::CompositeSrc])
+{
+  // Destination is never read, conversion is pure streaming.
+  _prefetchDst = false;
+  _prefetchSrc = true;
+
+  _maxPixelsPerLoop = 4;
+  _complexity = Complex;
+}
+
+Module_ConvertFloat_SSE2::~Module_ConvertFloat_SSE2()
+{
+}
+
+void Module_ConvertFloat_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+}
+
+void Module_ConvertFloat_SSE2::free()
+{
+}
+
+void Module_ConvertFloat_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    XMMRef pix0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    if (dstPf->id() == srcPf->id())
+    {
+      c->movups(pix0.x(), ptr(src->c(), srcDisp));
+      c->movups(ptr(dst->c(), dstDisp), pix0.r());
+    }
+    else
+    {
+      g->loadPixels_1x1F_SSE2(pix0, *src, srcDisp, srcPf);
+      g->storePixels_1x1F_SSE2(*dst, dstDisp, pix0, dstPf);
+    }
+
+    offset++;
+    i--;
+  } while (i > 0);
+}
+
+} // BlitJit namespace
@@ -0,0 +1,158 @@
+// BlitJit - Just In Time Image Blitting Library for C++ Language.
+
+// Copyright (c) 2008-2009, Petr Kobalicek <kobalicek.petr@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use,
+// copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+
+
+// [Guard]
+#ifndef _BLITJIT_MODULE_CONVERT_H
+#define _BLITJIT_MODULE_CONVERT_H
+
+// [Dependencies]
+#include <AsmJit/Compiler.h>
+
+#include "Module_p.h"
+
+namespace BlitJit {
+
+//! @addtogroup BlitJit_Private
+//! @{
+
+// ============================================================================
+// [BlitJit::Module_Convert_SSE2]
+// ============================================================================
+
+//! @brief Pixel format conversion module.
+//!
+//! Pixels are loaded and converted to packed ARGB32, then premultiplied or
+//! demultiplied if needed and stored to destination format. Conversions 
+//! between identical 32 bit formats are handled by @c Module_MemCpy32,
+//! conversions between 32 bit formats that only differ in channel order are
+//! done by one shuffle without going through ARGB32.
+struct BLITJIT_HIDDEN Module_Convert_SSE2 : public Module_Blit
+{
+  Module_Convert_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf);
+  virtual ~Module_Convert_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Premultiply or demultiply packed pixels in @a pix0.
+  void processPixelsPacked(
+    const AsmJit::XMMRef& pix0);
+
+  //! @brief Alpha conversion done between load and store.
+  enum AlphaOp
+  {
+    AlphaNone = 0,
+    AlphaPremultiply = 1,
+    AlphaDemultiply = 2
+  };
+
+  UInt32 alphaOp;
+  //! @brief Whether to dither pixels stored to 16 bit destination.
+  bool dither;
+  //! @brief Whether pixels are only reordered by @c swizzle.
+  bool direct;
+  //! @brief Shuffle used if @c direct is true.
+  UInt32 swizzle;
+};
+
+// ============================================================================
+// [BlitJit::Module_Convert64_SSE2]
+// ============================================================================
+
+//! @brief Pixel format conversion module used when source or destination
+//! is PRGB64.
+//!
+//! Pixels are converted through premultiplied 16 bit components, 8 bit
+//! components are expanded exactly (c * 257) and reduced with rounding.
+struct BLITJIT_HIDDEN Module_Convert64_SSE2 : public Module_Blit
+{
+  Module_Convert64_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf);
+  virtual ~Module_Convert64_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+};
+
+// ============================================================================
+// [BlitJit::Module_ConvertFloat_SSE2]
+// ============================================================================
+
+//! @brief Pixel format conversion module used when source or destination
+//! is float format.
+//!
+//! Pixels are converted through premultiplied float components. Pixels 
+//! between identical formats are copied.
+struct BLITJIT_HIDDEN Module_ConvertFloat_SSE2 : public Module_Blit
+{
+  Module_ConvertFloat_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf);
+  virtual ~Module_ConvertFloat_SSE2();
+
+  virtual void init();
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+};
+
+//! @}
+
+} // BlitJit namespace
+
+// [Guard]
+#endif // _BLITJIT_MODULE_CONVERT_H
@@ -48,6 +48,7 @@ Module_Fill_32_SSE2::Module_Fill_32_SSE2(
 {
   // Calculate correct pixel format positions
   dstAlphaPos = getARGB32AlphaPos(dstPf);
+  srcSwizzle = getARGB32Swizzle(dstPf, srcPf);
 
   // First look at NOPs
   if (op->id() == Operator::CompositeDest)
@@ -68,6 +69,10 @@ Module_Fill_32_SSE2::~Module_Fill_32_SSE2()
 
 void Module_Fill_32_SSE2::beginSwitch()
 {
+  // Nothing to do if opacity is zero, otherwise it's folded to source color
+  // after premultiplication.
+  if (g->useOpacity()) g->checkOpacity(_bail, NULL);
+
   // Expand pixel
   c->movd(srcxmm.x(), srcgp.c32());
   c->pshufd(srcxmm.r(), srcxmm.r(), mm_shuffle(0, 0, 0, 0));
@@ -76,7 +81,16 @@ void Module_Fill_32_SSE2::beginSwitch()
   {
     c->punpcklbw(srcxmm.r(), g->xmmZero().r());
     //c->punpcklqdq(srcxmm.r(), srcxmm.r());
+    g->swizzle_1x1W_SSE2(srcxmm, srcSwizzle);
     g->premultiply_1x1W_SSE2(srcxmm, dstAlphaPos, true);
+    if (g->useOpacity()) g->mul_1x1W_SSE2(srcxmm, srcxmm, g->opacity());
+
+    // Fully opaque mask blocks are filled without mask, CompositeOver 
+    // needs inverted alpha for it.
+    if (op->id() == Operator::CompositeOver)
+    {
+      g->extractAlpha_1x1W_SSE2(alphaxmm, srcxmm, dstAlphaPos, false, true);
+    }
   }
 
   // Check if alpha is 0xFF (255) 
@@ -90,7 +104,9 @@ void Module_Fill_32_SSE2::beginSwitch()
   {
     c->punpcklbw(srcxmm.r(), g->xmmZero().r());
     //c->punpcklqdq(srcxmm.r(), srcxmm.r());
+    g->swizzle_1x1W_SSE2(srcxmm, srcSwizzle);
     g->premultiply_1x1W_SSE2(srcxmm, dstAlphaPos, true);
+    if (g->useOpacity()) g->mul_1x1W_SSE2(srcxmm, srcxmm, g->opacity());
     g->extractAlpha_1x1W_SSE2(alphaxmm, srcxmm, dstAlphaPos, false, true);
   }
 }
@@ -105,7 +121,7 @@ void Module_Fill_32_SSE2::init(PtrRef& _src)
   srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
 
   // Only used as fastpath for CompositeOver operator.
-  if (mskPf == NULL && op->id() == Operator::CompositeOver)
+  if (op->id() == Operator::CompositeOver)
   {
     alphaxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
   }
@@ -193,7 +209,7 @@ void Module_Fill_32_SSE2::processPixelsPtr(
         {
           g->storeDQ(ptr(dst->c(), dstDisp), srcxmm, false, dstAligned);
 
-          offset -= 4;
+          offset += 4;
           i -= 4;
         }
         else if (i >= 1)
@@ -229,15 +245,28 @@ void Module_Fill_32_SSE2::processPixelsPtr(
           Int32Ref mskVal(c->newVariable(VARIABLE_TYPE_INT32));
 
           Label* end = c->newLabel();
+          Label* masked = c->newLabel();
+          Label* store = c->newLabel();
 
+          // Fully transparent mask is skipped, fully opaque mask means fill
+          // without mask.
           c->mov(mskVal.x(), ptr(msk->r(), mskDisp));
           c->test(mskVal.x(), mskVal.x());
           c->jz(end);
-          c->movd(msk0.x(), mskVal.c());
 
           c->movq(dst0.x(), ptr(dst->c(), dstDisp));
           c->movq(dst1.x(), ptr(dst->c(), dstDisp + 8));
+
+          c->cmp(mskVal.x(), imm(-1));
+          c->jne(masked);
+          processPixelsRaw_4(dst0, dst1, 0);
+          c->jmp(store);
+
+          c->bind(masked);
+          c->movd(msk0.x(), mskVal.c());
           processPixelsRawMask_4(dst0, dst1, msk0, 0);
+
+          c->bind(store);
           g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, dstAligned);
 
           c->bind(end);
@@ -317,7 +346,7 @@ void Module_Fill_32_SSE2::processPixelsPtr(
 
           c->bind(end);
 
-          offset -= 4;
+          offset += 4;
           i -= 4;
         }
         else if (i >= 1)
@@ -346,6 +375,45 @@ void Module_Fill_32_SSE2::processPixelsPtr(
   }
 }
 
+void Module_Fill_32_SSE2::processPixelsMsk(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  BLITJIT_ASSERT(dst != NULL);
+  BLITJIT_ASSERT(count == 4 || count == 1);
+
+  XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+  SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+  // Both kinds are processed in the same way, mask is always multiplied
+  // with source.
+  if (count == 4)
+  {
+    XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+
+    c->movq(dst0.x(), ptr(dst->c(), dstDisp));
+    c->movq(dst1.x(), ptr(dst->c(), dstDisp + 8));
+    processPixelsRawMask_4(dst0, dst1, msk0, 0);
+    g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, (flags & DstAligned) != 0);
+  }
+  else
+  {
+    // Only lowest byte is valid, zero extend it to word.
+    c->punpcklbw(msk0.r(), g->xmmZero().r());
+
+    c->movd(dst0.x(), ptr(dst->c(), dstDisp));
+    processPixelsRawMask(dst0, msk0, false);
+    c->movd(ptr(dst->c(), dstDisp), dst0.r());
+  }
+}
+
 void Module_Fill_32_SSE2::processPixelsRaw(
   XMMRef& dst0,
   bool two)
@@ -389,7 +457,7 @@ void Module_Fill_32_SSE2::processPixelsRawMask(
   }
 
   g->mul_1x1W_SSE2(msk0, msk0, srcxmm);
-  g->composite_1x1W_SSE2(dst0, msk0, dstAlphaPos, op, two);
+  g->composite_1x1W_SSE2(dst0, msk0, dstAlphaPos, op, two, dstPf);
   c->packuswb(dst0.r(), dst0.r());
 }
 
@@ -413,7 +481,7 @@ void Module_Fill_32_SSE2::processPixelsRawMask_4(
   c->pshuflw(msk0.r(), msk0.r(), imm(mm_shuffle(0, 0, 0, 0)));
 
   g->mul_2x2W_SSE2(msk0, msk0, srcxmm, msk1, msk1, srcxmm);
-  g->composite_2x2W_SSE2(dst0, msk0, dstAlphaPos, dst1, msk1, dstAlphaPos, op);
+  g->composite_2x2W_SSE2(dst0, msk0, dstAlphaPos, dst1, msk1, dstAlphaPos, op, dstPf);
   c->packuswb(dst0.r(), dst1.r());
 }
 
@@ -428,7 +496,7 @@ void Module_Fill_32_SSE2::processPixelsUnpacked(
   }
   else
   {
-    g->composite_1x1W_SSE2(dst0, srcxmm, dstAlphaPos, op, two);
+    g->composite_1x1W_SSE2(dst0, srcxmm, dstAlphaPos, op, two, dstPf);
   }
 }
 
@@ -443,8 +511,666 @@ void Module_Fill_32_SSE2::processPixelsUnpacked_4(
   }
   else
   {
-    g->composite_2x2W_SSE2(dst0, srcxmm, dstAlphaPos, dst1, srcxmm, dstAlphaPos, op);
+    g->composite_2x2W_SSE2(dst0, srcxmm, dstAlphaPos, dst1, srcxmm, dstAlphaPos, op, dstPf);
+  }
+}
+
+// ============================================================================
+// [BlitJit::Module_Fill_Generic_SSE2]
+// ============================================================================
+
+Module_Fill_Generic_SSE2::Module_Fill_Generic_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Fill(g, dstPf, srcPf, mskPf, op)
+{
+  // Compositing is done in premultiplied colorspace
+  dstPremultiply = dstPf->isArgb() && !dstPf->isPremultiplied();
+
+  dither = g->useDither(dstPf, srcPf, op);
+
+  // First look at NOPs
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  _maxPixelsPerLoop = 16;
+  _complexity = (op->id() == Operator::CompositeSrc) ? Simple : Complex;
+}
+
+Module_Fill_Generic_SSE2::~Module_Fill_Generic_SSE2()
+{
+}
+
+void Module_Fill_Generic_SSE2::init(PtrRef& _src)
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+
+  srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Load source color and premultiply it
+  g->loadPixels_SSE2(srcxmm, _src, 0, srcPf, 1, false);
+  if (srcPf->isArgb() && !srcPf->isPremultiplied())
+    g->premultiply_1x1B_SSE2(srcxmm, 3);
+  c->pshufd(srcxmm.r(), srcxmm.r(), mm_shuffle(0, 0, 0, 0));
+
+  if (op->id() == Operator::CompositeSrc)
+  {
+    // Source color in destination colorspace
+    if (dstPremultiply) g->demultiply_1x1B_SSE2(srcxmm, 3);
+
+    if (dstPf->bytesPerPixel() == 3)
+    {
+      XMMRef t0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      pat0.use(c->newVariable(VARIABLE_TYPE_XMM));
+      pat1.use(c->newVariable(VARIABLE_TYPE_XMM));
+      pat2.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+      c->movdqa(pat0.x(), srcxmm.c());
+      if (dstPf->rShift() == 0) g->swapRB_1x1B_SSE2(pat0);
+
+      c->movdqa(pat1.x(), pat0.c());
+      c->movdqa(pat2.x(), pat0.c());
+      c->movdqa(t0.x(), pat0.c());
+      g->pack24_4x4B_SSE2(pat0, pat1, pat2, t0);
+    }
+    else if (dstPf->bytesPerPixel() == 2 && !dither)
+    {
+      pat0.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+      c->movdqa(pat0.x(), srcxmm.c());
+      g->pack16_1x1B_SSE2(pat0, dstPf);
+      c->pslld(pat0.r(), imm(16));
+      c->psrad(pat0.r(), imm(16));
+      c->packssdw(pat0.r(), pat0.r());
+    }
+  }
+  else
+  {
+    srcwxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+    g->unpack_1x1W_SSE2(srcwxmm, srcxmm);
+  }
+}
+
+void Module_Fill_Generic_SSE2::free()
+{
+  srcxmm.unuse();
+  srcwxmm.unuse();
+  pat0.unuse();
+  pat1.unuse();
+  pat2.unuse();
+}
+
+void Module_Fill_Generic_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  BLITJIT_ASSERT(dst != NULL);
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+  bool nt = g->nonThermalHint();
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+    if (i >= 16)
+    {
+      if (op->id() == Operator::CompositeSrc && dstPf->bytesPerPixel() == 3)
+      {
+        g->storeDQ(ptr(dst->c(), dstDisp     ), pat0, nt, dstAligned);
+        g->storeDQ(ptr(dst->c(), dstDisp + 16), pat1, nt, dstAligned);
+        g->storeDQ(ptr(dst->c(), dstDisp + 32), pat2, nt, dstAligned);
+      }
+      else if (op->id() == Operator::CompositeSrc && dstPf->bytesPerPixel() == 2 && !dither)
+      {
+        g->storeDQ(ptr(dst->c(), dstDisp     ), pat0, nt, dstAligned);
+        g->storeDQ(ptr(dst->c(), dstDisp + 16), pat0, nt, dstAligned);
+      }
+      else
+      {
+        XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+        XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+        XMMRef dst2(c->newVariable(VARIABLE_TYPE_XMM, 5));
+        XMMRef dst3(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+        if (op->id() == Operator::CompositeSrc)
+        {
+          c->movdqa(dst0.x(), srcxmm.c());
+          c->movdqa(dst1.x(), srcxmm.c());
+          c->movdqa(dst2.x(), srcxmm.c());
+          c->movdqa(dst3.x(), srcxmm.c());
+        }
+        else
+        {
+          g->loadPixels_4x4B_SSE2(dst0, dst1, dst2, dst3, *dst, dstDisp, dstPf, dstAligned);
+
+          processPixelsPacked(dst0, 4);
+          processPixelsPacked(dst1, 4);
+          processPixelsPacked(dst2, 4);
+          processPixelsPacked(dst3, 4);
+        }
+
+        if (dither)
+        {
+          XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+          g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+          c->paddusb(dst0.r(), d0.r());
+          c->paddusb(dst1.r(), d0.r());
+          c->paddusb(dst2.r(), d0.r());
+          c->paddusb(dst3.r(), d0.r());
+        }
+
+        g->storePixels_4x4B_SSE2(*dst, dstDisp, dst0, dst1, dst2, dst3, dstPf, dstAligned);
+      }
+
+      offset += 16;
+      i -= 16;
+    }
+    else
+    {
+      SysInt n = (i >= 4) ? 4 : (i >= 2) ? 2 : 1;
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+      if (op->id() == Operator::CompositeSrc)
+      {
+        c->movdqa(dst0.x(), srcxmm.c());
+      }
+      else
+      {
+        g->loadPixels_SSE2(dst0, *dst, dstDisp, dstPf, n, n == 4 && dstAligned);
+        processPixelsPacked(dst0, n);
+      }
+
+      if (dither)
+      {
+        XMMRef d0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadDither_SSE2(d0, *dst, dstDisp, dstPf);
+        c->paddusb(dst0.r(), d0.r());
+      }
+
+      g->storePixels_SSE2(*dst, dstDisp, dst0, dstPf, n, n == 4 && dstAligned);
+
+      offset += n;
+      i -= n;
+    }
+  } while (i > 0);
+}
+
+void Module_Fill_Generic_SSE2::processPixelsPacked(
+  const XMMRef& dst0,
+  SysInt count)
+{
+  if (dstPremultiply) g->premultiply_1x1B_SSE2(dst0, 3);
+
+  switch (op->id())
+  {
+    case Operator::CompositeClear:
+      c->pxor(dst0.r(), dst0.r());
+      break;
+    case Operator::CompositeAdd:
+      c->paddusb(dst0.r(), srcxmm.r());
+      break;
+    default:
+      if (count == 4)
+      {
+        XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM, 5));
+
+        g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+        g->composite_2x2W_SSE2(
+          dst0, srcwxmm, 3,
+          dst1, srcwxmm, 3,
+          op);
+        g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      }
+      else
+      {
+        g->unpack_1x1W_SSE2(dst0, dst0);
+        g->composite_1x1W_SSE2(dst0, srcwxmm, 3, op, count == 2);
+        g->pack_1x1W_SSE2(dst0, dst0);
+      }
+      break;
+  }
+
+  if (dstPremultiply) g->demultiply_1x1B_SSE2(dst0, 3);
+}
+
+// ============================================================================
+// [BlitJit::Module_Fill_A8_SSE2]
+// ============================================================================
+
+Module_Fill_A8_SSE2::Module_Fill_A8_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Fill(g, dstPf, srcPf, mskPf, op)
+{
+  // Source color is loaded only once
+  _prefetchSrc = false;
+
+  // First look at NOPs (Da' = Da)
+  if (op->id() == Operator::CompositeDest || op->id() == Operator::CompositeAtop)
+  {
+    _isNop = true;
+    return;
+  }
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+    case Operator::CompositeAtopReverse:
+    case Operator::CompositeClear:
+      _prefetchDst = false;
+      // ... fall through ...
+    case Operator::CompositeAdd:
+      _maxPixelsPerLoop = 64;
+      _complexity = Simple;
+      break;
+    default:
+      _maxPixelsPerLoop = 16;
+      _complexity = Complex;
+      break;
+  }
+
+  // Source alpha multiplied by mask is computed on words.
+  if (mskPf)
+  {
+    _maxPixelsPerLoop = 16;
+    _complexity = Complex;
+  }
+}
+
+Module_Fill_A8_SSE2::~Module_Fill_A8_SSE2()
+{
+}
+
+void Module_Fill_A8_SSE2::init(PtrRef& _src)
+{
+  g->usingConstants();
+  g->usingXMMZero();
+
+  srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Broadcast source alpha to all bytes
+  g->loadAlpha_SSE2(srcxmm, _src, 0, srcPf, 1, false);
+  c->punpcklbw(srcxmm.r(), srcxmm.r());
+  c->pshuflw(srcxmm.r(), srcxmm.r(), mm_shuffle(0, 0, 0, 0));
+  c->punpcklqdq(srcxmm.r(), srcxmm.r());
+
+  if (_complexity == Complex)
+  {
+    g->usingXMM0080();
+
+    srcwxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+    g->unpack_1x1W_SSE2(srcwxmm, srcxmm);
+  }
+}
+
+void Module_Fill_A8_SSE2::free()
+{
+  srcxmm.unuse();
+  srcwxmm.unuse();
+}
+
+void Module_Fill_A8_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  // Source alpha is multiplied by A8 mask.
+  if (mskPf)
+  {
+    do {
+      SysInt n = (i >= 16) ? 16 : (i >= 4) ? 4 : 1;
+      SysInt mskDisp = mskPf->bytesPerPixel() * offset;
+
+      XMMRef msk0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadAlpha_SSE2(msk0, *msk, mskDisp, mskPf, n, false);
+      processPixelsRawMask(dst, msk0, n, offset, n == 16 && dstAligned);
+
+      offset += n;
+      i -= n;
+    } while (i > 0);
+    return;
+  }
+
+  do {
+    SysInt n = (i >= 16) ? 16 : (i >= 4) ? 4 : 1;
+    bool aligned = n == 16 && dstAligned;
+
+    switch (op->id())
+    {
+      case Operator::CompositeSrc:
+      case Operator::CompositeAtopReverse:
+        g->storeAlpha_SSE2(*dst, offset, srcxmm, n, aligned);
+        break;
+
+      case Operator::CompositeClear:
+      {
+        XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        c->pxor(dst0.x(), dst0.x());
+        g->storeAlpha_SSE2(*dst, offset, dst0, n, aligned);
+        break;
+      }
+
+      case Operator::CompositeAdd:
+      {
+        XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, n, aligned);
+        c->paddusb(dst0.r(), srcxmm.r());
+        g->storeAlpha_SSE2(*dst, offset, dst0, n, aligned);
+        break;
+      }
+
+      default:
+      {
+        XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+        XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+
+        g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, n, aligned);
+        g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+        g->compositeAlpha_2x2W_SSE2(
+          dst0, srcwxmm,
+          dst1, srcwxmm,
+          op);
+        g->pack_2x2W_SSE2(dst0, dst0, dst1);
+        g->storeAlpha_SSE2(*dst, offset, dst0, n, aligned);
+        break;
+      }
+    }
+
+    offset += n;
+    i -= n;
+  } while (i > 0);
+}
+
+void Module_Fill_A8_SSE2::processPixelsMsk(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  BLITJIT_ASSERT(dst != NULL);
+  BLITJIT_ASSERT(count == 4 || count == 1);
+
+  // A1 mask is expanded to 0x00 / 0xFF bytes, it's multiplied with source
+  // in the same way as A8 mask.
+  processPixelsRawMask(dst, msk0, count, offset, false);
+}
+
+void Module_Fill_A8_SSE2::processPixelsRawMask(
+  const AsmJit::PtrRef* dst,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  bool aligned)
+{
+  XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+  XMMRef msk1(c->newVariable(VARIABLE_TYPE_XMM));
+
+  // Clear doesn't depend on source.
+  if (op->id() == Operator::CompositeClear)
+  {
+    c->pxor(dst0.x(), dst0.x());
+    g->storeAlpha_SSE2(*dst, offset, dst0, count, aligned);
+    return;
+  }
+
+  // Sa' = Sa.M
+  g->unpack_2x2W_SSE2(msk0, msk1, msk0);
+  g->mul_2x2W_SSE2(
+    msk0, msk0, srcwxmm,
+    msk1, msk1, srcwxmm);
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+    case Operator::CompositeAtopReverse:
+      g->pack_2x2W_SSE2(dst0, msk0, msk1);
+      break;
+
+    default:
+      g->loadAlpha_SSE2(dst0, *dst, offset, dstPf, count, aligned);
+      g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+      g->compositeAlpha_2x2W_SSE2(
+        dst0, msk0,
+        dst1, msk1,
+        op);
+      g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      break;
   }
+
+  g->storeAlpha_SSE2(*dst, offset, dst0, count, aligned);
+}
+
+// ============================================================================
+// [BlitJit::Module_Fill_64_SSE2]
+// ============================================================================
+
+Module_Fill_64_SSE2::Module_Fill_64_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Fill(g, dstPf, srcPf, mskPf, op)
+{
+  // Source color is loaded only once
+  _prefetchSrc = false;
+
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  _maxPixelsPerLoop = 4;
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+    case Operator::CompositeClear:
+      _prefetchDst = false;
+      _complexity = Simple;
+      break;
+    default:
+      _complexity = Complex;
+      break;
+  }
+}
+
+Module_Fill_64_SSE2::~Module_Fill_64_SSE2()
+{
+}
+
+void Module_Fill_64_SSE2::init(PtrRef& _src)
+{
+  g->usingConstants();
+  g->usingXMMZero();
+
+  // sRGB conversion premultiplies / demultiplies packed pixels.
+  if (g->useLinear(dstPf) || g->useLinear(srcPf)) g->usingXMM0080();
+
+  srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+  g->loadPixels_1x1W16_SSE2(srcxmm, _src, 0, srcPf, 1, false);
+  c->punpcklqdq(srcxmm.r(), srcxmm.r());
+
+  if (op->id() == Operator::CompositeClear) c->pxor(srcxmm.r(), srcxmm.r());
+}
+
+void Module_Fill_64_SSE2::free()
+{
+  srcxmm.unuse();
+}
+
+void Module_Fill_64_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt n = (i >= 2) ? 2 : 1;
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    bool aligned = n == 2 && dstAligned && (offset & 1) == 0;
+
+    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    if (_complexity == Simple)
+    {
+      // Src and Clear (source is already cleared in init()).
+      c->movdqa(dst0.x(), srcxmm.c());
+    }
+    else
+    {
+      g->loadPixels_1x1W16_SSE2(dst0, *dst, dstDisp, dstPf, n, aligned);
+      g->composite_1x1W16_SSE2(dst0, srcxmm, op);
+    }
+
+    g->storePixels_1x1W16_SSE2(*dst, dstDisp, dst0, dstPf, n, aligned);
+
+    offset += n;
+    i -= n;
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_Fill_Float_SSE2]
+// ============================================================================
+
+Module_Fill_Float_SSE2::Module_Fill_Float_SSE2(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const PixelFormat* mskPf,
+  const Operator* op) :
+    Module_Fill(g, dstPf, srcPf, mskPf, op)
+{
+  // Source color is loaded only once
+  _prefetchSrc = false;
+
+  if (op->id() == Operator::CompositeDest)
+  {
+    _isNop = true;
+    return;
+  }
+
+  _maxPixelsPerLoop = 4;
+
+  switch (op->id())
+  {
+    case Operator::CompositeSrc:
+    case Operator::CompositeClear:
+      _prefetchDst = false;
+      _complexity = Simple;
+      break;
+    default:
+      _complexity = Complex;
+      break;
+  }
+}
+
+Module_Fill_Float_SSE2::~Module_Fill_Float_SSE2()
+{
+}
+
+void Module_Fill_Float_SSE2::init(PtrRef& _src)
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+
+  srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+
+  g->loadPixels_1x1F_SSE2(srcxmm, _src, 0, srcPf);
+  if (op->id() == Operator::CompositeClear) c->xorps(srcxmm.r(), srcxmm.r());
+}
+
+void Module_Fill_Float_SSE2::free()
+{
+  srcxmm.unuse();
+}
+
+void Module_Fill_Float_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+    XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+    if (_complexity == Simple)
+    {
+      // Src and Clear (source is already cleared in init()).
+      c->movaps(dst0.x(), srcxmm.c());
+    }
+    else
+    {
+      g->loadPixels_1x1F_SSE2(dst0, *dst, dstDisp, dstPf);
+      g->composite_1x1F_SSE2(dst0, srcxmm, op);
+    }
+
+    g->storePixels_1x1F_SSE2(*dst, dstDisp, dst0, dstPf);
+
+    offset++;
+    i--;
+  } while (i > 0);
 }
 
 } // BlitJit namespace
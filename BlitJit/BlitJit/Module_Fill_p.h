@@ -65,6 +65,15 @@ struct BLITJIT_HIDDEN Module_Fill_32_SSE2 : public Module_Fill
     UInt32 kind,
     UInt32 flags);
 
+  virtual void processPixelsMsk(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
   void processPixelsRaw(
     AsmJit::XMMRef& dst0,
     bool two);
@@ -94,12 +103,190 @@ struct BLITJIT_HIDDEN Module_Fill_32_SSE2 : public Module_Fill
     AsmJit::XMMRef& dst1);
 
   UInt32 dstAlphaPos;
+  //! @brief Shuffle that reorders unpacked source color to destination
+  //! channel order (see @c getARGB32Swizzle()).
+  UInt32 srcSwizzle;
 
   AsmJit::SysIntRef srcgp;
   AsmJit::XMMRef srcxmm;
   AsmJit::XMMRef alphaxmm;
 };
 
+// ============================================================================
+// [BlitJit::Module_Fill_Generic_SSE2]
+// ============================================================================
+
+//! @brief Fill module for any pixel format combination.
+//!
+//! Destination pixels are converted to packed premultiplied ARGB32, 
+//! composited and then converted back. Main loop processes 16 pixels, so 24
+//! bit destination can be processed in aligned 48 byte blocks. CompositeSrc
+//! operator stores precomputed pattern (24 and 16 bit destinations, if not
+//! dithered).
+struct BLITJIT_HIDDEN Module_Fill_Generic_SSE2 : public Module_Fill
+{
+  Module_Fill_Generic_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Fill_Generic_SSE2();
+
+  virtual void init(AsmJit::PtrRef& _src);
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Composite @a count packed pixels in @a dst0 with source color.
+  void processPixelsPacked(
+    const AsmJit::XMMRef& dst0,
+    SysInt count);
+
+  bool dstPremultiply;
+  //! @brief Whether to dither pixels stored to 16 bit destination.
+  bool dither;
+
+  //! @brief Source color (packed ARGB32, in all dwords).
+  AsmJit::XMMRef srcxmm;
+  //! @brief Source color unpacked to words (compositing).
+  AsmJit::XMMRef srcwxmm;
+  //! @brief 48 byte pattern (CompositeSrc and 24 bit destination) or 16 byte
+  //! pattern in @c pat0 (CompositeSrc and 16 bit destination).
+  AsmJit::XMMRef pat0;
+  AsmJit::XMMRef pat1;
+  AsmJit::XMMRef pat2;
+};
+
+// ============================================================================
+// [BlitJit::Module_Fill_A8_SSE2]
+// ============================================================================
+
+//! @brief Fill module for A8 destination (mask accumulation).
+//!
+//! Only alpha of source color is used. Operators that can be done on bytes
+//! (Src, Clear, Add) process 64 pixels in main loop, other operators are 
+//! computed on words and process 16 pixels. If mask is used, source alpha
+//! is multiplied by mask and all operators are computed on words.
+struct BLITJIT_HIDDEN Module_Fill_A8_SSE2 : public Module_Fill
+{
+  Module_Fill_A8_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Fill_A8_SSE2();
+
+  virtual void init(AsmJit::PtrRef& _src);
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  virtual void processPixelsMsk(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Multiply source alpha by @a count mask bytes in @a msk0 and
+  //! composite result to destination. Content of @a msk0 is destroyed.
+  void processPixelsRawMask(
+    const AsmJit::PtrRef* dst,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    bool aligned);
+
+  //! @brief Source alpha (in all bytes).
+  AsmJit::XMMRef srcxmm;
+  //! @brief Source alpha unpacked to words (multiplicative operators).
+  AsmJit::XMMRef srcwxmm;
+};
+
+// ============================================================================
+// [BlitJit::Module_Fill_64_SSE2]
+// ============================================================================
+
+//! @brief Fill module used when source or destination is PRGB64.
+//!
+//! See @c Module_Blit_64_SSE2.
+struct BLITJIT_HIDDEN Module_Fill_64_SSE2 : public Module_Fill
+{
+  Module_Fill_64_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Fill_64_SSE2();
+
+  virtual void init(AsmJit::PtrRef& _src);
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Source color (2 pixels with 16 bit components).
+  AsmJit::XMMRef srcxmm;
+};
+
+// ============================================================================
+// [BlitJit::Module_Fill_Float_SSE2]
+// ============================================================================
+
+//! @brief Fill module used when source or destination is float format.
+//!
+//! See @c Module_Blit_Float_SSE2.
+struct BLITJIT_HIDDEN Module_Fill_Float_SSE2 : public Module_Fill
+{
+  Module_Fill_Float_SSE2(
+    Generator* g,
+    const PixelFormat* dstPf,
+    const PixelFormat* srcPf,
+    const PixelFormat* mskPf,
+    const Operator* op);
+  virtual ~Module_Fill_Float_SSE2();
+
+  virtual void init(AsmJit::PtrRef& _src);
+  virtual void free();
+
+  virtual void processPixelsPtr(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    const AsmJit::PtrRef* msk,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
+  //! @brief Source color (premultiplied float components).
+  AsmJit::XMMRef srcxmm;
+};
+
 //! @}
 
 } // BlitJit namespace
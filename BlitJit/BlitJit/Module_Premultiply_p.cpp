@@ -0,0 +1,248 @@
+// BlitJit - Just In Time Image Blitting Library for C++ Language.
+
+// Copyright (c) 2008-2009, Petr Kobalicek <kobalicek.petr@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use,
+// copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+
+// [Dependencies]
+#include <AsmJit/Compiler.h>
+#include <AsmJit/CpuInfo.h>
+
+#include "BlitJit.h"
+#include "Constants_p.h"
+#include "Generator_p.h"
+#include "Module_p.h"
+#include "Module_Premultiply_p.h"
+
+using namespace AsmJit;
+
+namespace BlitJit {
+
+// ============================================================================
+// [BlitJit::Module_Premultiply_32_SSE2]
+// ============================================================================
+
+Module_Premultiply_32_SSE2::Module_Premultiply_32_SSE2(
+  Generator* g,
+  const PixelFormat* pf) : Module_Filter(g, pf)
+{
+  _maxPixelsPerLoop = 16;
+  _complexity = Complex;
+
+  dstAlphaPos = getARGB32AlphaPos(pf);
+}
+
+Module_Premultiply_32_SSE2::~Module_Premultiply_32_SSE2()
+{
+}
+
+void Module_Premultiply_32_SSE2::init()
+{
+  g->usingConstants();
+  g->usingXMMZero();
+  g->usingXMM0080();
+}
+
+void Module_Premultiply_32_SSE2::free()
+{
+}
+
+void Module_Premultiply_32_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+    if (i >= 8)
+    {
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef dst2(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef dst3(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadDQ(dst0, ptr(dst->c(), dstDisp), dstAligned);
+      g->loadDQ(dst2, ptr(dst->c(), dstDisp + 16), dstAligned);
+
+      g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+      g->unpack_2x2W_SSE2(dst2, dst3, dst2);
+
+      g->premultiply_2x2W_SSE2(
+        dst0, dstAlphaPos,
+        dst1, dstAlphaPos);
+      g->premultiply_2x2W_SSE2(
+        dst2, dstAlphaPos,
+        dst3, dstAlphaPos);
+
+      g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      g->pack_2x2W_SSE2(dst2, dst2, dst3);
+
+      g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, dstAligned);
+      g->storeDQ(ptr(dst->c(), dstDisp + 16), dst2, false, dstAligned);
+
+      offset += 8;
+      i -= 8;
+    }
+    else if (i >= 4)
+    {
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadDQ(dst0, ptr(dst->c(), dstDisp), dstAligned);
+      g->unpack_2x2W_SSE2(dst0, dst1, dst0);
+      g->premultiply_2x2W_SSE2(
+        dst0, dstAlphaPos,
+        dst1, dstAlphaPos);
+      g->pack_2x2W_SSE2(dst0, dst0, dst1);
+      g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, dstAligned);
+
+      offset += 4;
+      i -= 4;
+    }
+    else if (i >= 2)
+    {
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      c->movq(dst0.x(), ptr(dst->c(), dstDisp));
+      c->punpcklbw(dst0.r(), g->xmmZero().r());
+      g->premultiply_1x1W_SSE2(dst0, dstAlphaPos, true);
+      c->packuswb(dst0.r(), dst0.r());
+      c->movq(ptr(dst->c(), dstDisp), dst0.r());
+
+      offset += 2;
+      i -= 2;
+    }
+    else
+    {
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      c->movd(dst0.x(), ptr(dst->c(), dstDisp));
+      c->punpcklbw(dst0.r(), g->xmmZero().r());
+      g->premultiply_1x1W_SSE2(dst0, dstAlphaPos, false);
+      c->packuswb(dst0.r(), dst0.r());
+      c->movd(ptr(dst->c(), dstDisp), dst0.r());
+
+      offset++;
+      i--;
+    }
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_Demultiply_32_SSE2]
+// ============================================================================
+
+Module_Demultiply_32_SSE2::Module_Demultiply_32_SSE2(
+  Generator* g,
+  const PixelFormat* pf) : Module_Filter(g, pf)
+{
+  _maxPixelsPerLoop = 16;
+  _complexity = Complex;
+
+  dstAlphaPos = getARGB32AlphaPos(pf);
+}
+
+Module_Demultiply_32_SSE2::~Module_Demultiply_32_SSE2()
+{
+}
+
+void Module_Demultiply_32_SSE2::init()
+{
+  g->usingConstants();
+}
+
+void Module_Demultiply_32_SSE2::free()
+{
+}
+
+void Module_Demultiply_32_SSE2::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  SysInt i = count;
+  bool dstAligned = (flags & DstAligned) != 0;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+    if (i >= 8)
+    {
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+      XMMRef dst1(c->newVariable(VARIABLE_TYPE_XMM));
+
+      g->loadDQ(dst0, ptr(dst->c(), dstDisp), dstAligned);
+      g->loadDQ(dst1, ptr(dst->c(), dstDisp + 16), dstAligned);
+
+      g->demultiply_1x1B_SSE2(dst0, dstAlphaPos);
+      g->demultiply_1x1B_SSE2(dst1, dstAlphaPos);
+
+      g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, dstAligned);
+      g->storeDQ(ptr(dst->c(), dstDisp + 16), dst1, false, dstAligned);
+
+      offset += 8;
+      i -= 8;
+    }
+    else
+    {
+      SysInt n = (i >= 4) ? 4 : (i >= 2) ? 2 : 1;
+      XMMRef dst0(c->newVariable(VARIABLE_TYPE_XMM));
+
+      if (n == 4)
+        g->loadDQ(dst0, ptr(dst->c(), dstDisp), dstAligned);
+      else if (n == 2)
+        c->movq(dst0.x(), ptr(dst->c(), dstDisp));
+      else
+        c->movd(dst0.x(), ptr(dst->c(), dstDisp));
+
+      g->demultiply_1x1B_SSE2(dst0, dstAlphaPos);
+
+      if (n == 4)
+        g->storeDQ(ptr(dst->c(), dstDisp), dst0, false, dstAligned);
+      else if (n == 2)
+        c->movq(ptr(dst->c(), dstDisp), dst0.r());
+      else
+        c->movd(ptr(dst->c(), dstDisp), dst0.r());
+
+      offset += n;
+      i -= n;
+    }
+  } while (i > 0);
+}
+
+} // BlitJit namespace
@@ -0,0 +1,363 @@
+// BlitJit - Just In Time Image Blitting Library for C++ Language.
+
+// Copyright (c) 2008-2009, Petr Kobalicek <kobalicek.petr@gmail.com>
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use,
+// copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the
+// Software is furnished to do so, subject to the following
+// conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+// WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+// OTHER DEALINGS IN THE SOFTWARE.
+
+// [Dependencies]
+#include <AsmJit/Compiler.h>
+#include <AsmJit/CpuInfo.h>
+
+#include "Generator_p.h"
+#include "Module_Rop_p.h"
+
+using namespace AsmJit;
+
+namespace BlitJit {
+
+// ============================================================================
+// [BlitJit::Rop - Helpers]
+// ============================================================================
+
+// s = s rop d, s contains source pixels. Source is not used by RopNot, s
+// must be all ones in that case (~d == d ^ ~0).
+
+static void ropD(Compiler* c, UInt32 rop, const Register& s, const Mem& d)
+{
+  switch (rop)
+  {
+    case Operator::RopAnd:
+      c->and_(s, d);
+      break;
+    case Operator::RopOr:
+      c->or_(s, d);
+      break;
+    case Operator::RopXor:
+    case Operator::RopNot:
+      c->xor_(s, d);
+      break;
+    case Operator::RopAndNot:
+      c->not_(s);
+      c->and_(s, d);
+      break;
+  }
+}
+
+template<typename RegT, typename OpT>
+static void ropQ(Compiler* c, UInt32 rop, const RegT& s, const OpT& d)
+{
+  switch (rop)
+  {
+    case Operator::RopAnd:
+      c->pand(s, d);
+      break;
+    case Operator::RopOr:
+      c->por(s, d);
+      break;
+    case Operator::RopXor:
+    case Operator::RopNot:
+      c->pxor(s, d);
+      break;
+    case Operator::RopAndNot:
+      c->pandn(s, d);
+      break;
+  }
+}
+
+// ============================================================================
+// [BlitJit::Module_RopFill32]
+// ============================================================================
+
+Module_RopFill32::Module_RopFill32(
+  Generator* g,
+  const PixelFormat* pf,
+  const Operator* op) :
+    Module_Fill(g, pf, NULL, NULL, op)
+{
+  _prefetchDst = true;
+  _prefetchSrc = false;
+
+  srcgp.use(c->newVariable(VARIABLE_TYPE_SYSINT));
+
+  switch (g->optimization())
+  {
+    case OptimizeX86:
+      _maxPixelsPerLoop = 4;
+      break;
+    case OptimizeMMX:
+      srcmm.use(c->newVariable(VARIABLE_TYPE_MM));
+      _maxPixelsPerLoop = 16;
+      break;
+    case OptimizeSSE2:
+      srcxmm.use(c->newVariable(VARIABLE_TYPE_XMM));
+      _maxPixelsPerLoop = 32;
+      break;
+  }
+}
+
+Module_RopFill32::~Module_RopFill32()
+{
+}
+
+void Module_RopFill32::init(PtrRef& _src)
+{
+  // D & ~S is D & (~S) and ~D is D ^ 0xFFFFFFFF, so only and, or and xor
+  // are needed in the loop.
+  switch (op->id())
+  {
+    case Operator::RopNot:
+      c->mov(srcgp.x32(), imm(-1));
+      rop = Operator::RopXor;
+      break;
+    case Operator::RopAndNot:
+      c->mov(srcgp.x32(), ptr(_src.c()));
+      c->not_(srcgp.r32());
+      rop = Operator::RopAnd;
+      break;
+    default:
+      c->mov(srcgp.x32(), ptr(_src.c()));
+      rop = op->id();
+      break;
+  }
+
+  switch (g->optimization())
+  {
+    case OptimizeMMX:
+      c->movd(srcmm.x(), srcgp.c32());
+      c->pshufw(srcmm.r(), srcmm.r(), mm_shuffle(0, 1, 0, 1));
+      break;
+    case OptimizeSSE2:
+      c->movd(srcxmm.x(), srcgp.c32());
+      c->pshufd(srcxmm.r(), srcxmm.r(), mm_shuffle(0, 0, 0, 0));
+      break;
+  }
+}
+
+void Module_RopFill32::free()
+{
+}
+
+void Module_RopFill32::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  bool dstAligned = (flags & DstAligned) != 0;
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+
+    if (g->optimization() == OptimizeSSE2 && i >= 4)
+    {
+      SysInt n = (i >= 16) ? 4 : (i >= 8) ? 2 : 1;
+      SysInt k;
+      XMMRef t[4];
+
+      for (k = 0; k < n; k++)
+      {
+        t[k].use(c->newVariable(VARIABLE_TYPE_XMM));
+        g->loadDQ(t[k], dqword_ptr(dst->c(), dstDisp + k * 16), dstAligned);
+      }
+
+      for (k = 0; k < n; k++) ropQ(c, rop, t[k].r(), srcxmm.r());
+
+      for (k = 0; k < n; k++)
+        g->storeDQ(dqword_ptr(dst->c(), dstDisp + k * 16), t[k], false, dstAligned);
+
+      offset += n * 4;
+      i -= n * 4;
+    }
+    else if (g->optimization() == OptimizeMMX && i >= 2)
+    {
+      SysInt n = (i >= 8) ? 4 : (i >= 4) ? 2 : 1;
+      SysInt k;
+      MMRef t[4];
+
+      for (k = 0; k < n; k++)
+      {
+        t[k].use(c->newVariable(VARIABLE_TYPE_MM));
+        g->loadQ(t[k], qword_ptr(dst->c(), dstDisp + k * 8));
+      }
+
+      for (k = 0; k < n; k++) ropQ(c, rop, t[k].r(), srcmm.r());
+
+      for (k = 0; k < n; k++)
+        g->storeQ(qword_ptr(dst->c(), dstDisp + k * 8), t[k], false);
+
+      offset += n * 2;
+      i -= n * 2;
+    }
+    else
+    {
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_INT32));
+
+      c->mov(t.x32(), srcgp.c32());
+      ropD(c, rop, t.r32(), dword_ptr(dst->c(), dstDisp));
+      g->storeD(dword_ptr(dst->c(), dstDisp), t, false);
+
+      offset++;
+      i--;
+    }
+  } while (i > 0);
+}
+
+// ============================================================================
+// [BlitJit::Module_RopBlit32]
+// ============================================================================
+
+Module_RopBlit32::Module_RopBlit32(
+  Generator* g,
+  const PixelFormat* dstPf,
+  const PixelFormat* srcPf,
+  const Operator* op) :
+  Module_Blit(g, dstPf, srcPf, NULL, op)
+{
+  _prefetchDst = true;
+  _prefetchSrc = op->srcPixelUsed() != 0;
+
+  switch (g->optimization())
+  {
+    case OptimizeX86:
+      _maxPixelsPerLoop = 4;
+      break;
+    case OptimizeMMX:
+      _maxPixelsPerLoop = 16;
+      break;
+    case OptimizeSSE2:
+      _maxPixelsPerLoop = 32;
+      break;
+  }
+}
+
+Module_RopBlit32::~Module_RopBlit32()
+{
+}
+
+void Module_RopBlit32::processPixelsPtr(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  const AsmJit::PtrRef* msk,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  StateRef state(c->saveState());
+
+  bool srcAligned = (flags & SrcAligned) != 0;
+  bool dstAligned = (flags & DstAligned) != 0;
+  bool srcUsed = op->srcPixelUsed() != 0;
+  UInt32 rop = op->id();
+  SysInt i = count;
+
+  do {
+    SysInt dstDisp = dstPf->bytesPerPixel() * offset;
+    SysInt srcDisp = srcPf->bytesPerPixel() * offset;
+
+    if (g->optimization() == OptimizeSSE2 && i >= 4)
+    {
+      SysInt n = (i >= 16) ? 4 : (i >= 8) ? 2 : 1;
+      SysInt k;
+      XMMRef t[4];
+
+      for (k = 0; k < n; k++)
+      {
+        t[k].use(c->newVariable(VARIABLE_TYPE_XMM));
+        if (srcUsed)
+          g->loadDQ(t[k], dqword_ptr(src->c(), srcDisp + k * 16), srcAligned);
+        else
+          c->pcmpeqb(t[k].x(), t[k].x());
+      }
+
+      if (dstAligned)
+      {
+        for (k = 0; k < n; k++) 
+          ropQ(c, rop, t[k].r(), dqword_ptr(dst->c(), dstDisp + k * 16));
+      }
+      else
+      {
+        // Memory operands of SSE2 instructions must be aligned, destination
+        // is loaded through one temporary register.
+        XMMRef d(c->newVariable(VARIABLE_TYPE_XMM));
+
+        for (k = 0; k < n; k++) 
+        {
+          g->loadDQ(d, dqword_ptr(dst->c(), dstDisp + k * 16), false);
+          ropQ(c, rop, t[k].r(), d.r());
+        }
+      }
+
+      for (k = 0; k < n; k++)
+        g->storeDQ(dqword_ptr(dst->c(), dstDisp + k * 16), t[k], false, dstAligned);
+
+      offset += n * 4;
+      i -= n * 4;
+    }
+    else if (g->optimization() == OptimizeMMX && i >= 2)
+    {
+      SysInt n = (i >= 8) ? 4 : (i >= 4) ? 2 : 1;
+      SysInt k;
+      MMRef t[4];
+
+      for (k = 0; k < n; k++)
+      {
+        t[k].use(c->newVariable(VARIABLE_TYPE_MM));
+        if (srcUsed)
+          g->loadQ(t[k], qword_ptr(src->c(), srcDisp + k * 8));
+        else
+          c->pcmpeqb(t[k].x(), t[k].x());
+      }
+
+      for (k = 0; k < n; k++) 
+        ropQ(c, rop, t[k].r(), qword_ptr(dst->c(), dstDisp + k * 8));
+
+      for (k = 0; k < n; k++)
+        g->storeQ(qword_ptr(dst->c(), dstDisp + k * 8), t[k], false);
+
+      offset += n * 2;
+      i -= n * 2;
+    }
+    else
+    {
+      SysIntRef t(c->newVariable(VARIABLE_TYPE_INT32));
+
+      if (srcUsed)
+        g->loadD(t, dword_ptr(src->c(), srcDisp));
+      else
+        c->mov(t.x32(), imm(-1));
+      ropD(c, rop, t.r32(), dword_ptr(dst->c(), dstDisp));
+      g->storeD(dword_ptr(dst->c(), dstDisp), t, false);
+
+      offset++;
+      i--;
+    }
+  } while (i > 0);
+}
+
+} // BlitJit namespace
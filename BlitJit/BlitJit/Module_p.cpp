@@ -91,6 +91,18 @@ void Module::endKind(UInt32 kind)
   }
 }
 
+void Module::processPixelsMsk(
+  const AsmJit::PtrRef* dst,
+  const AsmJit::PtrRef* src,
+  AsmJit::XMMRef& msk0,
+  SysInt count,
+  SysInt offset,
+  UInt32 kind,
+  UInt32 flags)
+{
+  BLITJIT_ASSERT(0);
+}
+
 void Module::setNumKinds(UInt32 kinds)
 {
   while (_labels.length() < kinds)
@@ -79,6 +79,21 @@ struct BLITJIT_HIDDEN Module
     UInt32 kind,
     UInt32 flags) = 0;
 
+  //! @brief Process array of pixels with mask expanded to register.
+  //!
+  //! Used by A1 masks, loop generator expands mask bits to bytes (0x00 or
+  //! 0xFF) and @a msk0 contains @a count (1 or 4) of them in lowest bytes.
+  //! Content of @a msk0 can be destroyed. Default implementation asserts,
+  //! modules that support A1 masks must reimplement it.
+  virtual void processPixelsMsk(
+    const AsmJit::PtrRef* dst,
+    const AsmJit::PtrRef* src,
+    AsmJit::XMMRef& msk0,
+    SysInt count,
+    SysInt offset,
+    UInt32 kind,
+    UInt32 flags);
+
   inline UInt32 maxPixelsPerLoop() const
   { return _maxPixelsPerLoop; }
 
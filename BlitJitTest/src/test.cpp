@@ -2,6 +2,7 @@
 // #define USE_CAIRO 1
 
 // [Includes]
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -722,6 +723,801 @@ struct BenchmarkIt
 
 
 
+// [Verification]
+
+// Generated functions are checked against scalar reference, run "test --verify"
+// (no window is created). Each check prints first few mismatches and returns
+// their count.
+
+// Span lengths, each one uses different part of generated loop (16 pixels
+// main loop and 8, 4, 2, 1 pixel tails).
+static const int verifyChunks[] = { 16, 8, 4, 2, 1 };
+
+// All (color, alpha) pairs, 256 colors for each alpha. Color channels are
+// c, 255 - c and c / 2, so channel order is checked too.
+#define VERIFY_PAIRS 65536
+
+static inline DATA32 verifyPixel(DATA32 c, DATA32 a)
+{
+  return (a << 24) | (c << 16) | ((255 - c) << 8) | (c >> 1);
+}
+
+static int verifyReport(const char* name, int errors, int index, DATA32 input, DATA32 result, DATA32 expected)
+{
+  if (errors < 8)
+  {
+    fprintf(stderr, "%s: pixel %d, %08X -> %08X (expected %08X)\n",
+      name, index, input, result, expected);
+  }
+  return errors + 1;
+}
+
+// round(c * a / 255) for each color channel, alpha is kept.
+static DATA32 verifyPremultiplyRef(DATA32 x)
+{
+  DATA32 a = x >> 24;
+  DATA32 r = a << 24;
+
+  for (int s = 0; s < 24; s += 8)
+    r |= ((((x >> s) & 0xFF) * a + 127) / 255) << s;
+  return r;
+}
+
+// round(c * 255 / a) for each color channel (clamped to 255), transparent
+// pixels are zero.
+static DATA32 verifyDemultiplyRef(DATA32 x)
+{
+  DATA32 a = x >> 24;
+  if (a == 0) return 0;
+
+  DATA32 r = a << 24;
+
+  for (int s = 0; s < 24; s += 8)
+  {
+    DATA32 c = (((x >> s) & 0xFF) * 510 + a) / (a * 2);
+    r |= (c > 255 ? 255 : c) << s;
+  }
+  return r;
+}
+
+static int verify_Premultiply(bool demultiply)
+{
+  const BlitJit::PixelFormat* pf = &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32];
+  const char* name = demultiply ? "Demultiply" : "Premultiply";
+
+  BlitJit::PremultiplyFn fn = demultiply
+    ? (BlitJit::PremultiplyFn)BlitJit::Api::genDemultiply(pf)
+    : BlitJit::Api::genPremultiply(pf);
+
+  if (fn == NULL)
+  {
+    fprintf(stderr, "%s: generator returned NULL\n", name);
+    return 1;
+  }
+
+  DATA32* buf = (DATA32*)malloc(VERIFY_PAIRS * 4);
+  int errors = 0;
+
+  for (size_t k = 0; k < sizeof(verifyChunks) / sizeof(verifyChunks[0]); k++)
+  {
+    int chunk = verifyChunks[k];
+    int i;
+
+    for (i = 0; i < VERIFY_PAIRS; i++) buf[i] = verifyPixel(i & 0xFF, i >> 8);
+    for (i = 0; i < VERIFY_PAIRS; i += chunk) fn(buf + i, chunk);
+
+    for (i = 0; i < VERIFY_PAIRS; i++)
+    {
+      DATA32 input = verifyPixel(i & 0xFF, i >> 8);
+      DATA32 expected = demultiply
+        ? verifyDemultiplyRef(input)
+        : verifyPremultiplyRef(input);
+
+      if (buf[i] != expected) errors = verifyReport(name, errors, i, input, buf[i], expected);
+    }
+  }
+
+  BlitJit::Api::freeFunction((void*)fn);
+  free(buf);
+
+  return errors;
+}
+
+// CompositeIn is pure multiplication (Dca' = Sca.Da, Da' = Sa.Da), so it
+// checks mul_1x1W_SSE2() and mul_2x2W_SSE2() rounding of all products.
+static int verify_Multiply()
+{
+  const BlitJit::PixelFormat* pf = &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::PRGB32];
+
+  BlitJit::BlitSpanFn fn = BlitJit::Api::genBlitSpan(pf, pf,
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeIn]);
+
+  DATA32* dst = (DATA32*)malloc(VERIFY_PAIRS * 4);
+  DATA32* src = (DATA32*)malloc(VERIFY_PAIRS * 4);
+  int errors = 0;
+
+  for (size_t k = 0; k < sizeof(verifyChunks) / sizeof(verifyChunks[0]); k++)
+  {
+    int chunk = verifyChunks[k];
+    int i;
+
+    for (i = 0; i < VERIFY_PAIRS; i++)
+    {
+      DATA32 c = i & 0xFF;
+      src[i] = c * 0x01010101;
+      dst[i] = verifyPixel(0xFF, i >> 8);
+    }
+
+    for (i = 0; i < VERIFY_PAIRS; i += chunk) fn(dst + i, src + i, chunk);
+
+    for (i = 0; i < VERIFY_PAIRS; i++)
+    {
+      DATA32 c = i & 0xFF;
+      DATA32 a = i >> 8;
+      DATA32 expected = ((c * a + 127) / 255) * 0x01010101;
+
+      if (dst[i] != expected) errors = verifyReport("Multiply", errors, i, src[i], dst[i], expected);
+    }
+  }
+
+  BlitJit::Api::freeFunction((void*)fn);
+  free(dst);
+  free(src);
+
+  return errors;
+}
+
+// Separable blend term B (Sa.Da.B(Cs, Cb)) of CompositeOverlay,
+// CompositeColorDodge, CompositeColorBurn, CompositeHardLight and
+// CompositeSoftLight in double precision, all values in [0, 1].
+static double verifyBlendTerm(DATA32 op, double sca, double sa, double dca, double da)
+{
+  switch (op)
+  {
+    case BlitJit::Operator::CompositeOverlay:
+      if (2.0 * dca <= da)
+        return 2.0 * sca * dca;
+      else
+        return sa * da - 2.0 * (da - dca) * (sa - sca);
+
+    case BlitJit::Operator::CompositeHardLight:
+      if (2.0 * sca <= sa)
+        return 2.0 * sca * dca;
+      else
+        return sa * da - 2.0 * (da - dca) * (sa - sca);
+
+    case BlitJit::Operator::CompositeColorDodge:
+    {
+      if (dca == 0.0) return 0.0;
+      if (sca >= sa) return sa * da;
+
+      double t = sa * sa * dca / (sa - sca);
+      return t < sa * da ? t : sa * da;
+    }
+
+    case BlitJit::Operator::CompositeColorBurn:
+    {
+      if (dca >= da) return sa * da;
+      if (sca == 0.0) return 0.0;
+
+      double t = sa * da - sa * sa * (da - dca) / sca;
+      return t > 0.0 ? t : 0.0;
+    }
+
+    case BlitJit::Operator::CompositeSoftLight:
+    {
+      double cb = 0.0;
+      double f;
+
+      if (da > 0.0) cb = dca / da;
+      if (cb > 1.0) cb = 1.0;
+
+      if (2.0 * sca < sa)
+        f = dca * (1.0 - cb);
+      else if (4.0 * dca <= da)
+        f = dca * ((16.0 * cb - 12.0) * cb + 3.0);
+      else
+        f = sqrt(dca * da) - dca;
+
+      return dca * sa + (2.0 * sca - sa) * f;
+    }
+  }
+
+  return 0.0;
+}
+
+// Dca' of operators that are not separable blend modes (as documented in
+// Operator::Id) and of separable blend modes.
+static double verifyBlendColor(DATA32 op, double sca, double sa, double dca, double da)
+{
+  double a = sca * da;
+  double b = dca * sa;
+
+  switch (op)
+  {
+    case BlitJit::Operator::CompositeSubtract:
+      return dca - sca;
+    case BlitJit::Operator::CompositeMultiply:
+      return sca * dca + sca * (1.0 - da) + dca * (1.0 - sa);
+    case BlitJit::Operator::CompositeScreen:
+      return sca + dca - sca * dca;
+    case BlitJit::Operator::CompositeDarken:
+      return (a < b ? a : b) + sca * (1.0 - da) + dca * (1.0 - sa);
+    case BlitJit::Operator::CompositeLighten:
+      return (a > b ? a : b) + sca * (1.0 - da) + dca * (1.0 - sa);
+    case BlitJit::Operator::CompositeDifference:
+      return sca + dca - 2.0 * (a < b ? a : b);
+    case BlitJit::Operator::CompositeExclusion:
+      return sca + dca - 2.0 * sca * dca;
+    case BlitJit::Operator::CompositeInvert:
+      return (da - dca) * sa + dca * (1.0 - sa);
+    case BlitJit::Operator::CompositeInvertRgb:
+      return (da - dca) * sca + dca * (1.0 - sa);
+    default:
+      return verifyBlendTerm(op, sca, sa, dca, da) + sca * (1.0 - da) + dca * (1.0 - sa);
+  }
+}
+
+// Dca' for each color channel and Da' = Sa + Da - Sa.Da (same for all tested
+// operators), rounded to 8 bits.
+static DATA32 verifyBlendRef(DATA32 op, DATA32 d, DATA32 s)
+{
+  double sa = (double)(s >> 24) / 255.0;
+  double da = (double)(d >> 24) / 255.0;
+  DATA32 r = 0;
+
+  for (int i = 0; i < 32; i += 8)
+  {
+    double sca = (double)((s >> i) & 0xFF) / 255.0;
+    double dca = (double)((d >> i) & 0xFF) / 255.0;
+
+    double x = (i == 24)
+      ? sa + da - sa * da
+      : verifyBlendColor(op, sca, sa, dca, da);
+
+    if (x < 0.0) x = 0.0;
+    if (x > 1.0) x = 1.0;
+
+    r |= (DATA32)floor(x * 255.0 + 0.5) << i;
+  }
+
+  return r;
+}
+
+static bool verifyWithinOne(DATA32 a, DATA32 b)
+{
+  for (int i = 0; i < 32; i += 8)
+  {
+    int d = (int)((a >> i) & 0xFF) - (int)((b >> i) & 0xFF);
+    if (d < -1 || d > 1) return false;
+  }
+  return true;
+}
+
+// Each (Sa, Da) pair from the alpha list is checked with all valid colors
+// (Sca <= Sa, Dca <= Da), including fully transparent source and destination.
+static int verify_BlendModes()
+{
+  static const DATA32 ops[] =
+  {
+    BlitJit::Operator::CompositeSubtract,
+    BlitJit::Operator::CompositeMultiply,
+    BlitJit::Operator::CompositeScreen,
+    BlitJit::Operator::CompositeDarken,
+    BlitJit::Operator::CompositeLighten,
+    BlitJit::Operator::CompositeDifference,
+    BlitJit::Operator::CompositeExclusion,
+    BlitJit::Operator::CompositeInvert,
+    BlitJit::Operator::CompositeInvertRgb,
+    BlitJit::Operator::CompositeOverlay,
+    BlitJit::Operator::CompositeColorDodge,
+    BlitJit::Operator::CompositeColorBurn,
+    BlitJit::Operator::CompositeHardLight,
+    BlitJit::Operator::CompositeSoftLight
+  };
+
+  static const DATA32 alphas[] =
+  {
+    0, 1, 2, 17, 34, 51, 68, 85, 102, 119, 127, 128, 136, 153, 170, 187,
+    204, 221, 238, 254, 255
+  };
+
+  const BlitJit::PixelFormat* pf = &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::PRGB32];
+
+  DATA32* dst = (DATA32*)malloc(65536 * 4);
+  DATA32* src = (DATA32*)malloc(65536 * 4);
+  DATA32* org = (DATA32*)malloc(65536 * 4);
+  int errors = 0;
+
+  for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++)
+  {
+    const BlitJit::Operator* op = &BlitJit::Api::operators[ops[o]];
+    BlitJit::BlitSpanFn fn = BlitJit::Api::genBlitSpan(pf, pf, op);
+
+    if (fn == NULL)
+    {
+      fprintf(stderr, "%s: generator returned NULL\n", op->name());
+      errors++;
+      continue;
+    }
+
+    int opErrors = 0;
+
+    for (size_t si = 0; si < sizeof(alphas) / sizeof(alphas[0]); si++)
+    {
+      for (size_t di = 0; di < sizeof(alphas) / sizeof(alphas[0]); di++)
+      {
+        DATA32 sa = alphas[si];
+        DATA32 da = alphas[di];
+        DATA32 sc, dc;
+        int i, k, len = 0;
+
+        // Channels get c, alpha - c and c / 2, so each one sees different
+        // (Sca, Dca) pair.
+        for (sc = 0; sc <= sa; sc++)
+        {
+          for (dc = 0; dc <= da; dc++)
+          {
+            src[len] = (sa << 24) | (sc << 16) | ((sa - sc) << 8) | (sc >> 1);
+            org[len] = (da << 24) | (dc << 16) | ((da - dc) << 8) | (dc >> 1);
+            dst[len] = org[len];
+            len++;
+          }
+        }
+
+        // Chunk sizes are rotated to use all parts of the generated loop.
+        for (i = 0, k = 0; i < len; k++)
+        {
+          int chunk = verifyChunks[k % (sizeof(verifyChunks) / sizeof(verifyChunks[0]))];
+          if (chunk > len - i) chunk = len - i;
+
+          fn(dst + i, src + i, chunk);
+          i += chunk;
+        }
+
+        for (i = 0; i < len; i++)
+        {
+          DATA32 expected = verifyBlendRef(ops[o], org[i], src[i]);
+
+          if (!verifyWithinOne(dst[i], expected))
+          {
+            if (opErrors < 8)
+            {
+              fprintf(stderr, "%s: src %08X, dst %08X -> %08X (expected %08X)\n",
+                op->name(), src[i], org[i], dst[i], expected);
+            }
+            opErrors++;
+          }
+        }
+      }
+    }
+
+    BlitJit::Api::freeFunction((void*)fn);
+    errors += opErrors;
+  }
+
+  free(dst);
+  free(src);
+  free(org);
+
+  return errors;
+}
+
+// Lum(), Sat(), SetSat() and SetLum() with ClipColor() as defined by W3C
+// compositing specification, colors are [R, G, B] in [0, 1].
+static double verifyLum(const double* c)
+{
+  return 0.3 * c[0] + 0.59 * c[1] + 0.11 * c[2];
+}
+
+static double verifyMin3(const double* c)
+{
+  double n = c[0];
+  if (c[1] < n) n = c[1];
+  if (c[2] < n) n = c[2];
+  return n;
+}
+
+static double verifyMax3(const double* c)
+{
+  double x = c[0];
+  if (c[1] > x) x = c[1];
+  if (c[2] > x) x = c[2];
+  return x;
+}
+
+static void verifySetSat(double* c, double sat)
+{
+  double n = verifyMin3(c);
+  double x = verifyMax3(c);
+
+  for (int i = 0; i < 3; i++)
+    c[i] = (x > n) ? (c[i] - n) * sat / (x - n) : 0.0;
+}
+
+static void verifySetLum(double* c, double l)
+{
+  double d = l - verifyLum(c);
+  int i;
+
+  for (i = 0; i < 3; i++) c[i] += d;
+
+  l = verifyLum(c);
+
+  double n = verifyMin3(c);
+  double x = verifyMax3(c);
+
+  if (n < 0.0)
+  {
+    for (i = 0; i < 3; i++) c[i] = l + (c[i] - l) * l / (l - n);
+  }
+
+  if (x > 1.0)
+  {
+    for (i = 0; i < 3; i++) c[i] = l + (c[i] - l) * (1.0 - l) / (x - l);
+  }
+}
+
+// CompositeHue, CompositeSaturation, CompositeColor and CompositeLuminosity
+// of two pixels in @a pf format, computed in double precision and rounded.
+static DATA32 verifyNonSeparableRef(DATA32 op, DATA32 d, DATA32 s, const BlitJit::PixelFormat* pf)
+{
+  const DATA32 shift[4] = { pf->rShift(), pf->gShift(), pf->bShift(), pf->aShift() };
+
+  double sa = (double)((s >> shift[3]) & 0xFF) / 255.0;
+  double da = (double)((d >> shift[3]) & 0xFF) / 255.0;
+
+  // Premultiplied colors (Sca, Dca) and colors (Sc, Dc).
+  double sca[3], dca[3];
+  double sc[3], dc[3];
+  int i;
+
+  for (i = 0; i < 3; i++)
+  {
+    sca[i] = (double)((s >> shift[i]) & 0xFF) / 255.0;
+    dca[i] = (double)((d >> shift[i]) & 0xFF) / 255.0;
+
+    if (!pf->isPremultiplied())
+    {
+      sca[i] *= sa;
+      dca[i] *= da;
+    }
+
+    sc[i] = (sa > 0.0) ? sca[i] / sa : 0.0;
+    dc[i] = (da > 0.0) ? dca[i] / da : 0.0;
+  }
+
+  double b[3];
+
+  switch (op)
+  {
+    case BlitJit::Operator::CompositeHue:
+      memcpy(b, sc, sizeof(b));
+      verifySetSat(b, verifyMax3(dc) - verifyMin3(dc));
+      verifySetLum(b, verifyLum(dc));
+      break;
+    case BlitJit::Operator::CompositeSaturation:
+      memcpy(b, dc, sizeof(b));
+      verifySetSat(b, verifyMax3(sc) - verifyMin3(sc));
+      verifySetLum(b, verifyLum(dc));
+      break;
+    case BlitJit::Operator::CompositeColor:
+      memcpy(b, sc, sizeof(b));
+      verifySetLum(b, verifyLum(dc));
+      break;
+    default:
+      memcpy(b, dc, sizeof(b));
+      verifySetLum(b, verifyLum(sc));
+      break;
+  }
+
+  double ra = sa + da - sa * da;
+  DATA32 r = (DATA32)floor(ra * 255.0 + 0.5) << shift[3];
+
+  for (i = 0; i < 3; i++)
+  {
+    double x = b[i] * sa * da + sca[i] * (1.0 - da) + dca[i] * (1.0 - sa);
+
+    if (!pf->isPremultiplied()) x = (ra > 0.0) ? x / ra : 0.0;
+    if (x < 0.0) x = 0.0;
+    if (x > 1.0) x = 1.0;
+
+    r |= (DATA32)floor(x * 255.0 + 0.5) << shift[i];
+  }
+
+  return r;
+}
+
+// Random pixel in @a pf with alpha @a a (colors premultiplied if @a pf is
+// premultiplied).
+static DATA32 verifyRandomPixel(DATA32* seed, DATA32 a, const BlitJit::PixelFormat* pf)
+{
+  const DATA32 shift[3] = { pf->rShift(), pf->gShift(), pf->bShift() };
+  DATA32 p = a << pf->aShift();
+
+  for (int i = 0; i < 3; i++)
+  {
+    *seed = *seed * 1103515245 + 12345;
+
+    DATA32 c = (*seed >> 16) & 0xFF;
+    if (pf->isPremultiplied()) c = c * a / 255;
+
+    p |= c << shift[i];
+  }
+
+  return p;
+}
+
+// Non-separable blend modes use approximate reciprocals in 8 bit paths and
+// luminance weights depend on channel order. PRGB32 is checked with random
+// colors of all pairs from the alpha list, ARGB32 and ABGR32 (swapped red
+// and blue) with random opaque colors, where premultiplication and
+// demultiplication are exact. Results must be within +-1.
+static int verify_NonSeparable()
+{
+  static const DATA32 ops[] =
+  {
+    BlitJit::Operator::CompositeHue,
+    BlitJit::Operator::CompositeSaturation,
+    BlitJit::Operator::CompositeColor,
+    BlitJit::Operator::CompositeLuminosity
+  };
+
+  static const DATA32 formats[] =
+  {
+    BlitJit::PixelFormat::PRGB32,
+    BlitJit::PixelFormat::ARGB32,
+    BlitJit::PixelFormat::ABGR32
+  };
+
+  static const DATA32 alphas[] =
+  {
+    0, 1, 2, 17, 34, 51, 68, 85, 102, 119, 127, 128, 136, 153, 170, 187,
+    204, 221, 238, 254, 255
+  };
+
+  enum { Count = 4096 };
+
+  DATA32* dst = (DATA32*)malloc(Count * 4);
+  DATA32* src = (DATA32*)malloc(Count * 4);
+  DATA32* org = (DATA32*)malloc(Count * 4);
+  int errors = 0;
+
+  for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++)
+  {
+    const BlitJit::PixelFormat* pf = &BlitJit::Api::pixelFormats[formats[f]];
+
+    for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++)
+    {
+      const BlitJit::Operator* op = &BlitJit::Api::operators[ops[o]];
+      BlitJit::BlitSpanFn fn = BlitJit::Api::genBlitSpan(pf, pf, op);
+
+      if (fn == NULL)
+      {
+        fprintf(stderr, "%s %s: generator returned NULL\n", pf->name(), op->name());
+        errors++;
+        continue;
+      }
+
+      size_t numAlphas = pf->isPremultiplied() ? sizeof(alphas) / sizeof(alphas[0]) : 1;
+      DATA32 seed = 1;
+      int opErrors = 0;
+
+      for (size_t si = 0; si < numAlphas; si++)
+      {
+        for (size_t di = 0; di < numAlphas; di++)
+        {
+          DATA32 sa = pf->isPremultiplied() ? alphas[si] : 255;
+          DATA32 da = pf->isPremultiplied() ? alphas[di] : 255;
+          int len = pf->isPremultiplied() ? 256 : Count;
+          int i, k;
+
+          for (i = 0; i < len; i++)
+          {
+            src[i] = verifyRandomPixel(&seed, sa, pf);
+            org[i] = verifyRandomPixel(&seed, da, pf);
+            dst[i] = org[i];
+          }
+
+          // Chunk sizes are rotated to use all parts of the generated loop.
+          for (i = 0, k = 0; i < len; k++)
+          {
+            int chunk = verifyChunks[k % (sizeof(verifyChunks) / sizeof(verifyChunks[0]))];
+            if (chunk > len - i) chunk = len - i;
+
+            fn(dst + i, src + i, chunk);
+            i += chunk;
+          }
+
+          for (i = 0; i < len; i++)
+          {
+            DATA32 expected = verifyNonSeparableRef(ops[o], org[i], src[i], pf);
+
+            if (!verifyWithinOne(dst[i], expected))
+            {
+              if (opErrors < 8)
+              {
+                fprintf(stderr, "%s %s: src %08X, dst %08X -> %08X (expected %08X)\n",
+                  pf->name(), op->name(), src[i], org[i], dst[i], expected);
+              }
+              opErrors++;
+            }
+          }
+        }
+      }
+
+      BlitJit::Api::freeFunction((void*)fn);
+      errors += opErrors;
+    }
+  }
+
+  free(dst);
+  free(src);
+  free(org);
+
+  return errors;
+}
+
+// Limited range YUV to RGB in double precision, matrix is derived from Kr
+// and Kb of BT.601 and BT.709.
+static DATA32 verifyYuvRef(DATA32 matrix, int y, int u, int v)
+{
+  double kr = (matrix == BlitJit::YuvBT601) ? 0.299 : 0.2126;
+  double kb = (matrix == BlitJit::YuvBT601) ? 0.114 : 0.0722;
+  double kg = 1.0 - kr - kb;
+
+  double ly = (double)(y - 16) * 255.0 / 219.0;
+  double cu = (double)(u - 128) * 255.0 / 112.0;
+  double cv = (double)(v - 128) * 255.0 / 112.0;
+
+  double rgb[3];
+  rgb[0] = ly + cv * (1.0 - kr);
+  rgb[1] = ly - cu * (1.0 - kb) * kb / kg - cv * (1.0 - kr) * kr / kg;
+  rgb[2] = ly + cu * (1.0 - kb);
+
+  DATA32 r = 0xFF000000;
+
+  for (int i = 0; i < 3; i++)
+  {
+    double x = rgb[i];
+
+    if (x < 0.0) x = 0.0;
+    if (x > 255.0) x = 255.0;
+
+    r |= (DATA32)floor(x + 0.5) << (16 - i * 8);
+  }
+
+  return r;
+}
+
+// Random planes are converted to ARGB32 and compared with double precision
+// reference within +-1. Widths 1 to 17 use all combinations of 4, 2 and 1
+// pixel tails (odd widths included), pixels right of the rect must not be
+// touched.
+static int verify_Yuv(DATA32 layout, DATA32 matrix)
+{
+  static const char* layoutNames[] = { "NV12", "I420", "YUY2" };
+  static const int widths[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 13, 15, 16, 17, 31, 64 };
+
+  enum { MaxW = 64, H = 6 };
+
+  const BlitJit::PixelFormat* pf = &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32];
+
+  char name[32];
+  sprintf(name, "%s/%s", layoutNames[layout],
+    matrix == BlitJit::YuvBT601 ? "BT601" : "BT709");
+
+  BlitJit::ConvertYuvRectFn fn = BlitJit::Api::genConvertYuvRect(pf, layout, matrix);
+  if (fn == NULL)
+  {
+    fprintf(stderr, "%s: generator returned NULL\n", name);
+    return 1;
+  }
+
+  static DATA8 planes[3][MaxW * 2 * H];
+  static DATA32 dst[(MaxW + 1) * H];
+
+  // Y plane holds YUY2 macro pixels, U plane holds NV12 UV pairs.
+  BlitJit::SysInt yStride = (layout == BlitJit::YuvYUY2) ? MaxW * 2 : MaxW;
+  BlitJit::SysInt uStride = (layout == BlitJit::YuvNV12) ? MaxW : MaxW / 2;
+  BlitJit::SysInt dstStride = (MaxW + 1) * 4;
+
+  BlitJit::YuvImage img;
+  img.planes[0] = planes[0];
+  img.planes[1] = planes[1];
+  img.planes[2] = planes[2];
+  img.strides[0] = yStride;
+  img.strides[1] = uStride;
+  img.strides[2] = uStride;
+
+  DATA32 seed = 1;
+  int errors = 0;
+
+  for (size_t k = 0; k < sizeof(widths) / sizeof(widths[0]); k++)
+  {
+    int w = widths[k];
+
+    for (int run = 0; run < 256; run++)
+    {
+      int i, x, y;
+
+      for (i = 0; i < 3; i++)
+      {
+        for (x = 0; x < MaxW * 2 * H; x++)
+        {
+          seed = seed * 1103515245 + 12345;
+          planes[i][x] = (DATA8)(seed >> 16);
+        }
+      }
+
+      memset(dst, 0, sizeof(dst));
+      fn(dst, &img, dstStride, w, H);
+
+      for (y = 0; y < H; y++)
+      {
+        DATA32* dstRow = dst + y * (MaxW + 1);
+
+        // Pixel right of the rect.
+        if (dstRow[w] != 0)
+          errors = verifyReport(name, errors, y * w + w, 0, dstRow[w], 0);
+
+        for (x = 0; x < w; x++)
+        {
+          int yy, uu, vv;
+
+          switch (layout)
+          {
+            case BlitJit::YuvNV12:
+              yy = planes[0][y * yStride + x];
+              uu = planes[1][(y / 2) * uStride + (x / 2) * 2];
+              vv = planes[1][(y / 2) * uStride + (x / 2) * 2 + 1];
+              break;
+            case BlitJit::YuvI420:
+              yy = planes[0][y * yStride + x];
+              uu = planes[1][(y / 2) * uStride + x / 2];
+              vv = planes[2][(y / 2) * uStride + x / 2];
+              break;
+            default:
+              yy = planes[0][y * yStride + x * 2];
+              uu = planes[0][y * yStride + (x / 2) * 4 + 1];
+              vv = planes[0][y * yStride + (x / 2) * 4 + 3];
+              break;
+          }
+
+          DATA32 input = (yy << 16) | (uu << 8) | vv;
+          DATA32 expected = verifyYuvRef(matrix, yy, uu, vv);
+
+          if (!verifyWithinOne(dstRow[x], expected))
+            errors = verifyReport(name, errors, y * w + x, input, dstRow[x], expected);
+        }
+      }
+    }
+  }
+
+  BlitJit::Api::freeFunction((void*)fn);
+  return errors;
+}
+
+static int verifyAll()
+{
+  int errors = 0;
+
+  errors += verify_Premultiply(false);
+  errors += verify_Premultiply(true);
+  errors += verify_Multiply();
+  errors += verify_BlendModes();
+  errors += verify_NonSeparable();
+
+  for (DATA32 layout = 0; layout < BlitJit::YuvLayoutCount; layout++)
+  {
+    errors += verify_Yuv(layout, BlitJit::YuvBT601);
+    errors += verify_Yuv(layout, BlitJit::YuvBT709);
+  }
+
+  fprintf(stderr, "Verification %s (%d errors)\n", errors ? "failed" : "passed", errors);
+  return errors != 0;
+}
+
 struct Application
 {
   Application();
@@ -737,6 +1533,13 @@ struct Application
 
   int test_BlitJit_Blit(int count);
   int test_BlitJit_Blend(int count);
+  int test_BlitJit_BlendLinear(int count);
+  int test_BlitJit_BlendOpacity(int count);
+  int test_BlitJit_BlendPrecision(int count, BlitJit::UInt32 options);
+  int test_BlitJit_Rop(int count);
+  int test_BlitJit_ColorKey(int count);
+  int test_BlitJit_Scaled(int count, BlitJit::UInt32 step);
+  int test_BlitJit_Filtered(int count, BlitJit::UInt32 step, BlitJit::UInt32 edgeMode);
 
   int test_Sdl_Blit(int count);
   int test_Sdl_Blend(int count);
@@ -842,6 +1645,17 @@ void Application::onRender()
 #if 1
   // printf("BlitJit - Copy: %d\n", test_BlitJit_Blit(count));
   // printf("BlitJit - Blend: %d\n", test_BlitJit_Blend(count));
+  // printf("BlitJit - Blend (linear): %d\n", test_BlitJit_BlendLinear(count));
+  // printf("BlitJit - Blend (opacity): %d\n", test_BlitJit_BlendOpacity(count));
+  // printf("BlitJit - Blend (div255 exact): %d\n", test_BlitJit_BlendPrecision(count, 0));
+  // printf("BlitJit - Blend (div255 approx): %d\n", test_BlitJit_BlendPrecision(count, BlitJit::OptionDiv255Approx));
+  // printf("BlitJit - Blend (div255 fast): %d\n", test_BlitJit_BlendPrecision(count, BlitJit::OptionDiv255Fast));
+  // printf("BlitJit - Rop (xor): %d\n", test_BlitJit_Rop(count));
+  // printf("BlitJit - Color key: %d\n", test_BlitJit_ColorKey(count));
+  // printf("BlitJit - Scaled (2x): %d\n", test_BlitJit_Scaled(count, 0x8000));
+  // printf("BlitJit - Scaled (1.5x): %d\n", test_BlitJit_Scaled(count, 0xAAAA));
+  // printf("BlitJit - Filtered (1.5x): %d\n", test_BlitJit_Filtered(count, 0xAAAA, BlitJit::EdgePad));
+  // printf("BlitJit - Filtered (1/2x, repeat): %d\n", test_BlitJit_Filtered(count, 0x20000, BlitJit::EdgeRepeat));
 
   // printf("Sdl - Copy: %d\n", test_Sdl_Blit(count));
   // printf("Sdl - Blend: %d\n", test_Sdl_Blend(count));
@@ -1010,6 +1824,259 @@ int Application::test_BlitJit_Blend(int count)
   return benchmark.delta();
 }
 
+// Same loop as test_BlitJit_BlendPrecision(count, 0), but compositing is
+// done in linear light, compare with it to get the cost of OptionLinear.
+int Application::test_BlitJit_BlendLinear(int count)
+{
+  BlitJit::BlitRectFn blitRect = BlitJit::Api::genBlitRect(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeOver],
+    BlitJit::OptionLinear);
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    AbstractImage* s = img[0];
+    int x = rand() % (screen->w() - s->w());
+    int y = rand() % (screen->h() - s->h());
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)s->w(), (BlitJit::SysUInt)s->h());
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+
+  return benchmark.t;
+}
+
+int Application::test_BlitJit_BlendOpacity(int count)
+{
+  BlitJit::BlitRectClosureFn blitRect = BlitJit::Api::genBlitRectClosure(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeOver],
+    BlitJit::OptionOpacity);
+
+  BlitJit::Closure closure;
+  closure.palette = NULL;
+  closure.maskOffset = 0;
+  closure.opacity = 128;
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    AbstractImage* s = img[0];
+    int x = rand() % (screen->w() - s->w());
+    int y = rand() % (screen->h() - s->h());
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)s->w(), (BlitJit::SysUInt)s->h(),
+      &closure);
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+
+  return benchmark.t;
+}
+
+// Raster operators should run at the same speed as test_BlitJit_Blit().
+int Application::test_BlitJit_Rop(int count)
+{
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    AbstractImage* s = img[0];
+    screen->blit(
+      rand() % (screen->w() - s->w()), rand() % (screen->h() - s->h()),
+      s,
+      BlitJit::Operator::RopXor);
+  }
+
+  return benchmark.delta();
+}
+
+// Color keyed copy, magenta is transparent.
+int Application::test_BlitJit_ColorKey(int count)
+{
+  BlitJit::BlitRectClosureFn blitRect = BlitJit::Api::genBlitRectClosure(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::XRGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::XRGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeSrc],
+    BlitJit::OptionColorKey);
+
+  BlitJit::Closure closure;
+  closure.palette = NULL;
+  closure.maskOffset = 0;
+  closure.opacity = 255;
+  closure.colorKey = 0x00FF00FF;
+  closure.colorKeyTolerance = 8;
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    AbstractImage* s = img[0];
+    int x = rand() % (screen->w() - s->w());
+    int y = rand() % (screen->h() - s->h());
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)s->w(), (BlitJit::SysUInt)s->h(),
+      &closure);
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+
+  return benchmark.t;
+}
+
+// Nearest neighbour scaled blend of img[0], step is 16.16 source step per
+// destination pixel (0x8000 is 2x zoom).
+int Application::test_BlitJit_Scaled(int count, BlitJit::UInt32 step)
+{
+  BlitJit::ScaledBlitRectFn blitRect = BlitJit::Api::genScaledBlitRect(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeOver]);
+
+  AbstractImage* s = img[0];
+  int w = (int)(((BlitJit::UInt64)s->w() << 16) / step);
+  int h = (int)(((BlitJit::UInt64)s->h() << 16) / step);
+
+  if (w > screen->w() - 1) w = screen->w() - 1;
+  if (h > screen->h() - 1) h = screen->h() - 1;
+
+  // Row buffer (16 byte aligned).
+  void* bufferMem = malloc(w * 4 + 16);
+
+  BlitJit::ScaleParams scale;
+  scale.srcX = 0;
+  scale.srcY = 0;
+  scale.stepX = step;
+  scale.stepY = step;
+  scale.buffer = (void*)(((BlitJit::SysUInt)bufferMem + 15) & ~(BlitJit::SysUInt)15);
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    int x = rand() % (screen->w() - w);
+    int y = rand() % (screen->h() - h);
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)w, (BlitJit::SysUInt)h,
+      &scale, NULL);
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+  free(bufferMem);
+
+  return benchmark.t;
+}
+
+// Bilinear filtered blend of img[0], step is 16.16 source step per
+// destination pixel. Destination rect is always 256x256, source is tiled
+// or padded by edgeMode when it's smaller than the scaled rect.
+int Application::test_BlitJit_Filtered(int count, BlitJit::UInt32 step, BlitJit::UInt32 edgeMode)
+{
+  BlitJit::FilteredBlitRectFn blitRect = BlitJit::Api::genFilteredBlitRect(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeOver]);
+
+  AbstractImage* s = img[0];
+  int w = 256;
+  int h = 256;
+
+  // Tables and row buffer (16 byte aligned).
+  void* bufferMem = malloc(BlitJit::Api::filterBufferSize(w, h) + 16);
+
+  BlitJit::FilterParams filter;
+  filter.srcX = (BlitJit::Int32)(step / 2) - 0x8000;
+  filter.srcY = (BlitJit::Int32)(step / 2) - 0x8000;
+  filter.stepX = (BlitJit::Int32)step;
+  filter.stepY = (BlitJit::Int32)step;
+  filter.srcWidth = s->w();
+  filter.srcHeight = s->h();
+  filter.edgeMode = edgeMode;
+  filter.buffer = (void*)(((BlitJit::SysUInt)bufferMem + 15) & ~(BlitJit::SysUInt)15);
+
+  BlitJit::Api::prepareFilter(&filter, w, h);
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    int x = rand() % (screen->w() - w);
+    int y = rand() % (screen->h() - h);
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)w, (BlitJit::SysUInt)h,
+      &filter, NULL);
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+  free(bufferMem);
+
+  return benchmark.t;
+}
+
+// Blend with given division by 255 precision (OptionDiv255Approx or
+// OptionDiv255Fast, 0 is exact), compare with each other to get the cost of
+// correct rounding.
+int Application::test_BlitJit_BlendPrecision(int count, BlitJit::UInt32 options)
+{
+  BlitJit::BlitRectFn blitRect = BlitJit::Api::genBlitRect(
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::pixelFormats[BlitJit::PixelFormat::ARGB32],
+    &BlitJit::Api::operators[BlitJit::Operator::CompositeOver],
+    options);
+
+  BenchmarkIt benchmark;
+  benchmark.start();
+
+  for (int i = 0; i < count; i++)
+  {
+    AbstractImage* s = img[0];
+    int x = rand() % (screen->w() - s->w());
+    int y = rand() % (screen->h() - s->h());
+
+    blitRect(
+      screen->scanline() + y * screen->stride() + x * 4, s->scanline(),
+      (BlitJit::SysInt)screen->stride(), (BlitJit::SysInt)s->stride(),
+      (BlitJit::SysUInt)s->w(), (BlitJit::SysUInt)s->h());
+  }
+
+  benchmark.delta();
+  BlitJit::Api::freeFunction((void*)blitRect);
+
+  return benchmark.t;
+}
+
 // Test SDL library speed
 int Application::test_Sdl_Blit(int count)
 {
@@ -1207,6 +2274,8 @@ int Application::test_Cairo_Blend(int count)
 int main(int argc, char* argv[])
 //int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+  if (argc > 1 && strcmp(argv[1], "--verify") == 0) return verifyAll();
+
   Application app;
   return app.run(940, 540, 32);
 }